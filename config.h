@@ -0,0 +1,420 @@
+/* Automatically generated by configure - do not modify! */
+#define FFMPEG_CONFIGURATION " --disable-v4l --disable-v4l2 --enable-gpl --enable-pthreads --extra-cflags=-fgnu89-inline -fcommon "
+#define ARCH_X86_64 1
+#define TUNECPU generic
+#define HAVE_MMX 1
+#define __CPU__ 586
+#define HAVE_BUILTIN_VECTOR 1
+#define HAVE_MM3DNOW 1
+#define HAVE_LOCALTIME_R 1
+#define HAVE_SENDFILE 1
+#define HAVE_SYS_MMAN_H 1
+#define HAVE_RECVMMSG 1
+#define HAVE_PTHREADS 1
+#define HAVE_THREADS 1
+#define HAVE_LRINTF 1
+#define HAVE_VHOOK 1
+#define CONFIG_ENCODERS 1
+#define CONFIG_DECODERS 1
+#define CONFIG_MUXERS 1
+#define CONFIG_DEMUXERS 1
+#define CONFIG_MPEGAUDIO_HP 1
+#define CONFIG_DV1394 1
+#define CONFIG_HAVE_DLOPEN 1
+#define CONFIG_HAVE_DLFCN 1
+#define CONFIG_AUDIO_OSS 1
+#define CONFIG_NETWORK 1
+#define CONFIG_IPV6 1
+#define CONFIG_ZLIB 1
+#define HAVE_MALLOC_H 1
+#define HAVE_MEMALIGN 1
+#define SIMPLE_IDCT 1
+#define CONFIG_PROTOCOLS 1
+#define CONFIG_FFSERVER 1
+#define CONFIG_GPL 1
+#define restrict restrict
+#define CONFIG_OGGVORBIS_DECODER 1
+#define CONFIG_H263_DECODER 1
+#define CONFIG_H261_DECODER 1
+#define CONFIG_MPEG4_DECODER 1
+#define CONFIG_MSMPEG4V1_DECODER 1
+#define CONFIG_MSMPEG4V2_DECODER 1
+#define CONFIG_MSMPEG4V3_DECODER 1
+#define CONFIG_WMV1_DECODER 1
+#define CONFIG_WMV2_DECODER 1
+#define CONFIG_VC1_DECODER 1
+#define CONFIG_WMV3_DECODER 1
+#define CONFIG_H263I_DECODER 1
+#define CONFIG_FLV_DECODER 1
+#define CONFIG_RV10_DECODER 1
+#define CONFIG_RV20_DECODER 1
+#define CONFIG_SVQ1_DECODER 1
+#define CONFIG_SVQ3_DECODER 1
+#define CONFIG_WMAV1_DECODER 1
+#define CONFIG_WMAV2_DECODER 1
+#define CONFIG_INDEO2_DECODER 1
+#define CONFIG_INDEO3_DECODER 1
+#define CONFIG_TSCC_DECODER 1
+#define CONFIG_CSCD_DECODER 1
+#define CONFIG_NUV_DECODER 1
+#define CONFIG_ULTI_DECODER 1
+#define CONFIG_QDRAW_DECODER 1
+#define CONFIG_XL_DECODER 1
+#define CONFIG_QPEG_DECODER 1
+#define CONFIG_LOCO_DECODER 1
+#define CONFIG_KMVC_DECODER 1
+#define CONFIG_WNV1_DECODER 1
+#define CONFIG_AASC_DECODER 1
+#define CONFIG_FRAPS_DECODER 1
+#define CONFIG_AAC_DECODER 1
+#define CONFIG_MPEG4AAC_DECODER 1
+#define CONFIG_MPEG1VIDEO_DECODER 1
+#define CONFIG_MPEG2VIDEO_DECODER 1
+#define CONFIG_MPEGVIDEO_DECODER 1
+#define CONFIG_MPEG_XVMC_DECODER 1
+#define CONFIG_DVVIDEO_DECODER 1
+#define CONFIG_MJPEG_DECODER 1
+#define CONFIG_MJPEGB_DECODER 1
+#define CONFIG_SP5X_DECODER 1
+#define CONFIG_PNG_DECODER 1
+#define CONFIG_MP2_DECODER 1
+#define CONFIG_MP3_DECODER 1
+#define CONFIG_MP3ADU_DECODER 1
+#define CONFIG_MP3ON4_DECODER 1
+#define CONFIG_MACE3_DECODER 1
+#define CONFIG_MACE6_DECODER 1
+#define CONFIG_HUFFYUV_DECODER 1
+#define CONFIG_FFVHUFF_DECODER 1
+#define CONFIG_FFV1_DECODER 1
+#define CONFIG_SNOW_DECODER 1
+#define CONFIG_CYUV_DECODER 1
+#define CONFIG_H264_DECODER 1
+#define CONFIG_VP3_DECODER 1
+#define CONFIG_THEORA_DECODER 1
+#define CONFIG_ASV1_DECODER 1
+#define CONFIG_ASV2_DECODER 1
+#define CONFIG_VCR1_DECODER 1
+#define CONFIG_CLJR_DECODER 1
+#define CONFIG_FOURXM_DECODER 1
+#define CONFIG_MDEC_DECODER 1
+#define CONFIG_ROQ_DECODER 1
+#define CONFIG_INTERPLAY_VIDEO_DECODER 1
+#define CONFIG_XAN_WC3_DECODER 1
+#define CONFIG_RPZA_DECODER 1
+#define CONFIG_CINEPAK_DECODER 1
+#define CONFIG_MSRLE_DECODER 1
+#define CONFIG_MSVIDEO1_DECODER 1
+#define CONFIG_VQA_DECODER 1
+#define CONFIG_IDCIN_DECODER 1
+#define CONFIG_EIGHTBPS_DECODER 1
+#define CONFIG_SMC_DECODER 1
+#define CONFIG_FLIC_DECODER 1
+#define CONFIG_TRUEMOTION1_DECODER 1
+#define CONFIG_TRUEMOTION2_DECODER 1
+#define CONFIG_VMDVIDEO_DECODER 1
+#define CONFIG_VMDAUDIO_DECODER 1
+#define CONFIG_MSZH_DECODER 1
+#define CONFIG_ZLIB_DECODER 1
+#define CONFIG_ZMBV_DECODER 1
+#define CONFIG_SMACKER_DECODER 1
+#define CONFIG_SMACKAUD_DECODER 1
+#define CONFIG_SONIC_DECODER 1
+#define CONFIG_AC3_DECODER 1
+#define CONFIG_DTS_DECODER 1
+#define CONFIG_RA_144_DECODER 1
+#define CONFIG_RA_288_DECODER 1
+#define CONFIG_ROQ_DPCM_DECODER 1
+#define CONFIG_INTERPLAY_DPCM_DECODER 1
+#define CONFIG_XAN_DPCM_DECODER 1
+#define CONFIG_SOL_DPCM_DECODER 1
+#define CONFIG_QTRLE_DECODER 1
+#define CONFIG_FLAC_DECODER 1
+#define CONFIG_SHORTEN_DECODER 1
+#define CONFIG_ALAC_DECODER 1
+#define CONFIG_WS_SND1_DECODER 1
+#define CONFIG_VORBIS_DECODER 1
+#define CONFIG_LIBGSM_DECODER 1
+#define CONFIG_QDM2_DECODER 1
+#define CONFIG_COOK_DECODER 1
+#define CONFIG_TRUESPEECH_DECODER 1
+#define CONFIG_TTA_DECODER 1
+#define CONFIG_AVS_DECODER 1
+#define CONFIG_CAVS_DECODER 1
+#define CONFIG_RAWVIDEO_DECODER 1
+#define CONFIG_FLASHSV_DECODER 1
+#define CONFIG_AMR_NB_DECODER 1
+#define CONFIG_AMR_WB_DECODER 1
+#define CONFIG_BMP_DECODER 1
+#define CONFIG_MMVIDEO_DECODER 1
+#define CONFIG_PCM_S32LE_DECODER 1
+#define CONFIG_PCM_S32BE_DECODER 1
+#define CONFIG_PCM_U32LE_DECODER 1
+#define CONFIG_PCM_U32BE_DECODER 1
+#define CONFIG_PCM_S24LE_DECODER 1
+#define CONFIG_PCM_S24BE_DECODER 1
+#define CONFIG_PCM_U24LE_DECODER 1
+#define CONFIG_PCM_U24BE_DECODER 1
+#define CONFIG_PCM_S24DAUD_DECODER 1
+#define CONFIG_PCM_S16LE_DECODER 1
+#define CONFIG_PCM_S16BE_DECODER 1
+#define CONFIG_PCM_U16LE_DECODER 1
+#define CONFIG_PCM_U16BE_DECODER 1
+#define CONFIG_PCM_S8_DECODER 1
+#define CONFIG_PCM_U8_DECODER 1
+#define CONFIG_PCM_ALAW_DECODER 1
+#define CONFIG_PCM_MULAW_DECODER 1
+#define CONFIG_ADPCM_IMA_QT_DECODER 1
+#define CONFIG_ADPCM_IMA_WAV_DECODER 1
+#define CONFIG_ADPCM_IMA_DK3_DECODER 1
+#define CONFIG_ADPCM_IMA_DK4_DECODER 1
+#define CONFIG_ADPCM_IMA_WS_DECODER 1
+#define CONFIG_ADPCM_IMA_SMJPEG_DECODER 1
+#define CONFIG_ADPCM_MS_DECODER 1
+#define CONFIG_ADPCM_4XM_DECODER 1
+#define CONFIG_ADPCM_XA_DECODER 1
+#define CONFIG_ADPCM_ADX_DECODER 1
+#define CONFIG_ADPCM_EA_DECODER 1
+#define CONFIG_ADPCM_G726_DECODER 1
+#define CONFIG_ADPCM_CT_DECODER 1
+#define CONFIG_ADPCM_SWF_DECODER 1
+#define CONFIG_ADPCM_YAMAHA_DECODER 1
+#define CONFIG_ADPCM_SBPRO_4_DECODER 1
+#define CONFIG_ADPCM_SBPRO_3_DECODER 1
+#define CONFIG_ADPCM_SBPRO_2_DECODER 1
+#define CONFIG_DVDSUB_DECODER 1
+#define CONFIG_DVBSUB_DECODER 1
+#define CONFIG_AC3_ENCODER 1
+#define CONFIG_MP2_ENCODER 1
+#define CONFIG_MP3LAME_ENCODER 1
+#define CONFIG_OGGVORBIS_ENCODER 1
+#define CONFIG_FAAC_ENCODER 1
+#define CONFIG_FLAC_ENCODER 1
+#define CONFIG_XVID_ENCODER 1
+#define CONFIG_MPEG1VIDEO_ENCODER 1
+#define CONFIG_H264_ENCODER 1
+#define CONFIG_MPEG2VIDEO_ENCODER 1
+#define CONFIG_H261_ENCODER 1
+#define CONFIG_H263_ENCODER 1
+#define CONFIG_H263P_ENCODER 1
+#define CONFIG_FLV_ENCODER 1
+#define CONFIG_RV10_ENCODER 1
+#define CONFIG_RV20_ENCODER 1
+#define CONFIG_MPEG4_ENCODER 1
+#define CONFIG_MSMPEG4V1_ENCODER 1
+#define CONFIG_MSMPEG4V2_ENCODER 1
+#define CONFIG_MSMPEG4V3_ENCODER 1
+#define CONFIG_WMV1_ENCODER 1
+#define CONFIG_WMV2_ENCODER 1
+#define CONFIG_SVQ1_ENCODER 1
+#define CONFIG_MJPEG_ENCODER 1
+#define CONFIG_LJPEG_ENCODER 1
+#define CONFIG_JPEGLS_ENCODER 1
+#define CONFIG_PNG_ENCODER 1
+#define CONFIG_PPM_ENCODER 1
+#define CONFIG_PGM_ENCODER 1
+#define CONFIG_PGMYUV_ENCODER 1
+#define CONFIG_PBM_ENCODER 1
+#define CONFIG_PAM_ENCODER 1
+#define CONFIG_HUFFYUV_ENCODER 1
+#define CONFIG_FFVHUFF_ENCODER 1
+#define CONFIG_ASV1_ENCODER 1
+#define CONFIG_ASV2_ENCODER 1
+#define CONFIG_FFV1_ENCODER 1
+#define CONFIG_SNOW_ENCODER 1
+#define CONFIG_ZLIB_ENCODER 1
+#define CONFIG_DVVIDEO_ENCODER 1
+#define CONFIG_SONIC_ENCODER 1
+#define CONFIG_SONIC_LS_ENCODER 1
+#define CONFIG_X264_ENCODER 1
+#define CONFIG_LIBGSM_ENCODER 1
+#define CONFIG_RAWVIDEO_ENCODER 1
+#define CONFIG_AMR_NB_ENCODER 1
+#define CONFIG_AMR_WB_ENCODER 1
+#define CONFIG_PCM_S32LE_ENCODER 1
+#define CONFIG_PCM_S32BE_ENCODER 1
+#define CONFIG_PCM_U32LE_ENCODER 1
+#define CONFIG_PCM_U32BE_ENCODER 1
+#define CONFIG_PCM_S24LE_ENCODER 1
+#define CONFIG_PCM_S24BE_ENCODER 1
+#define CONFIG_PCM_U24LE_ENCODER 1
+#define CONFIG_PCM_U24BE_ENCODER 1
+#define CONFIG_PCM_S24DAUD_ENCODER 1
+#define CONFIG_PCM_S16LE_ENCODER 1
+#define CONFIG_PCM_S16BE_ENCODER 1
+#define CONFIG_PCM_U16LE_ENCODER 1
+#define CONFIG_PCM_U16BE_ENCODER 1
+#define CONFIG_PCM_S8_ENCODER 1
+#define CONFIG_PCM_U8_ENCODER 1
+#define CONFIG_PCM_ALAW_ENCODER 1
+#define CONFIG_PCM_MULAW_ENCODER 1
+#define CONFIG_ADPCM_IMA_QT_ENCODER 1
+#define CONFIG_ADPCM_IMA_WAV_ENCODER 1
+#define CONFIG_ADPCM_IMA_DK3_ENCODER 1
+#define CONFIG_ADPCM_IMA_DK4_ENCODER 1
+#define CONFIG_ADPCM_IMA_WS_ENCODER 1
+#define CONFIG_ADPCM_IMA_SMJPEG_ENCODER 1
+#define CONFIG_ADPCM_MS_ENCODER 1
+#define CONFIG_ADPCM_4XM_ENCODER 1
+#define CONFIG_ADPCM_XA_ENCODER 1
+#define CONFIG_ADPCM_ADX_ENCODER 1
+#define CONFIG_ADPCM_EA_ENCODER 1
+#define CONFIG_ADPCM_G726_ENCODER 1
+#define CONFIG_ADPCM_CT_ENCODER 1
+#define CONFIG_ADPCM_SWF_ENCODER 1
+#define CONFIG_ADPCM_YAMAHA_ENCODER 1
+#define CONFIG_ADPCM_SBPRO_4_ENCODER 1
+#define CONFIG_ADPCM_SBPRO_3_ENCODER 1
+#define CONFIG_ADPCM_SBPRO_2_ENCODER 1
+#define CONFIG_DVDSUB_ENCODER 1
+#define CONFIG_DVBSUB_ENCODER 1
+#define CONFIG_MPEGVIDEO_PARSER 1
+#define CONFIG_MPEG4VIDEO_PARSER 1
+#define CONFIG_CAVSVIDEO_PARSER 1
+#define CONFIG_H261_PARSER 1
+#define CONFIG_H263_PARSER 1
+#define CONFIG_H264_PARSER 1
+#define CONFIG_MJPEG_PARSER 1
+#define CONFIG_PNM_PARSER 1
+#define CONFIG_MPEGAUDIO_PARSER 1
+#define CONFIG_AC3_PARSER 1
+#define CONFIG_DVDSUB_PARSER 1
+#define CONFIG_DVBSUB_PARSER 1
+#define CONFIG_AAC_PARSER 1
+#define CONFIG_FOURXM_DEMUXER 1
+#define CONFIG_AIFF_DEMUXER 1
+#define CONFIG_AMR_DEMUXER 1
+#define CONFIG_ASF_DEMUXER 1
+#define CONFIG_AU_DEMUXER 1
+#define CONFIG_AUDIO_DEMUXER 1
+#define CONFIG_AVI_DEMUXER 1
+#define CONFIG_AVS_DEMUXER 1
+#define CONFIG_DAUD_DEMUXER 1
+#define CONFIG_DC1394_DEMUXER 1
+#define CONFIG_DV1394_DEMUXER 1
+#define CONFIG_DV_DEMUXER 1
+#define CONFIG_EA_DEMUXER 1
+#define CONFIG_FFM_DEMUXER 1
+#define CONFIG_FLIC_DEMUXER 1
+#define CONFIG_FLV_DEMUXER 1
+#define CONFIG_GIF_DEMUXER 1
+#define CONFIG_GXF_DEMUXER 1
+#define CONFIG_IDCIN_DEMUXER 1
+#define CONFIG_ROQ_DEMUXER 1
+#define CONFIG_IMAGE2_DEMUXER 1
+#define CONFIG_IMAGE2PIPE_DEMUXER 1
+#define CONFIG_IMAGE_DEMUXER 1
+#define CONFIG_IMAGEPIPE_DEMUXER 1
+#define CONFIG_IPMOVIE_DEMUXER 1
+#define CONFIG_MATROSKA_DEMUXER 1
+#define CONFIG_MM_DEMUXER 1
+#define CONFIG_MMF_DEMUXER 1
+#define CONFIG_MOV_DEMUXER 1
+#define CONFIG_MP3_DEMUXER 1
+#define CONFIG_MPEGPS_DEMUXER 1
+#define CONFIG_MPEGTS_DEMUXER 1
+#define CONFIG_MXF_DEMUXER 1
+#define CONFIG_NSV_DEMUXER 1
+#define CONFIG_NUT_DEMUXER 1
+#define CONFIG_NUV_DEMUXER 1
+#define CONFIG_OGG_DEMUXER 1
+#define CONFIG_STR_DEMUXER 1
+#define CONFIG_SHORTEN_DEMUXER 1
+#define CONFIG_FLAC_DEMUXER 1
+#define CONFIG_AC3_DEMUXER 1
+#define CONFIG_DTS_DEMUXER 1
+#define CONFIG_AAC_DEMUXER 1
+#define CONFIG_H261_DEMUXER 1
+#define CONFIG_H263_DEMUXER 1
+#define CONFIG_M4V_DEMUXER 1
+#define CONFIG_H264_DEMUXER 1
+#define CONFIG_MPEGVIDEO_DEMUXER 1
+#define CONFIG_MJPEG_DEMUXER 1
+#define CONFIG_INGENIENT_DEMUXER 1
+#define CONFIG_PCM_S16LE_DEMUXER 1
+#define CONFIG_PCM_S16BE_DEMUXER 1
+#define CONFIG_PCM_U16LE_DEMUXER 1
+#define CONFIG_PCM_U16BE_DEMUXER 1
+#define CONFIG_PCM_S8_DEMUXER 1
+#define CONFIG_PCM_U8_DEMUXER 1
+#define CONFIG_PCM_MULAW_DEMUXER 1
+#define CONFIG_PCM_ALAW_DEMUXER 1
+#define CONFIG_RAWVIDEO_DEMUXER 1
+#define CONFIG_RM_DEMUXER 1
+#define CONFIG_RTSP_DEMUXER 1
+#define CONFIG_SDP_DEMUXER 1
+#define CONFIG_REDIR_DEMUXER 1
+#define CONFIG_SEGAFILM_DEMUXER 1
+#define CONFIG_VMD_DEMUXER 1
+#define CONFIG_SMACKER_DEMUXER 1
+#define CONFIG_SOL_DEMUXER 1
+#define CONFIG_SWF_DEMUXER 1
+#define CONFIG_TTA_DEMUXER 1
+#define CONFIG_V4L2_DEMUXER 1
+#define CONFIG_VIDEO_GRAB_DEVICE_DEMUXER 1
+#define CONFIG_VOC_DEMUXER 1
+#define CONFIG_WAV_DEMUXER 1
+#define CONFIG_WC3_DEMUXER 1
+#define CONFIG_WSAUD_DEMUXER 1
+#define CONFIG_WSVQA_DEMUXER 1
+#define CONFIG_YUV4MPEGPIPE_DEMUXER 1
+#define CONFIG_ADTS_MUXER 1
+#define CONFIG_AIFF_MUXER 1
+#define CONFIG_AMR_MUXER 1
+#define CONFIG_ASF_MUXER 1
+#define CONFIG_ASF_STREAM_MUXER 1
+#define CONFIG_AU_MUXER 1
+#define CONFIG_AUDIO_MUXER 1
+#define CONFIG_AVI_MUXER 1
+#define CONFIG_CRC_MUXER 1
+#define CONFIG_FRAMECRC_MUXER 1
+#define CONFIG_DV_MUXER 1
+#define CONFIG_FFM_MUXER 1
+#define CONFIG_FLV_MUXER 1
+#define CONFIG_GIF_MUXER 1
+#define CONFIG_GXF_MUXER 1
+#define CONFIG_IMAGE2_MUXER 1
+#define CONFIG_IMAGE2PIPE_MUXER 1
+#define CONFIG_IMAGE_MUXER 1
+#define CONFIG_IMAGEPIPE_MUXER 1
+#define CONFIG_MMF_MUXER 1
+#define CONFIG_MOV_MUXER 1
+#define CONFIG_TGP_MUXER 1
+#define CONFIG_MP4_MUXER 1
+#define CONFIG_PSP_MUXER 1
+#define CONFIG_TG2_MUXER 1
+#define CONFIG_MP2_MUXER 1
+#define CONFIG_MP3_MUXER 1
+#define CONFIG_MPEG1SYSTEM_MUXER 1
+#define CONFIG_MPEG1VCD_MUXER 1
+#define CONFIG_MPEG2VOB_MUXER 1
+#define CONFIG_MPEG2SVCD_MUXER 1
+#define CONFIG_MPEG2DVD_MUXER 1
+#define CONFIG_MPEGTS_MUXER 1
+#define CONFIG_MPJPEG_MUXER 1
+#define CONFIG_NUT_MUXER 1
+#define CONFIG_OGG_MUXER 1
+#define CONFIG_FLAC_MUXER 1
+#define CONFIG_AC3_MUXER 1
+#define CONFIG_H261_MUXER 1
+#define CONFIG_H263_MUXER 1
+#define CONFIG_M4V_MUXER 1
+#define CONFIG_H264_MUXER 1
+#define CONFIG_MPEG1VIDEO_MUXER 1
+#define CONFIG_MPEG2VIDEO_MUXER 1
+#define CONFIG_MJPEG_MUXER 1
+#define CONFIG_PCM_S16LE_MUXER 1
+#define CONFIG_PCM_S16BE_MUXER 1
+#define CONFIG_PCM_U16LE_MUXER 1
+#define CONFIG_PCM_U16BE_MUXER 1
+#define CONFIG_PCM_S8_MUXER 1
+#define CONFIG_PCM_U8_MUXER 1
+#define CONFIG_PCM_MULAW_MUXER 1
+#define CONFIG_PCM_ALAW_MUXER 1
+#define CONFIG_RAWVIDEO_MUXER 1
+#define CONFIG_NULL_MUXER 1
+#define CONFIG_RM_MUXER 1
+#define CONFIG_RTP_MUXER 1
+#define CONFIG_SWF_MUXER 1
+#define CONFIG_VOC_MUXER 1
+#define CONFIG_WAV_MUXER 1
+#define CONFIG_YUV4MPEGPIPE_MUXER 1
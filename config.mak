@@ -0,0 +1,436 @@
+# Automatically generated by configure - do not modify!
+PREFIX=/usr/local
+prefix=$(DESTDIR)${PREFIX}
+libdir=$(DESTDIR)${PREFIX}/lib
+shlibdir=$(DESTDIR)${PREFIX}/lib
+incdir=$(DESTDIR)${PREFIX}/include/ffmpeg
+bindir=$(DESTDIR)${PREFIX}/bin
+mandir=$(DESTDIR)${PREFIX}/man
+MAKE=make
+CC=gcc
+AR=ar
+RANLIB=ranlib
+STRIP=strip
+INSTALLSTRIP=-s
+OPTFLAGS=-O3  -fgnu89-inline -fcommon -D_GNU_SOURCE -pthread -g -Wdeclaration-after-statement -Wall -Wno-switch
+SHCFLAGS=-O3  -fgnu89-inline -fcommon -D_GNU_SOURCE -pthread -g -Wdeclaration-after-statement -Wall -Wno-switch
+LDFLAGS=-Wl,--warn-common   -pthread -rdynamic -export-dynamic -Wl,--as-needed -Wl,-rpath-link,$(BUILD_ROOT)/libavcodec -Wl,-rpath-link,$(BUILD_ROOT)/libavformat -Wl,-rpath-link,$(BUILD_ROOT)/libavutil
+LDCONFIG=ldconfig
+FFSERVERLDFLAGS=-Wl,-E
+SHFLAGS=-shared -Wl,-soname,$@
+VHOOKFLAGS=-shared -Wl,-soname,$@
+LIBOBJFLAGS=
+BUILD_STATIC=yes
+BUILDSUF=
+LIBPREF=lib
+LIBSUF=${BUILDSUF}.a
+LIB=$(LIBPREF)$(NAME)$(LIBSUF)
+SLIBPREF=lib
+SLIBSUF=${BUILDSUF}.so
+EXESUF=${BUILDSUF}
+TARGET_OS=Linux
+TARGET_ARCH_X86_64=yes
+TARGET_MMX=yes
+TARGET_BUILTIN_VECTOR=yes
+TARGET_BUILTIN_3DNOW=yes
+HAVE_PTHREADS=yes
+BUILD_VHOOK=yes
+EXTRALIBS=-lm -lz 
+CONFIG_ENCODERS=yes
+CONFIG_DECODERS=yes
+CONFIG_MUXERS=yes
+CONFIG_DEMUXERS=yes
+CONFIG_DV1394=yes
+CONFIG_AUDIO_OSS=yes
+CONFIG_NETWORK=yes
+CONFIG_ZLIB=yes
+CONFIG_PROTOCOLS=yes
+CONFIG_FFSERVER=yes
+CONFIG_GPL=yes
+SRC_PATH=/root/repo
+BUILD_ROOT=/root/repo
+CONFIG_OGGVORBIS_DECODER=yes
+CONFIG_H263_DECODER=yes
+CONFIG_H261_DECODER=yes
+CONFIG_MPEG4_DECODER=yes
+CONFIG_MSMPEG4V1_DECODER=yes
+CONFIG_MSMPEG4V2_DECODER=yes
+CONFIG_MSMPEG4V3_DECODER=yes
+CONFIG_WMV1_DECODER=yes
+CONFIG_WMV2_DECODER=yes
+CONFIG_VC1_DECODER=yes
+CONFIG_WMV3_DECODER=yes
+CONFIG_H263I_DECODER=yes
+CONFIG_FLV_DECODER=yes
+CONFIG_RV10_DECODER=yes
+CONFIG_RV20_DECODER=yes
+CONFIG_SVQ1_DECODER=yes
+CONFIG_SVQ3_DECODER=yes
+CONFIG_WMAV1_DECODER=yes
+CONFIG_WMAV2_DECODER=yes
+CONFIG_INDEO2_DECODER=yes
+CONFIG_INDEO3_DECODER=yes
+CONFIG_TSCC_DECODER=yes
+CONFIG_CSCD_DECODER=yes
+CONFIG_NUV_DECODER=yes
+CONFIG_ULTI_DECODER=yes
+CONFIG_QDRAW_DECODER=yes
+CONFIG_XL_DECODER=yes
+CONFIG_QPEG_DECODER=yes
+CONFIG_LOCO_DECODER=yes
+CONFIG_KMVC_DECODER=yes
+CONFIG_WNV1_DECODER=yes
+CONFIG_AASC_DECODER=yes
+CONFIG_FRAPS_DECODER=yes
+CONFIG_AAC_DECODER=yes
+CONFIG_MPEG4AAC_DECODER=yes
+CONFIG_MPEG1VIDEO_DECODER=yes
+CONFIG_MPEG2VIDEO_DECODER=yes
+CONFIG_MPEGVIDEO_DECODER=yes
+CONFIG_MPEG_XVMC_DECODER=yes
+CONFIG_DVVIDEO_DECODER=yes
+CONFIG_MJPEG_DECODER=yes
+CONFIG_MJPEGB_DECODER=yes
+CONFIG_SP5X_DECODER=yes
+CONFIG_PNG_DECODER=yes
+CONFIG_MP2_DECODER=yes
+CONFIG_MP3_DECODER=yes
+CONFIG_MP3ADU_DECODER=yes
+CONFIG_MP3ON4_DECODER=yes
+CONFIG_MACE3_DECODER=yes
+CONFIG_MACE6_DECODER=yes
+CONFIG_HUFFYUV_DECODER=yes
+CONFIG_FFVHUFF_DECODER=yes
+CONFIG_FFV1_DECODER=yes
+CONFIG_SNOW_DECODER=yes
+CONFIG_CYUV_DECODER=yes
+CONFIG_H264_DECODER=yes
+CONFIG_VP3_DECODER=yes
+CONFIG_THEORA_DECODER=yes
+CONFIG_ASV1_DECODER=yes
+CONFIG_ASV2_DECODER=yes
+CONFIG_VCR1_DECODER=yes
+CONFIG_CLJR_DECODER=yes
+CONFIG_FOURXM_DECODER=yes
+CONFIG_MDEC_DECODER=yes
+CONFIG_ROQ_DECODER=yes
+CONFIG_INTERPLAY_VIDEO_DECODER=yes
+CONFIG_XAN_WC3_DECODER=yes
+CONFIG_RPZA_DECODER=yes
+CONFIG_CINEPAK_DECODER=yes
+CONFIG_MSRLE_DECODER=yes
+CONFIG_MSVIDEO1_DECODER=yes
+CONFIG_VQA_DECODER=yes
+CONFIG_IDCIN_DECODER=yes
+CONFIG_EIGHTBPS_DECODER=yes
+CONFIG_SMC_DECODER=yes
+CONFIG_FLIC_DECODER=yes
+CONFIG_TRUEMOTION1_DECODER=yes
+CONFIG_TRUEMOTION2_DECODER=yes
+CONFIG_VMDVIDEO_DECODER=yes
+CONFIG_VMDAUDIO_DECODER=yes
+CONFIG_MSZH_DECODER=yes
+CONFIG_ZLIB_DECODER=yes
+CONFIG_ZMBV_DECODER=yes
+CONFIG_SMACKER_DECODER=yes
+CONFIG_SMACKAUD_DECODER=yes
+CONFIG_SONIC_DECODER=yes
+CONFIG_AC3_DECODER=yes
+CONFIG_DTS_DECODER=yes
+CONFIG_RA_144_DECODER=yes
+CONFIG_RA_288_DECODER=yes
+CONFIG_ROQ_DPCM_DECODER=yes
+CONFIG_INTERPLAY_DPCM_DECODER=yes
+CONFIG_XAN_DPCM_DECODER=yes
+CONFIG_SOL_DPCM_DECODER=yes
+CONFIG_QTRLE_DECODER=yes
+CONFIG_FLAC_DECODER=yes
+CONFIG_SHORTEN_DECODER=yes
+CONFIG_ALAC_DECODER=yes
+CONFIG_WS_SND1_DECODER=yes
+CONFIG_VORBIS_DECODER=yes
+CONFIG_LIBGSM_DECODER=yes
+CONFIG_QDM2_DECODER=yes
+CONFIG_COOK_DECODER=yes
+CONFIG_TRUESPEECH_DECODER=yes
+CONFIG_TTA_DECODER=yes
+CONFIG_AVS_DECODER=yes
+CONFIG_CAVS_DECODER=yes
+CONFIG_RAWVIDEO_DECODER=yes
+CONFIG_FLASHSV_DECODER=yes
+CONFIG_AMR_NB_DECODER=yes
+CONFIG_AMR_WB_DECODER=yes
+CONFIG_BMP_DECODER=yes
+CONFIG_MMVIDEO_DECODER=yes
+CONFIG_PCM_S32LE_DECODER=yes
+CONFIG_PCM_S32BE_DECODER=yes
+CONFIG_PCM_U32LE_DECODER=yes
+CONFIG_PCM_U32BE_DECODER=yes
+CONFIG_PCM_S24LE_DECODER=yes
+CONFIG_PCM_S24BE_DECODER=yes
+CONFIG_PCM_U24LE_DECODER=yes
+CONFIG_PCM_U24BE_DECODER=yes
+CONFIG_PCM_S24DAUD_DECODER=yes
+CONFIG_PCM_S16LE_DECODER=yes
+CONFIG_PCM_S16BE_DECODER=yes
+CONFIG_PCM_U16LE_DECODER=yes
+CONFIG_PCM_U16BE_DECODER=yes
+CONFIG_PCM_S8_DECODER=yes
+CONFIG_PCM_U8_DECODER=yes
+CONFIG_PCM_ALAW_DECODER=yes
+CONFIG_PCM_MULAW_DECODER=yes
+CONFIG_ADPCM_IMA_QT_DECODER=yes
+CONFIG_ADPCM_IMA_WAV_DECODER=yes
+CONFIG_ADPCM_IMA_DK3_DECODER=yes
+CONFIG_ADPCM_IMA_DK4_DECODER=yes
+CONFIG_ADPCM_IMA_WS_DECODER=yes
+CONFIG_ADPCM_IMA_SMJPEG_DECODER=yes
+CONFIG_ADPCM_MS_DECODER=yes
+CONFIG_ADPCM_4XM_DECODER=yes
+CONFIG_ADPCM_XA_DECODER=yes
+CONFIG_ADPCM_ADX_DECODER=yes
+CONFIG_ADPCM_EA_DECODER=yes
+CONFIG_ADPCM_G726_DECODER=yes
+CONFIG_ADPCM_CT_DECODER=yes
+CONFIG_ADPCM_SWF_DECODER=yes
+CONFIG_ADPCM_YAMAHA_DECODER=yes
+CONFIG_ADPCM_SBPRO_4_DECODER=yes
+CONFIG_ADPCM_SBPRO_3_DECODER=yes
+CONFIG_ADPCM_SBPRO_2_DECODER=yes
+CONFIG_DVDSUB_DECODER=yes
+CONFIG_DVBSUB_DECODER=yes
+CONFIG_AC3_ENCODER=yes
+CONFIG_MP2_ENCODER=yes
+CONFIG_MP3LAME_ENCODER=yes
+CONFIG_OGGVORBIS_ENCODER=yes
+CONFIG_FAAC_ENCODER=yes
+CONFIG_FLAC_ENCODER=yes
+CONFIG_XVID_ENCODER=yes
+CONFIG_MPEG1VIDEO_ENCODER=yes
+CONFIG_H264_ENCODER=yes
+CONFIG_MPEG2VIDEO_ENCODER=yes
+CONFIG_H261_ENCODER=yes
+CONFIG_H263_ENCODER=yes
+CONFIG_H263P_ENCODER=yes
+CONFIG_FLV_ENCODER=yes
+CONFIG_RV10_ENCODER=yes
+CONFIG_RV20_ENCODER=yes
+CONFIG_MPEG4_ENCODER=yes
+CONFIG_MSMPEG4V1_ENCODER=yes
+CONFIG_MSMPEG4V2_ENCODER=yes
+CONFIG_MSMPEG4V3_ENCODER=yes
+CONFIG_WMV1_ENCODER=yes
+CONFIG_WMV2_ENCODER=yes
+CONFIG_SVQ1_ENCODER=yes
+CONFIG_MJPEG_ENCODER=yes
+CONFIG_LJPEG_ENCODER=yes
+CONFIG_JPEGLS_ENCODER=yes
+CONFIG_PNG_ENCODER=yes
+CONFIG_PPM_ENCODER=yes
+CONFIG_PGM_ENCODER=yes
+CONFIG_PGMYUV_ENCODER=yes
+CONFIG_PBM_ENCODER=yes
+CONFIG_PAM_ENCODER=yes
+CONFIG_HUFFYUV_ENCODER=yes
+CONFIG_FFVHUFF_ENCODER=yes
+CONFIG_ASV1_ENCODER=yes
+CONFIG_ASV2_ENCODER=yes
+CONFIG_FFV1_ENCODER=yes
+CONFIG_SNOW_ENCODER=yes
+CONFIG_ZLIB_ENCODER=yes
+CONFIG_DVVIDEO_ENCODER=yes
+CONFIG_SONIC_ENCODER=yes
+CONFIG_SONIC_LS_ENCODER=yes
+CONFIG_X264_ENCODER=yes
+CONFIG_LIBGSM_ENCODER=yes
+CONFIG_RAWVIDEO_ENCODER=yes
+CONFIG_AMR_NB_ENCODER=yes
+CONFIG_AMR_WB_ENCODER=yes
+CONFIG_PCM_S32LE_ENCODER=yes
+CONFIG_PCM_S32BE_ENCODER=yes
+CONFIG_PCM_U32LE_ENCODER=yes
+CONFIG_PCM_U32BE_ENCODER=yes
+CONFIG_PCM_S24LE_ENCODER=yes
+CONFIG_PCM_S24BE_ENCODER=yes
+CONFIG_PCM_U24LE_ENCODER=yes
+CONFIG_PCM_U24BE_ENCODER=yes
+CONFIG_PCM_S24DAUD_ENCODER=yes
+CONFIG_PCM_S16LE_ENCODER=yes
+CONFIG_PCM_S16BE_ENCODER=yes
+CONFIG_PCM_U16LE_ENCODER=yes
+CONFIG_PCM_U16BE_ENCODER=yes
+CONFIG_PCM_S8_ENCODER=yes
+CONFIG_PCM_U8_ENCODER=yes
+CONFIG_PCM_ALAW_ENCODER=yes
+CONFIG_PCM_MULAW_ENCODER=yes
+CONFIG_ADPCM_IMA_QT_ENCODER=yes
+CONFIG_ADPCM_IMA_WAV_ENCODER=yes
+CONFIG_ADPCM_IMA_DK3_ENCODER=yes
+CONFIG_ADPCM_IMA_DK4_ENCODER=yes
+CONFIG_ADPCM_IMA_WS_ENCODER=yes
+CONFIG_ADPCM_IMA_SMJPEG_ENCODER=yes
+CONFIG_ADPCM_MS_ENCODER=yes
+CONFIG_ADPCM_4XM_ENCODER=yes
+CONFIG_ADPCM_XA_ENCODER=yes
+CONFIG_ADPCM_ADX_ENCODER=yes
+CONFIG_ADPCM_EA_ENCODER=yes
+CONFIG_ADPCM_G726_ENCODER=yes
+CONFIG_ADPCM_CT_ENCODER=yes
+CONFIG_ADPCM_SWF_ENCODER=yes
+CONFIG_ADPCM_YAMAHA_ENCODER=yes
+CONFIG_ADPCM_SBPRO_4_ENCODER=yes
+CONFIG_ADPCM_SBPRO_3_ENCODER=yes
+CONFIG_ADPCM_SBPRO_2_ENCODER=yes
+CONFIG_DVDSUB_ENCODER=yes
+CONFIG_DVBSUB_ENCODER=yes
+CONFIG_MPEGVIDEO_PARSER=yes
+CONFIG_MPEG4VIDEO_PARSER=yes
+CONFIG_CAVSVIDEO_PARSER=yes
+CONFIG_H261_PARSER=yes
+CONFIG_H263_PARSER=yes
+CONFIG_H264_PARSER=yes
+CONFIG_MJPEG_PARSER=yes
+CONFIG_PNM_PARSER=yes
+CONFIG_MPEGAUDIO_PARSER=yes
+CONFIG_AC3_PARSER=yes
+CONFIG_DVDSUB_PARSER=yes
+CONFIG_DVBSUB_PARSER=yes
+CONFIG_AAC_PARSER=yes
+CONFIG_FOURXM_DEMUXER=yes
+CONFIG_AIFF_DEMUXER=yes
+CONFIG_AMR_DEMUXER=yes
+CONFIG_ASF_DEMUXER=yes
+CONFIG_AU_DEMUXER=yes
+CONFIG_AUDIO_DEMUXER=yes
+CONFIG_AVI_DEMUXER=yes
+CONFIG_AVS_DEMUXER=yes
+CONFIG_DAUD_DEMUXER=yes
+CONFIG_DC1394_DEMUXER=yes
+CONFIG_DV1394_DEMUXER=yes
+CONFIG_DV_DEMUXER=yes
+CONFIG_EA_DEMUXER=yes
+CONFIG_FFM_DEMUXER=yes
+CONFIG_FLIC_DEMUXER=yes
+CONFIG_FLV_DEMUXER=yes
+CONFIG_GIF_DEMUXER=yes
+CONFIG_GXF_DEMUXER=yes
+CONFIG_IDCIN_DEMUXER=yes
+CONFIG_ROQ_DEMUXER=yes
+CONFIG_IMAGE2_DEMUXER=yes
+CONFIG_IMAGE2PIPE_DEMUXER=yes
+CONFIG_IMAGE_DEMUXER=yes
+CONFIG_IMAGEPIPE_DEMUXER=yes
+CONFIG_IPMOVIE_DEMUXER=yes
+CONFIG_MATROSKA_DEMUXER=yes
+CONFIG_MM_DEMUXER=yes
+CONFIG_MMF_DEMUXER=yes
+CONFIG_MOV_DEMUXER=yes
+CONFIG_MP3_DEMUXER=yes
+CONFIG_MPEGPS_DEMUXER=yes
+CONFIG_MPEGTS_DEMUXER=yes
+CONFIG_MXF_DEMUXER=yes
+CONFIG_NSV_DEMUXER=yes
+CONFIG_NUT_DEMUXER=yes
+CONFIG_NUV_DEMUXER=yes
+CONFIG_OGG_DEMUXER=yes
+CONFIG_STR_DEMUXER=yes
+CONFIG_SHORTEN_DEMUXER=yes
+CONFIG_FLAC_DEMUXER=yes
+CONFIG_AC3_DEMUXER=yes
+CONFIG_DTS_DEMUXER=yes
+CONFIG_AAC_DEMUXER=yes
+CONFIG_H261_DEMUXER=yes
+CONFIG_H263_DEMUXER=yes
+CONFIG_M4V_DEMUXER=yes
+CONFIG_H264_DEMUXER=yes
+CONFIG_MPEGVIDEO_DEMUXER=yes
+CONFIG_MJPEG_DEMUXER=yes
+CONFIG_INGENIENT_DEMUXER=yes
+CONFIG_PCM_S16LE_DEMUXER=yes
+CONFIG_PCM_S16BE_DEMUXER=yes
+CONFIG_PCM_U16LE_DEMUXER=yes
+CONFIG_PCM_U16BE_DEMUXER=yes
+CONFIG_PCM_S8_DEMUXER=yes
+CONFIG_PCM_U8_DEMUXER=yes
+CONFIG_PCM_MULAW_DEMUXER=yes
+CONFIG_PCM_ALAW_DEMUXER=yes
+CONFIG_RAWVIDEO_DEMUXER=yes
+CONFIG_RM_DEMUXER=yes
+CONFIG_RTSP_DEMUXER=yes
+CONFIG_SDP_DEMUXER=yes
+CONFIG_REDIR_DEMUXER=yes
+CONFIG_SEGAFILM_DEMUXER=yes
+CONFIG_VMD_DEMUXER=yes
+CONFIG_SMACKER_DEMUXER=yes
+CONFIG_SOL_DEMUXER=yes
+CONFIG_SWF_DEMUXER=yes
+CONFIG_TTA_DEMUXER=yes
+CONFIG_V4L2_DEMUXER=yes
+CONFIG_VIDEO_GRAB_DEVICE_DEMUXER=yes
+CONFIG_VOC_DEMUXER=yes
+CONFIG_WAV_DEMUXER=yes
+CONFIG_WC3_DEMUXER=yes
+CONFIG_WSAUD_DEMUXER=yes
+CONFIG_WSVQA_DEMUXER=yes
+CONFIG_YUV4MPEGPIPE_DEMUXER=yes
+CONFIG_ADTS_MUXER=yes
+CONFIG_AIFF_MUXER=yes
+CONFIG_AMR_MUXER=yes
+CONFIG_ASF_MUXER=yes
+CONFIG_ASF_STREAM_MUXER=yes
+CONFIG_AU_MUXER=yes
+CONFIG_AUDIO_MUXER=yes
+CONFIG_AVI_MUXER=yes
+CONFIG_CRC_MUXER=yes
+CONFIG_FRAMECRC_MUXER=yes
+CONFIG_DV_MUXER=yes
+CONFIG_FFM_MUXER=yes
+CONFIG_FLV_MUXER=yes
+CONFIG_GIF_MUXER=yes
+CONFIG_GXF_MUXER=yes
+CONFIG_IMAGE2_MUXER=yes
+CONFIG_IMAGE2PIPE_MUXER=yes
+CONFIG_IMAGE_MUXER=yes
+CONFIG_IMAGEPIPE_MUXER=yes
+CONFIG_MMF_MUXER=yes
+CONFIG_MOV_MUXER=yes
+CONFIG_TGP_MUXER=yes
+CONFIG_MP4_MUXER=yes
+CONFIG_PSP_MUXER=yes
+CONFIG_TG2_MUXER=yes
+CONFIG_MP2_MUXER=yes
+CONFIG_MP3_MUXER=yes
+CONFIG_MPEG1SYSTEM_MUXER=yes
+CONFIG_MPEG1VCD_MUXER=yes
+CONFIG_MPEG2VOB_MUXER=yes
+CONFIG_MPEG2SVCD_MUXER=yes
+CONFIG_MPEG2DVD_MUXER=yes
+CONFIG_MPEGTS_MUXER=yes
+CONFIG_MPJPEG_MUXER=yes
+CONFIG_NUT_MUXER=yes
+CONFIG_OGG_MUXER=yes
+CONFIG_FLAC_MUXER=yes
+CONFIG_AC3_MUXER=yes
+CONFIG_H261_MUXER=yes
+CONFIG_H263_MUXER=yes
+CONFIG_M4V_MUXER=yes
+CONFIG_H264_MUXER=yes
+CONFIG_MPEG1VIDEO_MUXER=yes
+CONFIG_MPEG2VIDEO_MUXER=yes
+CONFIG_MJPEG_MUXER=yes
+CONFIG_PCM_S16LE_MUXER=yes
+CONFIG_PCM_S16BE_MUXER=yes
+CONFIG_PCM_U16LE_MUXER=yes
+CONFIG_PCM_U16BE_MUXER=yes
+CONFIG_PCM_S8_MUXER=yes
+CONFIG_PCM_U8_MUXER=yes
+CONFIG_PCM_MULAW_MUXER=yes
+CONFIG_PCM_ALAW_MUXER=yes
+CONFIG_RAWVIDEO_MUXER=yes
+CONFIG_NULL_MUXER=yes
+CONFIG_RM_MUXER=yes
+CONFIG_RTP_MUXER=yes
+CONFIG_SWF_MUXER=yes
+CONFIG_VOC_MUXER=yes
+CONFIG_WAV_MUXER=yes
+CONFIG_YUV4MPEGPIPE_MUXER=yes
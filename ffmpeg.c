@@ -40,6 +40,9 @@
 #endif
 #undef time //needed because HAVE_AV_CONFIG_H is defined on top
 #include <time.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "version.h"
 #include "cmdutils.h"
@@ -163,6 +166,14 @@ static int frame_skip_exp= 0;
 static int loop_input = 0;
 static int loop_output = AVFMT_NOOUTPUTLOOP;
 static int genpts = 0;
+static int index_cache = 0;
+static int header_only = 0;
+static int no_parse = 0;
+static int probesize = 0;
+static int probe_packets = 0;
+static int probe_time = 0;
+static int pipeline_size = 0;
+static int scale_cascade = 0;
 static int qp_hist = 0;
 
 static int gop_size = 12;
@@ -184,6 +195,8 @@ static int mux_rate= 0;
 static int mux_packet_size= 0;
 static float mux_preload= 0.5;
 static float mux_max_delay= 0.7;
+static int mux_faststart = 0;
+static int mux_fragment = 0;
 
 static int64_t recording_time = 0;
 static int64_t start_time = 0;
@@ -236,11 +249,7 @@ static int verbose = 1;
 static int thread_count= 1;
 static int q_pressed = 0;
 static int me_range = 0;
-static int64_t video_size = 0;
-static int64_t audio_size = 0;
 static int64_t extra_size = 0;
-static int nb_frames_dup = 0;
-static int nb_frames_drop = 0;
 static int input_sync;
 static int limit_filesize = 0; //
 
@@ -268,9 +277,11 @@ typedef struct AVOutputStream {
     AVStream *st;            /* stream in the output file */
     int encoding_needed;     /* true if encoding needed for this stream */
     int frame_number;
+    int64_t size;            /* total size of the encoded or copied frames */
+    int is_start;            /* is 1 at the start and after a discontinuity */
     /* input pts and corresponding output pts
        for A/V sync */
-    //double sync_ipts;        /* dts from the AVPacket of the demuxer in second units */
+    int64_t sync_ipts;       /* pts + ts offset of sync_ist when the frame was decoded */
     struct AVInputStream *sync_ist; /* input stream to sync against */
     int64_t sync_opts;       /* output frame counter, could be changed to some true timestamp */ //FIXME look at frame_number
     /* video only */
@@ -278,6 +289,12 @@ typedef struct AVOutputStream {
     AVFrame pict_tmp;      /* temporary image for resampling */
     struct SwsContext *img_resample_ctx; /* for image resampling */
     int resample_height;
+    int nb_frames_dup;
+    int nb_frames_drop;
+    struct AVOutputStream *cascade_src; /* scale the frame scaled for this
+                                           stream instead of the decoded one */
+    int cascade_index;       /* index of the frame scaled for this stream in
+                                the jobs, or -1 if no stream scales from it */
 
     int video_crop;
     int topBand;             /* cropping area sizes */
@@ -293,7 +310,22 @@ typedef struct AVOutputStream {
     int audio_resample;
     ReSampleContext *resample; /* for audio resampling */
     FifoBuffer fifo;     /* for compression: one audio fifo per codec */
+    uint8_t *audio_buf;
+    uint8_t *audio_out;
+    uint8_t *input_tmp;
+
+    /* buffers of the encoding stage, one per stream so that the streams
+       can be encoded concurrently */
+    uint8_t *bit_buffer;
+    uint8_t *subtitle_out;
+    AVFrame copy_frame;      /* coded_frame of the codec when copying */
     FILE *logfile;
+#ifdef HAVE_PTHREADS
+    struct AVStageQueue *job_queue;    /* jobs to encode for this stream */
+    struct AVStageQueue *packet_queue; /* packets to write, each job ends
+                                          with a NULL item */
+    pthread_t thread_id;
+#endif
 } AVOutputStream;
 
 typedef struct AVInputStream {
@@ -309,7 +341,23 @@ typedef struct AVInputStream {
     int64_t       next_pts;  /* synthetic pts for cases where pkt.pts
                                 is not defined */
     int64_t       pts;       /* current pts */
-    int is_start;            /* is 1 at the start and after a discontinuity */
+    int discontinuity;       /* set by the decoding stage, moved to is_start
+                                of the output streams with the next frame
+                                passed to the encoding stage */
+    AVCodecContext *dec;     /* decoder context, the codec context of the
+                                stream unless the file is read ahead */
+    AVCodecParserContext *parser; /* parser changing the copied packets when
+                                     the file is read ahead, the one of the
+                                     stream belongs to the reading thread */
+#ifdef HAVE_PTHREADS
+    /* decoder fields used by av_read_frame() to compute the timestamps,
+       passed to the reading thread under the mutex of the input queue */
+    int has_b_frames;
+    int frame_size;
+    AVRational time_base;
+    int dec_changes;         /* number of times they were changed */
+    int reader_changes;      /* dec_changes applied by the reading thread */
+#endif
 } AVInputStream;
 
 typedef struct AVInputFile {
@@ -321,6 +369,67 @@ typedef struct AVInputFile {
     int nb_streams;       /* nb streams we are aware of */
 } AVInputFile;
 
+/* a decoded frame (or a packet to copy) passed from the decoding stage
+   to the encoding stage, together with the decoder state it depends on.
+   The frame is shared read-only by all the output streams it feeds */
+typedef struct AVOutputJob {
+    AVInputStream *ist;
+    int ist_index;
+    int eof;                 /* flush the encoders fed by ist */
+    int is_start;            /* a discontinuity was found before this frame */
+    int64_t next_pts;        /* ist->next_pts when the frame was decoded */
+    int64_t ts_offset;       /* ts offset of the input file */
+    int64_t *sync_ipts;      /* sync_ipts of each output stream */
+    AVPacket pkt;            /* source packet, its data is not used */
+    AVPacket *src_pkt;       /* demuxed packet data_buf points to when the
+                                job is not queued, the last output stream
+                                copying it may take its payload over */
+    uint8_t *data_buf;       /* decoded samples or payload to copy */
+    int data_size;
+    AVFrame picture;
+    int has_picture;
+    AVSubtitle subtitle;
+    int has_subtitle;
+    int refcount;            /* output streams which did not process the job yet */
+
+    /* frames scaled for the output streams other streams are scaled
+       from, see AVOutputStream.cascade_index */
+    AVFrame *cascade_frames;
+    int *cascade_ready;
+
+    /* buffers owned by the job when it is queued */
+    uint8_t *data;
+    unsigned int data_alloc;
+    uint8_t *picture_buf;
+    int picture_buf_size;
+} AVOutputJob;
+
+#ifdef HAVE_PTHREADS
+/* bounded FIFO between two stages of the pipeline */
+typedef struct AVStageQueue {
+    void **items;
+    int max_items;
+    int nb_items;
+    int rindex, windex;
+    int pending;             /* items put and not yet processed */
+    int nb_waiting;          /* threads waiting for the condition */
+    int eof;                 /* the producer will not put any more items */
+    int abort_request;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} AVStageQueue;
+
+/* a packet read in advance, with the fields of the codec context of the
+   reading thread which the main thread needs to copy it */
+typedef struct AVReadPacket {
+    AVPacket pkt;
+    int frame_size;
+    int sample_rate;
+    int channels;
+    AVRational time_base;
+} AVReadPacket;
+#endif
+
 #ifndef __MINGW32__
 
 /* init terminal so that we can grab keys */
@@ -448,10 +557,249 @@ static int read_ffserver_streams(AVFormatContext *s, const char *filename)
 static double
 get_sync_ipts(const AVOutputStream *ost)
 {
-    const AVInputStream *ist = ost->sync_ist;
-    return (double)(ist->pts + input_files_ts_offset[ist->file_index] - start_time)/AV_TIME_BASE;
+    return (double)(ost->sync_ipts - start_time)/AV_TIME_BASE;
+}
+
+/* true when demuxing, encoding and muxing run on their own threads */
+static int pipeline = 0;
+/* true when all the output streams are stream copies: the packets are
+   then copied by the demuxing thread and passed to the muxing threads
+   directly */
+static int remux = 0;
+static int64_t input_size = 0;  /* bytes of the packets demuxed */
+
+#ifdef HAVE_PTHREADS
+static AVStageQueue input_queues[MAX_FILES]; /* packets read from each input file */
+static AVStageQueue free_job_queue;   /* jobs which can be reused */
+static AVStageQueue mux_queues[MAX_FILES]; /* input streams of the jobs
+                                              to write, in decoding order */
+static pthread_t input_thread_ids[MAX_FILES], mux_thread_ids[MAX_FILES];
+static int nb_input_threads = 0;
+static int input_threaded[MAX_FILES]; /* the file is read on its own thread */
+static AVInputStream **input_ist_table;
+static AVInputFile *input_file_table;
+static AVOutputStream **job_ost_table;
+static int job_nb_ostreams;
+static AVInputStream **job_ist_table;
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t vstats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* packets got at once from the input and muxing queues */
+#define PACKET_BATCH 8
+static AVPacket *input_batches[MAX_FILES][PACKET_BATCH];
+static int input_batch_index[MAX_FILES], input_batch_size[MAX_FILES];
+
+static int stage_queue_init(AVStageQueue *q, int max_items)
+{
+    memset(q, 0, sizeof(AVStageQueue));
+    q->items = av_malloc(max_items * sizeof(void *));
+    if (!q->items)
+        return -1;
+    q->max_items = max_items;
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->cond, NULL);
+    return 0;
+}
+
+static void stage_queue_end(AVStageQueue *q)
+{
+    av_freep(&q->items);
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->cond);
+}
+
+/* wait for the condition of the queue, its mutex must be locked */
+static void stage_queue_sleep(AVStageQueue *q)
+{
+    q->nb_waiting++;
+    pthread_cond_wait(&q->cond, &q->mutex);
+    q->nb_waiting--;
+}
+
+/* wake up the threads waiting for the queue, if any */
+static void stage_queue_wake(AVStageQueue *q)
+{
+    if (q->nb_waiting)
+        pthread_cond_broadcast(&q->cond);
+}
+
+/* return < 0 if aborted */
+static int stage_queue_put(AVStageQueue *q, void *item)
+{
+    int ret = 0;
+
+    pthread_mutex_lock(&q->mutex);
+    while (q->nb_items >= q->max_items && !q->abort_request)
+        stage_queue_sleep(q);
+    if (q->abort_request) {
+        ret = -1;
+    } else {
+        q->items[q->windex] = item;
+        if (++q->windex == q->max_items)
+            q->windex = 0;
+        q->nb_items++;
+        q->pending++;
+        stage_queue_wake(q);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+/* get up to max_items items, waiting only if the queue is empty.
+   return < 0 if aborted, 0 if there are no more items, or the number of
+   items got */
+static int stage_queue_get_batch(AVStageQueue *q, void **items, int max_items)
+{
+    int ret;
+
+    pthread_mutex_lock(&q->mutex);
+    while (!q->nb_items && !q->eof && !q->abort_request)
+        stage_queue_sleep(q);
+    if (q->abort_request) {
+        ret = -1;
+    } else {
+        for(ret = 0; ret < max_items && q->nb_items > 0; ret++) {
+            items[ret] = q->items[q->rindex];
+            if (++q->rindex == q->max_items)
+                q->rindex = 0;
+            q->nb_items--;
+        }
+        if (ret)
+            stage_queue_wake(q);
+    }
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+/* return < 0 if aborted, 0 if there are no more items and > 0 if an
+   item was got */
+static int stage_queue_get(AVStageQueue *q, void **item)
+{
+    return stage_queue_get_batch(q, item, 1);
+}
+
+/* signal that nb_items items got from the queue have been processed */
+static void stage_queue_done(AVStageQueue *q, int nb_items)
+{
+    pthread_mutex_lock(&q->mutex);
+    q->pending -= nb_items;
+    stage_queue_wake(q);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+/* signal the end of the stream, or abort the producer and the consumer */
+static void stage_queue_finish(AVStageQueue *q, int abort)
+{
+    pthread_mutex_lock(&q->mutex);
+    if (abort)
+        q->abort_request = 1;
+    else
+        q->eof = 1;
+    pthread_cond_broadcast(&q->cond);
+    pthread_mutex_unlock(&q->mutex);
+}
+
+/* wait until all the items put in the queue have been processed */
+static void stage_queue_wait(AVStageQueue *q)
+{
+    pthread_mutex_lock(&q->mutex);
+    while (q->pending > 0 && !q->abort_request)
+        stage_queue_sleep(q);
+    pthread_mutex_unlock(&q->mutex);
 }
 
+static int stage_queue_size(AVStageQueue *q)
+{
+    int nb_items;
+
+    pthread_mutex_lock(&q->mutex);
+    nb_items = q->nb_items;
+    pthread_mutex_unlock(&q->mutex);
+    return nb_items;
+}
+
+/* allocate a copy of pkt at the start of a queue item of the given size,
+   the data is moved to the copy if pkt owns it */
+static AVPacket *packet_queue_item(AVPacket *pkt, int size)
+{
+    AVPacket *pkt1;
+
+    pkt1 = av_malloc(size);
+    if (!pkt1)
+        return NULL;
+    *pkt1 = *pkt;
+    if (pkt->destruct == av_destruct_packet) {
+        pkt->destruct = NULL;
+    } else if (av_dup_packet(pkt1) < 0) {
+        av_free(pkt1);
+        return NULL;
+    }
+    return pkt1;
+}
+
+/* queue a copy of pkt, the data is moved to the queue if pkt owns it */
+static int packet_queue_put(AVStageQueue *q, AVPacket *pkt)
+{
+    AVPacket *pkt1;
+
+    pkt1 = packet_queue_item(pkt, sizeof(AVPacket));
+    if (!pkt1)
+        return -1;
+    if (stage_queue_put(q, pkt1) < 0) {
+        av_free_packet(pkt1);
+        av_free(pkt1);
+        return -1;
+    }
+    return 0;
+}
+
+static void packet_queue_flush(AVStageQueue *q)
+{
+    AVPacket *pkt;
+
+    while (q->nb_items > 0) {
+        pkt = q->items[q->rindex];
+        if (++q->rindex == q->max_items)
+            q->rindex = 0;
+        q->nb_items--;
+        av_free_packet(pkt);
+        av_free(pkt);
+    }
+}
+
+/* input stream of a packet of a file read ahead, NULL for the streams
+   which appeared after the start */
+static AVInputStream *input_stream(int file_index, int stream_index)
+{
+    AVInputFile *file = &input_file_table[file_index];
+
+    if (stream_index >= file->nb_streams)
+        return NULL;
+    return input_ist_table[file->ist_index + stream_index];
+}
+
+/* pass the decoder fields used to compute the timestamps to the thread
+   reading the file, the main thread is the only one to change them */
+static void input_stream_publish(AVInputStream *ist)
+{
+    AVCodecContext *dec = ist->dec;
+    AVStageQueue *q = &input_queues[ist->file_index];
+
+    if (dec->has_b_frames == ist->has_b_frames &&
+        dec->frame_size == ist->frame_size &&
+        dec->time_base.num == ist->time_base.num &&
+        dec->time_base.den == ist->time_base.den)
+        return;
+    pthread_mutex_lock(&q->mutex);
+    ist->has_b_frames = dec->has_b_frames;
+    ist->frame_size = dec->frame_size;
+    ist->time_base = dec->time_base;
+    ist->dec_changes++;
+    pthread_mutex_unlock(&q->mutex);
+}
+#endif
+
 static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx, AVBitStreamFilterContext *bsfc){
     while(bsfc){
         AVPacket new_pkt= *pkt;
@@ -468,6 +816,20 @@ static void write_frame(AVFormatContext *s, AVPacket *pkt, AVCodecContext *avctx
         bsfc= bsfc->next;
     }
 
+#ifdef HAVE_PTHREADS
+    if (pipeline) {
+        AVOutputStream *ost;
+        int i;
+
+        for(i=0;i<job_nb_ostreams;i++) {
+            ost = job_ost_table[i];
+            if (output_files[ost->file_index] == s && ost->index == pkt->stream_index) {
+                packet_queue_put(remux ? &mux_queues[ost->file_index] : ost->packet_queue, pkt);
+                return;
+            }
+        }
+    }
+#endif
     av_interleaved_write_frame(s, pkt);
 }
 
@@ -479,30 +841,31 @@ static void do_audio_out(AVFormatContext *s,
                          unsigned char *buf, int size)
 {
     uint8_t *buftmp;
-    static uint8_t *audio_buf = NULL;
-    static uint8_t *audio_out = NULL;
+    uint8_t *audio_buf, *audio_out;
     const int audio_out_size= 4*MAX_AUDIO_PACKET_SIZE;
 
     int size_out, frame_bytes, ret;
     AVCodecContext *enc= ost->st->codec;
 
     /* SC: dynamic allocation of buffers */
-    if (!audio_buf)
-        audio_buf = av_malloc(2*MAX_AUDIO_PACKET_SIZE);
-    if (!audio_out)
-        audio_out = av_malloc(audio_out_size);
-    if (!audio_buf || !audio_out)
+    if (!ost->audio_buf)
+        ost->audio_buf = av_malloc(2*MAX_AUDIO_PACKET_SIZE);
+    if (!ost->audio_out)
+        ost->audio_out = av_malloc(audio_out_size);
+    if (!ost->audio_buf || !ost->audio_out)
         return;               /* Should signal an error ! */
+    audio_buf = ost->audio_buf;
+    audio_out = ost->audio_out;
 
     if(audio_sync_method){
         double delta = get_sync_ipts(ost) * enc->sample_rate - ost->sync_opts
                 - fifo_size(&ost->fifo, ost->fifo.rptr)/(ost->st->codec->channels * 2);
-        double idelta= delta*ist->st->codec->sample_rate / enc->sample_rate;
-        int byte_delta= ((int)idelta)*2*ist->st->codec->channels;
+        double idelta= delta*ist->dec->sample_rate / enc->sample_rate;
+        int byte_delta= ((int)idelta)*2*ist->dec->channels;
 
         //FIXME resample delay
         if(fabs(delta) > 50){
-            if(ist->is_start){
+            if(ost->is_start){
                 if(byte_delta < 0){
                     byte_delta= FFMAX(byte_delta, -size);
                     size += byte_delta;
@@ -511,13 +874,13 @@ static void do_audio_out(AVFormatContext *s,
                         fprintf(stderr, "discarding %d audio samples\n", (int)-delta);
                     if(!size)
                         return;
-                    ist->is_start=0;
+                    ost->is_start=0;
                 }else{
-                    static uint8_t *input_tmp= NULL;
-                    input_tmp= av_realloc(input_tmp, byte_delta + size);
+                    uint8_t *input_tmp;
+                    input_tmp= ost->input_tmp= av_realloc(ost->input_tmp, byte_delta + size);
 
                     if(byte_delta + size <= MAX_AUDIO_PACKET_SIZE)
-                        ist->is_start=0;
+                        ost->is_start=0;
                     else
                         byte_delta= MAX_AUDIO_PACKET_SIZE - size;
 
@@ -545,7 +908,7 @@ static void do_audio_out(AVFormatContext *s,
         buftmp = audio_buf;
         size_out = audio_resample(ost->resample,
                                   (short *)buftmp, (short *)buf,
-                                  size / (ist->st->codec->channels * 2));
+                                  size / (ist->dec->channels * 2));
         size_out = size_out * enc->channels * 2;
     } else {
         buftmp = buf;
@@ -567,7 +930,7 @@ static void do_audio_out(AVFormatContext *s,
 
             ret = avcodec_encode_audio(enc, audio_out, audio_out_size,
                                        (short *)audio_buf);
-            audio_size += ret;
+            ost->size += ret;
             pkt.stream_index= ost->index;
             pkt.data= audio_out;
             pkt.size= ret;
@@ -611,7 +974,7 @@ static void do_audio_out(AVFormatContext *s,
         }
         ret = avcodec_encode_audio(enc, audio_out, size_out,
                                    (short *)buftmp);
-        audio_size += ret;
+        ost->size += ret;
         pkt.stream_index= ost->index;
         pkt.data= audio_out;
         pkt.size= ret;
@@ -629,7 +992,7 @@ static void pre_process_video_frame(AVInputStream *ist, AVPicture *picture, void
     AVPicture picture_tmp;
     uint8_t *buf = 0;
 
-    dec = ist->st->codec;
+    dec = ist->dec;
 
     /* deinterlace : must be done before any resize */
     if (do_deinterlace || using_vhook) {
@@ -673,9 +1036,9 @@ static void do_subtitle_out(AVFormatContext *s,
                             AVOutputStream *ost,
                             AVInputStream *ist,
                             AVSubtitle *sub,
-                            int64_t pts)
+                            int64_t pts, int64_t ts_offset)
 {
-    static uint8_t *subtitle_out = NULL;
+    uint8_t *subtitle_out;
     int subtitle_out_max_size = 65536;
     int subtitle_out_size, nb, i;
     AVCodecContext *enc;
@@ -688,9 +1051,10 @@ static void do_subtitle_out(AVFormatContext *s,
 
     enc = ost->st->codec;
 
-    if (!subtitle_out) {
-        subtitle_out = av_malloc(subtitle_out_max_size);
+    if (!ost->subtitle_out) {
+        ost->subtitle_out = av_malloc(subtitle_out_max_size);
     }
+    subtitle_out = ost->subtitle_out;
 
     /* Note: DVB subtitle need one packet to draw them and one other
        packet to clear them */
@@ -708,7 +1072,7 @@ static void do_subtitle_out(AVFormatContext *s,
         pkt.stream_index = ost->index;
         pkt.data = subtitle_out;
         pkt.size = subtitle_out_size;
-        pkt.pts = av_rescale_q(av_rescale_q(pts, ist->st->time_base, AV_TIME_BASE_Q) + input_files_ts_offset[ist->file_index], AV_TIME_BASE_Q,  ost->st->time_base);
+        pkt.pts = av_rescale_q(av_rescale_q(pts, ist->st->time_base, AV_TIME_BASE_Q) + ts_offset, AV_TIME_BASE_Q,  ost->st->time_base);
         if (enc->codec_id == CODEC_ID_DVB_SUBTITLE) {
             /* XXX: the pts correction is handled here. Maybe handling
                it in the codec would be better */
@@ -722,15 +1086,57 @@ static void do_subtitle_out(AVFormatContext *s,
 }
 
 static int bit_buffer_size= 1024*256;
-static uint8_t *bit_buffer= NULL;
+
+static AVFrame *get_cascade_frame(AVOutputJob *job, AVOutputStream *ost);
+
+/* scale the frame of a job for a stream which other streams are scaled
+   from */
+static void scale_cascade_frame(AVOutputJob *job, AVOutputStream *ost)
+{
+    AVFrame *src, *dst = &job->cascade_frames[ost->cascade_index];
+
+    if (ost->cascade_src)
+        src = get_cascade_frame(job, ost->cascade_src);
+    else
+        src = &job->picture;
+    sws_scale(ost->img_resample_ctx, src->data, src->linesize,
+              0, ost->resample_height, dst->data, dst->linesize);
+
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&job_mutex);
+    job->cascade_ready[ost->cascade_index] = 1;
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&job_mutex);
+#else
+    job->cascade_ready[ost->cascade_index] = 1;
+#endif
+}
+
+/* get the frame of a job scaled for ost; when the streams are encoded
+   concurrently, only the thread of ost scales it */
+static AVFrame *get_cascade_frame(AVOutputJob *job, AVOutputStream *ost)
+{
+#ifdef HAVE_PTHREADS
+    if (pipeline) {
+        pthread_mutex_lock(&job_mutex);
+        while (!job->cascade_ready[ost->cascade_index])
+            pthread_cond_wait(&job_cond, &job_mutex);
+        pthread_mutex_unlock(&job_mutex);
+    } else
+#endif
+    if (!job->cascade_ready[ost->cascade_index])
+        scale_cascade_frame(job, ost);
+    return &job->cascade_frames[ost->cascade_index];
+}
 
 static void do_video_out(AVFormatContext *s,
                          AVOutputStream *ost,
                          AVInputStream *ist,
-                         AVFrame *in_picture,
+                         AVOutputJob *job,
                          int *frame_size)
 {
     int nb_frames, i, ret;
+    AVFrame *in_picture = &job->picture;
     AVFrame *final_picture, *formatted_picture, *resampling_dst, *padding_src;
     AVFrame picture_crop_temp, picture_pad_temp;
     uint8_t *buf = NULL, *buf1 = NULL;
@@ -740,13 +1146,18 @@ static void do_video_out(AVFormatContext *s,
     avcodec_get_frame_defaults(&picture_pad_temp);
 
     enc = ost->st->codec;
-    dec = ist->st->codec;
+    dec = ist->dec;
 
     /* by default, we output a single frame */
     nb_frames = 1;
 
     *frame_size = 0;
 
+    /* the streams scaled from this one need the frame even if it is
+       dropped here */
+    if (ost->cascade_index >= 0 && !job->cascade_ready[ost->cascade_index])
+        scale_cascade_frame(job, ost);
+
     if(video_sync_method){
         double vdelta;
         vdelta = get_sync_ipts(ost) / av_q2d(enc->time_base) - ost->sync_opts;
@@ -757,11 +1168,11 @@ static void do_video_out(AVFormatContext *s,
             nb_frames = lrintf(vdelta);
 //fprintf(stderr, "vdelta:%f, ost->sync_opts:%lld, ost->sync_ipts:%f nb_frames:%d\n", vdelta, ost->sync_opts, ost->sync_ipts, nb_frames);
         if (nb_frames == 0){
-            ++nb_frames_drop;
+            ++ost->nb_frames_drop;
             if (verbose>2)
                 fprintf(stderr, "*** drop!\n");
         }else if (nb_frames > 1) {
-            nb_frames_dup += nb_frames;
+            ost->nb_frames_dup += nb_frames;
             if (verbose>2)
                 fprintf(stderr, "*** %d dup!\n", nb_frames-1);
         }
@@ -778,6 +1189,8 @@ static void do_video_out(AVFormatContext *s,
             goto the_end;
         }
         formatted_picture = &picture_crop_temp;
+    } else if (ost->cascade_src) {
+        formatted_picture = get_cascade_frame(job, ost->cascade_src);
     } else {
         formatted_picture = in_picture;
     }
@@ -796,7 +1209,9 @@ static void do_video_out(AVFormatContext *s,
         }
     }
 
-    if (ost->video_resample) {
+    if (ost->cascade_index >= 0) {
+        final_picture = &job->cascade_frames[ost->cascade_index];
+    } else if (ost->video_resample) {
         padding_src = NULL;
         final_picture = &ost->pict_tmp;
         sws_scale(ost->img_resample_ctx, formatted_picture->data, formatted_picture->linesize,
@@ -847,7 +1262,7 @@ static void do_video_out(AVFormatContext *s,
             /* handles sameq here. This is not correct because it may
                not be a global option */
             if (same_quality) {
-                big_picture.quality = ist->st->quality;
+                big_picture.quality = in_picture->quality;
             }else
                 big_picture.quality = ost->st->quality;
             if(!me_threshold)
@@ -857,11 +1272,11 @@ static void do_video_out(AVFormatContext *s,
 //            big_picture.pts= av_rescale(ost->sync_opts, AV_TIME_BASE*(int64_t)enc->time_base.num, enc->time_base.den);
 //av_log(NULL, AV_LOG_DEBUG, "%lld -> encoder\n", ost->sync_opts);
             ret = avcodec_encode_video(enc,
-                                       bit_buffer, bit_buffer_size,
+                                       ost->bit_buffer, bit_buffer_size,
                                        &big_picture);
             //enc->frame_number = enc->real_pict_num;
             if(ret>0){
-                pkt.data= bit_buffer;
+                pkt.data= ost->bit_buffer;
                 pkt.size= ret;
                 if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
                     pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
@@ -907,6 +1322,9 @@ static void do_video_stats(AVFormatContext *os, AVOutputStream *ost,
     int64_t ti;
     double ti1, bitrate, avg_bitrate;
 
+#ifdef HAVE_PTHREADS
+    pthread_mutex_lock(&vstats_mutex);
+#endif
     if (!fvstats) {
         today2 = time(NULL);
         today = localtime(&today2);
@@ -935,11 +1353,14 @@ static void do_video_stats(AVFormatContext *os, AVOutputStream *ost,
             ti1 = 0.01;
 
         bitrate = (frame_size * 8) / av_q2d(enc->time_base) / 1000.0;
-        avg_bitrate = (double)(video_size * 8) / ti1 / 1000.0;
+        avg_bitrate = (double)(ost->size * 8) / ti1 / 1000.0;
         fprintf(fvstats, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
-            (double)video_size / 1024, ti1, bitrate, avg_bitrate);
+            (double)ost->size / 1024, ti1, bitrate, avg_bitrate);
         fprintf(fvstats,"type= %c\n", av_get_pict_type_char(enc->coded_frame->pict_type));
     }
+#ifdef HAVE_PTHREADS
+    pthread_mutex_unlock(&vstats_mutex);
+#endif
 }
 
 static void print_report(AVFormatContext **output_files,
@@ -949,9 +1370,9 @@ static void print_report(AVFormatContext **output_files,
     char buf[1024];
     AVOutputStream *ost;
     AVFormatContext *oc, *os;
-    int64_t total_size;
+    int64_t total_size, video_size, audio_size;
     AVCodecContext *enc;
-    int frame_number, vid, i;
+    int frame_number, vid, i, nb_frames_dup, nb_frames_drop;
     double bitrate, ti1, pts;
     static int64_t last_time = -1;
     static int qp_histogram[52];
@@ -977,10 +1398,18 @@ static void print_report(AVFormatContext **output_files,
     buf[0] = '\0';
     ti1 = 1e10;
     vid = 0;
+    video_size = audio_size = 0;
+    nb_frames_dup = nb_frames_drop = 0;
     for(i=0;i<nb_ostreams;i++) {
         ost = ost_table[i];
         os = output_files[ost->file_index];
         enc = ost->st->codec;
+        if (enc->codec_type == CODEC_TYPE_VIDEO)
+            video_size += ost->size;
+        else if (enc->codec_type == CODEC_TYPE_AUDIO)
+            audio_size += ost->size;
+        nb_frames_dup += ost->nb_frames_dup;
+        nb_frames_drop += ost->nb_frames_drop;
         if (vid && enc->codec_type == CODEC_TYPE_VIDEO) {
             snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "q=%2.1f ",
                     enc->coded_frame->quality/(float)FF_QP2LAMBDA);
@@ -1041,6 +1470,26 @@ static void print_report(AVFormatContext **output_files,
           snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " dup=%d drop=%d",
                   nb_frames_dup, nb_frames_drop);
 
+#ifdef HAVE_PTHREADS
+        /* packets and frames waiting for each stage */
+        if ((pipeline || nb_input_threads) && !is_last_report) {
+            int dec_size = 0, enc_size = 0, mux_size = 0;
+
+            for(i=0;i<nb_input_files;i++) {
+                if (input_threaded[i])
+                    dec_size += stage_queue_size(&input_queues[i]);
+            }
+            for(i=0;pipeline && !remux && i<nb_ostreams;i++) {
+                enc_size += stage_queue_size(ost_table[i]->job_queue);
+                mux_size += stage_queue_size(ost_table[i]->packet_queue);
+            }
+            for(i=0;remux && i<nb_output_files;i++)
+                mux_size += stage_queue_size(&mux_queues[i]);
+            snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " dec=%d enc=%d mux=%d",
+                     dec_size, enc_size, mux_size);
+        }
+#endif
+
         if (verbose >= 0)
             fprintf(stderr, "%s    \r", buf);
 
@@ -1059,13 +1508,360 @@ static void print_report(AVFormatContext **output_files,
     }
 }
 
+static AVOutputJob *output_jobs;
+static int nb_output_jobs;
+static int nb_cascade_frames;
+
+static void free_subtitle(AVSubtitle *sub)
+{
+    int i;
+
+    /* XXX: allocate the subtitles in the codec ? */
+    if (sub->rects != NULL) {
+        for (i = 0; i < sub->num_rects; i++) {
+            av_free(sub->rects[i].bitmap);
+            av_free(sub->rects[i].rgba_palette);
+        }
+        av_freep(&sub->rects);
+    }
+    sub->num_rects = 0;
+}
+
+/* encode (or copy) a decoded frame in the output stream ost_table[i], or
+   flush its encoder at EOF. last is set if no other output stream uses
+   the job after this one */
+static void process_output_stream(AVOutputJob *job, AVOutputStream *ost, int i, int last)
+{
+    AVInputStream *ist = job->ist;
+    const AVPacket *pkt = &job->pkt;
+    uint8_t *data_buf = job->data_buf;
+    int data_size = job->data_size;
+    AVFormatContext *os = output_files[ost->file_index];
+    AVCodecContext *enc = ost->st->codec;
+    int ret, frame_size;
+
+    if (job->is_start)
+        ost->is_start = 1;
+
+    if (job->eof) {
+        if(enc->codec_type == CODEC_TYPE_AUDIO && enc->frame_size <=1)
+            return;
+        if(enc->codec_type == CODEC_TYPE_VIDEO && (os->oformat->flags & AVFMT_RAWPICTURE))
+            return;
+
+        if (ost->encoding_needed) {
+            for(;;) {
+                AVPacket pkt;
+                int fifo_bytes;
+                av_init_packet(&pkt);
+                pkt.stream_index= ost->index;
+
+                switch(enc->codec_type) {
+                case CODEC_TYPE_AUDIO:
+                    fifo_bytes = fifo_size(&ost->fifo, NULL);
+                    ret = 0;
+                    /* encode any samples remaining in fifo */
+                    if(fifo_bytes > 0 && enc->codec->capabilities & CODEC_CAP_SMALL_LAST_FRAME) {
+                        int fs_tmp = enc->frame_size;
+                        enc->frame_size = fifo_bytes / (2 * enc->channels);
+                        /* the fifo never holds more than 2*MAX_AUDIO_PACKET_SIZE */
+                        if (!ost->audio_buf)
+                            ost->audio_buf = av_malloc(2*MAX_AUDIO_PACKET_SIZE);
+                        if(ost->audio_buf && fifo_read(&ost->fifo, ost->audio_buf, fifo_bytes,
+                                &ost->fifo.rptr) == 0) {
+                            ret = avcodec_encode_audio(enc, ost->bit_buffer, bit_buffer_size, (short *)ost->audio_buf);
+                        }
+                        enc->frame_size = fs_tmp;
+                    }
+                    if(ret <= 0) {
+                        ret = avcodec_encode_audio(enc, ost->bit_buffer, bit_buffer_size, NULL);
+                    }
+                    ost->size += ret;
+                    pkt.flags |= PKT_FLAG_KEY;
+                    break;
+                case CODEC_TYPE_VIDEO:
+                    ret = avcodec_encode_video(enc, ost->bit_buffer, bit_buffer_size, NULL);
+                    ost->size += ret;
+                    if(enc->coded_frame && enc->coded_frame->key_frame)
+                        pkt.flags |= PKT_FLAG_KEY;
+                    if (ost->logfile && enc->stats_out) {
+                        fprintf(ost->logfile, "%s", enc->stats_out);
+                    }
+                    break;
+                default:
+                    ret=-1;
+                }
+
+                if(ret<=0)
+                    break;
+                pkt.data= ost->bit_buffer;
+                pkt.size= ret;
+                if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
+                    pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
+                write_frame(os, &pkt, ost->st->codec, bitstream_filters[ost->file_index][pkt.stream_index]);
+            }
+        }
+        return;
+    }
+
+#if 0
+    printf("%d: got pts=%0.3f %0.3f\n", i,
+           (double)pkt->pts / AV_TIME_BASE,
+           ((double)ist->pts / AV_TIME_BASE) -
+           ((double)ost->st->pts.val * ost->st->time_base.num / ost->st->time_base.den));
+#endif
+    /* set the input output pts pairs */
+    ost->sync_ipts = job->sync_ipts[i];
+
+    if (ost->encoding_needed) {
+        switch(enc->codec_type) {
+        case CODEC_TYPE_AUDIO:
+            do_audio_out(os, ost, ist, data_buf, data_size);
+            break;
+        case CODEC_TYPE_VIDEO:
+                do_video_out(os, ost, ist, job, &frame_size);
+                ost->size += frame_size;
+                if (do_vstats && frame_size)
+                    do_video_stats(os, ost, frame_size);
+            break;
+        case CODEC_TYPE_SUBTITLE:
+            do_subtitle_out(os, ost, ist, &job->subtitle,
+                            pkt->pts, job->ts_offset);
+            break;
+        default:
+            av_abort();
+        }
+    } else {
+        AVFrame *avframe = &ost->copy_frame; //FIXME/XXX remove this
+        AVPacket opkt;
+        av_init_packet(&opkt);
+
+        /* no reencoding needed : output the packet directly */
+        /* force the input stream PTS */
+
+        avcodec_get_frame_defaults(avframe);
+        ost->st->codec->coded_frame= avframe;
+        avframe->key_frame = pkt->flags & PKT_FLAG_KEY;
+
+        if(ost->st->codec->codec_type == CODEC_TYPE_AUDIO)
+            ost->size += data_size;
+        else if (ost->st->codec->codec_type == CODEC_TYPE_VIDEO) {
+            ost->size += data_size;
+            ost->sync_opts++;
+        }
+
+        opkt.stream_index= ost->index;
+        if(pkt->pts != AV_NOPTS_VALUE)
+            opkt.pts= av_rescale_q(av_rescale_q(pkt->pts, ist->st->time_base, AV_TIME_BASE_Q) + job->ts_offset, AV_TIME_BASE_Q,  ost->st->time_base);
+        else
+            opkt.pts= AV_NOPTS_VALUE;
+
+        {
+            int64_t dts;
+            if (pkt->dts == AV_NOPTS_VALUE)
+                dts = job->next_pts;
+            else
+                dts= av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
+            opkt.dts= av_rescale_q(dts + job->ts_offset, AV_TIME_BASE_Q,  ost->st->time_base);
+        }
+        opkt.flags= pkt->flags;
+
+        //FIXME remove the following 2 lines they shall be replaced by the bitstream filters
+        if(av_parser_change(ist->parser ? ist->parser : ist->st->parser, ost->st->codec, &opkt.data, &opkt.size, data_buf, data_size, pkt->flags & PKT_FLAG_KEY))
+            opkt.destruct= av_destruct_packet;
+        else if (last && job->src_pkt && job->src_pkt->destruct == av_destruct_packet &&
+                 opkt.data == job->src_pkt->data && opkt.size == job->src_pkt->size) {
+            /* nothing reads the demuxed packet any more: move its payload
+               to the muxer instead of copying it */
+            opkt.destruct= av_destruct_packet;
+            job->src_pkt->destruct= NULL;
+        }
+
+        write_frame(os, &opkt, ost->st->codec, bitstream_filters[ost->file_index][pkt->stream_index]);
+        ost->st->codec->frame_number++;
+        ost->frame_number++;
+        av_free_packet(&opkt);
+    }
+}
+
+/* encode (or copy) a decoded frame in every output stream fed by its
+   input stream, or flush their encoders at EOF */
+static void process_output_job(AVOutputJob *job,
+                               AVOutputStream **ost_table, int nb_ostreams)
+{
+    int i, last = -1;
+
+    for(i=0;i<nb_ostreams;i++) {
+        if (ost_table[i]->source_index == job->ist_index)
+            last = i;
+    }
+    for(i=0;i<nb_ostreams;i++) {
+        if (ost_table[i]->source_index == job->ist_index)
+            process_output_stream(job, ost_table[i], i, i == last);
+    }
+    if (job->has_subtitle)
+        free_subtitle(&job->subtitle);
+}
+
+#ifdef HAVE_PTHREADS
+/* copy the data of a job which still points to the buffers of the
+   decoder before queueing it */
+static int output_job_copy(AVOutputJob *job)
+{
+    AVCodecContext *dec = job->ist->dec;
+
+    if (job->data_buf && job->data_size > 0) {
+        job->data = av_fast_realloc(job->data, &job->data_alloc, job->data_size);
+        if (!job->data)
+            return -1;
+        memcpy(job->data, job->data_buf, job->data_size);
+        job->data_buf = job->data;
+    }
+    if (job->has_picture) {
+        AVPicture src;
+        int size;
+
+        src = *(AVPicture *)&job->picture;
+        size = avpicture_get_size(dec->pix_fmt, dec->width, dec->height);
+        if (size > job->picture_buf_size) {
+            /* not av_fast_realloc(), the encoders need aligned planes */
+            av_free(job->picture_buf);
+            job->picture_buf_size = 0;
+            job->picture_buf = av_malloc(size);
+            if (!job->picture_buf)
+                return -1;
+            job->picture_buf_size = size;
+        }
+        avpicture_fill((AVPicture *)&job->picture, job->picture_buf,
+                       dec->pix_fmt, dec->width, dec->height);
+        img_copy((AVPicture *)&job->picture, &src,
+                 dec->pix_fmt, dec->width, dec->height);
+    }
+    return 0;
+}
+
+/* called by each output stream which processed the job, the last one
+   makes it reusable */
+static void output_job_release(AVOutputJob *job)
+{
+    int refcount;
+
+    pthread_mutex_lock(&job_mutex);
+    refcount = --job->refcount;
+    pthread_mutex_unlock(&job_mutex);
+    if (refcount > 0)
+        return;
+    if (job->has_subtitle)
+        free_subtitle(&job->subtitle);
+    stage_queue_put(&free_job_queue, job);
+}
+
+/* pass a job to the threads of the output streams fed by its input
+   stream, and tell the muxing threads of their files in which order
+   the packets of the streams must be written */
+static int output_job_queue(AVOutputJob *job)
+{
+    AVOutputStream *ost;
+    int i, j;
+
+    job->refcount = 1;
+    for(i=0;i<nb_output_files;i++) {
+        for(j=0;j<job_nb_ostreams;j++) {
+            ost = job_ost_table[j];
+            if (ost->file_index == i && ost->source_index == job->ist_index)
+                break;
+        }
+        if (j < job_nb_ostreams && stage_queue_put(&mux_queues[i], job->ist) < 0)
+            return -1;
+    }
+    for(i=0;i<job_nb_ostreams;i++) {
+        ost = job_ost_table[i];
+        if (ost->source_index == job->ist_index) {
+            pthread_mutex_lock(&job_mutex);
+            job->refcount++;
+            pthread_mutex_unlock(&job_mutex);
+            if (stage_queue_put(ost->job_queue, job) < 0)
+                return -1;
+        }
+    }
+    /* drop the reference held while queueing */
+    output_job_release(job);
+    return 0;
+}
+#endif
+
+/* pass a frame decoded by output_packet() to the encoding stage, the
+   subtitle is freed once encoded */
+static int output_frame(AVInputStream *ist, int ist_index,
+                        AVOutputStream **ost_table, int nb_ostreams,
+                        AVPacket *pkt, int eof,
+                        uint8_t *data_buf, int data_size,
+                        AVFrame *picture, AVSubtitle *subtitle)
+{
+    AVOutputJob *job;
+    AVInputStream *sync_ist;
+    int i;
+
+#ifdef HAVE_PTHREADS
+    if (pipeline && !remux) {
+        void *item;
+
+        if (stage_queue_get(&free_job_queue, &item) <= 0)
+            return -1;
+        job = item;
+    } else
+#endif
+        job = &output_jobs[0];
+
+    job->ist = ist;
+    job->ist_index = ist_index;
+    job->eof = eof;
+    job->is_start = ist->discontinuity;
+    ist->discontinuity = 0;
+    job->next_pts = ist->next_pts;
+    job->ts_offset = input_files_ts_offset[ist->file_index];
+    for(i=0;i<nb_ostreams;i++) {
+        sync_ist = ost_table[i]->sync_ist;
+        job->sync_ipts[i] = sync_ist->pts + input_files_ts_offset[sync_ist->file_index];
+    }
+    if (pkt)
+        job->pkt = *pkt;
+    else
+        av_init_packet(&job->pkt);
+    job->pkt.data = NULL;
+    job->pkt.destruct = NULL;
+    job->src_pkt = pkt;
+    job->data_buf = data_buf;
+    job->data_size = data_size;
+    job->has_picture = picture != NULL;
+    if (picture)
+        job->picture = *picture;
+    job->has_subtitle = subtitle != NULL;
+    if (subtitle)
+        job->subtitle = *subtitle;
+    memset(job->cascade_ready, 0, nb_cascade_frames * sizeof(int));
+
+#ifdef HAVE_PTHREADS
+    if (pipeline && !remux) {
+        job->src_pkt = NULL;
+        if (output_job_copy(job) < 0) {
+            if (job->has_subtitle)
+                free_subtitle(&job->subtitle);
+            stage_queue_put(&free_job_queue, job);
+            return -1;
+        }
+        return output_job_queue(job);
+    }
+#endif
+    process_output_job(job, ost_table, nb_ostreams);
+    return 0;
+}
+
 /* pkt = NULL means EOF (needed to flush decoder buffers) */
 static int output_packet(AVInputStream *ist, int ist_index,
                          AVOutputStream **ost_table, int nb_ostreams,
-                         const AVPacket *pkt)
+                         AVPacket *pkt)
 {
-    AVFormatContext *os;
-    AVOutputStream *ost;
     uint8_t *ptr;
     int len, ret, i;
     uint8_t *data_buf;
@@ -1101,13 +1897,13 @@ static int output_packet(AVInputStream *ist, int ist_index,
         data_size = 0;
         subtitle_to_free = NULL;
         if (ist->decoding_needed) {
-            switch(ist->st->codec->codec_type) {
+            switch(ist->dec->codec_type) {
             case CODEC_TYPE_AUDIO:{
                 if(pkt)
                     samples= av_fast_realloc(samples, &samples_size, FFMAX(pkt->size, AVCODEC_MAX_AUDIO_FRAME_SIZE));
                     /* XXX: could avoid copy if PCM 16 bits with same
                        endianness as CPU */
-                ret = avcodec_decode_audio(ist->st->codec, samples, &data_size,
+                ret = avcodec_decode_audio(ist->dec, samples, &data_size,
                                            ptr, len);
                 if (ret < 0)
                     goto fail_decode;
@@ -1121,14 +1917,14 @@ static int output_packet(AVInputStream *ist, int ist_index,
                 }
                 data_buf = (uint8_t *)samples;
                 ist->next_pts += ((int64_t)AV_TIME_BASE/2 * data_size) /
-                    (ist->st->codec->sample_rate * ist->st->codec->channels);
+                    (ist->dec->sample_rate * ist->dec->channels);
                 break;}
             case CODEC_TYPE_VIDEO:
-                    data_size = (ist->st->codec->width * ist->st->codec->height * 3) / 2;
+                    data_size = (ist->dec->width * ist->dec->height * 3) / 2;
                     /* XXX: allocate picture correctly */
                     avcodec_get_frame_defaults(&picture);
 
-                    ret = avcodec_decode_video(ist->st->codec,
+                    ret = avcodec_decode_video(ist->dec,
                                                &picture, &got_picture, ptr, len);
                     ist->st->quality= picture.quality;
                     if (ret < 0)
@@ -1137,15 +1933,15 @@ static int output_packet(AVInputStream *ist, int ist_index,
                         /* no picture yet */
                         goto discard_packet;
                     }
-                    if (ist->st->codec->time_base.num != 0) {
+                    if (ist->dec->time_base.num != 0) {
                         ist->next_pts += ((int64_t)AV_TIME_BASE *
-                                          ist->st->codec->time_base.num) /
-                            ist->st->codec->time_base.den;
+                                          ist->dec->time_base.num) /
+                            ist->dec->time_base.den;
                     }
                     len = 0;
                     break;
             case CODEC_TYPE_SUBTITLE:
-                ret = avcodec_decode_subtitle(ist->st->codec,
+                ret = avcodec_decode_subtitle(ist->dec,
                                               &subtitle, &got_subtitle, ptr, len);
                 if (ret < 0)
                     goto fail_decode;
@@ -1159,16 +1955,16 @@ static int output_packet(AVInputStream *ist, int ist_index,
                 goto fail_decode;
             }
         } else {
-                switch(ist->st->codec->codec_type) {
+                switch(ist->dec->codec_type) {
                 case CODEC_TYPE_AUDIO:
-                    ist->next_pts += ((int64_t)AV_TIME_BASE * ist->st->codec->frame_size) /
-                        (ist->st->codec->sample_rate * ist->st->codec->channels);
+                    ist->next_pts += ((int64_t)AV_TIME_BASE * ist->dec->frame_size) /
+                        (ist->dec->sample_rate * ist->dec->channels);
                     break;
                 case CODEC_TYPE_VIDEO:
-                    if (ist->st->codec->time_base.num != 0) {
+                    if (ist->dec->time_base.num != 0) {
                         ist->next_pts += ((int64_t)AV_TIME_BASE *
-                                          ist->st->codec->time_base.num) /
-                            ist->st->codec->time_base.den;
+                                          ist->dec->time_base.num) /
+                            ist->dec->time_base.den;
                     }
                     break;
                 }
@@ -1179,13 +1975,13 @@ static int output_packet(AVInputStream *ist, int ist_index,
             }
 
             buffer_to_free = NULL;
-            if (ist->st->codec->codec_type == CODEC_TYPE_VIDEO) {
+            if (ist->dec->codec_type == CODEC_TYPE_VIDEO) {
                 pre_process_video_frame(ist, (AVPicture *)&picture,
                                         &buffer_to_free);
             }
 
             // preprocess audio (volume)
-            if (ist->st->codec->codec_type == CODEC_TYPE_AUDIO) {
+            if (ist->dec->codec_type == CODEC_TYPE_AUDIO) {
                 if (audio_volume != 256) {
                     short *volp;
                     volp = samples;
@@ -1199,8 +1995,8 @@ static int output_packet(AVInputStream *ist, int ist_index,
             }
 
             /* frame rate emulation */
-            if (ist->st->codec->rate_emu) {
-                int64_t pts = av_rescale((int64_t) ist->frame * ist->st->codec->time_base.num, 1000000, ist->st->codec->time_base.den);
+            if (ist->dec->rate_emu) {
+                int64_t pts = av_rescale((int64_t) ist->frame * ist->dec->time_base.num, 1000000, ist->dec->time_base.den);
                 int64_t now = av_gettime() - ist->start;
                 if (pts > now)
                     usleep(pts - now);
@@ -1212,8 +2008,8 @@ static int output_packet(AVInputStream *ist, int ist_index,
             /* mpeg PTS deordering : if it is a P or I frame, the PTS
                is the one of the next displayed one */
             /* XXX: add mpeg4 too ? */
-            if (ist->st->codec->codec_id == CODEC_ID_MPEG1VIDEO) {
-                if (ist->st->codec->pict_type != B_TYPE) {
+            if (ist->dec->codec_id == CODEC_ID_MPEG1VIDEO) {
+                if (ist->dec->pict_type != B_TYPE) {
                     int64_t tmp;
                     tmp = ist->last_ip_pts;
                     ist->last_ip_pts  = ist->frac_pts.val;
@@ -1223,174 +2019,398 @@ static int output_packet(AVInputStream *ist, int ist_index,
 #endif
             /* if output time reached then transcode raw format,
                encode packets and output them */
-            if (start_time == 0 || ist->pts >= start_time)
-                for(i=0;i<nb_ostreams;i++) {
-                    int frame_size;
-
-                    ost = ost_table[i];
-                    if (ost->source_index == ist_index) {
-                        os = output_files[ost->file_index];
-
-#if 0
-                        printf("%d: got pts=%0.3f %0.3f\n", i,
-                               (double)pkt->pts / AV_TIME_BASE,
-                               ((double)ist->pts / AV_TIME_BASE) -
-                               ((double)ost->st->pts.val * ost->st->time_base.num / ost->st->time_base.den));
-#endif
-                        /* set the input output pts pairs */
-                        //ost->sync_ipts = (double)(ist->pts + input_files_ts_offset[ist->file_index] - start_time)/ AV_TIME_BASE;
-
-                        if (ost->encoding_needed) {
-                            switch(ost->st->codec->codec_type) {
-                            case CODEC_TYPE_AUDIO:
-                                do_audio_out(os, ost, ist, data_buf, data_size);
-                                break;
-                            case CODEC_TYPE_VIDEO:
-                                    do_video_out(os, ost, ist, &picture, &frame_size);
-                                    video_size += frame_size;
-                                    if (do_vstats && frame_size)
-                                        do_video_stats(os, ost, frame_size);
-                                break;
-                            case CODEC_TYPE_SUBTITLE:
-                                do_subtitle_out(os, ost, ist, &subtitle,
-                                                pkt->pts);
-                                break;
-                            default:
-                                av_abort();
-                            }
-                        } else {
-                            AVFrame avframe; //FIXME/XXX remove this
-                            AVPacket opkt;
-                            av_init_packet(&opkt);
-
-                            /* no reencoding needed : output the packet directly */
-                            /* force the input stream PTS */
-
-                            avcodec_get_frame_defaults(&avframe);
-                            ost->st->codec->coded_frame= &avframe;
-                            avframe.key_frame = pkt->flags & PKT_FLAG_KEY;
-
-                            if(ost->st->codec->codec_type == CODEC_TYPE_AUDIO)
-                                audio_size += data_size;
-                            else if (ost->st->codec->codec_type == CODEC_TYPE_VIDEO) {
-                                video_size += data_size;
-                                ost->sync_opts++;
-                            }
-
-                            opkt.stream_index= ost->index;
-                            if(pkt->pts != AV_NOPTS_VALUE)
-                                opkt.pts= av_rescale_q(av_rescale_q(pkt->pts, ist->st->time_base, AV_TIME_BASE_Q) + input_files_ts_offset[ist->file_index], AV_TIME_BASE_Q,  ost->st->time_base);
-                            else
-                                opkt.pts= AV_NOPTS_VALUE;
-
-                            {
-                                int64_t dts;
-                                if (pkt->dts == AV_NOPTS_VALUE)
-                                    dts = ist->next_pts;
-                                else
-                                    dts= av_rescale_q(pkt->dts, ist->st->time_base, AV_TIME_BASE_Q);
-                                opkt.dts= av_rescale_q(dts + input_files_ts_offset[ist->file_index], AV_TIME_BASE_Q,  ost->st->time_base);
-                            }
-                            opkt.flags= pkt->flags;
-
-                            //FIXME remove the following 2 lines they shall be replaced by the bitstream filters
-                            if(av_parser_change(ist->st->parser, ost->st->codec, &opkt.data, &opkt.size, data_buf, data_size, pkt->flags & PKT_FLAG_KEY))
-                                opkt.destruct= av_destruct_packet;
-
-                            write_frame(os, &opkt, ost->st->codec, bitstream_filters[ost->file_index][pkt->stream_index]);
-                            ost->st->codec->frame_number++;
-                            ost->frame_number++;
-                            av_free_packet(&opkt);
-                        }
-                    }
-                }
+            if (start_time == 0 || ist->pts >= start_time) {
+                output_frame(ist, ist_index, ost_table, nb_ostreams, pkt, 0,
+                             data_buf, data_size,
+                             ist->decoding_needed && ist->dec->codec_type == CODEC_TYPE_VIDEO ? &picture : NULL,
+                             subtitle_to_free);
+                subtitle_to_free = NULL;
+            }
             av_free(buffer_to_free);
-            /* XXX: allocate the subtitles in the codec ? */
             if (subtitle_to_free) {
-                if (subtitle_to_free->rects != NULL) {
-                    for (i = 0; i < subtitle_to_free->num_rects; i++) {
-                        av_free(subtitle_to_free->rects[i].bitmap);
-                        av_free(subtitle_to_free->rects[i].rgba_palette);
-                    }
-                    av_freep(&subtitle_to_free->rects);
-                }
-                subtitle_to_free->num_rects = 0;
+                free_subtitle(subtitle_to_free);
                 subtitle_to_free = NULL;
             }
         }
  discard_packet:
+#ifdef HAVE_PTHREADS
+    if (ist->decoding_needed && input_threaded[ist->file_index])
+        input_stream_publish(ist);
+#endif
     if (pkt == NULL) {
         /* EOF handling */
+        output_frame(ist, ist_index, ost_table, nb_ostreams, NULL, 1,
+                     NULL, 0, NULL, NULL);
+    }
 
-        for(i=0;i<nb_ostreams;i++) {
-            ost = ost_table[i];
-            if (ost->source_index == ist_index) {
-                AVCodecContext *enc= ost->st->codec;
-                os = output_files[ost->file_index];
+    return 0;
+ fail_decode:
+    return -1;
+}
 
-                if(ost->st->codec->codec_type == CODEC_TYPE_AUDIO && enc->frame_size <=1)
-                    continue;
-                if(ost->st->codec->codec_type == CODEC_TYPE_VIDEO && (os->oformat->flags & AVFMT_RAWPICTURE))
-                    continue;
 
-                if (ost->encoding_needed) {
-                    for(;;) {
-                        AVPacket pkt;
-                        int fifo_bytes;
-                        av_init_packet(&pkt);
-                        pkt.stream_index= ost->index;
-
-                        switch(ost->st->codec->codec_type) {
-                        case CODEC_TYPE_AUDIO:
-                            fifo_bytes = fifo_size(&ost->fifo, NULL);
-                            ret = 0;
-                            /* encode any samples remaining in fifo */
-                            if(fifo_bytes > 0 && enc->codec->capabilities & CODEC_CAP_SMALL_LAST_FRAME) {
-                                int fs_tmp = enc->frame_size;
-                                enc->frame_size = fifo_bytes / (2 * enc->channels);
-                                if(fifo_read(&ost->fifo, (uint8_t *)samples, fifo_bytes,
-                                        &ost->fifo.rptr) == 0) {
-                                    ret = avcodec_encode_audio(enc, bit_buffer, bit_buffer_size, samples);
-                                }
-                                enc->frame_size = fs_tmp;
-                            }
-                            if(ret <= 0) {
-                                ret = avcodec_encode_audio(enc, bit_buffer, bit_buffer_size, NULL);
-                            }
-                            audio_size += ret;
-                            pkt.flags |= PKT_FLAG_KEY;
-                            break;
-                        case CODEC_TYPE_VIDEO:
-                            ret = avcodec_encode_video(enc, bit_buffer, bit_buffer_size, NULL);
-                            video_size += ret;
-                            if(enc->coded_frame && enc->coded_frame->key_frame)
-                                pkt.flags |= PKT_FLAG_KEY;
-                            if (ost->logfile && enc->stats_out) {
-                                fprintf(ost->logfile, "%s", enc->stats_out);
-                            }
-                            break;
-                        default:
-                            ret=-1;
-                        }
+#ifdef HAVE_PTHREADS
+/* read the packets of one input file, so that a slow input does not
+   delay the others as long as they are not selected. The streams have
+   their own codec contexts, the decoders pass the fields which change
+   the timestamps before each packet is read */
+static void *input_thread(void *arg)
+{
+    AVStageQueue *q = arg;
+    int file_index = q - input_queues;
+    AVFormatContext *is = input_files[file_index];
+    AVInputFile *file = &input_file_table[file_index];
+    AVInputStream *ist;
+    AVCodecContext *avctx;
+    AVReadPacket *rpkt;
+    AVPacket pkt;
+    int i;
 
-                        if(ret<=0)
-                            break;
-                        pkt.data= bit_buffer;
-                        pkt.size= ret;
-                        if(enc->coded_frame && enc->coded_frame->pts != AV_NOPTS_VALUE)
-                            pkt.pts= av_rescale_q(enc->coded_frame->pts, enc->time_base, ost->st->time_base);
-                        write_frame(os, &pkt, ost->st->codec, bitstream_filters[ost->file_index][pkt.stream_index]);
-                    }
-                }
+    for(;;) {
+        pthread_mutex_lock(&q->mutex);
+        for(i=0;i<file->nb_streams;i++) {
+            ist = input_ist_table[file->ist_index + i];
+            if (ist->reader_changes != ist->dec_changes) {
+                avctx = ist->st->codec;
+                avctx->has_b_frames = ist->has_b_frames;
+                avctx->frame_size = ist->frame_size;
+                avctx->time_base = ist->time_base;
+                ist->reader_changes = ist->dec_changes;
             }
         }
+        pthread_mutex_unlock(&q->mutex);
+
+        if (av_read_frame(is, &pkt) < 0)
+            break;
+        rpkt = (AVReadPacket *)packet_queue_item(&pkt, sizeof(AVReadPacket));
+        av_free_packet(&pkt);
+        if (!rpkt)
+            break;
+        avctx = is->streams[rpkt->pkt.stream_index]->codec;
+        rpkt->frame_size = avctx->frame_size;
+        rpkt->sample_rate = avctx->sample_rate;
+        rpkt->channels = avctx->channels;
+        rpkt->time_base = avctx->time_base;
+        if (stage_queue_put(q, rpkt) < 0) {
+            av_free_packet(&rpkt->pkt);
+            av_free(rpkt);
+            break;
+        }
     }
+    stage_queue_finish(q, 0);
+    return NULL;
+}
+
+/* give the streams of a file read ahead a copy of their codec context,
+   which av_read_frame() uses on the reading thread to parse the packets
+   and compute their timestamps while the main thread decodes them */
+static int input_file_detach(int file_index)
+{
+    AVInputFile *file = &input_file_table[file_index];
+    AVInputStream *ist;
+    AVCodecContext *avctx;
+    int i;
 
+    for(i=0;i<file->nb_streams;i++) {
+        ist = input_ist_table[file->ist_index + i];
+        avctx = av_malloc(sizeof(AVCodecContext));
+        if (!avctx)
+            return -1;
+        *avctx = *ist->dec;
+        ist->st->codec = avctx;
+        ist->has_b_frames = avctx->has_b_frames;
+        ist->frame_size = avctx->frame_size;
+        ist->time_base = avctx->time_base;
+        ist->dec_changes = ist->reader_changes = 0;
+    }
     return 0;
- fail_decode:
+}
+
+/* give the streams back their codec context once the file is no longer
+   read ahead */
+static void input_file_attach(int file_index)
+{
+    AVInputFile *file = &input_file_table[file_index];
+    AVInputStream *ist;
+    int i;
+
+    for(i=0;i<file->nb_streams;i++) {
+        ist = input_ist_table[file->ist_index + i];
+        if (ist->st->codec != ist->dec) {
+            av_free(ist->st->codec);
+            ist->st->codec = ist->dec;
+        }
+    }
+}
+
+/* read each input file on its own thread. The packets copied while the
+   file is read are changed with a parser of their own, as the parser of
+   the stream is used by the reading thread */
+static int input_threads_start(AVInputStream **ist_table, int nb_istreams,
+                               AVInputFile *file_table, int nb_input_files)
+{
+    int i;
+
+    input_ist_table = ist_table;
+    input_file_table = file_table;
+    for(i=0;i<nb_input_files;i++)
+        input_threaded[i] = 1;
+    for(i=0;i<nb_istreams;i++) {
+        AVInputStream *ist = ist_table[i];
+        AVFormatContext *ic = input_files[ist->file_index];
+
+        /* the demuxers change the palette of the decoders as they read
+           the packets, so it must not be read ahead of the decoding */
+        if (ist->decoding_needed && ist->dec->palctrl)
+            input_threaded[ist->file_index] = 0;
+        if (!ist->decoding_needed && (ist->st->parser ||
+            (ist->st->need_parsing && !(ic->flags & AVFMT_FLAG_NOPARSE))))
+            ist->parser = av_parser_init(ist->dec->codec_id);
+    }
+
+    for(i=0;i<nb_input_files;i++) {
+        AVStageQueue *q = &input_queues[i];
+
+        if (!input_threaded[i])
+            continue;
+        if (input_file_detach(i) < 0 ||
+            stage_queue_init(q, pipeline_size) < 0) {
+            input_file_attach(i);
+            goto fail;
+        }
+        if (pthread_create(&input_thread_ids[i], NULL, input_thread, q)) {
+            stage_queue_end(q);
+            input_file_attach(i);
+            goto fail;
+        }
+        nb_input_threads++;
+    }
+    return 0;
+ fail:
+    for(; i<nb_input_files; i++)
+        input_threaded[i] = 0;
     return -1;
 }
 
+/* stop reading the input files and drop the packets read in advance */
+static void input_threads_stop(AVInputStream **ist_table, int nb_istreams)
+{
+    int i;
+
+    for(i=0;i<MAX_FILES;i++) {
+        if (!input_threaded[i])
+            continue;
+        stage_queue_finish(&input_queues[i], 1);
+        pthread_join(input_thread_ids[i], NULL);
+        packet_queue_flush(&input_queues[i]);
+        stage_queue_end(&input_queues[i]);
+        for(; input_batch_index[i] < input_batch_size[i]; input_batch_index[i]++) {
+            AVPacket *pkt = input_batches[i][input_batch_index[i]];
+            av_free_packet(pkt);
+            av_free(pkt);
+        }
+        input_batch_index[i] = input_batch_size[i] = 0;
+        input_file_attach(i);
+        input_threaded[i] = 0;
+    }
+    nb_input_threads = 0;
+    for(i=0;i<nb_istreams;i++) {
+        if (ist_table[i]->parser) {
+            av_parser_close(ist_table[i]->parser);
+            ist_table[i]->parser = NULL;
+        }
+    }
+}
+
+/* encode the frames of one output stream, arg points to the stream in
+   the output stream table */
+static void *encode_thread(void *arg)
+{
+    AVOutputStream **postream = arg;
+    AVOutputStream *ost = *postream;
+    void *job;
+
+    while (stage_queue_get(ost->job_queue, &job) > 0) {
+        process_output_stream(job, ost, postream - job_ost_table, 0);
+        stage_queue_put(ost->packet_queue, NULL);
+        stage_queue_done(ost->job_queue, 1);
+        output_job_release(job);
+    }
+    return NULL;
+}
+
+/* write the packets of the streams of one output file in the order
+   they would be written by a single thread: job after job, and stream
+   after stream for each job */
+static void *mux_thread(void *arg)
+{
+    AVStageQueue *q = arg;
+    int file_index = q - mux_queues;
+    AVFormatContext *s = output_files[file_index];
+    AVOutputStream *ost;
+    void *ist, *pkt, *pkts[PACKET_BATCH];
+    int i, n;
+
+    if (remux) {
+        /* the queue holds the packets themselves */
+        while ((n = stage_queue_get_batch(q, pkts, PACKET_BATCH)) > 0) {
+            for(i=0;i<n;i++) {
+                av_interleaved_write_frame(s, pkts[i]);
+                av_free_packet(pkts[i]);
+                av_free(pkts[i]);
+            }
+            stage_queue_done(q, n);
+        }
+        return NULL;
+    }
+
+    while (stage_queue_get(q, &ist) > 0) {
+        for(i=0;i<job_nb_ostreams;i++) {
+            ost = job_ost_table[i];
+            if (ost->file_index != file_index || job_ist_table[ost->source_index] != ist)
+                continue;
+            while (stage_queue_get(ost->packet_queue, &pkt) > 0) {
+                stage_queue_done(ost->packet_queue, 1);
+                if (!pkt)
+                    break;
+                av_interleaved_write_frame(s, pkt);
+                av_free_packet(pkt);
+                av_free(pkt);
+            }
+        }
+        stage_queue_done(q, 1);
+    }
+    return NULL;
+}
+
+/* run the encoding of each output stream and the muxing of each output
+   file on their own threads. When all the streams are copied, only the
+   muxing threads are run */
+static int pipeline_start(AVInputStream **ist_table,
+                          AVOutputStream **ost_table, int nb_ostreams)
+{
+    AVOutputStream *ost;
+    int i;
+
+    remux = 1;
+    for(i=0;i<nb_ostreams;i++) {
+        if (ost_table[i]->encoding_needed)
+            remux = 0;
+    }
+
+    if (stage_queue_init(&free_job_queue, nb_output_jobs) < 0)
+        return -1;
+    for(i=0;i<nb_output_jobs;i++)
+        stage_queue_put(&free_job_queue, &output_jobs[i]);
+    job_ost_table = ost_table;
+    job_nb_ostreams = nb_ostreams;
+    job_ist_table = ist_table;
+
+    pipeline = 1;
+    for(i=0;!remux && i<nb_ostreams;i++) {
+        ost = ost_table[i];
+        ost->job_queue = av_mallocz(sizeof(AVStageQueue));
+        ost->packet_queue = av_mallocz(sizeof(AVStageQueue));
+        /* a stream never has to wait to get a job */
+        if (!ost->job_queue || !ost->packet_queue ||
+            stage_queue_init(ost->job_queue, nb_output_jobs) < 0 ||
+            stage_queue_init(ost->packet_queue, pipeline_size) < 0 ||
+            pthread_create(&ost->thread_id, NULL, encode_thread, &ost_table[i]))
+            return -1;
+    }
+    for(i=0;i<nb_output_files;i++) {
+        if (stage_queue_init(&mux_queues[i], remux ? FFMAX(pipeline_size, PACKET_BATCH) : nb_output_jobs) < 0 ||
+            pthread_create(&mux_thread_ids[i], NULL, mux_thread, &mux_queues[i]))
+            return -1;
+    }
+    return 0;
+}
+
+/* wait until the encoding and muxing stages have processed all the
+   frames decoded so far */
+static void pipeline_wait(void)
+{
+    int i;
+
+    for(i=0;!remux && i<job_nb_ostreams;i++)
+        stage_queue_wait(job_ost_table[i]->job_queue);
+    for(i=0;i<nb_output_files;i++)
+        stage_queue_wait(&mux_queues[i]);
+}
+
+/* finish encoding and muxing the frames decoded so far */
+static void pipeline_stop(void)
+{
+    AVOutputStream *ost;
+    int i;
+
+    for(i=0;!remux && i<job_nb_ostreams;i++) {
+        ost = job_ost_table[i];
+        stage_queue_finish(ost->job_queue, 0);
+        pthread_join(ost->thread_id, NULL);
+    }
+    for(i=0;i<nb_output_files;i++) {
+        stage_queue_finish(&mux_queues[i], 0);
+        pthread_join(mux_thread_ids[i], NULL);
+        stage_queue_end(&mux_queues[i]);
+    }
+    for(i=0;!remux && i<job_nb_ostreams;i++) {
+        ost = job_ost_table[i];
+        stage_queue_end(ost->job_queue);
+        stage_queue_end(ost->packet_queue);
+        av_freep(&ost->job_queue);
+        av_freep(&ost->packet_queue);
+    }
+    stage_queue_end(&free_job_queue);
+    pipeline = 0;
+    remux = 0;
+}
+#endif
+
+/* true if the output stream only scales the decoded frames, so that it
+   can be scaled from another output stream with -cascade */
+static int is_cascade_candidate(AVOutputStream *ost)
+{
+    return ost->encoding_needed &&
+           ost->st->codec->codec_type == CODEC_TYPE_VIDEO &&
+           ost->video_resample && !ost->video_crop && !ost->video_pad;
+}
+
+static int read_input_packet(int file_index, AVPacket *pkt)
+{
+#ifdef HAVE_PTHREADS
+    if (input_threaded[file_index]) {
+        AVPacket **batch = input_batches[file_index];
+        AVReadPacket *rpkt;
+        AVInputStream *ist;
+
+        /* take the packets read in advance in batches to lock the queue
+           less often */
+        if (input_batch_index[file_index] == input_batch_size[file_index]) {
+            int n = stage_queue_get_batch(&input_queues[file_index],
+                                          (void **)batch, PACKET_BATCH);
+            if (n <= 0)
+                return -1;
+            input_batch_index[file_index] = 0;
+            input_batch_size[file_index] = n;
+        }
+        rpkt = (AVReadPacket *)batch[input_batch_index[file_index]++];
+        *pkt = rpkt->pkt;
+        /* the copied streams are not decoded, their codec context only
+           follows the one of the reading thread */
+        ist = input_stream(file_index, pkt->stream_index);
+        if (ist && !ist->decoding_needed) {
+            ist->dec->frame_size = rpkt->frame_size;
+            ist->dec->sample_rate = rpkt->sample_rate;
+            ist->dec->channels = rpkt->channels;
+            ist->dec->time_base = rpkt->time_base;
+        }
+        av_free(rpkt);
+        return 0;
+    }
+#endif
+    return av_read_frame(input_files[file_index], pkt);
+}
 
 /*
  * The following code is the main loop of the file converter
@@ -1409,6 +2429,7 @@ static int av_encode(AVFormatContext **output_files,
     AVInputFile *file_table;
     AVFormatContext *stream_no_data;
     int key;
+    int pipeline_sync = 0;
 
     file_table= (AVInputFile*) av_mallocz(nb_input_files * sizeof(AVInputFile));
     if (!file_table)
@@ -1440,12 +2461,13 @@ static int av_encode(AVFormatContext **output_files,
         for(k=0;k<is->nb_streams;k++) {
             ist = ist_table[j++];
             ist->st = is->streams[k];
+            ist->dec = ist->st->codec;
             ist->file_index = i;
             ist->index = k;
             ist->discard = 1; /* the stream is discarded by default
                                  (changed later) */
 
-            if (ist->st->codec->rate_emu) {
+            if (ist->dec->rate_emu) {
                 ist->start = av_gettime();
                 ist->frame = 0;
             }
@@ -1489,6 +2511,8 @@ static int av_encode(AVFormatContext **output_files,
         ost = av_mallocz(sizeof(AVOutputStream));
         if (!ost)
             goto fail;
+        ost->is_start = 1;
+        ost->cascade_index = -1;
         ost_table[i] = ost;
     }
 
@@ -1519,7 +2543,7 @@ static int av_encode(AVFormatContext **output_files,
                 for(j=0;j<nb_istreams;j++) {
                     ist = ist_table[j];
                     if (ist->discard &&
-                        ist->st->codec->codec_type == ost->st->codec->codec_type) {
+                        ist->dec->codec_type == ost->st->codec->codec_type) {
                         ost->source_index = j;
                         found = 1;
                         break;
@@ -1530,7 +2554,7 @@ static int av_encode(AVFormatContext **output_files,
                     /* try again and reuse existing stream */
                     for(j=0;j<nb_istreams;j++) {
                         ist = ist_table[j];
-                        if (ist->st->codec->codec_type == ost->st->codec->codec_type) {
+                        if (ist->dec->codec_type == ost->st->codec->codec_type) {
                             ost->source_index = j;
                             found = 1;
                         }
@@ -1556,7 +2580,7 @@ static int av_encode(AVFormatContext **output_files,
         ist = ist_table[ost->source_index];
 
         codec = ost->st->codec;
-        icodec = ist->st->codec;
+        icodec = ist->dec;
 
         if (ost->st->stream_copy) {
             /* if stream_copy is selected, no need to decode or encode */
@@ -1728,10 +2752,87 @@ static int av_encode(AVFormatContext **output_files,
         }
     }
 
-    if (!bit_buffer)
-        bit_buffer = av_malloc(bit_buffer_size);
-    if (!bit_buffer)
+    for(i=0;i<nb_ostreams;i++) {
+        ost = ost_table[i];
+        if (ost->encoding_needed) {
+            ost->bit_buffer = av_malloc(bit_buffer_size);
+            if (!ost->bit_buffer)
+                goto fail;
+        }
+    }
+
+    /* scale the smaller video outputs of an input stream from the frame
+       scaled for the next larger one */
+    nb_cascade_frames = 0;
+    for(i=0;scale_cascade && i<nb_ostreams;i++) {
+        AVOutputStream *src = NULL;
+        int area, src_area = 0;
+
+        ost = ost_table[i];
+        codec = ost->st->codec;
+        if (!is_cascade_candidate(ost))
+            continue;
+        area = codec->width * codec->height;
+        for(j=0;j<nb_ostreams;j++) {
+            AVOutputStream *ost2 = ost_table[j];
+            AVCodecContext *codec2 = ost2->st->codec;
+            int area2 = codec2->width * codec2->height;
+
+            if (j == i || !is_cascade_candidate(ost2) ||
+                ost2->source_index != ost->source_index ||
+                codec2->pix_fmt != codec->pix_fmt ||
+                codec2->width < codec->width || codec2->height < codec->height)
+                continue;
+            /* streams of the same size are chained in index order */
+            if (area2 == area && j > i)
+                continue;
+            /* the smallest one, the last one in index order if several
+               streams have the same size */
+            if (!src || area2 <= src_area) {
+                src = ost2;
+                src_area = area2;
+            }
+        }
+        if (!src)
+            continue;
+
+        ost->cascade_src = src;
+        if (src->cascade_index < 0)
+            src->cascade_index = nb_cascade_frames++;
+        sws_freeContext(ost->img_resample_ctx);
+        ost->img_resample_ctx = sws_getContext(
+                src->st->codec->width, src->st->codec->height, src->st->codec->pix_fmt,
+                codec->width, codec->height, codec->pix_fmt,
+                sws_flags, NULL, NULL, NULL);
+        if (ost->img_resample_ctx == NULL) {
+            fprintf(stderr, "Cannot get resampling context\n");
+            exit(1);
+        }
+        ost->resample_height = src->st->codec->height;
+    }
+
+    /* allocate the frames passed from the decoding to the encoding stage */
+    nb_output_jobs = FFMAX(pipeline_size, 1);
+    output_jobs = av_mallocz(nb_output_jobs * sizeof(AVOutputJob));
+    if (!output_jobs)
         goto fail;
+    for(i=0;i<nb_output_jobs;i++) {
+        AVOutputJob *job = &output_jobs[i];
+
+        job->sync_ipts = av_mallocz(FFMAX(nb_ostreams, 1) * sizeof(int64_t));
+        job->cascade_frames = av_mallocz(FFMAX(nb_cascade_frames, 1) * sizeof(AVFrame));
+        job->cascade_ready = av_mallocz(FFMAX(nb_cascade_frames, 1) * sizeof(int));
+        if (!job->sync_ipts || !job->cascade_frames || !job->cascade_ready)
+            goto fail;
+        for(j=0;j<nb_ostreams;j++) {
+            ost = ost_table[j];
+            codec = ost->st->codec;
+            if (ost->cascade_index >= 0 &&
+                avpicture_alloc((AVPicture *)&job->cascade_frames[ost->cascade_index],
+                                codec->pix_fmt, codec->width, codec->height))
+                goto fail;
+        }
+    }
 
     /* dump the file output parameters - cannot be done before in case
        of stream copy */
@@ -1782,19 +2883,19 @@ static int av_encode(AVFormatContext **output_files,
         ist = ist_table[i];
         if (ist->decoding_needed) {
             AVCodec *codec;
-            codec = avcodec_find_decoder(ist->st->codec->codec_id);
+            codec = avcodec_find_decoder(ist->dec->codec_id);
             if (!codec) {
                 fprintf(stderr, "Unsupported codec (id=%d) for input stream #%d.%d\n",
-                        ist->st->codec->codec_id, ist->file_index, ist->index);
+                        ist->dec->codec_id, ist->file_index, ist->index);
                 exit(1);
             }
-            if (avcodec_open(ist->st->codec, codec) < 0) {
+            if (avcodec_open(ist->dec, codec) < 0) {
                 fprintf(stderr, "Error while opening codec for input stream #%d.%d\n",
                         ist->file_index, ist->index);
                 exit(1);
             }
-            //if (ist->st->codec->codec_type == CODEC_TYPE_VIDEO)
-            //    ist->st->codec->flags |= CODEC_FLAG_REPEAT_FIELD;
+            //if (ist->dec->codec_type == CODEC_TYPE_VIDEO)
+            //    ist->dec->flags |= CODEC_FLAG_REPEAT_FIELD;
         }
     }
 
@@ -1808,7 +2909,6 @@ static int av_encode(AVFormatContext **output_files,
             ist->next_pts=0;
         if(input_files_ts_offset[ist->file_index])
             ist->next_pts= AV_NOPTS_VALUE;
-        ist->is_start = 1;
     }
 
     /* compute buffer size max (should use a complete heuristic) */
@@ -1857,6 +2957,38 @@ static int av_encode(AVFormatContext **output_files,
         }
     }
 
+#ifdef HAVE_PTHREADS
+    if (pipeline_size > 0) {
+        int raw_picture = 0;
+
+        if (input_threads_start(ist_table, nb_istreams, file_table, nb_input_files) < 0) {
+            fprintf(stderr, "Could not start the input threads\n");
+            exit(1);
+        }
+
+        for(i=0;i<nb_output_files;i++) {
+            if (output_files[i]->oformat->flags & AVFMT_RAWPICTURE)
+                raw_picture = 1;
+        }
+        /* raw pictures are written as pointers to the decoded frames, and
+           with -me_threshold or -mb_threshold the encoders use the motion
+           vectors of the decoded frames: both need the decoder to wait */
+        if (!raw_picture && !me_threshold && !mb_threshold) {
+            if (pipeline_start(ist_table, ost_table, nb_ostreams) < 0) {
+                fprintf(stderr, "Could not start the pipeline threads\n");
+                exit(1);
+            }
+            /* the choice of the next input file and the end conditions
+               depend on what the encoding and muxing stages have done */
+            pipeline_sync = nb_input_files > 1 || recording_time > 0 || limit_filesize != 0;
+            for(i=0;i<4;i++) {
+                if (max_frames[i] != INT_MAX)
+                    pipeline_sync = 1;
+            }
+        }
+    }
+#endif
+
 #ifndef __MINGW32__
     if ( !using_stdin && verbose >= 0) {
         fprintf(stderr, "Press [q] to stop encoding\n");
@@ -1887,6 +3019,11 @@ static int av_encode(AVFormatContext **output_files,
                 break;
         }
 
+#ifdef HAVE_PTHREADS
+        if (pipeline_sync)
+            pipeline_wait();
+#endif
+
         /* select the stream that we must read now by looking at the
            smallest output pts */
         file_index = -1;
@@ -1930,11 +3067,12 @@ static int av_encode(AVFormatContext **output_files,
 
         /* read a frame from it and output it in the fifo */
         is = input_files[file_index];
-        if (av_read_frame(is, &pkt) < 0) {
+        if (read_input_packet(file_index, &pkt) < 0) {
             file_table[file_index].eof_reached = 1;
             if (opt_shortest) break; else continue; //
         }
 
+        input_size += pkt.size;
         if (!pkt.size) {
             stream_no_data = is;
         } else {
@@ -1952,7 +3090,7 @@ static int av_encode(AVFormatContext **output_files,
         if (ist->discard)
             goto discard_packet;
 
-//        fprintf(stderr, "next:%lld dts:%lld off:%lld %d\n", ist->next_pts, pkt.dts, input_files_ts_offset[ist->file_index], ist->st->codec->codec_type);
+//        fprintf(stderr, "next:%lld dts:%lld off:%lld %d\n", ist->next_pts, pkt.dts, input_files_ts_offset[ist->file_index], ist->dec->codec_type);
         if (pkt.dts != AV_NOPTS_VALUE && ist->next_pts != AV_NOPTS_VALUE) {
             int64_t delta= av_rescale_q(pkt.dts, ist->st->time_base, AV_TIME_BASE_Q) - ist->next_pts;
             if(ABS(delta) > 1LL*dts_delta_threshold*AV_TIME_BASE && !copy_ts){
@@ -1962,7 +3100,7 @@ static int av_encode(AVFormatContext **output_files,
                 for(i=0; i<file_table[file_index].nb_streams; i++){
                     int index= file_table[file_index].ist_index + i;
                     ist_table[index]->next_pts += delta;
-                    ist_table[index]->is_start=1;
+                    ist_table[index]->discontinuity=1;
                 }
             }
         }
@@ -1993,6 +3131,12 @@ static int av_encode(AVFormatContext **output_files,
         }
     }
 
+#ifdef HAVE_PTHREADS
+    input_threads_stop(ist_table, nb_istreams);
+    if (pipeline)
+        pipeline_stop();
+#endif
+
     term_exit();
 
     /* write the trailer if needed and close file */
@@ -2017,7 +3161,7 @@ static int av_encode(AVFormatContext **output_files,
     for(i=0;i<nb_istreams;i++) {
         ist = ist_table[i];
         if (ist->decoding_needed) {
-            avcodec_close(ist->st->codec);
+            avcodec_close(ist->dec);
         }
     }
 
@@ -2025,9 +3169,25 @@ static int av_encode(AVFormatContext **output_files,
 
     ret = 0;
  fail1:
-    av_freep(&bit_buffer);
     av_free(file_table);
 
+    if (output_jobs) {
+        for(i=0;i<nb_output_jobs;i++) {
+            AVOutputJob *job = &output_jobs[i];
+
+            if (job->cascade_frames) {
+                for(j=0;j<nb_cascade_frames;j++)
+                    av_free(job->cascade_frames[j].data[0]);
+            }
+            av_free(job->cascade_frames);
+            av_free(job->cascade_ready);
+            av_free(job->sync_ipts);
+            av_free(job->data);
+            av_free(job->picture_buf);
+        }
+        av_freep(&output_jobs);
+    }
+
     if (ist_table) {
         for(i=0;i<nb_istreams;i++) {
             ist = ist_table[i];
@@ -2046,6 +3206,11 @@ static int av_encode(AVFormatContext **output_files,
                 fifo_free(&ost->fifo); /* works even if fifo is not
                                           initialized but set to zero */
                 av_free(ost->pict_tmp.data[0]);
+                av_free(ost->bit_buffer);
+                av_free(ost->audio_buf);
+                av_free(ost->audio_out);
+                av_free(ost->input_tmp);
+                av_free(ost->subtitle_out);
                 if (ost->video_resample)
                     sws_freeContext(ost->img_resample_ctx);
                 if (ost->audio_resample)
@@ -2808,6 +3973,15 @@ static void opt_input_file(const char *filename)
 
     if(genpts)
         ic->flags|= AVFMT_FLAG_GENPTS;
+    if(index_cache)
+        ic->flags|= AVFMT_FLAG_INDEXCACHE;
+    if(header_only)
+        ic->flags|= AVFMT_FLAG_HEADERONLY;
+    if(no_parse)
+        ic->flags|= AVFMT_FLAG_NOPARSE;
+    ic->probesize = probesize;
+    ic->probe_packets = probe_packets;
+    ic->probe_time = probe_time;
 
     /* If not enough info to get the stream parameters, we decode the
        first frames to get it. (used in mpeg case for example) */
@@ -3432,6 +4606,10 @@ static void opt_output_file(const char *filename)
     oc->preload= (int)(mux_preload*AV_TIME_BASE);
     oc->max_delay= (int)(mux_max_delay*AV_TIME_BASE);
     oc->loop_output = loop_output;
+    if (mux_faststart)
+        oc->flags |= AVFMT_FLAG_FASTSTART;
+    if (mux_fragment)
+        oc->flags |= AVFMT_FLAG_FRAGMENT;
 
     /* reset some options */
     file_oformat = NULL;
@@ -3975,6 +5153,14 @@ const OptionDef options[] = {
       "when dumping packets, also dump the payload" },
     { "re", OPT_BOOL | OPT_EXPERT, {(void*)&rate_emu}, "read input at native frame rate", "" },
     { "loop_input", OPT_BOOL | OPT_EXPERT, {(void*)&loop_input}, "loop (current only works with images)" },
+    { "indexcache", OPT_BOOL | OPT_EXPERT, {(void*)&index_cache}, "cache the seek index and duration of the input files" },
+    { "headeronly", OPT_BOOL | OPT_EXPERT, {(void*)&header_only}, "trust the stream parameters of the input file headers" },
+    { "noparse", OPT_BOOL | OPT_EXPERT, {(void*)&no_parse}, "use the packets and timestamps of the input file containers as they are" },
+    { "probesize", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&probesize}, "maximum number of bytes read to find the stream parameters", "size" },
+    { "probepackets", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&probe_packets}, "maximum number of packets read to find the stream parameters", "n" },
+    { "probetime", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&probe_time}, "maximum time in milliseconds spent finding the stream parameters", "ms" },
+    { "pipeline", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&pipeline_size}, "number of packets and frames queued between the demuxing, decoding, encoding and muxing threads (0, the default, to use a single thread)", "number" },
+    { "cascade", OPT_BOOL | OPT_EXPERT | OPT_VIDEO, {(void*)&scale_cascade}, "scale the smaller video outputs of an input stream from the next larger one" },
     { "loop_output", HAS_ARG | OPT_INT | OPT_EXPERT, {(void*)&loop_output}, "number of times to loop output in formats that support looping (0 loops forever)", "" },
     { "v", HAS_ARG, {(void*)opt_verbose}, "control amount of logging", "verbose" },
     { "target", HAS_ARG, {(void*)opt_target}, "specify target file type (\"vcd\", \"svcd\", \"dvd\", \"dv\", \"dv50\", \"pal-vcd\", \"ntsc-svcd\", ...)", "type" },
@@ -4099,6 +5285,8 @@ const OptionDef options[] = {
     { "packetsize", OPT_INT | HAS_ARG | OPT_EXPERT, {(void*)&mux_packet_size}, "set packet size", "size" },
     { "muxdelay", OPT_FLOAT | HAS_ARG | OPT_EXPERT, {(void*)&mux_max_delay}, "set the maximum demux-decode delay", "seconds" },
     { "muxpreload", OPT_FLOAT | HAS_ARG | OPT_EXPERT, {(void*)&mux_preload}, "set the initial demux-decode delay", "seconds" },
+    { "faststart", OPT_BOOL | OPT_EXPERT, {(void*)&mux_faststart}, "put the index of MOV/MP4 files before the data" },
+    { "fragment", OPT_BOOL | OPT_EXPERT, {(void*)&mux_fragment}, "write MOV/MP4 files as one fragment per GOP" },
 
     { "absf", HAS_ARG | OPT_AUDIO | OPT_EXPERT, {(void*)opt_audio_bsf}, "", "bitstream filter" },
     { "vbsf", HAS_ARG | OPT_VIDEO | OPT_EXPERT, {(void*)opt_video_bsf}, "", "bitstream filter" },
@@ -4203,7 +5391,7 @@ void parse_arg_file(const char *filename)
 int main(int argc, char **argv)
 {
     int i;
-    int64_t ti;
+    int64_t ti, rti;
 
     av_register_all();
 
@@ -4229,10 +5417,15 @@ int main(int argc, char **argv)
     }
 
     ti = getutime();
+    rti = av_gettime();
     av_encode(output_files, nb_output_files, input_files, nb_input_files,
               stream_maps, nb_stream_maps);
     ti = getutime() - ti;
+    rti = av_gettime() - rti;
     if (do_benchmark) {
+        printf("bench: read=%0.3fMB rtime=%0.3fs rate=%0.3fMB/s\n",
+               input_size / 1048576.0, rti / 1000000.0,
+               rti > 0 ? input_size / 1048576.0 * 1000000.0 / rti : 0.0);
         printf("bench: utime=%0.3fs\n", ti / 1000000.0);
     }
 
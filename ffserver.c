@@ -31,6 +31,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -38,6 +39,9 @@
 #ifdef CONFIG_HAVE_DLFCN
 #include <dlfcn.h>
 #endif
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
 
 #include "version.h"
 #include "ffserver.h"
@@ -45,6 +49,17 @@
 /* maximum number of simultaneous HTTP connections */
 #define HTTP_MAX_CONNECTIONS 2000
 
+/* maximum number of HTTP worker processes */
+#define HTTP_MAX_WORKERS 64
+
+/* order the accesses to the memory shared with the worker processes */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define memory_barrier() __sync_synchronize()
+#else
+/* only a compiler barrier, which is enough on x86 */
+#define memory_barrier() __asm__ volatile("" ::: "memory")
+#endif
+
 enum HTTPState {
     HTTPSTATE_WAIT_REQUEST,
     HTTPSTATE_SEND_HEADER,
@@ -87,6 +102,14 @@ const char *http_state[] = {
 
 #define SYNC_TIMEOUT (10 * 1000)
 
+/* a connection using a shared muxer which is that many bytes late
+   skips to the last key frame, the connections are checked every
+   quarter of it */
+#define SHARED_MUX_MAX_LAG (4 * 1024 * 1024)
+
+/* maximum number of bytes sent at once in passthrough mode */
+#define PASSTHROUGH_MAX_SEND (256 * 1024)
+
 typedef struct {
     int64_t count1, count2;
     long time1, time2;
@@ -153,8 +176,51 @@ typedef struct HTTPContext {
     /* RTP/TCP specific */
     struct HTTPContext *rtsp_c;
     uint8_t *packet_buffer, *packet_buffer_ptr, *packet_buffer_end;
+
+    /* shared muxer specific */
+    struct SharedMux *shared_mux;
+    struct MuxChunk *mux_chunk; /* chunk being sent, or last chunk sent */
+    int mux_chunk_sent;         /* true if mux_chunk was completely sent */
+    int mux_wait_key;           /* true until a key frame chunk is found */
+    uint8_t *mux_data;          /* unsent end of a chunk left by a late connection */
+
+    /* passthrough specific */
+    int passthrough;            /* true if the file data is sent as is */
+    int passthrough_fd;
+    int passthrough_sync;       /* true until a feed packet with a frame start is found */
+    offset_t passthrough_pos;   /* file position of the next byte to send */
+    offset_t passthrough_size;  /* size of the file (not used for feeds) */
 } HTTPContext;
 
+/* output of a shared muxer, for one input packet. A chunk holds a
+   reference to the next one, so a chunk stays valid as long as it is
+   referenced by a connection or by the previous chunk */
+typedef struct MuxChunk {
+    struct MuxChunk *next;
+    int refcount;
+    int key_frame;      /* true if a connection can start with this chunk */
+    int64_t pos;        /* position of the chunk in the muxed stream */
+    int size;
+    uint8_t *data;
+} MuxChunk;
+
+/* muxer whose output is sent to all the connections of a stream, so
+   that each packet is muxed only once */
+typedef struct SharedMux {
+    struct FFStream *stream;
+    AVFormatContext *fmt_in;   /* feed input, at the live position */
+    AVFormatContext fmt_ctx;   /* output format handling */
+    int key_stream_index;      /* stream giving the key frames, -1 if none */
+    uint8_t *header;           /* output of av_write_header() */
+    int header_size;
+    MuxChunk *first;           /* oldest chunk kept for new connections */
+    MuxChunk *last;            /* newest chunk */
+    MuxChunk *last_key;        /* newest key frame chunk */
+    int64_t size;              /* total size of the muxed stream */
+    int64_t next_lag_check;    /* size at which the late connections are checked */
+    int nb_connections;
+} SharedMux;
+
 static AVFrame dummy_frame;
 
 /* each generated stream is described here */
@@ -212,6 +278,9 @@ typedef struct FFStream {
     int multicast_port; /* first port used for multicast */
     int multicast_ttl;
     int loop; /* if true, send the stream in loops (only meaningful if file) */
+    int use_shared_mux; /* if true, live connections share a single muxer */
+    int passthrough;    /* if true, the file or feed data is sent without remuxing */
+    struct SharedMux *shared_mux;
 
     /* feed specific */
     int feed_opened;     /* true if someone is writing to the feed */
@@ -222,9 +291,31 @@ typedef struct FFStream {
     int64_t feed_max_size;      /* maximum storage size, zero means unlimited */
     int64_t feed_write_index;   /* current write position in feed (it wraps round) */
     int64_t feed_size;          /* current size of feed */
+    FFMIndex *feed_index;       /* time index of the feed */
+    struct SharedFeedState *shared_state; /* feed state seen by the workers */
+    int header_count;    /* last feed header parsed by a worker */
     struct FFStream *next_feed;
 } FFStream;
 
+/* feed state published by the main process to the HTTP workers. The
+   main process is the only writer; seq is odd while an update is in
+   progress */
+typedef struct SharedFeedState {
+    volatile unsigned int seq;
+    volatile int opened;
+    volatile int64_t write_index;
+    volatile int64_t size;
+    volatile int header_count; /* incremented when a new header is received */
+    uint8_t header[FFM_PACKET_SIZE];
+} SharedFeedState;
+
+/* load of each server process (index 0 is the main process) */
+typedef struct SharedLoad {
+    volatile int pid;
+    volatile int nb_connections;
+    volatile int bandwidth;
+} SharedLoad;
+
 typedef struct FeedData {
     long long data_count;
     float avg_frame_size;   /* frame size averraged over last frames with exponential mean */
@@ -239,6 +330,8 @@ static FFStream *first_feed;   /* contains only feeds */
 static FFStream *first_stream; /* contains all streams, including feeds */
 
 static void new_connection(int server_fd, int is_rtsp);
+static int receive_connection(int worker_fd);
+static void reap_children(void);
 static void close_connection(HTTPContext *c);
 
 /* HTTP handling */
@@ -249,6 +342,17 @@ static void compute_stats(HTTPContext *c);
 static int open_input_stream(HTTPContext *c, const char *info);
 static int http_start_receive_data(HTTPContext *c);
 static int http_receive_data(HTTPContext *c);
+static int parse_feed_header(FFStream *feed, uint8_t *buf, int size);
+
+/* shared muxer handling */
+static int can_use_shared_mux(HTTPContext *c, const char *info);
+static int shared_mux_add_connection(HTTPContext *c);
+static void shared_mux_remove_connection(HTTPContext *c);
+
+/* passthrough handling */
+static int can_use_passthrough(HTTPContext *c, const char *info);
+static int open_passthrough(HTTPContext *c, const char *info);
+static int http_send_passthrough(HTTPContext *c);
 
 /* RTSP handling */
 static int rtsp_parse_request(HTTPContext *c);
@@ -278,6 +382,7 @@ static int ffserver_debug;
 static int ffserver_daemon;
 static int no_launch;
 static int need_to_start_children;
+static volatile sig_atomic_t child_exited; /* set by the SIGCHLD handler */
 
 static int nb_max_connections;
 static int nb_connections;
@@ -285,6 +390,13 @@ static int nb_connections;
 static int max_bandwidth;
 static int current_bandwidth;
 
+static int nb_workers;          /* number of HTTP worker processes */
+static int worker_index;        /* 0 in the main process, 1..nb_workers in workers */
+static int worker_fds[HTTP_MAX_WORKERS + 1]; /* dispatch sockets, indexed like worker_index, -1 once the worker exited */
+static int next_worker;
+static int feeds_updated;
+static SharedLoad *shared_load;
+
 static long cur_time;           // Making this global saves on passing it around everywhere
 
 static long gettime_ms(void)
@@ -506,6 +618,192 @@ static void start_multicast(void)
     }
 }
 
+/* publish the state of a feed to the workers, along with the new
+   feed header if not NULL. Only the main process writes it */
+static void publish_feed_state(FFStream *feed, const uint8_t *header)
+{
+    SharedFeedState *fs = feed->shared_state;
+
+    if (!fs)
+        return;
+    fs->seq++;
+    memory_barrier();
+    fs->opened = feed->feed_opened;
+    fs->write_index = feed->feed_write_index;
+    fs->size = feed->feed_size;
+    if (header) {
+        memcpy(fs->header, header, FFM_PACKET_SIZE);
+        fs->header_count++;
+    }
+    memory_barrier();
+    fs->seq++;
+    feeds_updated = 1;
+}
+
+/* update the local copy of the feeds from the state published by the
+   main process, and wake up the connections waiting for new data */
+static void refresh_feed_states(void)
+{
+    FFStream *feed;
+    HTTPContext *c;
+    uint8_t header[FFM_PACKET_SIZE];
+
+    for(feed = first_feed; feed != NULL; feed = feed->next_feed) {
+        SharedFeedState *fs = feed->shared_state;
+        unsigned int seq;
+        int opened, header_count;
+        int64_t write_index, size;
+
+        if (!fs)
+            continue;
+        do {
+            seq = fs->seq;
+            memory_barrier();
+            opened = fs->opened;
+            write_index = fs->write_index;
+            size = fs->size;
+            header_count = fs->header_count;
+            if (header_count != feed->header_count)
+                memcpy(header, fs->header, FFM_PACKET_SIZE);
+            memory_barrier();
+        } while ((seq & 1) || seq != fs->seq);
+
+        if (header_count != feed->header_count) {
+            feed->header_count = header_count;
+            parse_feed_header(feed, header, FFM_PACKET_SIZE);
+        }
+
+        if (write_index == feed->feed_write_index &&
+            size == feed->feed_size &&
+            opened == feed->feed_opened)
+            continue;
+        feed->feed_opened = opened;
+        feed->feed_write_index = write_index;
+        feed->feed_size = size;
+
+        for(c = first_http_ctx; c != NULL; c = c->next) {
+            if (c->state == HTTPSTATE_WAIT_FEED &&
+                c->stream->feed == feed) {
+                c->state = HTTPSTATE_SEND_DATA;
+            }
+        }
+    }
+}
+
+static void publish_load(void)
+{
+    if (!shared_load)
+        return;
+    shared_load[worker_index].nb_connections = nb_connections;
+    shared_load[worker_index].bandwidth = current_bandwidth;
+}
+
+/* bandwidth used by all the server processes */
+static int total_bandwidth(void)
+{
+    int i, bandwidth;
+
+    bandwidth = current_bandwidth;
+    if (shared_load) {
+        for(i = 0; i <= nb_workers; i++) {
+            if (i != worker_index)
+                bandwidth += shared_load[i].bandwidth;
+        }
+    }
+    return bandwidth;
+}
+
+/* wake up the workers so that they look at the new feed data */
+static void notify_workers(void)
+{
+    int i;
+
+    for(i = 1; i <= nb_workers; i++) {
+        if (worker_fds[i] >= 0)
+            send(worker_fds[i], "F", 1, MSG_DONTWAIT);
+    }
+}
+
+/* stop handing connections over to a worker which has exited */
+static void close_worker(int i)
+{
+    if (worker_fds[i] < 0)
+        return;
+    close(worker_fds[i]);
+    worker_fds[i] = -1;
+    shared_load[i].nb_connections = 0;
+    shared_load[i].bandwidth = 0;
+}
+
+/* fork the HTTP worker processes. The main process keeps accepting
+   connections, receiving the feeds and serving RTSP and status
+   requests; the other HTTP requests are handed over to the
+   workers. In the workers, *server_fd becomes the socket on which the
+   connections are received and *rtsp_server_fd is closed */
+static int start_workers(int *server_fd, int *rtsp_server_fd)
+{
+    SharedFeedState *feed_states;
+    FFStream *feed;
+    uint8_t *shm;
+    int i, nb_feeds, size, fds[2];
+    pid_t pid;
+
+    if (!nb_workers)
+        return 0;
+
+    nb_feeds = 0;
+    for(feed = first_feed; feed != NULL; feed = feed->next_feed)
+        nb_feeds++;
+
+    size = (nb_workers + 1) * sizeof(SharedLoad) +
+        nb_feeds * sizeof(SharedFeedState);
+    shm = mmap(NULL, size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shm == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    memset(shm, 0, size);
+    shared_load = (SharedLoad *)shm;
+    shared_load[0].pid = getpid();
+
+    feed_states = (SharedFeedState *)(shm + (nb_workers + 1) * sizeof(SharedLoad));
+    for(feed = first_feed; feed != NULL; feed = feed->next_feed) {
+        feed->shared_state = feed_states++;
+        publish_feed_state(feed, NULL);
+    }
+
+    for(i = 1; i <= nb_workers; i++) {
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+            perror("socketpair");
+            return -1;
+        }
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return -1;
+        }
+        if (!pid) {
+            /* In worker */
+            int j;
+
+            close(fds[0]);
+            for(j = 1; j < i; j++)
+                close(worker_fds[j]);
+            close(*server_fd);
+            close(*rtsp_server_fd);
+            *server_fd = fds[1];
+            *rtsp_server_fd = -1;
+            worker_index = i;
+            shared_load[i].pid = getpid();
+            return 0;
+        }
+        close(fds[1]);
+        worker_fds[i] = fds[0];
+    }
+    return 0;
+}
+
 /* main loop of the http server */
 static int http_server(void)
 {
@@ -523,12 +821,16 @@ static int http_server(void)
 
     http_log("ffserver started.\n");
 
-    start_children(first_feed);
+    if (start_workers(&server_fd, &rtsp_server_fd) < 0)
+        return -1;
 
     first_http_ctx = NULL;
     nb_connections = 0;
 
-    start_multicast();
+    if (!worker_index) {
+        start_children(first_feed);
+        start_multicast();
+    }
 
     for(;;) {
         poll_entry = poll_table;
@@ -600,7 +902,15 @@ static int http_server(void)
 
         cur_time = gettime_ms();
 
-        if (need_to_start_children) {
+        if (worker_index)
+            refresh_feed_states();
+
+        if (child_exited && !worker_index) {
+            child_exited = 0;
+            reap_children();
+        }
+
+        if (need_to_start_children && !worker_index) {
             need_to_start_children = 0;
             start_children(first_feed);
         }
@@ -616,15 +926,30 @@ static int http_server(void)
         }
 
         poll_entry = poll_table;
-        /* new HTTP connection request ? */
-        if (poll_entry->revents & POLLIN) {
-            new_connection(server_fd, 0);
-        }
-        poll_entry++;
-        /* new RTSP connection request ? */
-        if (poll_entry->revents & POLLIN) {
-            new_connection(rtsp_server_fd, 1);
+        if (worker_index) {
+            /* connection handed over by the main process ? */
+            if (poll_entry->revents & (POLLIN | POLLERR | POLLHUP)) {
+                if (receive_connection(server_fd) < 0) {
+                    /* the main process has exited */
+                    exit(0);
+                }
+            }
+        } else {
+            /* new HTTP connection request ? */
+            if (poll_entry->revents & POLLIN) {
+                new_connection(server_fd, 0);
+            }
+            poll_entry++;
+            /* new RTSP connection request ? */
+            if (poll_entry->revents & POLLIN) {
+                new_connection(rtsp_server_fd, 1);
+            }
+            if (feeds_updated) {
+                feeds_updated = 0;
+                notify_workers();
+            }
         }
+        publish_load();
     }
 }
 
@@ -643,17 +968,12 @@ static void start_wait_request(HTTPContext *c, int is_rtsp)
     }
 }
 
-static void new_connection(int server_fd, int is_rtsp)
+/* allocate the context of a new connection on socket fd. The socket
+   is closed if the connection cannot be accepted */
+static HTTPContext *add_new_connection(int fd, struct sockaddr_in *from_addr)
 {
-    struct sockaddr_in from_addr;
-    int fd, len;
     HTTPContext *c = NULL;
 
-    len = sizeof(from_addr);
-    fd = accept(server_fd, (struct sockaddr *)&from_addr,
-                &len);
-    if (fd < 0)
-        return;
     fcntl(fd, F_SETFL, O_NONBLOCK);
 
     /* XXX: should output a warning page when coming
@@ -668,7 +988,7 @@ static void new_connection(int server_fd, int is_rtsp)
 
     c->fd = fd;
     c->poll_entry = NULL;
-    c->from_addr = from_addr;
+    c->from_addr = *from_addr;
     c->buffer_size = IOBUFFER_INIT_SIZE;
     c->buffer = av_malloc(c->buffer_size);
     if (!c->buffer)
@@ -678,9 +998,7 @@ static void new_connection(int server_fd, int is_rtsp)
     first_http_ctx = c;
     nb_connections++;
 
-    start_wait_request(c, is_rtsp);
-
-    return;
+    return c;
 
  fail:
     if (c) {
@@ -688,6 +1006,132 @@ static void new_connection(int server_fd, int is_rtsp)
         av_free(c);
     }
     close(fd);
+    return NULL;
+}
+
+static void new_connection(int server_fd, int is_rtsp)
+{
+    struct sockaddr_in from_addr;
+    int fd, len;
+    HTTPContext *c;
+
+    len = sizeof(from_addr);
+    fd = accept(server_fd, (struct sockaddr *)&from_addr,
+                &len);
+    if (fd < 0)
+        return;
+
+    c = add_new_connection(fd, &from_addr);
+    if (!c)
+        return;
+
+    start_wait_request(c, is_rtsp);
+}
+
+/* receive a connection handed over by the main process. Return < 0
+   if the main process has exited */
+static int receive_connection(int worker_fd)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr cm;
+        char control[CMSG_SPACE(sizeof(int))];
+    } control_un;
+    struct cmsghdr *cmsg;
+    struct sockaddr_in from_addr;
+    socklen_t from_len;
+    HTTPContext *c;
+    uint8_t buf[IOBUFFER_INIT_SIZE];
+    int fd, len;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = sizeof(buf) - 1;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_un.control;
+    msg.msg_controllen = sizeof(control_un.control);
+
+    len = recvmsg(worker_fd, &msg, MSG_DONTWAIT);
+    if (len < 0)
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    if (len == 0)
+        return -1;
+
+    fd = -1;
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+    /* a truncated request or descriptor cannot be served */
+    if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+        http_log("Dropped a truncated connection from the main process\n");
+        if (fd >= 0)
+            close(fd);
+        return 0;
+    }
+    /* no descriptor: it is only a feed update notification */
+    if (fd < 0)
+        return 0;
+
+    from_len = sizeof(from_addr);
+    if (getpeername(fd, (struct sockaddr *)&from_addr, &from_len) < 0)
+        memset(&from_addr, 0, sizeof(from_addr));
+
+    c = add_new_connection(fd, &from_addr);
+    if (!c)
+        return 0;
+
+    /* the request has already been read by the main process */
+    start_wait_request(c, 0);
+    memcpy(c->buffer, buf, len);
+    c->buffer_ptr = c->buffer + len;
+    *c->buffer_ptr = '\0';
+    if (http_parse_request(c) < 0) {
+        log_connection(c);
+        close_connection(c);
+    }
+    return 0;
+}
+
+/* hand the connection over to the next worker process which has not
+   exited. The request is sent along with the socket so that the
+   worker can parse it again */
+static int dispatch_connection(HTTPContext *c)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr cm;
+        char control[CMSG_SPACE(sizeof(int))];
+    } control_un;
+    struct cmsghdr *cmsg;
+    int i, worker;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = c->buffer;
+    iov.iov_len = c->buffer_ptr - c->buffer;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_un.control;
+    msg.msg_controllen = sizeof(control_un.control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &c->fd, sizeof(int));
+
+    for(i = 0; i < nb_workers; i++) {
+        worker = 1 + next_worker;
+        next_worker = (next_worker + 1) % nb_workers;
+        if (worker_fds[worker] < 0)
+            continue;
+        if (sendmsg(worker_fds[worker], &msg, 0) >= 0)
+            return 0;
+        /* the worker has exited but was not reaped yet */
+        close_worker(worker);
+    }
+    return -1;
 }
 
 static void close_connection(HTTPContext *c)
@@ -728,6 +1172,10 @@ static void close_connection(HTTPContext *c)
         }
         av_close_input_file(c->fmt_in);
     }
+    if (c->shared_mux)
+        shared_mux_remove_connection(c);
+    if (c->passthrough)
+        close(c->passthrough_fd);
 
     /* free RTP output streams if any */
     nb_streams = 0;
@@ -1169,7 +1617,7 @@ static int http_parse_request(HTTPContext *c)
     char info[1024], *filename;
     char url[1024], *q;
     char protocol[32];
-    char msg[1024];
+    char msg[sizeof(url) + 64]; /* room for the messages quoting the url */
     const char *mime_type;
     FFStream *stream;
     int i;
@@ -1292,7 +1740,7 @@ static int http_parse_request(HTTPContext *c)
         current_bandwidth += stream->bandwidth;
     }
 
-    if (c->post == 0 && max_bandwidth < current_bandwidth) {
+    if (c->post == 0 && max_bandwidth < total_bandwidth()) {
         c->http_error = 200;
         q = c->buffer;
         q += snprintf(q, q - (char *) c->buffer + c->buffer_size, "HTTP/1.0 200 Server too busy\r\n");
@@ -1301,7 +1749,7 @@ static int http_parse_request(HTTPContext *c)
         q += snprintf(q, q - (char *) c->buffer + c->buffer_size, "<html><head><title>Too busy</title></head><body>\r\n");
         q += snprintf(q, q - (char *) c->buffer + c->buffer_size, "<p>The server is too busy to serve your request at this time.</p>\r\n");
         q += snprintf(q, q - (char *) c->buffer + c->buffer_size, "<p>The bandwidth being served (including your stream) is %dkbit/sec, and this exceeds the limit of %dkbit/sec.</p>\r\n",
-            current_bandwidth, max_bandwidth);
+            total_bandwidth(), max_bandwidth);
         q += snprintf(q, q - (char *) c->buffer + c->buffer_size, "</body></html>\r\n");
 
         /* prepare output buffer */
@@ -1514,8 +1962,26 @@ static int http_parse_request(HTTPContext *c)
     if (c->stream->stream_type == STREAM_TYPE_STATUS)
         goto send_stats;
 
+    /* the data is sent by a worker process if there are some left,
+       otherwise by the main process */
+    if (nb_workers && !worker_index && dispatch_connection(c) >= 0) {
+        /* the connection is logged by the worker */
+        c->suppress_log = 1;
+        return -1;
+    }
+
     /* open input stream */
-    if (open_input_stream(c, info) < 0) {
+    if (can_use_passthrough(c, info)) {
+        if (open_passthrough(c, info) < 0) {
+            snprintf(msg, sizeof(msg), "Input stream corresponding to '%s' not found", url);
+            goto send_error;
+        }
+    } else if (can_use_shared_mux(c, info)) {
+        if (shared_mux_add_connection(c) < 0) {
+            snprintf(msg, sizeof(msg), "Input stream corresponding to '%s' not found", url);
+            goto send_error;
+        }
+    } else if (open_input_stream(c, info) < 0) {
         snprintf(msg, sizeof(msg), "Input stream corresponding to '%s' not found", url);
         goto send_error;
     }
@@ -1804,7 +2270,18 @@ static void compute_stats(HTTPContext *c)
                  nb_connections, nb_max_connections);
 
     url_fprintf(pb, "Bandwidth in use: %dk / %dk<BR>\n",
-                 current_bandwidth, max_bandwidth);
+                 total_bandwidth(), max_bandwidth);
+
+    if (nb_workers) {
+        url_fprintf(pb, "<TABLE>\n");
+        url_fprintf(pb, "<TR><th>Worker<th>Pid<th>Connections<th>Bandwidth\n");
+        for (i = 1; i <= nb_workers; i++) {
+            url_fprintf(pb, "<TR><TD><B>%d</B><TD>%d<td align=right>%d<td align=right>%dk\n",
+                        i, shared_load[i].pid, shared_load[i].nb_connections,
+                        shared_load[i].bandwidth);
+        }
+        url_fprintf(pb, "</TABLE>\n");
+    }
 
     url_fprintf(pb, "<TABLE>\n");
     url_fprintf(pb, "<TR><th>#<th>File<th>IP<th>Proto<th>State<th>Target bits/sec<th>Actual bits/sec<th>Bytes transferred\n");
@@ -1832,7 +2309,8 @@ static void compute_stats(HTTPContext *c)
         url_fprintf(pb, "<TR><TD><B>%d</B><TD>%s%s<TD>%s<TD>%s<TD>%s<td align=right>",
                     i,
                     c1->stream ? c1->stream->filename : "",
-                    c1->state == HTTPSTATE_RECEIVE_DATA ? "(input)" : "",
+                    c1->state == HTTPSTATE_RECEIVE_DATA ? "(input)" :
+                    c1->shared_mux ? "(shared)" : "",
                     p,
                     c1->protocol,
                     http_state[c1->state]);
@@ -1947,6 +2425,372 @@ static int open_input_stream(HTTPContext *c, const char *info)
     return 0;
 }
 
+/* open the output format context of a stream */
+static void init_output_streams(AVFormatContext *ctx, FFStream *stream)
+{
+    int i;
+
+    memset(ctx, 0, sizeof(*ctx));
+    pstrcpy(ctx->author, sizeof(ctx->author), stream->author);
+    pstrcpy(ctx->comment, sizeof(ctx->comment), stream->comment);
+    pstrcpy(ctx->copyright, sizeof(ctx->copyright), stream->copyright);
+    pstrcpy(ctx->title, sizeof(ctx->title), stream->title);
+
+    /* open output stream by using specified codecs */
+    ctx->oformat = stream->fmt;
+    ctx->nb_streams = stream->nb_streams;
+    for(i=0;i<ctx->nb_streams;i++) {
+        AVStream *st;
+        AVStream *src;
+        st = av_mallocz(sizeof(AVStream));
+        st->codec= avcodec_alloc_context();
+        ctx->streams[i] = st;
+        /* if file or feed, then just take streams from FFStream struct */
+        if (!stream->feed ||
+            stream->feed == stream)
+            src = stream->streams[i];
+        else
+            src = stream->feed->streams[stream->feed_streams[i]];
+
+        *st = *src;
+        st->priv_data = 0;
+        st->codec->frame_number = 0; /* XXX: should be done in
+                                       AVStream, not in codec */
+        /* I'm pretty sure that this is not correct...
+         * However, without it, we crash
+         */
+        st->codec->coded_frame = &dummy_frame;
+    }
+}
+
+static void mux_chunk_unref(MuxChunk *chunk)
+{
+    MuxChunk *next;
+
+    while (chunk && --chunk->refcount == 0) {
+        next = chunk->next;
+        av_free(chunk->data);
+        av_free(chunk);
+        chunk = next;
+    }
+}
+
+static void shared_mux_close(SharedMux *mux)
+{
+    int i;
+
+    if (mux->fmt_in) {
+        for(i=0;i<mux->fmt_in->nb_streams;i++) {
+            AVStream *st = mux->fmt_in->streams[i];
+            if (st->codec->codec)
+                avcodec_close(st->codec);
+        }
+        av_close_input_file(mux->fmt_in);
+    }
+    for(i=0;i<mux->fmt_ctx.nb_streams;i++)
+        av_free(mux->fmt_ctx.streams[i]);
+    mux_chunk_unref(mux->first);
+    mux->stream->shared_mux = NULL;
+    av_free(mux->header);
+    av_free(mux);
+}
+
+/* open the shared muxer of a live stream, at the current feed
+   position */
+static SharedMux *shared_mux_open(FFStream *stream)
+{
+    SharedMux *mux;
+    AVFormatContext *s;
+    int64_t stream_pos;
+    int i;
+
+    mux = av_mallocz(sizeof(SharedMux));
+    if (!mux)
+        return NULL;
+    mux->stream = stream;
+    stream->shared_mux = mux;
+
+    if (av_open_input_file(&s, stream->feed->feed_filename, stream->ifmt,
+                           FFM_PACKET_SIZE, stream->ap_in) < 0) {
+        http_log("%s not found", stream->feed->feed_filename);
+        goto fail;
+    }
+    mux->fmt_in = s;
+
+    /* open each parser */
+    for(i=0;i<s->nb_streams;i++)
+        open_parser(s, i);
+
+    stream_pos = av_gettime() - stream->prebuffer * (int64_t)1000;
+    if (s->iformat->read_seek)
+        s->iformat->read_seek(s, 0, stream_pos, 0);
+
+    init_output_streams(&mux->fmt_ctx, stream);
+
+    /* new connections start on video key frames, or anywhere if
+       there is no video */
+    mux->key_stream_index = -1;
+    for(i=0;i<mux->fmt_ctx.nb_streams;i++) {
+        if (mux->key_stream_index < 0 &&
+            mux->fmt_ctx.streams[i]->codec->codec_type == CODEC_TYPE_VIDEO)
+            mux->key_stream_index = i;
+    }
+
+    if (url_open_dyn_buf(&mux->fmt_ctx.pb) < 0)
+        goto fail;
+    mux->fmt_ctx.pb.is_streamed = 1;
+
+    av_set_parameters(&mux->fmt_ctx, NULL);
+    av_write_header(&mux->fmt_ctx);
+
+    mux->header_size = url_close_dyn_buf(&mux->fmt_ctx.pb, &mux->header);
+    return mux;
+ fail:
+    shared_mux_close(mux);
+    return NULL;
+}
+
+/* move a late connection to the last key frame, so that it no longer
+   keeps the chunks before it in memory. The rest of the chunk being
+   sent is copied */
+static void shared_mux_skip(HTTPContext *c)
+{
+    SharedMux *mux = c->shared_mux;
+    MuxChunk *chunk = c->mux_chunk;
+    uint8_t *data;
+    int len;
+
+    if (c->buffer_ptr >= chunk->data && c->buffer_ptr < chunk->data + chunk->size) {
+        len = c->buffer_end - c->buffer_ptr;
+        data = av_malloc(len);
+        if (!data)
+            return;
+        memcpy(data, c->buffer_ptr, len);
+        av_free(c->mux_data);
+        c->mux_data = data;
+        c->buffer_ptr = data;
+        c->buffer_end = data + len;
+    }
+    mux->last_key->refcount++;
+    mux_chunk_unref(chunk);
+    c->mux_chunk = mux->last_key;
+    c->mux_chunk_sent = 0;
+}
+
+static void shared_mux_add_chunk(SharedMux *mux, uint8_t *data, int size,
+                                 int key_frame)
+{
+    MuxChunk *chunk, *first;
+    HTTPContext *c;
+
+    chunk = av_mallocz(sizeof(MuxChunk));
+    if (!chunk) {
+        av_free(data);
+        return;
+    }
+    chunk->refcount = 1; /* reference of the previous chunk */
+    chunk->key_frame = key_frame;
+    chunk->pos = mux->size;
+    chunk->size = size;
+    chunk->data = data;
+    mux->size += size;
+
+    if (mux->last)
+        mux->last->next = chunk;
+    else
+        mux->first = chunk;
+    mux->last = chunk;
+    if (key_frame)
+        mux->last_key = chunk;
+
+    /* only keep the chunks since the last key frame for the new
+       connections */
+    while (mux->first != (mux->last_key ? mux->last_key : mux->last)) {
+        first = mux->first;
+        mux->first = first->next;
+        mux->first->refcount++;
+        mux_chunk_unref(first);
+    }
+
+    /* the chunks referenced by the connections are kept too: the late
+       ones skip to the last key frame, so that the memory used stays
+       bounded even if they do not send anything */
+    if (mux->last_key && mux->size >= mux->next_lag_check) {
+        mux->next_lag_check = mux->size + SHARED_MUX_MAX_LAG / 4;
+        for(c = first_http_ctx; c != NULL; c = c->next) {
+            if (c->shared_mux == mux && c->mux_chunk &&
+                c->mux_chunk->pos < mux->last_key->pos &&
+                mux->size - c->mux_chunk->pos > SHARED_MUX_MAX_LAG)
+                shared_mux_skip(c);
+        }
+    }
+}
+
+/* mux the next available feed packet. Return 1 if a chunk was added,
+   0 if we must wait for the feed and < 0 at the end of the feed */
+static int shared_mux_read(SharedMux *mux)
+{
+    FFStream *stream = mux->stream;
+    AVCodecContext *codec;
+    AVPacket pkt;
+    uint8_t *data;
+    int i, len, key_frame;
+
+    ffm_set_write_index(mux->fmt_in,
+                        stream->feed->feed_write_index,
+                        stream->feed->feed_size);
+    for(;;) {
+        if (av_read_frame(mux->fmt_in, &pkt) < 0)
+            return stream->feed->feed_opened ? 0 : -1;
+
+        /* select the right stream */
+        for(i=0;i<stream->nb_streams;i++) {
+            if (stream->feed_streams[i] == pkt.stream_index)
+                break;
+        }
+        if (i == stream->nb_streams) {
+            av_free_packet(&pkt);
+            continue;
+        }
+        pkt.stream_index = i;
+        key_frame = (pkt.flags & PKT_FLAG_KEY) &&
+            (mux->key_stream_index < 0 || i == mux->key_stream_index);
+
+        codec = mux->fmt_ctx.streams[i]->codec;
+        codec->coded_frame->key_frame = ((pkt.flags & PKT_FLAG_KEY) != 0);
+        if (url_open_dyn_buf(&mux->fmt_ctx.pb) < 0) {
+            av_free_packet(&pkt);
+            return -1;
+        }
+        av_write_frame(&mux->fmt_ctx, &pkt);
+        len = url_close_dyn_buf(&mux->fmt_ctx.pb, &data);
+        codec->frame_number++;
+        av_free_packet(&pkt);
+
+        if (len > 0) {
+            shared_mux_add_chunk(mux, data, len, key_frame);
+            return 1;
+        }
+        av_free(data);
+    }
+}
+
+/* true if the connection can use the shared muxer of its stream */
+static int can_use_shared_mux(HTTPContext *c, const char *info)
+{
+    char buf[128];
+    FFStream *stream = c->stream;
+
+    if (!stream->use_shared_mux || !stream->feed || stream->feed == stream)
+        return 0;
+    /* the connections asking for another position or other streams
+       need their own muxer */
+    if (find_info_tag(buf, sizeof(buf), "date", info) ||
+        find_info_tag(buf, sizeof(buf), "buffer", info))
+        return 0;
+    return !memcmp(c->feed_streams, stream->feed_streams,
+                   sizeof(c->feed_streams));
+}
+
+static int shared_mux_add_connection(HTTPContext *c)
+{
+    SharedMux *mux = c->stream->shared_mux;
+
+    if (!mux) {
+        mux = shared_mux_open(c->stream);
+        if (!mux)
+            return -1;
+    }
+    mux->nb_connections++;
+    c->shared_mux = mux;
+
+    /* start with the last key frame, or wait for the next one */
+    if (mux->last_key) {
+        c->mux_chunk = mux->last_key;
+        c->mux_chunk_sent = 0;
+    } else {
+        c->mux_chunk = mux->last;
+        c->mux_chunk_sent = 1;
+        c->mux_wait_key = 1;
+    }
+    if (c->mux_chunk)
+        c->mux_chunk->refcount++;
+    c->start_time = cur_time;
+    return 0;
+}
+
+static void shared_mux_remove_connection(HTTPContext *c)
+{
+    SharedMux *mux = c->shared_mux;
+
+    mux_chunk_unref(c->mux_chunk);
+    c->mux_chunk = NULL;
+    av_freep(&c->mux_data);
+    c->shared_mux = NULL;
+    if (--mux->nb_connections == 0)
+        shared_mux_close(mux);
+}
+
+/* point the output buffer to the next chunk of the shared muxer */
+static int http_prepare_shared_data(HTTPContext *c)
+{
+    SharedMux *mux = c->shared_mux;
+    MuxChunk *chunk;
+    int ret;
+
+    if (c->stream->max_time &&
+        c->stream->max_time + c->start_time - cur_time < 0) {
+        /* We have timed out */
+        c->state = HTTPSTATE_SEND_DATA_TRAILER;
+        return 0;
+    }
+
+    for(;;) {
+        if (!c->mux_chunk)
+            chunk = mux->first;
+        else if (!c->mux_chunk_sent)
+            chunk = c->mux_chunk;
+        else
+            chunk = c->mux_chunk->next;
+
+        if (!chunk) {
+            ret = shared_mux_read(mux);
+            if (ret < 0) {
+                c->state = HTTPSTATE_SEND_DATA_TRAILER;
+                return 0;
+            } else if (ret == 0) {
+                c->state = HTTPSTATE_WAIT_FEED;
+                return 1; /* state changed */
+            }
+            continue;
+        }
+
+        /* too slow connections lose data instead of keeping too many
+           chunks in memory */
+        if (mux->last_key && mux->last_key->pos > chunk->pos &&
+            mux->size - chunk->pos > SHARED_MUX_MAX_LAG)
+            chunk = mux->last_key;
+
+        if (chunk != c->mux_chunk) {
+            chunk->refcount++;
+            mux_chunk_unref(c->mux_chunk);
+            c->mux_chunk = chunk;
+        }
+        c->mux_chunk_sent = 1;
+
+        if (c->mux_wait_key) {
+            if (!chunk->key_frame)
+                continue;
+            c->mux_wait_key = 0;
+        }
+        av_freep(&c->mux_data);
+        c->buffer_ptr = chunk->data;
+        c->buffer_end = chunk->data + chunk->size;
+        c->cur_frame_bytes = chunk->size;
+        return 0;
+    }
+}
+
 /* return the server clock (in us) */
 static int64_t get_server_clock(HTTPContext *c)
 {
@@ -1979,41 +2823,15 @@ static int http_prepare_data(HTTPContext *c)
     av_freep(&c->pb_buffer);
     switch(c->state) {
     case HTTPSTATE_SEND_DATA_HEADER:
-        memset(&c->fmt_ctx, 0, sizeof(c->fmt_ctx));
-        pstrcpy(c->fmt_ctx.author, sizeof(c->fmt_ctx.author),
-                c->stream->author);
-        pstrcpy(c->fmt_ctx.comment, sizeof(c->fmt_ctx.comment),
-                c->stream->comment);
-        pstrcpy(c->fmt_ctx.copyright, sizeof(c->fmt_ctx.copyright),
-                c->stream->copyright);
-        pstrcpy(c->fmt_ctx.title, sizeof(c->fmt_ctx.title),
-                c->stream->title);
-
-        /* open output stream by using specified codecs */
-        c->fmt_ctx.oformat = c->stream->fmt;
-        c->fmt_ctx.nb_streams = c->stream->nb_streams;
-        for(i=0;i<c->fmt_ctx.nb_streams;i++) {
-            AVStream *st;
-            AVStream *src;
-            st = av_mallocz(sizeof(AVStream));
-            st->codec= avcodec_alloc_context();
-            c->fmt_ctx.streams[i] = st;
-            /* if file or feed, then just take streams from FFStream struct */
-            if (!c->stream->feed ||
-                c->stream->feed == c->stream)
-                src = c->stream->streams[i];
-            else
-                src = c->stream->feed->streams[c->stream->feed_streams[i]];
-
-            *st = *src;
-            st->priv_data = 0;
-            st->codec->frame_number = 0; /* XXX: should be done in
-                                           AVStream, not in codec */
-            /* I'm pretty sure that this is not correct...
-             * However, without it, we crash
-             */
-            st->codec->coded_frame = &dummy_frame;
+        if (c->shared_mux) {
+            /* the header is sent from the shared muxer */
+            c->buffer_ptr = c->shared_mux->header;
+            c->buffer_end = c->shared_mux->header + c->shared_mux->header_size;
+            c->state = HTTPSTATE_SEND_DATA;
+            c->last_packet_sent = 0;
+            break;
         }
+        init_output_streams(&c->fmt_ctx, c->stream);
         c->got_key_frame = 0;
 
         /* prepare header and save header data in a stream */
@@ -2034,6 +2852,8 @@ static int http_prepare_data(HTTPContext *c)
         c->last_packet_sent = 0;
         break;
     case HTTPSTATE_SEND_DATA:
+        if (c->shared_mux)
+            return http_prepare_shared_data(c);
         /* find a new packet */
         {
             AVPacket pkt;
@@ -2186,7 +3006,7 @@ static int http_prepare_data(HTTPContext *c)
     default:
     case HTTPSTATE_SEND_DATA_TRAILER:
         /* last packet test ? */
-        if (c->last_packet_sent || c->is_packetized)
+        if (c->last_packet_sent || c->is_packetized || c->shared_mux)
             return -1;
         ctx = &c->fmt_ctx;
         /* prepare header */
@@ -2215,6 +3035,9 @@ static int http_send_data(HTTPContext *c)
 {
     int len, ret;
 
+    if (c->passthrough)
+        return http_send_passthrough(c);
+
     for(;;) {
         if (c->buffer_ptr >= c->buffer_end) {
             ret = http_prepare_data(c);
@@ -2334,6 +3157,204 @@ static int http_send_data(HTTPContext *c)
     return 0;
 }
 
+/* update the codec parameters of the feed streams from the header
+   sent by the feed writer */
+static int parse_feed_header(FFStream *feed, uint8_t *buf, int size)
+{
+    AVFormatContext s;
+    AVInputFormat *fmt_in;
+    ByteIOContext *pb = &s.pb;
+    int i;
+
+    memset(&s, 0, sizeof(s));
+
+    url_open_buf(pb, buf, size, URL_RDONLY);
+    pb->buf_end = buf + size;        /* ?? */
+    pb->is_streamed = 1;
+
+    /* use feed output format name to find corresponding input format */
+    fmt_in = av_find_input_format(feed->fmt->name);
+    if (!fmt_in)
+        return -1;
+
+    if (fmt_in->priv_data_size > 0) {
+        s.priv_data = av_mallocz(fmt_in->priv_data_size);
+        if (!s.priv_data)
+            return -1;
+    } else
+        s.priv_data = NULL;
+
+    if (fmt_in->read_header(&s, 0) < 0) {
+        av_freep(&s.priv_data);
+        return -1;
+    }
+
+    /* Now we have the actual streams */
+    if (s.nb_streams != feed->nb_streams) {
+        av_freep(&s.priv_data);
+        return -1;
+    }
+    for (i = 0; i < s.nb_streams; i++) {
+        memcpy(feed->streams[i]->codec,
+               s.streams[i]->codec, sizeof(AVCodecContext));
+    }
+    av_freep(&s.priv_data);
+    return 0;
+}
+
+/* true if the stream data can be sent without remuxing */
+static int can_use_passthrough(HTTPContext *c, const char *info)
+{
+    char buf[128];
+    FFStream *stream = c->stream;
+
+    if (!stream->passthrough || stream->fmt == &rtp_muxer)
+        return 0;
+    /* only the feed itself can be sent as is, the other streams of the
+       feed select some of its streams */
+    if (stream->feed)
+        return stream->feed == stream;
+    /* files are always sent from the start */
+    return !find_info_tag(buf, sizeof(buf), "date", info);
+}
+
+static int open_passthrough(HTTPContext *c, const char *info)
+{
+    int fd;
+
+    if (c->stream->feed) {
+        /* find the starting position as for remuxing */
+        if (open_input_stream(c, info) < 0)
+            return -1;
+        c->passthrough_pos = url_ftell(&c->fmt_in->pb);
+        av_close_input_file(c->fmt_in);
+        c->fmt_in = NULL;
+        c->passthrough_sync = 1;
+        fd = open(c->stream->feed_filename, O_RDONLY);
+    } else {
+        fd = open(c->stream->feed_filename, O_RDONLY);
+        if (fd >= 0)
+            c->passthrough_size = lseek(fd, 0, SEEK_END);
+        c->passthrough_pos = 0;
+    }
+    if (fd < 0)
+        return -1;
+    c->passthrough_fd = fd;
+    c->passthrough = 1;
+    c->start_time = cur_time;
+    return 0;
+}
+
+/* return the number of bytes which can be sent from the current
+   passthrough position, or -1 if at the end of the stream. */
+static offset_t passthrough_available(HTTPContext *c)
+{
+    FFStream *feed = c->stream;
+    uint8_t header[FFM_PACKET_HEADER_SIZE];
+
+    if (!feed->feed) {
+        if (c->passthrough_pos >= c->passthrough_size)
+            return -1;
+        return c->passthrough_size - c->passthrough_pos;
+    }
+
+    for(;;) {
+        /* handle wrap around */
+        if (c->passthrough_pos >= feed->feed_size &&
+            feed->feed_write_index < c->passthrough_pos)
+            c->passthrough_pos = FFM_PACKET_SIZE;
+        if (c->passthrough_pos == feed->feed_write_index)
+            return feed->feed_opened ? 0 : -1;
+        if (!c->passthrough_sync)
+            break;
+        /* the first packet sent must contain a frame start */
+        if (pread(c->passthrough_fd, header, FFM_PACKET_HEADER_SIZE,
+                  c->passthrough_pos) != FFM_PACKET_HEADER_SIZE)
+            return -1;
+        if (((header[12] << 8) | header[13]) & 0x7fff) {
+            c->passthrough_sync = 0;
+            break;
+        }
+        c->passthrough_pos += FFM_PACKET_SIZE;
+    }
+    if (c->passthrough_pos < feed->feed_write_index)
+        return feed->feed_write_index - c->passthrough_pos;
+    else
+        return feed->feed_size - c->passthrough_pos;
+}
+
+/* send the file or feed data without remuxing it */
+static int http_send_passthrough(HTTPContext *c)
+{
+    offset_t avail;
+    int len;
+
+    if (c->state == HTTPSTATE_SEND_DATA_HEADER) {
+        if (c->stream->feed) {
+            /* the feed header must be the one of a streamed feed */
+            init_output_streams(&c->fmt_ctx, c->stream);
+            if (url_open_dyn_buf(&c->fmt_ctx.pb) < 0)
+                return -1;
+            c->fmt_ctx.pb.is_streamed = 1;
+            av_set_parameters(&c->fmt_ctx, NULL);
+            av_write_header(&c->fmt_ctx);
+            len = url_close_dyn_buf(&c->fmt_ctx.pb, &c->pb_buffer);
+            c->buffer_ptr = c->pb_buffer;
+            c->buffer_end = c->pb_buffer + len;
+        }
+        c->last_packet_sent = 1; /* no trailer */
+        c->state = HTTPSTATE_SEND_DATA;
+    }
+
+    if (c->stream->max_time &&
+        c->stream->max_time + c->start_time - cur_time < 0)
+        return -1;
+
+    if (c->buffer_ptr < c->buffer_end) {
+        len = write(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr);
+    } else {
+        avail = passthrough_available(c);
+        if (avail < 0)
+            return -1;
+        if (avail == 0) {
+            c->state = HTTPSTATE_WAIT_FEED;
+            return 0;
+        }
+        if (avail > PASSTHROUGH_MAX_SEND)
+            avail = PASSTHROUGH_MAX_SEND;
+#ifdef HAVE_SENDFILE
+        {
+            off_t pos = c->passthrough_pos;
+            len = sendfile(c->fd, c->passthrough_fd, &pos, avail);
+        }
+#else
+        if (avail > c->buffer_size)
+            avail = c->buffer_size;
+        len = pread(c->passthrough_fd, c->buffer, avail, c->passthrough_pos);
+        if (len <= 0)
+            return -1;
+        c->buffer_ptr = c->buffer;
+        c->buffer_end = c->buffer + len;
+        c->passthrough_pos += len;
+        len = write(c->fd, c->buffer_ptr, c->buffer_end - c->buffer_ptr);
+#endif
+    }
+    if (len < 0) {
+        if (errno != EAGAIN && errno != EINTR)
+            return -1;
+        return 0;
+    }
+    if (c->buffer_ptr < c->buffer_end)
+        c->buffer_ptr += len;
+    else
+        c->passthrough_pos += len;
+    c->data_count += len;
+    update_datarate(&c->datarate, c->data_count);
+    if (c->stream)
+        c->stream->bytes_served += len;
+    return 0;
+}
+
 static int http_start_receive_data(HTTPContext *c)
 {
     int fd;
@@ -2359,6 +3380,7 @@ static int http_start_receive_data(HTTPContext *c)
     c->buffer_ptr = c->buffer;
     c->buffer_end = c->buffer + FFM_PACKET_SIZE;
     c->stream->feed_opened = 1;
+    publish_feed_state(c->stream, NULL);
     return 0;
 }
 
@@ -2400,6 +3422,8 @@ static int http_receive_data(HTTPContext *c)
         if (c->data_count > FFM_PACKET_SIZE) {
 
             //            printf("writing pos=0x%Lx size=0x%Lx\n", feed->feed_write_index, feed->feed_size);
+            offset_t pos = feed->feed_write_index;
+
             /* XXX: use llseek or url_seek */
             lseek(c->feed_fd, feed->feed_write_index, SEEK_SET);
             write(c->feed_fd, c->buffer, FFM_PACKET_SIZE);
@@ -2414,7 +3438,10 @@ static int http_receive_data(HTTPContext *c)
                 feed->feed_write_index = FFM_PACKET_SIZE;
 
             /* write index */
+            ffm_index_add_packet(feed->feed_index, pos, c->buffer,
+                                 feed->feed_write_index);
             ffm_write_write_index(c->feed_fd, feed->feed_write_index);
+            publish_feed_state(feed, NULL);
 
             /* wake up any waiting connections */
             for(c1 = first_http_ctx; c1 != NULL; c1 = c1->next) {
@@ -2425,44 +3452,9 @@ static int http_receive_data(HTTPContext *c)
             }
         } else {
             /* We have a header in our hands that contains useful data */
-            AVFormatContext s;
-            AVInputFormat *fmt_in;
-            ByteIOContext *pb = &s.pb;
-            int i;
-
-            memset(&s, 0, sizeof(s));
-
-            url_open_buf(pb, c->buffer, c->buffer_end - c->buffer, URL_RDONLY);
-            pb->buf_end = c->buffer_end;        /* ?? */
-            pb->is_streamed = 1;
-
-            /* use feed output format name to find corresponding input format */
-            fmt_in = av_find_input_format(feed->fmt->name);
-            if (!fmt_in)
-                goto fail;
-
-            if (fmt_in->priv_data_size > 0) {
-                s.priv_data = av_mallocz(fmt_in->priv_data_size);
-                if (!s.priv_data)
-                    goto fail;
-            } else
-                s.priv_data = NULL;
-
-            if (fmt_in->read_header(&s, 0) < 0) {
-                av_freep(&s.priv_data);
+            if (parse_feed_header(feed, c->buffer, c->buffer_end - c->buffer) < 0)
                 goto fail;
-            }
-
-            /* Now we have the actual streams */
-            if (s.nb_streams != feed->nb_streams) {
-                av_freep(&s.priv_data);
-                goto fail;
-            }
-            for (i = 0; i < s.nb_streams; i++) {
-                memcpy(feed->streams[i]->codec,
-                       s.streams[i]->codec, sizeof(AVCodecContext));
-            }
-            av_freep(&s.priv_data);
+            publish_feed_state(feed, c->buffer);
         }
         c->buffer_ptr = c->buffer;
     }
@@ -2470,6 +3462,7 @@ static int http_receive_data(HTTPContext *c)
     return 0;
  fail:
     c->stream->feed_opened = 0;
+    publish_feed_state(c->stream, NULL);
     close(c->feed_fd);
     return -1;
 }
@@ -3334,6 +4327,30 @@ static void extract_mpeg4_header(AVFormatContext *infile)
     }
 }
 
+/* true if a file of the input format can be sent as is to the clients
+   of a stream of the output format. The input format names are lists
+   such as "mov,mp4,m4a", the output formats used for streaming have a
+   "_stream" suffix */
+static int passthrough_format_match(AVInputFormat *ifmt, AVOutputFormat *ofmt)
+{
+    char name[64];
+    const char *p, *q;
+    int len;
+
+    pstrcpy(name, sizeof(name), ofmt->name);
+    len = strlen(name);
+    if (len > 7 && !strcmp(name + len - 7, "_stream"))
+        name[len - 7] = '\0';
+    len = strlen(name);
+    for(p = ifmt->name;; p = q + 1) {
+        q = strchr(p, ',');
+        if (!q)
+            return !strcmp(p, name);
+        if (q - p == len && !strncmp(p, name, len))
+            return 1;
+    }
+}
+
 /* compute the needed AVStream for each file */
 static void build_file_streams(void)
 {
@@ -3374,6 +4391,14 @@ static void build_file_streams(void)
                 }
                 extract_mpeg4_header(infile);
 
+                /* a file in another format than the stream is remuxed */
+                if (stream->passthrough && (!stream->fmt ||
+                    !passthrough_format_match(infile->iformat, stream->fmt))) {
+                    http_log("%s is not in the format of %s, it is remuxed",
+                             stream->feed_filename, stream->filename);
+                    stream->passthrough = 0;
+                }
+
                 for(i=0;i<infile->nb_streams;i++) {
                     add_av_stream1(stream, infile->streams[i]->codec);
                 }
@@ -3503,12 +4528,15 @@ static void build_feed_streams(void)
             }
 
             /* only write the header of the ffm file */
+            memset(s, 0, sizeof(*s));
+            pstrcpy(s->filename, sizeof(s->filename), feed->feed_filename);
             if (url_fopen(&s->pb, feed->feed_filename, URL_WRONLY) < 0) {
                 fprintf(stderr, "Could not open output feed file '%s'\n",
                         feed->feed_filename);
                 exit(1);
             }
             s->oformat = feed->fmt;
+            s->flags |= AVFMT_FLAG_FFMINDEX;
             s->nb_streams = feed->nb_streams;
             for(i=0;i<s->nb_streams;i++) {
                 AVStream *st;
@@ -3517,8 +4545,7 @@ static void build_feed_streams(void)
             }
             av_set_parameters(s, NULL);
             av_write_header(s);
-            /* XXX: need better api */
-            av_freep(&s->priv_data);
+            av_write_trailer(s);
             url_fclose(&s->pb);
         }
         /* get feed size and write index */
@@ -3535,6 +4562,12 @@ static void build_feed_streams(void)
         if (feed->feed_max_size && feed->feed_max_size < feed->feed_size)
             feed->feed_max_size = feed->feed_size;
 
+        /* the index is rebuilt if it does not match the feed */
+        feed->feed_index = ffm_index_open(feed->feed_filename, fd);
+        if (!feed->feed_index)
+            http_log("Could not open the index of feed file '%s'\n",
+                     feed->feed_filename);
+
         close(fd);
     }
 }
@@ -3812,6 +4845,16 @@ static int parse_ffconfig(const char *filename)
             } else {
                 max_bandwidth = val;
             }
+        } else if (!strcasecmp(cmd, "HTTPWorkers")) {
+            get_arg(arg, sizeof(arg), &p);
+            val = atoi(arg);
+            if (val < 0 || val > HTTP_MAX_WORKERS) {
+                fprintf(stderr, "%s:%d: Invalid HTTPWorkers: %s\n",
+                        filename, line_num, arg);
+                errors++;
+            } else {
+                nb_workers = val;
+            }
         } else if (!strcasecmp(cmd, "CustomLog")) {
             get_arg(logfilename, sizeof(logfilename), &p);
         } else if (!strcasecmp(cmd, "<Feed")) {
@@ -4031,6 +5074,16 @@ static int parse_ffconfig(const char *filename)
             if (stream) {
                 stream->send_on_key = 1;
             }
+        } else if (!strcasecmp(cmd, "SharedMux")) {
+            if (stream) {
+                stream->use_shared_mux = 1;
+            }
+        } else if (!strcasecmp(cmd, "Passthrough")) {
+            if (feed) {
+                feed->passthrough = 1;
+            } else if (stream) {
+                stream->passthrough = 1;
+            }
         } else if (!strcasecmp(cmd, "AudioCodec")) {
             get_arg(arg, sizeof(arg), &p);
             audio_id = opt_audio_codec(arg);
@@ -4452,13 +5505,28 @@ static void show_license(void)
     );
 }
 
+/* only flag the exit, the children are reaped by the main loop */
 static void handle_child_exit(int sig)
+{
+    child_exited = 1;
+}
+
+static void reap_children(void)
 {
     pid_t pid;
     int status;
 
     while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
         FFStream *feed;
+        int i;
+
+        for (i = 1; i <= nb_workers; i++) {
+            if (shared_load && shared_load[i].pid == pid) {
+                http_log("Worker %d (pid %d) exited with status %d\n", i, pid, status);
+                close_worker(i);
+                shared_load[i].pid = 0;
+            }
+        }
 
         for (feed = first_feed; feed; feed = feed->next) {
             if (feed->pid == pid) {
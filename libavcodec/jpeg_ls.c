@@ -704,7 +704,7 @@ static int encode_picture_ls(AVCodecContext *avctx, unsigned char *buf, int buf_
     int i, size;
     int comps;
 
-    buf2 = av_malloc(buf_size);
+    buf2 = av_mallocz(buf_size);
 
     init_put_bits(&pb, buf, buf_size);
     init_put_bits(&pb2, buf2, buf_size);
@@ -5,8 +5,8 @@
 extern "C" {
 #endif
 
-#define LIBAVFORMAT_VERSION_INT ((50<<16)+(5<<8)+0)
-#define LIBAVFORMAT_VERSION     50.5.0
+#define LIBAVFORMAT_VERSION_INT ((50<<16)+(6<<8)+0)
+#define LIBAVFORMAT_VERSION     50.6.0
 #define LIBAVFORMAT_BUILD       LIBAVFORMAT_VERSION_INT
 
 #define LIBAVFORMAT_IDENT       "Lavf" AV_STRINGIFY(LIBAVFORMAT_VERSION)
@@ -346,8 +346,37 @@ typedef struct AVFormatContext {
 
     int flags;
 #define AVFMT_FLAG_GENPTS       0x0001 ///< generate pts if missing even if it requires parsing future frames
+#define AVFMT_FLAG_INDEXCACHE   0x0002 ///< load and save the seek index and timings in a "<file>.avidx" cache
+#define AVFMT_FLAG_FASTSTART    0x0004 ///< put the index before the data (mov/mp4 muxer)
+#define AVFMT_FLAG_FRAGMENT     0x0008 ///< write self contained fragments that do not need seeking (mov/mp4 muxer)
+#define AVFMT_FLAG_HEADERONLY   0x0010 ///< trust the stream parameters of the header, av_find_stream_info() only reads packets if they are missing
+#define AVFMT_FLAG_NOPARSE      0x0020 ///< return the packets of the demuxer as they are, without splitting them into frames or interpolating their timestamps
+#define AVFMT_FLAG_FFMINDEX     0x0040 ///< keep a time index of the ffm feed in a "<file>.idx" file (set by ffserver)
 
     int loop_input;
+
+    /* number of index entries restored from the index cache, -1 if none */
+    int index_cache_entries;
+
+    /* muxing: private state of the interleaver of av_interleaved_write_frame() */
+    struct AVInterleaver *interleaver;
+    /* muxing: interleaving statistics, the number of packets and bytes
+       waiting for packets of the other streams (current and maximum), and
+       the largest difference in AV_TIME_BASE units between the dts of a
+       written packet and the highest dts buffered at that time */
+    int interleave_packets;
+    int interleave_max_packets;
+    int64_t interleave_bytes;
+    int64_t interleave_max_bytes;
+    int64_t interleave_max_delay;
+
+    /* av_find_stream_info() budget: maximum number of bytes and packets
+       read and of milliseconds spent, 0 for no limit (5 MB for probesize).
+       When one is set, the end of MPEG files is not read for the duration
+       if the stream timings are known, as with AVFMT_FLAG_HEADERONLY */
+    int probesize;
+    int probe_packets;
+    int probe_time;
 } AVFormatContext;
 
 typedef struct AVPacketList {
@@ -480,9 +509,19 @@ int av_find_default_stream_index(AVFormatContext *s);
 int av_index_search_timestamp(AVStream *st, int64_t timestamp, int flags);
 int av_add_index_entry(AVStream *st,
                        int64_t pos, int64_t timestamp, int size, int distance, int flags);
+int av_add_index_entries(AVStream *st, const AVIndexEntry *entries, int nb_entries);
 int av_seek_frame_binary(AVFormatContext *s, int stream_index, int64_t target_ts, int flags);
 void av_update_cur_dts(AVFormatContext *s, AVStream *ref_st, int64_t timestamp);
 
+/* probesig.c */
+int av_register_probe_signature(AVInputFormat *fmt, int offset, const uint8_t *magic, int size);
+void av_register_probe_signatures(AVInputFormat *fmt);
+AVInputFormat *av_probe_input_format_signature(AVProbeData *pd, int *score_ret);
+
+/* indexcache.c */
+int av_index_cache_load(AVFormatContext *s);
+int av_index_cache_save(AVFormatContext *s);
+
 /* media file output */
 int av_set_parameters(AVFormatContext *s, AVFormatParameters *ap);
 int av_write_header(AVFormatContext *s);
@@ -503,9 +542,15 @@ int64_t av_gettime(void);
 
 /* ffm specific for ffserver */
 #define FFM_PACKET_SIZE 4096
+#define FFM_PACKET_HEADER_SIZE 14 /* id, fill size, pts and frame offset */
 offset_t ffm_read_write_index(int fd);
 void ffm_write_write_index(int fd, offset_t pos);
 void ffm_set_write_index(AVFormatContext *s, offset_t pos, offset_t file_size);
+typedef struct FFMIndex FFMIndex;
+FFMIndex *ffm_index_open(const char *feed_filename, int feed_fd);
+void ffm_index_add_packet(FFMIndex *idx, offset_t pos, const uint8_t *packet,
+                          offset_t write_index);
+void ffm_index_close(FFMIndex *idx);
 
 int find_info_tag(char *arg, int arg_size, const char *tag1, const char *info);
 
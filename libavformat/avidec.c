@@ -41,6 +41,12 @@ typedef struct AVIStream {
 
     int prefix;                       ///< normally 'd'<<8 + 'c' or 'w'<<8 + 'b'
     int prefix_count;
+
+    uint8_t *ra_buf;                  ///< read-ahead of the stream data for non-interleaved files
+    unsigned int ra_buf_size;
+    int64_t ra_pos;                   ///< file position of ra_buf[0]
+    int ra_len;
+    int64_t ra_next;                  ///< file position of the next packet data in ra_buf
 } AVIStream;
 
 typedef struct {
@@ -52,8 +58,17 @@ typedef struct {
     int non_interleaved;
     int stream_index;
     DVDemuxContext* dv_demux;
+    int ra_packet;                    ///< the current packet is read from the read-ahead buffer
+    int64_t ra_end;                   ///< file position after the last packet read from a read-ahead buffer
 } AVIContext;
 
+/* In non-interleaved files the data of each stream is read in runs of up
+   to AVI_READ_AHEAD_SIZE bytes, so that switching between the streams does
+   not need a seek for every packet. Entries less than AVI_READ_AHEAD_GAP
+   bytes apart are considered contiguous. */
+#define AVI_READ_AHEAD_SIZE (1<<20)
+#define AVI_READ_AHEAD_GAP  4096
+
 static int avi_load_index(AVFormatContext *s);
 static int guess_ni_flag(AVFormatContext *s);
 
@@ -466,6 +481,50 @@ static int avi_read_header(AVFormatContext *s, AVFormatParameters *ap)
     return 0;
 }
 
+/**
+ * Make sure that the read-ahead buffer of a stream contains the size bytes
+ * at pos, which are in index entry i, by reading the run of entries
+ * starting there.
+ * @return 0 on success, < 0 if the data has to be read directly
+ */
+static int avi_fill_read_ahead(AVFormatContext *s, AVStream *st, int i, int64_t pos, int size)
+{
+    AVIStream *ast = st->priv_data;
+    int64_t end = pos + size;
+    uint8_t *buf;
+    int len;
+
+    if (pos >= ast->ra_pos && end <= ast->ra_pos + ast->ra_len)
+        return 0;
+
+    for(i++; i < st->nb_index_entries; i++){
+        AVIndexEntry *e = &st->index_entries[i];
+        int64_t next = e->pos + 8;
+
+        if (next < end || next - end > AVI_READ_AHEAD_GAP ||
+            next + e->size - pos > AVI_READ_AHEAD_SIZE)
+            break;
+        end = next + e->size;
+    }
+    if (end - pos > INT_MAX)
+        return -1;
+    len = end - pos;
+
+    buf = av_fast_realloc(ast->ra_buf, &ast->ra_buf_size, len);
+    if (!buf)
+        return -1;
+    ast->ra_buf = buf;
+    ast->ra_len = 0;
+
+    url_fseek(&s->pb, pos, SEEK_SET);
+    len = get_buffer(&s->pb, ast->ra_buf, len);
+    if (len < size)
+        return -1;
+    ast->ra_pos = pos;
+    ast->ra_len = len;
+    return 0;
+}
+
 static int avi_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     AVIContext *avi = s->priv_data;
@@ -480,6 +539,7 @@ static int avi_read_packet(AVFormatContext *s, AVPacket *pkt)
             return size;
     }
 
+    avi->ra_packet = 0;
     if(avi->non_interleaved){
         int best_stream_index = 0;
         AVStream *best_st= NULL;
@@ -514,7 +574,6 @@ static int avi_read_packet(AVFormatContext *s, AVPacket *pkt)
         if(i>=0){
             int64_t pos= best_st->index_entries[i].pos;
             pos += best_ast->packet_size - best_ast->remaining;
-            url_fseek(&s->pb, pos + 8, SEEK_SET);
 //        av_log(NULL, AV_LOG_DEBUG, "pos=%Ld\n", pos);
 
             assert(best_ast->remaining <= best_ast->packet_size);
@@ -523,6 +582,19 @@ static int avi_read_packet(AVFormatContext *s, AVPacket *pkt)
             if(!best_ast->remaining)
                 best_ast->packet_size=
                 best_ast->remaining= best_st->index_entries[i].size;
+
+            if(!url_is_streamed(pb) &&
+               avi_fill_read_ahead(s, best_st, i, pos + 8, best_ast->remaining) >= 0){
+                best_ast->ra_next= pos + 8;
+                avi->ra_packet= 1;
+            }else{
+                url_fseek(&s->pb, pos + 8, SEEK_SET);
+                avi->ra_end= 0;
+            }
+        }else if(avi->ra_end){
+            /* continue after the last packet, as if it had been read directly */
+            url_fseek(&s->pb, avi->ra_end, SEEK_SET);
+            avi->ra_end= 0;
         }
     }
 
@@ -541,7 +613,15 @@ resync:
 
         if(size > ast->remaining)
             size= ast->remaining;
-        av_get_packet(pb, pkt, size);
+        if(avi->ra_packet){
+            if(av_new_packet(pkt, size) < 0)
+                return AVERROR_NOMEM;
+            pkt->pos= ast->ra_next;
+            memcpy(pkt->data, ast->ra_buf + (ast->ra_next - ast->ra_pos), size);
+            ast->ra_next += size;
+            avi->ra_end= ast->ra_next + (size == ast->remaining && (size & 1));
+        }else
+            av_get_packet(pb, pkt, size);
 
         if (avi->dv_demux) {
             dstr = pkt->destruct;
@@ -587,7 +667,7 @@ resync:
         if(!ast->remaining){
             avi->stream_index= -1;
             ast->packet_size= 0;
-            if (size & 1) {
+            if (size & 1 && !avi->ra_packet) {
                 get_byte(pb);
                 size++;
             }
@@ -889,6 +969,7 @@ static int avi_read_seek(AVFormatContext *s, int stream_index, int64_t timestamp
     /* do the seek */
     url_fseek(&s->pb, pos, SEEK_SET);
     avi->stream_index= -1;
+    avi->ra_end= 0;
     return 0;
 }
 
@@ -900,6 +981,7 @@ static int avi_read_close(AVFormatContext *s)
     for(i=0;i<s->nb_streams;i++) {
         AVStream *st = s->streams[i];
         AVIStream *ast = st->priv_data;
+        av_free(ast->ra_buf);
         av_free(ast);
         av_free(st->codec->palctrl);
     }
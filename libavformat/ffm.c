@@ -18,9 +18,13 @@
  */
 #include "avformat.h"
 #include <unistd.h>
+#ifdef CONFIG_FFSERVER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 /* The FFM file is made of blocks of fixed size */
-#define FFM_HEADER_SIZE 14
 #define PACKET_ID       0x666d
 
 /* each packet contains frames (which can span several packets */
@@ -36,6 +40,30 @@ enum {
     READ_DATA,
 };
 
+#ifdef CONFIG_FFSERVER
+/* The time index of a feed is stored next to it in '<feed>.idx'. It
+   gives the pts of each packet of the feed so that the interpolation
+   search of ffm_seek() does not read the feed. It is only kept for the
+   feeds of ffserver (AVFMT_FLAG_FFMINDEX). It is mapped in memory by the
+   writer and by all the readers, and updated as packets are written. */
+#define FFM_INDEX_TAG MKTAG('F', 'F', 'I', '1')
+
+typedef struct FFMIndexHeader {
+    uint32_t tag;           /* native byte order, so also detects endianness */
+    uint32_t packet_size;
+    int64_t write_index;    /* write index of the feed at the last update */
+    int64_t nb_entries;
+} FFMIndexHeader;
+
+struct FFMIndex {
+    int fd;
+    int writable;
+    FFMIndexHeader *header;
+    int64_t *entries;       /* pts of each packet, AV_NOPTS_VALUE if unknown */
+    int64_t nb_mapped;      /* number of entries currently mapped */
+};
+#endif
+
 typedef struct FFMContext {
     /* only reading mode */
     offset_t write_index, file_size;
@@ -50,6 +78,12 @@ typedef struct FFMContext {
     int64_t pts;
     uint8_t *packet_ptr, *packet_end;
     uint8_t packet[FFM_PACKET_SIZE];
+#ifdef CONFIG_FFSERVER
+    FFMIndex *index;
+    /* feed mapped in memory (only reading mode) */
+    uint8_t *map;
+    offset_t map_size, map_pos;
+#endif
 } FFMContext;
 
 static int64_t get_pts(AVFormatContext *s, offset_t pos);
@@ -57,6 +91,185 @@ static int64_t get_pts(AVFormatContext *s, offset_t pos);
 /* disable pts hack for testing */
 int ffm_nopts = 0;
 
+static int64_t ffm_get_be64(const uint8_t *p)
+{
+    return ((int64_t)BE_32(p) << 32) | (uint32_t)BE_32(p + 4);
+}
+
+#ifdef CONFIG_FFSERVER
+static int ffm_index_map(FFMIndex *idx, int64_t nb_entries)
+{
+    void *map;
+
+    if (idx->header)
+        munmap(idx->header, sizeof(FFMIndexHeader) + idx->nb_mapped * sizeof(int64_t));
+    idx->header = NULL;
+    idx->entries = NULL;
+    idx->nb_mapped = 0;
+    map = mmap(NULL, sizeof(FFMIndexHeader) + nb_entries * sizeof(int64_t),
+               idx->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+               MAP_SHARED, idx->fd, 0);
+    if (map == MAP_FAILED)
+        return -1;
+    idx->header = map;
+    idx->entries = (int64_t *)(idx->header + 1);
+    idx->nb_mapped = nb_entries;
+    return 0;
+}
+
+/* make room for at least nb_entries entries */
+static int ffm_index_grow(FFMIndex *idx, int64_t nb_entries)
+{
+    int64_t i, old_nb_entries = idx->nb_mapped;
+
+    if (nb_entries <= old_nb_entries)
+        return 0;
+    /* grow by steps so that unlimited feeds are not remapped too often */
+    nb_entries = FFMAX(nb_entries, 2 * old_nb_entries);
+    if (ftruncate(idx->fd, sizeof(FFMIndexHeader) + nb_entries * sizeof(int64_t)) < 0 ||
+        ffm_index_map(idx, nb_entries) < 0)
+        return -1;
+    for(i = old_nb_entries; i < nb_entries; i++)
+        idx->entries[i] = AV_NOPTS_VALUE;
+    idx->header->nb_entries = nb_entries;
+    return 0;
+}
+
+static void ffm_index_set(FFMIndex *idx, offset_t pos, int64_t pts,
+                          offset_t write_index)
+{
+    int64_t n = pos / FFM_PACKET_SIZE;
+
+    if (!idx->header)
+        return;
+    if (n >= idx->nb_mapped && ffm_index_grow(idx, n + 1) < 0)
+        return;
+    idx->entries[n] = pts;
+    idx->header->write_index = write_index;
+}
+
+/* return the indexed pts of the packet at file position pos */
+static int64_t ffm_index_get(FFMIndex *idx, offset_t pos)
+{
+    int64_t n = pos / FFM_PACKET_SIZE;
+
+    if (idx->header && n >= idx->nb_mapped &&
+        idx->header->nb_entries > idx->nb_mapped)
+        ffm_index_map(idx, idx->header->nb_entries); /* grown by the writer */
+    if (!idx->header || n >= idx->nb_mapped)
+        return AV_NOPTS_VALUE;
+    return idx->entries[n];
+}
+
+/* open the index of a feed for writing. If it does not match the feed
+   opened in feed_fd, it is rebuilt from the packet headers. A negative
+   feed_fd creates an empty index. */
+FFMIndex *ffm_index_open(const char *feed_filename, int feed_fd)
+{
+    char filename[1024 + sizeof(".idx")];
+    FFMIndex *idx;
+    FFMIndexHeader header;
+    offset_t write_index, feed_size, pos;
+    uint8_t buf[FFM_PACKET_HEADER_SIZE];
+
+    idx = av_mallocz(sizeof(FFMIndex));
+    if (!idx)
+        return NULL;
+    idx->writable = 1;
+    snprintf(filename, sizeof(filename), "%s.idx", feed_filename);
+    idx->fd = open(filename, O_RDWR | O_CREAT, 0666);
+    if (idx->fd < 0) {
+        av_free(idx);
+        return NULL;
+    }
+
+    write_index = FFM_PACKET_SIZE;
+    feed_size = 0;
+    if (feed_fd >= 0) {
+        write_index = ffm_read_write_index(feed_fd);
+        feed_size = lseek(feed_fd, 0, SEEK_END);
+        if (read(idx->fd, &header, sizeof(header)) == sizeof(header) &&
+            header.tag == FFM_INDEX_TAG &&
+            header.packet_size == FFM_PACKET_SIZE &&
+            header.write_index == write_index &&
+            header.nb_entries * FFM_PACKET_SIZE >= feed_size &&
+            lseek(idx->fd, 0, SEEK_END) ==
+            sizeof(header) + header.nb_entries * sizeof(int64_t)) {
+            if (ffm_index_map(idx, header.nb_entries) < 0)
+                goto fail;
+            return idx;
+        }
+    }
+
+    /* (re)build the index */
+    if (ftruncate(idx->fd, sizeof(FFMIndexHeader)) < 0 ||
+        ffm_index_map(idx, 0) < 0)
+        goto fail;
+    idx->header->tag = FFM_INDEX_TAG;
+    idx->header->packet_size = FFM_PACKET_SIZE;
+    idx->header->write_index = write_index;
+    idx->header->nb_entries = 0;
+    if (ffm_index_grow(idx, feed_size / FFM_PACKET_SIZE) < 0)
+        goto fail;
+    for(pos = FFM_PACKET_SIZE; pos + FFM_PACKET_SIZE <= feed_size; pos += FFM_PACKET_SIZE) {
+        lseek(feed_fd, pos, SEEK_SET);
+        if (read(feed_fd, buf, FFM_PACKET_HEADER_SIZE) != FFM_PACKET_HEADER_SIZE)
+            break;
+        if (BE_16(buf) == PACKET_ID)
+            idx->entries[pos / FFM_PACKET_SIZE] = ffm_get_be64(buf + 4);
+    }
+    return idx;
+ fail:
+    ffm_index_close(idx);
+    return NULL;
+}
+
+/* open the index of a feed for reading */
+static FFMIndex *ffm_index_open_read(const char *feed_filename)
+{
+    char filename[1024 + sizeof(".idx")];
+    FFMIndex *idx;
+    struct stat st;
+
+    idx = av_mallocz(sizeof(FFMIndex));
+    if (!idx)
+        return NULL;
+    snprintf(filename, sizeof(filename), "%s.idx", feed_filename);
+    idx->fd = open(filename, O_RDONLY);
+    if (idx->fd < 0) {
+        av_free(idx);
+        return NULL;
+    }
+    if (fstat(idx->fd, &st) < 0 || st.st_size < sizeof(FFMIndexHeader) ||
+        ffm_index_map(idx, (st.st_size - sizeof(FFMIndexHeader)) / sizeof(int64_t)) < 0 ||
+        idx->header->tag != FFM_INDEX_TAG ||
+        idx->header->packet_size != FFM_PACKET_SIZE) {
+        ffm_index_close(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+/* pos is the file position of the packet which has just been written
+   and write_index the new write index of the feed */
+void ffm_index_add_packet(FFMIndex *idx, offset_t pos, const uint8_t *packet,
+                          offset_t write_index)
+{
+    if (idx)
+        ffm_index_set(idx, pos, ffm_get_be64(packet + 4), write_index);
+}
+
+void ffm_index_close(FFMIndex *idx)
+{
+    if (!idx)
+        return;
+    if (idx->header)
+        munmap(idx->header, sizeof(FFMIndexHeader) + idx->nb_mapped * sizeof(int64_t));
+    close(idx->fd);
+    av_free(idx);
+}
+#endif //CONFIG_FFSERVER
+
 #ifdef CONFIG_MUXERS
 static void flush_packet(AVFormatContext *s)
 {
@@ -70,6 +283,12 @@ static void flush_packet(AVFormatContext *s)
     if (url_ftell(pb) % ffm->packet_size)
         av_abort();
 
+#ifdef CONFIG_FFSERVER
+    if (ffm->index)
+        ffm_index_set(ffm->index, url_ftell(pb), ffm->pts,
+                      url_ftell(pb) + ffm->packet_size);
+#endif
+
     /* put header */
     put_be16(pb, PACKET_ID);
     put_be16(pb, fill_size);
@@ -97,7 +316,7 @@ static void ffm_write_data(AVFormatContext *s,
     int len;
 
     if (first && ffm->frame_offset == 0)
-        ffm->frame_offset = ffm->packet_ptr - ffm->packet + FFM_HEADER_SIZE;
+        ffm->frame_offset = ffm->packet_ptr - ffm->packet + FFM_PACKET_HEADER_SIZE;
     if (first && ffm->pts == 0)
         ffm->pts = pts;
 
@@ -221,9 +440,15 @@ static int ffm_write_header(AVFormatContext *s)
 
     put_flush_packet(pb);
 
+#ifdef CONFIG_FFSERVER
+    /* index the packets of the feeds of ffserver */
+    if ((s->flags & AVFMT_FLAG_FFMINDEX) && !url_is_streamed(pb))
+        ffm->index = ffm_index_open(s->filename, -1);
+#endif
+
     /* init packet mux */
     ffm->packet_ptr = ffm->packet;
-    ffm->packet_end = ffm->packet + ffm->packet_size - FFM_HEADER_SIZE;
+    ffm->packet_end = ffm->packet + ffm->packet_size - FFM_PACKET_HEADER_SIZE;
     assert(ffm->packet_end >= ffm->packet);
     ffm->frame_offset = 0;
     ffm->pts = 0;
@@ -293,12 +518,101 @@ static int ffm_write_trailer(AVFormatContext *s)
         put_flush_packet(pb);
     }
 
+#ifdef CONFIG_FFSERVER
+    ffm_index_close(ffm->index);
+    ffm->index = NULL;
+#endif
     return 0;
 }
 #endif //CONFIG_MUXERS
 
 /* ffm demux */
 
+static offset_t ffm_tell(AVFormatContext *s)
+{
+#ifdef CONFIG_FFSERVER
+    FFMContext *ffm = s->priv_data;
+
+    if (ffm->map)
+        return ffm->map_pos;
+#endif
+    return url_ftell(&s->pb);
+}
+
+static void ffm_seek_pos(AVFormatContext *s, offset_t pos)
+{
+#ifdef CONFIG_FFSERVER
+    FFMContext *ffm = s->priv_data;
+
+    ffm->map_pos = pos;
+#endif
+    url_fseek(&s->pb, pos, SEEK_SET);
+}
+
+#ifdef CONFIG_FFSERVER
+/* map the feed in memory so that the readers do not need any system
+   call to read the packets */
+static void ffm_map_feed(AVFormatContext *s, offset_t size)
+{
+    FFMContext *ffm = s->priv_data;
+    void *map;
+    int fd;
+
+    if (ffm->map) {
+        munmap(ffm->map, ffm->map_size);
+        ffm->map = NULL;
+        /* continue with normal reads if the new mapping fails */
+        url_fseek(&s->pb, ffm->map_pos, SEEK_SET);
+    }
+    if (size <= 0)
+        return;
+    fd = open(s->filename, O_RDONLY);
+    if (fd < 0)
+        return;
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return;
+    ffm->map = map;
+    ffm->map_size = size;
+    ffm->map_pos = url_ftell(&s->pb);
+}
+#endif
+
+/* read the packet at the current position and return its frame offset */
+static int ffm_read_block(AVFormatContext *s, int *fill_size)
+{
+    FFMContext *ffm = s->priv_data;
+    ByteIOContext *pb = &s->pb;
+
+#ifdef CONFIG_FFSERVER
+    if (ffm->map) {
+        const uint8_t *p = ffm->map + ffm->map_pos;
+
+        ffm->map_pos += ffm->packet_size;
+        if (ffm->map_pos > ffm->map_size) {
+            /* invalid packet */
+            *fill_size = ffm->packet_size;
+            return 0;
+        }
+        *fill_size = BE_16(p + 2);
+        ffm->pts = ffm_get_be64(p + 4);
+        memcpy(ffm->packet, p + FFM_PACKET_HEADER_SIZE, ffm->packet_size - FFM_PACKET_HEADER_SIZE);
+        return BE_16(p + 12);
+    }
+#endif
+    {
+        int frame_offset;
+
+        get_be16(pb); /* PACKET_ID */
+        *fill_size = get_be16(pb);
+        ffm->pts = get_be64(pb);
+        frame_offset = get_be16(pb);
+        get_buffer(pb, ffm->packet, ffm->packet_size - FFM_PACKET_HEADER_SIZE);
+        return frame_offset;
+    }
+}
+
 static int ffm_is_avail_data(AVFormatContext *s, int size)
 {
     FFMContext *ffm = s->priv_data;
@@ -311,7 +625,7 @@ static int ffm_is_avail_data(AVFormatContext *s, int size)
         if (size <= len)
             return 1;
     }
-    pos = url_ftell(&s->pb);
+    pos = ffm_tell(s);
     if (pos == ffm->write_index) {
         /* exactly at the end of stream */
         return 0;
@@ -320,7 +634,7 @@ static int ffm_is_avail_data(AVFormatContext *s, int size)
     } else {
         avail_size = (ffm->file_size - pos) + (ffm->write_index - FFM_PACKET_SIZE);
     }
-    avail_size = (avail_size / ffm->packet_size) * (ffm->packet_size - FFM_HEADER_SIZE) + len;
+    avail_size = (avail_size / ffm->packet_size) * (ffm->packet_size - FFM_PACKET_HEADER_SIZE) + len;
     if (size <= avail_size)
         return 1;
     else
@@ -332,7 +646,6 @@ static int ffm_read_data(AVFormatContext *s,
                          uint8_t *buf, int size, int first)
 {
     FFMContext *ffm = s->priv_data;
-    ByteIOContext *pb = &s->pb;
     int len, fill_size, size1, frame_offset;
 
     size1 = size;
@@ -342,16 +655,12 @@ static int ffm_read_data(AVFormatContext *s,
         if (len > size)
             len = size;
         if (len == 0) {
-            if (url_ftell(pb) == ffm->file_size)
-                url_fseek(pb, ffm->packet_size, SEEK_SET);
+            if (ffm_tell(s) == ffm->file_size)
+                ffm_seek_pos(s, ffm->packet_size);
     retry_read:
-            get_be16(pb); /* PACKET_ID */
-            fill_size = get_be16(pb);
-            ffm->pts = get_be64(pb);
+            frame_offset = ffm_read_block(s, &fill_size);
             ffm->first_frame_in_packet = 1;
-            frame_offset = get_be16(pb);
-            get_buffer(pb, ffm->packet, ffm->packet_size - FFM_HEADER_SIZE);
-            ffm->packet_end = ffm->packet + (ffm->packet_size - FFM_HEADER_SIZE - fill_size);
+            ffm->packet_end = ffm->packet + (ffm->packet_size - FFM_PACKET_HEADER_SIZE - fill_size);
             if (ffm->packet_end < ffm->packet)
                 return -1;
             /* if first packet or resynchronization packet, we must
@@ -359,17 +668,17 @@ static int ffm_read_data(AVFormatContext *s,
             if (ffm->first_packet || (frame_offset & 0x8000)) {
                 if (!frame_offset) {
                     /* This packet has no frame headers in it */
-                    if (url_ftell(pb) >= ffm->packet_size * 3) {
-                        url_fseek(pb, -ffm->packet_size * 2, SEEK_CUR);
+                    if (ffm_tell(s) >= ffm->packet_size * 3) {
+                        ffm_seek_pos(s, ffm_tell(s) - ffm->packet_size * 2);
                         goto retry_read;
                     }
                     /* This is bad, we cannot find a valid frame header */
                     return 0;
                 }
                 ffm->first_packet = 0;
-                if ((frame_offset & 0x7ffff) < FFM_HEADER_SIZE)
+                if ((frame_offset & 0x7ffff) < FFM_PACKET_HEADER_SIZE)
                     return -1;
-                ffm->packet_ptr = ffm->packet + (frame_offset & 0x7fff) - FFM_HEADER_SIZE;
+                ffm->packet_ptr = ffm->packet + (frame_offset & 0x7fff) - FFM_PACKET_HEADER_SIZE;
                 if (!first)
                     break;
             } else {
@@ -390,12 +699,11 @@ static int ffm_read_data(AVFormatContext *s,
 static void adjust_write_index(AVFormatContext *s)
 {
     FFMContext *ffm = s->priv_data;
-    ByteIOContext *pb = &s->pb;
     int64_t pts;
     //offset_t orig_write_index = ffm->write_index;
     offset_t pos_min, pos_max;
     int64_t pts_start;
-    offset_t ptr = url_ftell(pb);
+    offset_t ptr = ffm_tell(s);
 
 
     pos_min = 0;
@@ -440,7 +748,7 @@ static void adjust_write_index(AVFormatContext *s)
     //printf("pts range %0.6f - %0.6f\n", get_pts(s, 0) / 1000000. , get_pts(s, ffm->file_size - 2 * FFM_PACKET_SIZE) / 1000000. );
 
  end:
-    url_fseek(pb, ptr, SEEK_SET);
+    ffm_seek_pos(s, ptr);
 }
 
 
@@ -465,6 +773,10 @@ static int ffm_read_header(AVFormatContext *s, AVFormatParameters *ap)
     /* get also filesize */
     if (!url_is_streamed(pb)) {
         ffm->file_size = url_fsize(pb);
+#ifdef CONFIG_FFSERVER
+        ffm->index = ffm_index_open_read(s->filename);
+        ffm_map_feed(s, ffm->file_size);
+#endif
         adjust_write_index(s);
     } else {
         ffm->file_size = (uint64_t_C(1) << 63) - 1;
@@ -547,6 +859,9 @@ static int ffm_read_header(AVFormatContext *s, AVFormatParameters *ap)
     /* get until end of block reached */
     while ((url_ftell(pb) % ffm->packet_size) != 0)
         get_byte(pb);
+#ifdef CONFIG_FFSERVER
+    ffm->map_pos = url_ftell(pb);
+#endif
 
     /* init packet demux */
     ffm->packet_ptr = ffm->packet;
@@ -564,6 +879,13 @@ static int ffm_read_header(AVFormatContext *s, AVFormatParameters *ap)
             av_free(st);
         }
     }
+#ifdef CONFIG_FFSERVER
+    ffm_index_close(ffm->index);
+    ffm->index = NULL;
+    if (ffm->map)
+        munmap(ffm->map, ffm->map_size);
+    ffm->map = NULL;
+#endif
     return -1;
 }
 
@@ -606,7 +928,7 @@ static int ffm_read_packet(AVFormatContext *s, AVPacket *pkt)
 
         av_new_packet(pkt, size);
         pkt->stream_index = ffm->header[0];
-        pkt->pos = url_ftell(&s->pb);
+        pkt->pos = ffm_tell(s);
         if (ffm->header[1] & FLAG_KEY_FRAME)
             pkt->flags |= PKT_FLAG_KEY;
 
@@ -630,30 +952,55 @@ static int ffm_read_packet(AVFormatContext *s, AVPacket *pkt)
 //#define DEBUG_SEEK
 
 /* pos is between 0 and file_size - FFM_PACKET_SIZE. It is translated
-   by the write position inside this function */
-static void ffm_seek1(AVFormatContext *s, offset_t pos1)
+   by the write position */
+static offset_t ffm_file_pos(FFMContext *ffm, offset_t pos1)
 {
-    FFMContext *ffm = s->priv_data;
-    ByteIOContext *pb = &s->pb;
     offset_t pos;
 
     pos = pos1 + ffm->write_index;
     if (pos >= ffm->file_size)
         pos -= (ffm->file_size - FFM_PACKET_SIZE);
+    return pos;
+}
+
+static void ffm_seek1(AVFormatContext *s, offset_t pos1)
+{
+    offset_t pos = ffm_file_pos(s->priv_data, pos1);
+
 #ifdef DEBUG_SEEK
     printf("seek to %Lx -> %Lx\n", pos1, pos);
 #endif
-    url_fseek(pb, pos, SEEK_SET);
+    ffm_seek_pos(s, pos);
 }
 
-static int64_t get_pts(AVFormatContext *s, offset_t pos)
+/* read the pts of a packet in the feed itself */
+static int64_t read_pts(AVFormatContext *s, offset_t pos)
 {
     ByteIOContext *pb = &s->pb;
-    int64_t pts;
+#ifdef CONFIG_FFSERVER
+    FFMContext *ffm = s->priv_data;
+    offset_t file_pos = ffm_file_pos(ffm, pos);
 
+    if (ffm->map && file_pos + FFM_PACKET_HEADER_SIZE <= ffm->map_size)
+        return ffm_get_be64(ffm->map + file_pos + 4);
+#endif
     ffm_seek1(s, pos);
     url_fskip(pb, 4);
-    pts = get_be64(pb);
+    return get_be64(pb);
+}
+
+static int64_t get_pts(AVFormatContext *s, offset_t pos)
+{
+    int64_t pts;
+#ifdef CONFIG_FFSERVER
+    FFMContext *ffm = s->priv_data;
+
+    pts = AV_NOPTS_VALUE;
+    if (ffm->index)
+        pts = ffm_index_get(ffm->index, ffm_file_pos(ffm, pos));
+    if (pts == AV_NOPTS_VALUE)
+#endif
+    pts = read_pts(s, pos);
 #ifdef DEBUG_SEEK
     printf("pts=%0.6f\n", pts / 1000000.0);
 #endif
@@ -673,6 +1020,7 @@ static int ffm_seek(AVFormatContext *s, int stream_index, int64_t wanted_pts, in
 #ifdef DEBUG_SEEK
     printf("wanted_pts=%0.6f\n", wanted_pts / 1000000.0);
 #endif
+ redo:
     /* find the position using linear interpolation (better than
        dichotomy in typical cases) */
     pos_min = 0;
@@ -702,6 +1050,18 @@ static int ffm_seek(AVFormatContext *s, int stream_index, int64_t wanted_pts, in
     if (pos > 0)
         pos -= FFM_PACKET_SIZE;
  found:
+#ifdef CONFIG_FFSERVER
+    /* the index is only a hint: if it does not agree with the feed, it
+       is stale and the feed itself is searched */
+    if (ffm->index) {
+        pts = ffm_index_get(ffm->index, ffm_file_pos(ffm, pos));
+        if (pts != AV_NOPTS_VALUE && pts != read_pts(s, pos)) {
+            ffm_index_close(ffm->index);
+            ffm->index = NULL;
+            goto redo;
+        }
+    }
+#endif
     ffm_seek1(s, pos);
     return 0;
 }
@@ -737,6 +1097,9 @@ void ffm_set_write_index(AVFormatContext *s, offset_t pos, offset_t file_size)
     FFMContext *ffm = s->priv_data;
     ffm->write_index = pos;
     ffm->file_size = file_size;
+    /* the feed grows until its maximum size is reached */
+    if (ffm->map && file_size > ffm->map_size)
+        ffm_map_feed(s, file_size);
 }
 #endif // CONFIG_FFSERVER
 
@@ -744,6 +1107,13 @@ static int ffm_read_close(AVFormatContext *s)
 {
     AVStream *st;
     int i;
+#ifdef CONFIG_FFSERVER
+    FFMContext *ffm = s->priv_data;
+
+    ffm_index_close(ffm->index);
+    if (ffm->map)
+        munmap(ffm->map, ffm->map_size);
+#endif
 
     for(i=0;i<s->nb_streams;i++) {
         st = s->streams[i];
@@ -0,0 +1,264 @@
+/*
+ * Persistent seek index cache
+ * Copyright (c) 2006 The ffmpeg Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include "avformat.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * When AVFMT_FLAG_INDEXCACHE is set, the index entries and the timings
+ * of every stream are saved next to the input file in "<file>.avidx"
+ * when it is closed, and restored by av_find_stream_info() on the next
+ * open, so that formats without an index (MPEG-PS/TS, raw streams) do
+ * not have to probe timestamps again.
+ *
+ * The cache is keyed by the identity of the file (size, modification
+ * time, inode) and by the demuxer and stream layout; any mismatch makes
+ * it ignored and rewritten on close. All values are big endian:
+ *
+ *   tag 'FFIX', version
+ *   file size, mtime, inode (64 bit)
+ *   demuxer name (length + bytes)
+ *   number of streams, index built by av_build_index_raw()
+ *   for each stream:
+ *     codec_id, time_base num/den, start_time, duration (64 bit)
+ *     number of entries
+ *     for each entry: pos, timestamp (64 bit), flags, size, min_distance
+ */
+
+#define INDEX_CACHE_TAG     MKTAG('F', 'F', 'I', 'X')
+#define INDEX_CACHE_VERSION 1
+#define INDEX_CACHE_SUFFIX  ".avidx"
+
+typedef struct IndexCacheStream {
+    AVIndexEntry *entries;
+    int nb_entries;
+    int64_t start_time;
+    int64_t duration;
+} IndexCacheStream;
+
+/**
+ * Get the local file name and identity of the input, or return < 0 if
+ * the input is not a regular local file.
+ */
+static int index_cache_stat(AVFormatContext *s, char *cache_name, int cache_name_size,
+                            struct stat *st)
+{
+    const char *filename = s->filename;
+
+    if ((s->iformat->flags & AVFMT_NOFILE) || s->pb.is_streamed)
+        return -1;
+    strstart(filename, "file:", &filename);
+    if (stat(filename, st) < 0 || !S_ISREG(st->st_mode))
+        return -1;
+    snprintf(cache_name, cache_name_size, "%s%s", filename, INDEX_CACHE_SUFFIX);
+    return 0;
+}
+
+static int index_cache_total_entries(AVFormatContext *s)
+{
+    int i, total = 0;
+
+    for(i = 0; i < s->nb_streams; i++)
+        total += s->streams[i]->nb_index_entries;
+    return total;
+}
+
+static int index_cache_read(AVFormatContext *s, ByteIOContext *pb,
+                            struct stat *fst, IndexCacheStream *ics, int *index_built)
+{
+    char name[32];
+    int i, j, len, nb_streams;
+
+    if (get_le32(pb) != INDEX_CACHE_TAG || get_be32(pb) != INDEX_CACHE_VERSION)
+        return -1;
+    if (get_be64(pb) != (uint64_t)fst->st_size ||
+        get_be64(pb) != (uint64_t)fst->st_mtime ||
+        get_be64(pb) != (uint64_t)fst->st_ino)
+        return -1;
+    len = get_be32(pb);
+    if (len < 0 || len >= sizeof(name))
+        return -1;
+    get_buffer(pb, (uint8_t *)name, len);
+    name[len] = 0;
+    if (strcmp(name, s->iformat->name))
+        return -1;
+    nb_streams = get_be32(pb);
+    *index_built = get_be32(pb);
+    if (nb_streams != s->nb_streams)
+        return -1;
+
+    for(i = 0; i < nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        IndexCacheStream *c = &ics[i];
+        int64_t last_ts = INT64_MIN;
+
+        if (get_be32(pb) != st->codec->codec_id ||
+            get_be32(pb) != st->time_base.num ||
+            get_be32(pb) != st->time_base.den)
+            return -1;
+        c->start_time = get_be64(pb);
+        c->duration = get_be64(pb);
+        c->nb_entries = get_be32(pb);
+        if (c->nb_entries < 0 ||
+            (unsigned)c->nb_entries >= UINT_MAX / sizeof(AVIndexEntry) ||
+            c->nb_entries > fst->st_size)
+            return -1;
+        if (!c->nb_entries)
+            continue;
+        c->entries = av_malloc(c->nb_entries * sizeof(AVIndexEntry));
+        if (!c->entries)
+            return -1;
+        for(j = 0; j < c->nb_entries; j++) {
+            AVIndexEntry *e = &c->entries[j];
+            e->pos = get_be64(pb);
+            e->timestamp = get_be64(pb);
+            e->flags = get_be32(pb);
+            e->size = get_be32(pb);
+            e->min_distance = get_be32(pb);
+            /* av_index_search_timestamp() needs strictly sorted entries */
+            if (e->timestamp <= last_ts || e->pos < 0 || e->pos > fst->st_size)
+                return -1;
+            last_ts = e->timestamp;
+        }
+        if (url_feof(pb))
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * Restore the index entries and timings of the streams from the cache.
+ *
+ * @return < 0 if there is no valid cache for this file, in which case
+ *         the streams are left untouched.
+ */
+int av_index_cache_load(AVFormatContext *s)
+{
+    char cache_name[1024];
+    struct stat fst;
+    ByteIOContext pb;
+    IndexCacheStream *ics;
+    int i, ret, index_built = 0;
+
+    s->index_cache_entries = -1;
+    if (index_cache_stat(s, cache_name, sizeof(cache_name), &fst) < 0)
+        return -1;
+    if (url_fopen(&pb, cache_name, URL_RDONLY) < 0)
+        return -1;
+    ics = av_mallocz(FFMAX(s->nb_streams, 1) * sizeof(IndexCacheStream));
+    if (!ics) {
+        url_fclose(&pb);
+        return -1;
+    }
+    ret = index_cache_read(s, &pb, &fst, ics, &index_built);
+    url_fclose(&pb);
+
+    if (ret < 0) {
+        av_log(s, AV_LOG_DEBUG, "ignoring stale index cache %s\n", cache_name);
+    } else {
+        for(i = 0; i < s->nb_streams; i++) {
+            AVStream *st = s->streams[i];
+            IndexCacheStream *c = &ics[i];
+
+            if (!st->nb_index_entries) {
+                av_free(st->index_entries);
+                st->index_entries = c->entries;
+                st->nb_index_entries = c->nb_entries;
+                st->index_entries_allocated_size = c->nb_entries * sizeof(AVIndexEntry);
+                c->entries = NULL;
+            } else
+                av_add_index_entries(st, c->entries, c->nb_entries);
+            st->start_time = c->start_time;
+            st->duration = c->duration;
+        }
+        s->index_built = index_built;
+        s->index_cache_entries = index_cache_total_entries(s);
+        av_log(s, AV_LOG_DEBUG, "loaded %d index entries from %s\n",
+               s->index_cache_entries, cache_name);
+    }
+    for(i = 0; i < s->nb_streams; i++)
+        av_free(ics[i].entries);
+    av_free(ics);
+    return ret;
+}
+
+/**
+ * Write the index entries and timings of the streams to the cache if
+ * they changed since av_index_cache_load().
+ */
+int av_index_cache_save(AVFormatContext *s)
+{
+    char cache_name[1024], tmp_name[1024 + sizeof(".tmp")];
+    struct stat fst;
+    ByteIOContext pb;
+    int i, j, len, err;
+
+    if (s->index_cache_entries >= 0 &&
+        s->index_cache_entries == index_cache_total_entries(s))
+        return 0;
+    if (s->duration == AV_NOPTS_VALUE && !index_cache_total_entries(s))
+        return 0;
+    if (index_cache_stat(s, cache_name, sizeof(cache_name), &fst) < 0)
+        return -1;
+
+    /* write to a temporary file and rename it so that concurrent
+       readers never see a partial cache */
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", cache_name);
+    if (url_fopen(&pb, tmp_name, URL_WRONLY) < 0)
+        return -1;
+
+    put_tag(&pb, "FFIX");
+    put_be32(&pb, INDEX_CACHE_VERSION);
+    put_be64(&pb, fst.st_size);
+    put_be64(&pb, fst.st_mtime);
+    put_be64(&pb, fst.st_ino);
+    len = strlen(s->iformat->name);
+    put_be32(&pb, len);
+    put_buffer(&pb, (const uint8_t *)s->iformat->name, len);
+    put_be32(&pb, s->nb_streams);
+    put_be32(&pb, s->index_built);
+    for(i = 0; i < s->nb_streams; i++) {
+        AVStream *st = s->streams[i];
+
+        put_be32(&pb, st->codec->codec_id);
+        put_be32(&pb, st->time_base.num);
+        put_be32(&pb, st->time_base.den);
+        put_be64(&pb, st->start_time);
+        put_be64(&pb, st->duration);
+        put_be32(&pb, st->nb_index_entries);
+        for(j = 0; j < st->nb_index_entries; j++) {
+            AVIndexEntry *e = &st->index_entries[j];
+            put_be64(&pb, e->pos);
+            put_be64(&pb, e->timestamp);
+            put_be32(&pb, e->flags);
+            put_be32(&pb, e->size);
+            put_be32(&pb, e->min_distance);
+        }
+    }
+    put_flush_packet(&pb);
+    err = url_ferror(&pb);
+    url_fclose(&pb);
+
+    if (err < 0 || rename(tmp_name, cache_name) < 0) {
+        unlink(tmp_name);
+        return -1;
+    }
+    return 0;
+}
@@ -289,6 +289,11 @@ typedef struct MatroskaDemuxIndex {
   uint64_t        time;  /* in nanoseconds */
 } MatroskaDemuxIndex;
 
+typedef struct MatroskaClusterIndex {
+  offset_t        pos;   /* of the cluster element */
+  uint64_t        time;  /* cluster timecode, in time_scale units */
+} MatroskaClusterIndex;
+
 typedef struct MatroskaDemuxContext {
     AVFormatContext *ctx;
 
@@ -331,6 +336,24 @@ typedef struct MatroskaDemuxContext {
     /* The index for seeking. */
     int num_indexes;
     MatroskaDemuxIndex *index;
+
+    /* position of the cues given by the seekhead, they are only read
+     * when seeking for the first time */
+    offset_t cues_pos;
+    int cues_indexed;
+
+    /* the number of EBML levels down to the segment */
+    int segment_levels;
+
+    /* clusters seen so far, used for seeking when there are no cues */
+    offset_t first_cluster_pos;
+    int num_clusters;
+    unsigned int clusters_size;
+    MatroskaClusterIndex *clusters;
+
+    /* after a seek, drop the packets before this keyframe */
+    int skip_to_keyframe, skip_to_stream;
+    int64_t skip_to_timecode;
 } MatroskaDemuxContext;
 
 /*
@@ -1819,6 +1842,89 @@ matroska_parse_metadata (MatroskaDemuxContext *matroska)
     return res;
 }
 
+/*
+ * Parse the Cues or Tags element at the given position, and come back
+ * to the current position.
+ */
+
+static int
+matroska_parse_element_at (MatroskaDemuxContext *matroska,
+                           uint32_t              seek_id,
+                           offset_t              offset)
+{
+    uint32_t id, peek_id_cache = matroska->peek_id;
+    int level_up = matroska->level_up, res = 0;
+    offset_t before_pos = url_ftell(&matroska->ctx->pb);
+    uint64_t length;
+    MatroskaLevel level;
+
+    /* seek */
+    if ((res = ebml_read_seek(matroska, offset)) < 0)
+        return res;
+
+    /* we don't want to lose our current level, so we add a dummy.
+     * This is a crude hack. */
+    if (matroska->num_levels == EBML_MAX_DEPTH) {
+        av_log(matroska->ctx, AV_LOG_INFO,
+               "Max EBML element depth (%d) reached, "
+               "cannot parse further.\n", EBML_MAX_DEPTH);
+        return AVERROR_UNKNOWN;
+    }
+
+    level.start = 0;
+    level.length = (uint64_t)-1;
+    matroska->levels[matroska->num_levels] = level;
+    matroska->num_levels++;
+
+    /* check ID */
+    if (!(id = ebml_peek_id (matroska, &matroska->level_up)))
+        goto finish;
+    if (id != seek_id) {
+        av_log(matroska->ctx, AV_LOG_INFO,
+               "We looked for ID=0x%x but got "
+               "ID=0x%x (pos=%"PRIu64")",
+               seek_id, id, offset);
+        goto finish;
+    }
+
+    /* read master + parse */
+    if ((res = ebml_read_master(matroska, &id)) < 0)
+        goto finish;
+    switch (id) {
+        case MATROSKA_ID_CUES:
+            if (!(res = matroska_parse_index(matroska)) ||
+                url_feof(&matroska->ctx->pb)) {
+                matroska->index_parsed = 1;
+                res = 0;
+            }
+            break;
+        case MATROSKA_ID_TAGS:
+            if (!(res = matroska_parse_metadata(matroska)) ||
+               url_feof(&matroska->ctx->pb)) {
+                matroska->metadata_parsed = 1;
+                res = 0;
+            }
+            break;
+    }
+
+finish:
+    /* remove dummy level */
+    while (matroska->num_levels) {
+        matroska->num_levels--;
+        length = matroska->levels[matroska->num_levels].length;
+        if (length == (uint64_t)-1)
+            break;
+    }
+
+    /* seek back */
+    if (ebml_read_seek(matroska, before_pos) < 0)
+        return AVERROR_IO;
+    matroska->peek_id = peek_id_cache;
+    matroska->level_up = level_up;
+
+    return res;
+}
+
 static int
 matroska_parse_seekhead (MatroskaDemuxContext *matroska)
 {
@@ -1838,7 +1944,7 @@ matroska_parse_seekhead (MatroskaDemuxContext *matroska)
 
         switch (id) {
             case MATROSKA_ID_SEEKENTRY: {
-                uint32_t seek_id = 0, peek_id_cache = 0;
+                uint32_t seek_id = 0;
                 uint64_t seek_pos = (uint64_t) -1, t;
 
                 if ((res = ebml_read_master(matroska, &id)) < 0)
@@ -1888,87 +1994,15 @@ matroska_parse_seekhead (MatroskaDemuxContext *matroska)
 
                 switch (seek_id) {
                     case MATROSKA_ID_CUES:
-                    case MATROSKA_ID_TAGS: {
-                        uint32_t level_up = matroska->level_up;
-                        offset_t before_pos;
-                        uint64_t length;
-                        MatroskaLevel level;
-
-                        /* remember the peeked ID and the current position */
-                        peek_id_cache = matroska->peek_id;
-                        before_pos = url_ftell(&matroska->ctx->pb);
-
-                        /* seek */
-                        if ((res = ebml_read_seek(matroska, seek_pos +
-                                               matroska->segment_start)) < 0)
-                            return res;
-
-                        /* we don't want to lose our seekhead level, so we add
-                         * a dummy. This is a crude hack. */
-                        if (matroska->num_levels == EBML_MAX_DEPTH) {
-                            av_log(matroska->ctx, AV_LOG_INFO,
-                                   "Max EBML element depth (%d) reached, "
-                                   "cannot parse further.\n", EBML_MAX_DEPTH);
-                            return AVERROR_UNKNOWN;
-                        }
-
-                        level.start = 0;
-                        level.length = (uint64_t)-1;
-                        matroska->levels[matroska->num_levels] = level;
-                        matroska->num_levels++;
-
-                        /* check ID */
-                        if (!(id = ebml_peek_id (matroska,
-                                                 &matroska->level_up)))
-                            break;
-                        if (id != seek_id) {
-                            av_log(matroska->ctx, AV_LOG_INFO,
-                                   "We looked for ID=0x%x but got "
-                                   "ID=0x%x (pos=%"PRIu64")",
-                                   seek_id, id, seek_pos +
-                                   matroska->segment_start);
-                            goto finish;
-                        }
-
-                        /* read master + parse */
-                        if ((res = ebml_read_master(matroska, &id)) < 0)
-                            break;
-                        switch (id) {
-                            case MATROSKA_ID_CUES:
-                                if (!(res = matroska_parse_index(matroska)) ||
-                                    url_feof(&matroska->ctx->pb)) {
-                                    matroska->index_parsed = 1;
-                                    res = 0;
-                                }
-                                break;
-                            case MATROSKA_ID_TAGS:
-                                if (!(res = matroska_parse_metadata(matroska)) ||
-                                   url_feof(&matroska->ctx->pb)) {
-                                    matroska->metadata_parsed = 1;
-                                    res = 0;
-                                }
-                                break;
-                        }
-                        if (res < 0)
-                            break;
-
-                    finish:
-                        /* remove dummy level */
-                        while (matroska->num_levels) {
-                            matroska->num_levels--;
-                            length =
-                                matroska->levels[matroska->num_levels].length;
-                            if (length == (uint64_t)-1)
-                                break;
-                        }
+                        /* the cues are only needed for seeking, they
+                         * are read on the first seek */
+                        matroska->cues_pos = seek_pos + matroska->segment_start;
+                        break;
 
-                        /* seek back */
-                        if ((res = ebml_read_seek(matroska, before_pos)) < 0)
-                            return res;
-                        matroska->peek_id = peek_id_cache;
-                        matroska->level_up = level_up;
+                    case MATROSKA_ID_TAGS:
+                        res = matroska_parse_element_at(matroska, seek_id,
+                                         seek_pos + matroska->segment_start);
                         break;
-                    }
 
                     default:
                         av_log(matroska->ctx, AV_LOG_INFO,
@@ -2051,6 +2085,7 @@ matroska_read_header (AVFormatContext    *s,
     if ((res = ebml_read_master(matroska, &id)) < 0)
         return res;
     matroska->segment_start = url_ftell(&s->pb);
+    matroska->segment_levels = matroska->num_levels;
 
     matroska->time_scale = 1000000;
     /* we've found our segment, start reading the different contents in here */
@@ -2113,6 +2148,7 @@ matroska_read_header (AVFormatContext    *s,
             case MATROSKA_ID_CLUSTER: {
                 /* Do not read the master - this will be done in the next
                  * call to matroska_read_packet. */
+                matroska->first_cluster_pos = url_ftell(&s->pb) - 4;
                 res = 1;
                 break;
             }
@@ -2484,11 +2520,66 @@ matroska_parse_blockgroup (MatroskaDemuxContext *matroska,
         }
     }
 
+    /* after a seek, the cluster may start before the wanted keyframe */
+    if (matroska->skip_to_keyframe &&
+        last_num_packets != matroska->num_packets) {
+        pkt = matroska->packets[last_num_packets];
+        if (pkt->stream_index == matroska->skip_to_stream &&
+            pkt->pts != AV_NOPTS_VALUE &&
+            (pkt->pts > matroska->skip_to_timecode ||
+             (pkt->pts == matroska->skip_to_timecode &&
+              (pkt->flags & PKT_FLAG_KEY)))) {
+            matroska->skip_to_keyframe = 0;
+        } else {
+            while (matroska->num_packets > last_num_packets) {
+                pkt = matroska->packets[--matroska->num_packets];
+                av_free_packet(pkt);
+                av_free(pkt);
+            }
+        }
+    }
+
     return res;
 }
 
+/*
+ * Remember the position of a cluster, to seek in files without cues.
+ */
+
+static void
+matroska_add_cluster (MatroskaDemuxContext *matroska,
+                      offset_t              pos,
+                      uint64_t              time)
+{
+    MatroskaClusterIndex *clusters;
+    int a = -1, b = matroska->num_clusters, m;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (matroska->clusters[m].pos <= pos)
+            a = m;
+        else
+            b = m;
+    }
+    if (a >= 0 && matroska->clusters[a].pos == pos)
+        return;
+
+    clusters = av_fast_realloc(matroska->clusters, &matroska->clusters_size,
+                               (matroska->num_clusters + 1) *
+                               sizeof(MatroskaClusterIndex));
+    if (!clusters)
+        return;
+    matroska->clusters = clusters;
+    memmove(clusters + b + 1, clusters + b,
+            (matroska->num_clusters - b) * sizeof(MatroskaClusterIndex));
+    clusters[b].pos = pos;
+    clusters[b].time = time;
+    matroska->num_clusters++;
+}
+
 static int
-matroska_parse_cluster (MatroskaDemuxContext *matroska)
+matroska_parse_cluster (MatroskaDemuxContext *matroska,
+                        offset_t              cluster_pos)
 {
     int res = 0;
     uint32_t id;
@@ -2513,6 +2604,7 @@ matroska_parse_cluster (MatroskaDemuxContext *matroska)
                 if ((res = ebml_read_uint(matroska, &id, &num)) < 0)
                     break;
                 cluster_time = num;
+                matroska_add_cluster(matroska, cluster_pos, cluster_time);
                 break;
             }
 
@@ -2568,12 +2660,15 @@ matroska_read_packet (AVFormatContext *s,
         }
 
         switch (id) {
-            case MATROSKA_ID_CLUSTER:
+            case MATROSKA_ID_CLUSTER: {
+                /* the cluster ID has already been read */
+                offset_t pos = url_ftell(&s->pb) - 4;
                 if ((res = ebml_read_master(matroska, &id)) < 0)
                     break;
-                if ((res = matroska_parse_cluster(matroska)) == 0)
+                if ((res = matroska_parse_cluster(matroska, pos)) == 0)
                     res = 1; /* Parsed one cluster, let's get out. */
                 break;
+            }
 
             default:
             case EBML_ID_VOID:
@@ -2593,6 +2688,173 @@ matroska_read_packet (AVFormatContext *s,
     return matroska_deliver_packet(matroska, pkt);
 }
 
+/*
+ * Read the cues if that has not been done yet, and add them to the
+ * index of the streams.
+ */
+
+static void
+matroska_index_cues (MatroskaDemuxContext *matroska)
+{
+    AVFormatContext *s = matroska->ctx;
+    MatroskaTrack *track;
+    int i, n;
+
+    if (matroska->cues_indexed)
+        return;
+    matroska->cues_indexed = 1;
+
+    if (!matroska->index_parsed && matroska->cues_pos)
+        matroska_parse_element_at(matroska, MATROSKA_ID_CUES,
+                                  matroska->cues_pos);
+
+    for (i = 0; i < matroska->num_indexes; i++) {
+        MatroskaDemuxIndex *idx = &matroska->index[i];
+
+        n = matroska_find_track_by_num(matroska, idx->track);
+        if (n < 0)
+            continue;
+        track = matroska->tracks[n];
+        /* tracks without stream, see matroska_read_header() */
+        if (track->type == MATROSKA_TRACK_TYPE_SUBTITLE ||
+            track->codec_id == NULL || track->stream_index >= s->nb_streams)
+            continue;
+        av_add_index_entry(s->streams[track->stream_index],
+                           idx->pos + matroska->segment_start,
+                           idx->time / matroska->time_scale,
+                           0, 0, AVINDEX_KEYFRAME);
+    }
+}
+
+/*
+ * Find the clusters following the last known one, until one starts
+ * after the given timecode.
+ */
+
+static void
+matroska_index_clusters (MatroskaDemuxContext *matroska,
+                         int64_t               timecode)
+{
+    ByteIOContext *pb = &matroska->ctx->pb;
+    offset_t pos, next;
+    uint64_t length, num;
+    uint32_t id;
+
+    if (matroska->num_clusters)
+        pos = matroska->clusters[matroska->num_clusters - 1].pos;
+    else
+        pos = matroska->first_cluster_pos;
+    if (pos <= 0)
+        return;
+
+    for (;;) {
+        if (ebml_read_seek(matroska, pos) < 0 ||
+            ebml_read_element_id(matroska, &id, NULL) < 0 ||
+            ebml_read_element_length(matroska, &length) < 0)
+            break;
+        next = url_ftell(pb) + length;
+
+        if (id == MATROSKA_ID_CLUSTER) {
+            /* the timecode should be the first element of the cluster */
+            while (url_ftell(pb) < next) {
+                if (ebml_read_element_id(matroska, &id, NULL) < 0)
+                    break;
+                if (id == MATROSKA_ID_CLUSTERTIMECODE) {
+                    if (ebml_read_uint(matroska, &id, &num) < 0)
+                        break;
+                    matroska_add_cluster(matroska, pos, num);
+                    if ((int64_t)num > timecode)
+                        return;
+                    break;
+                }
+                if (ebml_read_element_length(matroska, &length) < 0)
+                    break;
+                url_fskip(pb, length);
+            }
+        }
+        if (next <= pos || url_feof(pb))
+            break;
+        pos = next;
+    }
+}
+
+static int
+matroska_read_seek (AVFormatContext *s,
+                    int              stream_index,
+                    int64_t          timestamp,
+                    int              flags)
+{
+    MatroskaDemuxContext *matroska = s->priv_data;
+    AVStream *st = s->streams[stream_index];
+    offset_t pos, before_pos = url_ftell(&s->pb);
+    uint32_t peek_id_cache = matroska->peek_id;
+    int64_t ts;
+    int index, n, a, b, m;
+
+    if (s->pb.is_streamed)
+        return -1;
+
+    matroska_index_cues(matroska);
+
+    if (st->nb_index_entries) {
+        index = av_index_search_timestamp(st, timestamp, flags);
+        if (index < 0)
+            goto fail;
+        pos = st->index_entries[index].pos;
+        ts = st->index_entries[index].timestamp;
+    } else {
+        /* no cues, use the cluster timecodes */
+        if (!matroska->num_clusters ||
+            matroska->clusters[matroska->num_clusters - 1].time <= timestamp)
+            matroska_index_clusters(matroska, timestamp);
+
+        a = -1;
+        b = matroska->num_clusters;
+        while (b - a > 1) {
+            m = (a + b) >> 1;
+            if ((int64_t)matroska->clusters[m].time <= timestamp)
+                a = m;
+            else
+                b = m;
+        }
+        if (flags & AVSEEK_FLAG_BACKWARD)
+            index = FFMAX(a, 0);
+        else
+            index = (a >= 0 && matroska->clusters[a].time == timestamp) ? a : b;
+        if (index >= matroska->num_clusters)
+            goto fail;
+        pos = matroska->clusters[index].pos;
+        ts = matroska->clusters[index].time;
+    }
+
+    /* drop the queued packets and restart at the cluster */
+    for (n = 0; n < matroska->num_packets; n++) {
+        av_free_packet(matroska->packets[n]);
+        av_free(matroska->packets[n]);
+    }
+    av_freep(&matroska->packets);
+    matroska->num_packets = 0;
+    matroska->num_levels = matroska->segment_levels;
+    matroska->level_up = 0;
+    matroska->done = 0;
+    if (ebml_read_seek(matroska, pos) < 0)
+        return -1;
+
+    /* a cue points into the cluster, the packets before it are dropped */
+    matroska->skip_to_keyframe = st->nb_index_entries &&
+                                 st->discard < AVDISCARD_ALL;
+    matroska->skip_to_stream = stream_index;
+    matroska->skip_to_timecode = ts;
+
+    av_update_cur_dts(s, st, ts);
+    return 0;
+
+fail:
+    ebml_read_seek(matroska, before_pos);
+    matroska->peek_id = peek_id_cache;
+    return -1;
+}
+
 static int
 matroska_read_close (AVFormatContext *s)
 {
@@ -2605,6 +2867,7 @@ matroska_read_close (AVFormatContext *s)
         av_free(matroska->muxing_app);
     if (matroska->index)
         av_free(matroska->index);
+    av_free(matroska->clusters);
 
     if (matroska->packets != NULL) {
         for (n = 0; n < matroska->num_packets; n++) {
@@ -2643,4 +2906,5 @@ AVInputFormat matroska_demuxer = {
     matroska_read_header,
     matroska_read_packet,
     matroska_read_close,
+    matroska_read_seek,
 };
@@ -156,8 +156,16 @@ typedef struct MOV_sample_to_chunk_tbl {
     long first;
     long count;
     long id;
+    int64_t first_sample; /* number of samples in the chunks before this run */
 } MOV_sample_to_chunk_tbl;
 
+typedef struct MOV_stts_tbl {
+    int count;
+    int duration;
+    int64_t first_sample; /* number of samples before this run */
+    int64_t first_dts;    /* dts of the first sample of this run */
+} MOV_stts_tbl;
+
 typedef struct {
     uint32_t type;
     int64_t offset;
@@ -228,11 +236,11 @@ struct MOVParseTableEntry;
 
 typedef struct MOVStreamContext {
     int ffindex; /* the ffmpeg stream id */
-    long next_chunk;
     long chunk_count;
     int64_t *chunk_offsets;
+    int chunk_offsets_sorted;
     int stts_count;
-    Time2Sample *stts_data;
+    MOV_stts_tbl *stts_data;
     int ctts_count;
     Time2Sample *ctts_data;
     int edit_count;             /* number of 'edit' (elst atom) */
@@ -242,14 +250,25 @@ typedef struct MOVStreamContext {
     int sample_to_ctime_sample;
     long sample_size;
     long sample_count;
-    long *sample_sizes;
+    long sample_sizes_count;
+    unsigned int *sample_sizes;
     long keyframe_count;
-    long *keyframes;
+    int *keyframes;
     int time_scale;
     int time_rate;
     long current_sample;
     MOV_esds_t esds;
     AVRational sample_size_v1;
+    /* position of current_sample in the sample tables, see mov_set_sample() */
+    int whole_chunks; /* every chunk is read as a single packet */
+    int *chunk_sizes; /* size of each chunk if whole_chunks is set */
+    int stsc_index;
+    int stts_index;
+    int stss_index;
+    long chunk_index;
+    long chunk_sample; /* index of current_sample in its chunk */
+    int64_t sample_pos;
+    int64_t sample_dts;
 } MOVStreamContext;
 
 typedef struct MOVContext {
@@ -784,6 +803,13 @@ static int mov_read_stco(MOVContext *c, ByteIOContext *pb, MOV_atom_t atom)
     } else
         return -1;
 
+    sc->chunk_offsets_sorted = 1;
+    for(i=1; i<entries; i++) {
+        if (sc->chunk_offsets[i] < sc->chunk_offsets[i-1]) {
+            sc->chunk_offsets_sorted = 0;
+            break;
+        }
+    }
     return 0;
 }
 
@@ -1080,20 +1106,20 @@ static int mov_read_stss(MOVContext *c, ByteIOContext *pb, MOV_atom_t atom)
 
     entries = get_be32(pb);
 
-    if(entries >= UINT_MAX / sizeof(long))
+    if(entries >= UINT_MAX / sizeof(int))
         return -1;
 
     sc->keyframe_count = entries;
 #ifdef DEBUG
     av_log(NULL, AV_LOG_DEBUG, "keyframe_count = %ld\n", sc->keyframe_count);
 #endif
-    sc->keyframes = (long*) av_malloc(entries * sizeof(long));
+    sc->keyframes = (int*) av_malloc(entries * sizeof(int));
     if (!sc->keyframes)
         return -1;
     for(i=0; i<entries; i++) {
         sc->keyframes[i] = get_be32(pb);
 #ifdef DEBUG
-/*        av_log(NULL, AV_LOG_DEBUG, "keyframes[]=%ld\n", sc->keyframes[i]); */
+/*        av_log(NULL, AV_LOG_DEBUG, "keyframes[]=%d\n", sc->keyframes[i]); */
 #endif
     }
     return 0;
@@ -1112,7 +1138,7 @@ static int mov_read_stsz(MOVContext *c, ByteIOContext *pb, MOV_atom_t atom)
     if (!sc->sample_size) /* do not overwrite value computed in stsd */
         sc->sample_size = sample_size;
     entries = get_be32(pb);
-    if(entries >= UINT_MAX / sizeof(long))
+    if(entries >= UINT_MAX / sizeof(unsigned int))
         return -1;
 
     sc->sample_count = entries;
@@ -1122,13 +1148,14 @@ static int mov_read_stsz(MOVContext *c, ByteIOContext *pb, MOV_atom_t atom)
 #ifdef DEBUG
     av_log(NULL, AV_LOG_DEBUG, "sample_size = %ld sample_count = %ld\n", sc->sample_size, sc->sample_count);
 #endif
-    sc->sample_sizes = (long*) av_malloc(entries * sizeof(long));
+    sc->sample_sizes_count = entries;
+    sc->sample_sizes = (unsigned int*) av_malloc(entries * sizeof(unsigned int));
     if (!sc->sample_sizes)
         return -1;
     for(i=0; i<entries; i++) {
         sc->sample_sizes[i] = get_be32(pb);
 #ifdef DEBUG
-        av_log(NULL, AV_LOG_DEBUG, "sample_sizes[]=%ld\n", sc->sample_sizes[i]);
+        av_log(NULL, AV_LOG_DEBUG, "sample_sizes[]=%u\n", sc->sample_sizes[i]);
 #endif
     }
     return 0;
@@ -1145,11 +1172,13 @@ static int mov_read_stts(MOVContext *c, ByteIOContext *pb, MOV_atom_t atom)
     get_byte(pb); /* version */
     get_byte(pb); get_byte(pb); get_byte(pb); /* flags */
     entries = get_be32(pb);
-    if(entries >= UINT_MAX / sizeof(Time2Sample))
+    if(entries >= UINT_MAX / sizeof(MOV_stts_tbl))
         return -1;
 
     sc->stts_count = entries;
-    sc->stts_data = av_malloc(entries * sizeof(Time2Sample));
+    sc->stts_data = av_malloc(entries * sizeof(MOV_stts_tbl));
+    if (!sc->stts_data)
+        return -1;
 
 #ifdef DEBUG
 av_log(NULL, AV_LOG_DEBUG, "track[%i].stts.entries = %i\n", c->fc->nb_streams-1, entries);
@@ -1462,6 +1491,12 @@ static const MOVParseTableEntry mov_default_parse_table[] = {
 static void mov_free_stream_context(MOVStreamContext *sc)
 {
     if(sc) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->chunk_sizes);
+        av_freep(&sc->sample_to_chunk);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
         av_freep(&sc->ctts_data);
         av_freep(&sc);
     }
@@ -1512,114 +1547,316 @@ static int mov_probe(AVProbeData *p)
     return score;
 }
 
+/* find the stsc run containing the given chunk */
+static int mov_find_stsc_chunk(MOVStreamContext *sc, long chunk)
+{
+    int a = 0, b = sc->sample_to_chunk_sz, m;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (sc->sample_to_chunk[m].first - 1 <= chunk)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+/* find the stsc run containing the given sample */
+static int mov_find_stsc_sample(MOVStreamContext *sc, int64_t sample)
+{
+    int a = 0, b = sc->sample_to_chunk_sz, m;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (sc->sample_to_chunk[m].first_sample <= sample)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+/* find the stts run containing the given sample, the last run covers all
+   samples after it */
+static int mov_find_stts(MOVStreamContext *sc, int64_t sample)
+{
+    int a = 0, b = sc->stts_count, m;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (sc->stts_data[m].first_sample <= sample)
+            a = m;
+        else
+            b = m;
+    }
+    return a;
+}
+
+static int64_t mov_sample_dts(MOVStreamContext *sc, int64_t sample)
+{
+    MOV_stts_tbl *stts;
+
+    if (!sc->stts_count)
+        return 0;
+    stts = &sc->stts_data[mov_find_stts(sc, sample)];
+    return stts->first_dts + (sample - stts->first_sample) * stts->duration;
+}
+
+static int64_t mov_chunk_first_sample(MOVStreamContext *sc, long chunk)
+{
+    MOV_sample_to_chunk_tbl *stsc = &sc->sample_to_chunk[mov_find_stsc_chunk(sc, chunk)];
+
+    return stsc->first_sample + (int64_t)(chunk - (stsc->first - 1)) * stsc->count;
+}
+
+/* dts of a packet, i.e. of a sample or of a whole chunk */
+static int64_t mov_packet_dts(MOVStreamContext *sc, long index)
+{
+    if (sc->whole_chunks)
+        return mov_sample_dts(sc, mov_chunk_first_sample(sc, index));
+    return mov_sample_dts(sc, index);
+}
+
+static int mov_sample_size(MOVStreamContext *sc, long sample)
+{
+    if (sc->sample_size > 0)
+        return sc->sample_size;
+    if (!sc->sample_sizes_count)
+        return 0;
+    return sc->sample_sizes[FFMIN(sample, sc->sample_sizes_count - 1)];
+}
+
+/**
+ * Position the stream on the given packet: look up its chunk, file
+ * offset and dts in the sample tables.
+ */
+static void mov_set_sample(MOVStreamContext *sc, long index)
+{
+    MOV_sample_to_chunk_tbl *stsc;
+    int64_t sample, first;
+    long i;
+    int a, b, m;
+
+    sc->current_sample = index;
+    if (index >= sc->sample_count)
+        return;
+
+    if (sc->whole_chunks) {
+        sc->chunk_index = index;
+        sc->chunk_sample = 0;
+        sc->stsc_index = mov_find_stsc_chunk(sc, index);
+        sc->sample_pos = sc->chunk_offsets[index];
+        sc->sample_dts = mov_packet_dts(sc, index);
+        return;
+    }
+
+    sc->stsc_index = mov_find_stsc_sample(sc, index);
+    stsc = &sc->sample_to_chunk[sc->stsc_index];
+    sample = index - stsc->first_sample;
+    sc->chunk_index = stsc->first - 1 + sample / stsc->count;
+    sc->chunk_sample = sample % stsc->count;
+    sc->sample_pos = sc->chunk_offsets[sc->chunk_index];
+    first = index - sc->chunk_sample;
+    if (sc->sample_size > 0)
+        sc->sample_pos += sc->chunk_sample * sc->sample_size;
+    else
+        for (i = first; i < index; i++)
+            sc->sample_pos += mov_sample_size(sc, i);
+
+    sc->stts_index = mov_find_stts(sc, index);
+    sc->sample_dts = mov_sample_dts(sc, index);
+
+    /* first sync sample at or after this one */
+    a = -1;
+    b = sc->keyframe_count;
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        if (sc->keyframes[m] >= index + 1)
+            b = m;
+        else
+            a = m;
+    }
+    sc->stss_index = b;
+}
+
+static int mov_sample_is_keyframe(MOVStreamContext *sc)
+{
+    return sc->whole_chunks || !sc->keyframe_count ||
+           (sc->stss_index < sc->keyframe_count &&
+            sc->keyframes[sc->stss_index] == sc->current_sample + 1);
+}
+
+/* advance to the next packet, incrementally in the common case */
+static void mov_next_sample(MOVStreamContext *sc)
+{
+    long next = sc->current_sample + 1;
+
+    if (sc->whole_chunks || next >= sc->sample_count ||
+        sc->chunk_sample + 1 >= sc->sample_to_chunk[sc->stsc_index].count) {
+        mov_set_sample(sc, next);
+        return;
+    }
+    if (mov_sample_is_keyframe(sc) && sc->keyframe_count)
+        sc->stss_index++;
+    sc->sample_pos += mov_sample_size(sc, sc->current_sample);
+    sc->chunk_sample++;
+    if (sc->stts_count) {
+        sc->sample_dts += sc->stts_data[sc->stts_index].duration;
+        while (sc->stts_index + 1 < sc->stts_count &&
+               sc->stts_data[sc->stts_index + 1].first_sample <= next)
+            sc->stts_index++;
+    }
+    sc->current_sample = next;
+}
+
+/**
+ * Find the packet with the given dts, or the previous one with
+ * AVSEEK_FLAG_BACKWARD, with the semantics of av_index_search_timestamp().
+ */
+static long mov_search_sample(MOVStreamContext *sc, int64_t timestamp, int flags)
+{
+    long a = -1, b = sc->sample_count, m;
+    int64_t dts;
+    int ka, kb, k;
+
+    while (b - a > 1) {
+        m = (a + b) >> 1;
+        dts = mov_packet_dts(sc, m);
+        if (dts >= timestamp)
+            b = m;
+        if (dts <= timestamp)
+            a = m;
+    }
+    m = (flags & AVSEEK_FLAG_BACKWARD) ? a : b;
+    if (m < 0 || m >= sc->sample_count)
+        return -1;
+
+    if (!(flags & AVSEEK_FLAG_ANY) && !sc->whole_chunks && sc->keyframe_count) {
+        /* stss holds the sorted 1 based numbers of the sync samples */
+        ka = -1;
+        kb = sc->keyframe_count;
+        while (kb - ka > 1) {
+            k = (ka + kb) >> 1;
+            if (sc->keyframes[k] <= m + 1)
+                ka = k;
+            if (sc->keyframes[k] >= m + 1)
+                kb = k;
+        }
+        k = (flags & AVSEEK_FLAG_BACKWARD) ? ka : kb;
+        if (k < 0 || k >= sc->keyframe_count ||
+            sc->keyframes[k] < 1 || sc->keyframes[k] > sc->sample_count)
+            return -1;
+        m = sc->keyframes[k] - 1;
+    }
+    return m;
+}
+
+/* size of a chunk read as a whole */
+static int mov_chunk_size(MOVContext *mov, AVStream *st, long chunk)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int64_t current_offset = sc->chunk_offsets[chunk];
+    int chunk_samples = sc->sample_to_chunk[mov_find_stsc_chunk(sc, chunk)].count;
+    int chunk_size, j;
+    long a, b, k;
+
+    if (sc->sample_size > 1 || st->codec->bits_per_sample == 8)
+        return chunk_samples * sc->sample_size;
+    if (sc->sample_size_v1.den > 0 && (chunk_samples * sc->sample_size_v1.num % sc->sample_size_v1.den == 0))
+        return chunk_samples * sc->sample_size_v1.num / sc->sample_size_v1.den;
+
+    /* workaround to find nearest next chunk offset */
+    chunk_size = INT_MAX;
+    for (j = 0; j < mov->total_streams; j++) {
+        MOVStreamContext *msc = mov->streams[j];
+
+        if (msc->chunk_offsets_sorted) {
+            a = -1;
+            b = msc->chunk_count;
+            while (b - a > 1) {
+                k = (a + b) >> 1;
+                if (msc->chunk_offsets[k] > current_offset)
+                    b = k;
+                else
+                    a = k;
+            }
+            if (b < msc->chunk_count && msc->chunk_offsets[b] - current_offset < chunk_size)
+                chunk_size = msc->chunk_offsets[b] - current_offset;
+        } else {
+            for (k = 0; k < msc->chunk_count; k++) {
+                if (msc->chunk_offsets[k] > current_offset && msc->chunk_offsets[k] - current_offset < chunk_size)
+                    chunk_size = msc->chunk_offsets[k] - current_offset;
+            }
+        }
+    }
+    /* check for last chunk */
+    if (chunk_size == INT_MAX)
+        for (j = 0; j < mov->mdat_count; j++) {
+            dprintf("mdat %d, offset %llx, size %lld, current offset %llx\n",
+                    j, mov->mdat_list[j].offset, mov->mdat_list[j].size, current_offset);
+            if (mov->mdat_list[j].offset <= current_offset && mov->mdat_list[j].offset + mov->mdat_list[j].size > current_offset)
+                chunk_size = mov->mdat_list[j].offset + mov->mdat_list[j].size - current_offset;
+        }
+    assert(chunk_size != INT_MAX);
+    return chunk_size;
+}
+
+/**
+ * Prepare the sample tables for lookups. They are not expanded into
+ * index entries: only the number of samples before each stsc and stts
+ * run and the dts of each stts run are computed here, so that the open
+ * time and memory depend on the number of runs and not on the number of
+ * samples.
+ */
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
-    offset_t current_offset;
-    int64_t current_dts = 0;
-    int stts_index = 0;
-    int stsc_index = 0;
-    int stss_index = 0;
-    int i, j, k;
+    int64_t samples = 0, dts = 0;
+    long start = 0, next;
+    int i;
 
-    if (sc->sample_sizes || st->codec->codec_type == CODEC_TYPE_VIDEO) {
-        int keyframe, sample_size;
-        int current_sample = 0;
-        int stts_sample = 0;
-        int distance = 0;
+    /* normalize the first chunk of each stsc run, the first run always
+       starts at the first chunk */
+    for (i = 0; i < sc->sample_to_chunk_sz; i++) {
+        MOV_sample_to_chunk_tbl *stsc = &sc->sample_to_chunk[i];
+
+        if (i + 1 < sc->sample_to_chunk_sz)
+            next = clip(sc->sample_to_chunk[i + 1].first - 1, start, sc->chunk_count);
+        else
+            next = sc->chunk_count;
+        if (stsc->count < 0)
+            stsc->count = 0;
+        stsc->first = start + 1;
+        stsc->first_sample = samples;
+        samples += (int64_t)(next - start) * stsc->count;
+        start = next;
+    }
+    for (i = 0; i < sc->stts_count; i++) {
+        MOV_stts_tbl *stts = &sc->stts_data[i];
+
+        assert(stts->duration % sc->time_rate == 0);
+        stts->duration /= sc->time_rate;
+        stts->first_sample = i ? stts[-1].first_sample + stts[-1].count : 0;
+        stts->first_dts = dts;
+        dts += (int64_t)stts->count * stts->duration;
+    }
 
+    if (sc->sample_sizes || st->codec->codec_type == CODEC_TYPE_VIDEO) {
         st->nb_frames = sc->sample_count;
-        for (i = 0; i < sc->chunk_count; i++) {
-            current_offset = sc->chunk_offsets[i];
-            if (stsc_index + 1 < sc->sample_to_chunk_sz && i + 1 == sc->sample_to_chunk[stsc_index + 1].first)
-                stsc_index++;
-            for (j = 0; j < sc->sample_to_chunk[stsc_index].count; j++) {
-                keyframe = !sc->keyframe_count || current_sample + 1 == sc->keyframes[stss_index];
-                if (keyframe) {
-                    distance = 0;
-                    if (stss_index + 1 < sc->keyframe_count)
-                        stss_index++;
-                }
-                sample_size = sc->sample_size > 0 ? sc->sample_size : sc->sample_sizes[current_sample];
-                dprintf("AVIndex stream %d, sample %d, offset %llx, dts %lld, size %d, distance %d, keyframe %d\n",
-                        st->index, current_sample, current_offset, current_dts, sample_size, distance, keyframe);
-                av_add_index_entry(st, current_offset, current_dts, sample_size, distance, keyframe ? AVINDEX_KEYFRAME : 0);
-                current_offset += sample_size;
-                assert(sc->stts_data[stts_index].duration % sc->time_rate == 0);
-                current_dts += sc->stts_data[stts_index].duration / sc->time_rate;
-                distance++;
-                stts_sample++;
-                if (current_sample + 1 < sc->sample_count)
-                    current_sample++;
-                if (stts_index + 1 < sc->stts_count && stts_sample == sc->stts_data[stts_index].count) {
-                    stts_sample = 0;
-                    stts_index++;
-                }
-            }
-        }
+        sc->sample_count = samples;
     } else { /* read whole chunk */
-        int chunk_samples, chunk_size, chunk_duration;
-
-        for (i = 0; i < sc->chunk_count; i++) {
-            current_offset = sc->chunk_offsets[i];
-            if (stsc_index + 1 < sc->sample_to_chunk_sz && i + 1 == sc->sample_to_chunk[stsc_index + 1].first)
-                stsc_index++;
-            chunk_samples = sc->sample_to_chunk[stsc_index].count;
-            /* get chunk size */
-            if (sc->sample_size > 1 || st->codec->bits_per_sample == 8)
-                chunk_size = chunk_samples * sc->sample_size;
-            else if (sc->sample_size_v1.den > 0 && (chunk_samples * sc->sample_size_v1.num % sc->sample_size_v1.den == 0))
-                chunk_size = chunk_samples * sc->sample_size_v1.num / sc->sample_size_v1.den;
-            else { /* workaround to find nearest next chunk offset */
-                chunk_size = INT_MAX;
-                for (j = 0; j < mov->total_streams; j++) {
-                    MOVStreamContext *msc = mov->streams[j];
-
-                    for (k = msc->next_chunk; k < msc->chunk_count; k++) {
-                        if (msc->chunk_offsets[k] > current_offset && msc->chunk_offsets[k] - current_offset < chunk_size) {
-                            chunk_size = msc->chunk_offsets[k] - current_offset;
-                            msc->next_chunk = k;
-                            break;
-                        }
-                    }
-                }
-                /* check for last chunk */
-                if (chunk_size == INT_MAX)
-                    for (j = 0; j < mov->mdat_count; j++) {
-                        dprintf("mdat %d, offset %llx, size %lld, current offset %llx\n",
-                                j, mov->mdat_list[j].offset, mov->mdat_list[j].size, current_offset);
-                        if (mov->mdat_list[j].offset <= current_offset && mov->mdat_list[j].offset + mov->mdat_list[j].size > current_offset)
-                            chunk_size = mov->mdat_list[j].offset + mov->mdat_list[j].size - current_offset;
-                    }
-                assert(chunk_size != INT_MAX);
-                for (j = 0; j < mov->total_streams; j++) {
-                    mov->streams[j]->next_chunk = 0;
-                }
-            }
-            av_add_index_entry(st, current_offset, current_dts, chunk_size, 0, AVINDEX_KEYFRAME);
-            /* get chunk duration */
-            chunk_duration = 0;
-            while (chunk_samples > 0) {
-                if (chunk_samples < sc->stts_data[stts_index].count) {
-                    chunk_duration += sc->stts_data[stts_index].duration * chunk_samples;
-                    sc->stts_data[stts_index].count -= chunk_samples;
-                    break;
-                } else {
-                    chunk_duration += sc->stts_data[stts_index].duration * chunk_samples;
-                    chunk_samples -= sc->stts_data[stts_index].count;
-                    if (stts_index + 1 < sc->stts_count) {
-                        stts_index++;
-                    }
-                }
-            }
-            dprintf("AVIndex stream %d, chunk %d, offset %llx, dts %lld, size %d, duration %d\n",
-                    st->index, i, current_offset, current_dts, chunk_size, chunk_duration);
-            assert(chunk_duration % sc->time_rate == 0);
-            current_dts += chunk_duration / sc->time_rate;
+        sc->whole_chunks = 1;
+        sc->sample_count = sc->sample_to_chunk_sz ? sc->chunk_count : 0;
+        sc->chunk_sizes = av_malloc(FFMAX(sc->chunk_count, 1) * sizeof(int));
+        if (!sc->chunk_sizes) {
+            sc->sample_count = 0;
+            return;
         }
+        for (i = 0; i < sc->sample_count; i++)
+            sc->chunk_sizes[i] = mov_chunk_size(mov, st, i);
     }
-    /* adjust sample count to avindex entries */
-    sc->sample_count = st->nb_index_entries;
+    mov_set_sample(sc, 0);
 }
 
 static int mov_read_header(AVFormatContext *s, AVFormatParameters *ap)
@@ -1669,14 +1906,6 @@ static int mov_read_header(AVFormatContext *s, AVFormatParameters *ap)
         mov_build_index(mov, s->streams[i]);
     }
 
-    for(i=0; i<mov->total_streams; i++) {
-        /* dont need those anymore */
-        av_freep(&mov->streams[i]->chunk_offsets);
-        av_freep(&mov->streams[i]->sample_to_chunk);
-        av_freep(&mov->streams[i]->sample_sizes);
-        av_freep(&mov->streams[i]->keyframes);
-        av_freep(&mov->streams[i]->stts_data);
-    }
     av_freep(&mov->mdat_list);
     return 0;
 }
@@ -1685,37 +1914,39 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 {
     MOVContext *mov = s->priv_data;
     MOVStreamContext *sc = 0;
-    AVIndexEntry *sample = 0;
     int64_t best_dts = INT64_MAX;
-    int i;
+    int64_t pos, dts;
+    int i, size, keyframe;
 
     for (i = 0; i < mov->total_streams; i++) {
         MOVStreamContext *msc = mov->streams[i];
 
         if (s->streams[i]->discard != AVDISCARD_ALL && msc->current_sample < msc->sample_count) {
-            AVIndexEntry *current_sample = &s->streams[i]->index_entries[msc->current_sample];
-            int64_t dts = av_rescale(current_sample->timestamp * (int64_t)msc->time_rate, AV_TIME_BASE, msc->time_scale);
+            int64_t dts = av_rescale(msc->sample_dts * (int64_t)msc->time_rate, AV_TIME_BASE, msc->time_scale);
 
             dprintf("stream %d, sample %ld, dts %lld\n", i, msc->current_sample, dts);
             if (dts < best_dts) {
-                sample = current_sample;
                 best_dts = dts;
                 sc = msc;
             }
         }
     }
-    if (!sample)
+    if (!sc)
         return -1;
+    pos = sc->sample_pos;
+    dts = sc->sample_dts;
+    size = sc->whole_chunks ? sc->chunk_sizes[sc->current_sample] : mov_sample_size(sc, sc->current_sample);
+    keyframe = mov_sample_is_keyframe(sc);
     /* must be done just before reading, to avoid infinite loop on sample */
-    sc->current_sample++;
-    if (sample->pos >= url_fsize(&s->pb)) {
-        av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%llx: partial file\n", sc->ffindex, sample->pos);
+    mov_next_sample(sc);
+    if (pos >= url_fsize(&s->pb)) {
+        av_log(mov->fc, AV_LOG_ERROR, "stream %d, offset 0x%llx: partial file\n", sc->ffindex, pos);
         return -1;
     }
-    url_fseek(&s->pb, sample->pos, SEEK_SET);
-    av_get_packet(&s->pb, pkt, sample->size);
+    url_fseek(&s->pb, pos, SEEK_SET);
+    av_get_packet(&s->pb, pkt, size);
     pkt->stream_index = sc->ffindex;
-    pkt->dts = sample->timestamp;
+    pkt->dts = dts;
     if (sc->ctts_data) {
         assert(sc->ctts_data[sc->sample_to_ctime_index].duration % sc->time_rate == 0);
         pkt->pts = pkt->dts + sc->ctts_data[sc->sample_to_ctime_index].duration / sc->time_rate;
@@ -1728,8 +1959,8 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
     } else {
         pkt->pts = pkt->dts;
     }
-    pkt->flags |= sample->flags & AVINDEX_KEYFRAME ? PKT_FLAG_KEY : 0;
-    pkt->pos = sample->pos;
+    pkt->flags |= keyframe ? PKT_FLAG_KEY : 0;
+    pkt->pos = pos;
     dprintf("stream %d, pts %lld, dts %lld, pos 0x%llx, duration %d\n", pkt->stream_index, pkt->pts, pkt->dts, pkt->pos, pkt->duration);
     return 0;
 }
@@ -1737,23 +1968,23 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
 static int mov_seek_stream(AVStream *st, int64_t timestamp, int flags)
 {
     MOVStreamContext *sc = st->priv_data;
-    int sample, time_sample;
+    long sample, time_sample;
     int i;
 
-    sample = av_index_search_timestamp(st, timestamp, flags);
-    dprintf("stream %d, timestamp %lld, sample %d\n", st->index, timestamp, sample);
+    sample = mov_search_sample(sc, timestamp, flags);
+    dprintf("stream %d, timestamp %lld, sample %ld\n", st->index, timestamp, sample);
     if (sample < 0) /* not sure what to do */
         return -1;
-    sc->current_sample = sample;
+    mov_set_sample(sc, sample);
     dprintf("stream %d, found sample %ld\n", st->index, sc->current_sample);
     /* adjust ctts index */
     if (sc->ctts_data) {
         time_sample = 0;
         for (i = 0; i < sc->ctts_count; i++) {
             time_sample += sc->ctts_data[i].count;
-            if (time_sample >= sc->current_sample) {
+            if (time_sample > sc->current_sample) {
                 sc->sample_to_ctime_index = i;
-                sc->sample_to_ctime_sample = time_sample - sc->current_sample;
+                sc->sample_to_ctime_sample = sc->current_sample - (time_sample - sc->ctts_data[i].count);
                 break;
             }
         }
@@ -1765,19 +1996,17 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 {
     AVStream *st;
     int64_t seek_timestamp, timestamp;
-    int sample;
     int i;
 
     if (stream_index >= s->nb_streams)
         return -1;
 
     st = s->streams[stream_index];
-    sample = mov_seek_stream(st, sample_time, flags);
-    if (sample < 0)
+    if (mov_seek_stream(st, sample_time, flags) < 0)
         return -1;
 
     /* adjust seek timestamp to found sample timestamp */
-    seek_timestamp = st->index_entries[sample].timestamp;
+    seek_timestamp = ((MOVStreamContext *)st->priv_data)->sample_dts;
 
     for (i = 0; i < s->nb_streams; i++) {
         st = s->streams[i];
@@ -25,9 +25,14 @@
 #undef NDEBUG
 #include <assert.h>
 
-#define MOV_INDEX_CLUSTER_SIZE 16384
+#define MOV_INDEX_BUFFER_SIZE 65536
+#define MOV_FASTSTART_BUFFER_SIZE (1024*1024)
 #define globalTimescale 1000
 
+/* sample flags of fragments */
+#define MOV_SAMPLE_SYNC     0x02000000 /* depends on no other sample */
+#define MOV_SAMPLE_NON_SYNC 0x01010000 /* depends on others, not a sync sample */
+
 #define MODE_MP4 0
 #define MODE_MOV 1
 #define MODE_3GP 2
@@ -44,6 +49,27 @@ typedef struct MOVIentry {
     int64_t      cts;
 } MOVIentry;
 
+/* fields of a coded index entry that differ from the previous one */
+#define MOV_INDEX_KEY     0x01
+#define MOV_INDEX_SAMPLES 0x02
+#define MOV_INDEX_SIZE    0x04
+#define MOV_INDEX_POS     0x08
+#define MOV_INDEX_CTS     0x10
+
+typedef struct MOVSampleIndex {
+    uint8_t     *buf;         /* entries not spilled yet */
+    int         len, size;
+    FILE        *spill;       /* temporary file, NULL if none */
+    int         noSpill;
+    int64_t     spilled;      /* bytes in the temporary file */
+    MOVIentry   last;         /* entries are coded relative to the previous one */
+    /* reading */
+    uint8_t     *readBuf, *readData;
+    int         readPos, readLen;
+    int64_t     readSpilled;
+    MOVIentry   readLast;
+} MOVSampleIndex;
+
 typedef struct MOVIndex {
     int         mode;
     int         entry;
@@ -62,7 +88,20 @@ typedef struct MOVIndex {
 
     int         vosLen;
     uint8_t     *vosData;
-    MOVIentry   *cluster;
+
+    MOVSampleIndex idx;
+    /* summary of the index entries for the atom writers */
+    int64_t     entrySamples;
+    int         stscEntries;
+    int         cttsEntries;
+    int         equalSampleSizes;
+    unsigned int firstSampleSize;
+    int         hasCts;
+    uint64_t    lastPos;
+    offset_t    posShift;  /* added to the chunk offsets */
+
+    ByteIOContext fragData; /* data of the current fragment */
+    int         fragSize;
 } MOVTrack;
 
 typedef struct MOVContext {
@@ -73,8 +112,212 @@ typedef struct MOVContext {
     uint64_t mdat_size;
     long    timescale;
     MOVTrack tracks[MAX_STREAMS];
+    int     fragments;    /* write a moof and mdat atom per GOP */
+    int     fragmentSeq;
+    int     refTrack;     /* track whose key frames start fragments */
 } MOVContext;
 
+/* The sample index of a track is delta coded: each entry is a flag byte
+ * telling which fields differ from the previous entry, followed by those
+ * fields as variable length integers. Full buffers are spilled to a
+ * temporary file, so that the memory used does not depend on the
+ * duration, and the atom writers read the entries back in order. */
+
+static void mov_index_put_v(uint8_t **p, uint64_t v)
+{
+    while (v > 0x7f) {
+        *(*p)++ = (v & 0x7f) | 0x80;
+        v >>= 7;
+    }
+    *(*p)++ = v;
+}
+
+static int mov_index_spill(MOVSampleIndex *idx)
+{
+    if (!idx->spill && !idx->noSpill) {
+        idx->spill = tmpfile();
+        idx->noSpill = !idx->spill;
+    }
+    if (!idx->spill) { /* keep the index in memory */
+        uint8_t *buf = av_realloc(idx->buf, 2 * idx->size);
+        if (!buf)
+            return -1;
+        idx->buf = buf;
+        idx->size *= 2;
+        return 0;
+    }
+    /* the file is only read back once all entries have been written */
+    if (!idx->spilled)
+        rewind(idx->spill);
+    if (fwrite(idx->buf, 1, idx->len, idx->spill) != idx->len)
+        return -1;
+    idx->spilled += idx->len;
+    idx->len = 0;
+    return 0;
+}
+
+static int mov_index_add(MOVTrack *track, MOVIentry *e)
+{
+    MOVSampleIndex *idx = &track->idx;
+    MOVIentry *last = &idx->last;
+    uint8_t tmp[64], *p = tmp + 1;
+    int flags = e->key_frame ? MOV_INDEX_KEY : 0;
+    int len;
+
+    if (!idx->buf) {
+        idx->size = MOV_INDEX_BUFFER_SIZE;
+        idx->buf = av_malloc(idx->size);
+        if (!idx->buf)
+            return -1;
+    }
+
+    if (e->samplesInChunk != last->samplesInChunk) {
+        flags |= MOV_INDEX_SAMPLES;
+        mov_index_put_v(&p, e->samplesInChunk);
+        track->stscEntries++;
+    }
+    if (e->size != last->size) {
+        flags |= MOV_INDEX_SIZE;
+        mov_index_put_v(&p, e->size);
+    }
+    if (e->pos != last->pos + last->size) {
+        int64_t d = e->pos - (last->pos + last->size);
+        flags |= MOV_INDEX_POS;
+        mov_index_put_v(&p, (d << 1) ^ (d >> 63));
+    }
+    if (e->cts != last->cts || !track->entry) {
+        if (e->cts != last->cts) {
+            flags |= MOV_INDEX_CTS;
+            mov_index_put_v(&p, (e->cts << 1) ^ (e->cts >> 63));
+        }
+        track->cttsEntries++;
+    }
+    tmp[0] = flags;
+    len = p - tmp;
+
+    if (e->size / e->samplesInChunk != track->firstSampleSize) {
+        if (!track->entry)
+            track->firstSampleSize = e->size / e->samplesInChunk;
+        else
+            track->equalSampleSizes = 0;
+    }
+    if (e->cts)
+        track->hasCts = 1;
+    track->entrySamples += e->samplesInChunk;
+    track->lastPos = e->pos;
+
+    if (idx->len + len > idx->size && mov_index_spill(idx) < 0)
+        return -1;
+    memcpy(idx->buf + idx->len, tmp, len);
+    idx->len += len;
+    *last = *e;
+    return 0;
+}
+
+static int mov_index_get_byte(MOVSampleIndex *idx)
+{
+    if (idx->readPos >= idx->readLen) {
+        if (idx->readSpilled < idx->spilled) {
+            int len = FFMIN(idx->spilled - idx->readSpilled, MOV_INDEX_BUFFER_SIZE);
+            if (!idx->readBuf && !(idx->readBuf = av_malloc(MOV_INDEX_BUFFER_SIZE)))
+                return 0;
+            if (fread(idx->readBuf, 1, len, idx->spill) != len)
+                return 0;
+            idx->readSpilled += len;
+            idx->readData = idx->readBuf;
+            idx->readLen = len;
+        } else {
+            idx->readData = idx->buf;
+            idx->readLen = idx->len;
+        }
+        idx->readPos = 0;
+        if (!idx->readLen)
+            return 0;
+    }
+    return idx->readData[idx->readPos++];
+}
+
+static uint64_t mov_index_get_v(MOVSampleIndex *idx)
+{
+    uint64_t v = 0;
+    int shift = 0, c;
+
+    do {
+        c = mov_index_get_byte(idx);
+        v |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while ((c & 0x80) && shift < 64);
+    return v;
+}
+
+/* start reading the index of a track from its first entry */
+static void mov_index_rewind(MOVTrack *track)
+{
+    MOVSampleIndex *idx = &track->idx;
+
+    memset(&idx->readLast, 0, sizeof(idx->readLast));
+    if (idx->spill) {
+        fflush(idx->spill);
+        rewind(idx->spill);
+    }
+    idx->readSpilled = 0;
+    idx->readPos = idx->readLen = 0;
+}
+
+/* read the next entry of the index */
+static void mov_index_next(MOVTrack *track, MOVIentry *e)
+{
+    MOVSampleIndex *idx = &track->idx;
+    MOVIentry *last = &idx->readLast;
+    int flags = mov_index_get_byte(idx);
+    uint64_t v;
+
+    *e = *last;
+    e->key_frame = !!(flags & MOV_INDEX_KEY);
+    if (flags & MOV_INDEX_SAMPLES)
+        e->samplesInChunk = e->entries = mov_index_get_v(idx);
+    if (flags & MOV_INDEX_SIZE)
+        e->size = mov_index_get_v(idx);
+    e->pos = last->pos + last->size;
+    if (flags & MOV_INDEX_POS) {
+        v = mov_index_get_v(idx);
+        e->pos += (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+    if (flags & MOV_INDEX_CTS) {
+        v = mov_index_get_v(idx);
+        e->cts = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+    *last = *e;
+}
+
+/* forget all entries, used when a fragment has been written */
+static void mov_index_reset(MOVTrack *track)
+{
+    MOVSampleIndex *idx = &track->idx;
+
+    idx->len = 0;
+    idx->spilled = 0;
+    memset(&idx->last, 0, sizeof(idx->last));
+    track->entry = 0;
+    track->entrySamples = 0;
+    track->stscEntries = 0;
+    track->cttsEntries = 0;
+    track->equalSampleSizes = 1;
+    track->hasCts = 0;
+}
+
+static void mov_index_free(MOVTrack *track)
+{
+    MOVSampleIndex *idx = &track->idx;
+
+    av_freep(&idx->buf);
+    av_freep(&idx->readBuf);
+    if (idx->spill) {
+        fclose(idx->spill);
+        idx->spill = NULL;
+    }
+}
+
 //FIXME supprt 64bit varaint with wide placeholders
 static offset_t updateSize (ByteIOContext *pb, offset_t pos)
 {
@@ -89,22 +332,25 @@ static offset_t updateSize (ByteIOContext *pb, offset_t pos)
 /* Chunk offset atom */
 static int mov_write_stco_tag(ByteIOContext *pb, MOVTrack* track)
 {
+    MOVIentry e;
     int i;
     int mode64 = 0; //   use 32 bit size variant if possible
     offset_t pos = url_ftell(pb);
     put_be32(pb, 0); /* size */
-    if (pos > UINT32_MAX) {
+    if (track->entry && track->lastPos + track->posShift > UINT32_MAX) {
         mode64 = 1;
         put_tag(pb, "co64");
     } else
         put_tag(pb, "stco");
     put_be32(pb, 0); /* version & flags */
     put_be32(pb, track->entry); /* entry count */
+    mov_index_rewind(track);
     for (i=0; i<track->entry; i++) {
+        mov_index_next(track, &e);
         if(mode64 == 1)
-            put_be64(pb, track->cluster[i].pos);
+            put_be64(pb, e.pos + track->posShift);
         else
-            put_be32(pb, track->cluster[i].pos);
+            put_be32(pb, e.pos + track->posShift);
     }
     return updateSize (pb, pos);
 }
@@ -112,34 +358,26 @@ static int mov_write_stco_tag(ByteIOContext *pb, MOVTrack* track)
 /* Sample size atom */
 static int mov_write_stsz_tag(ByteIOContext *pb, MOVTrack* track)
 {
-    int equalChunks = 1;
-    int i, j, entries = 0, tst = -1, oldtst = -1;
+    MOVIentry e;
+    int i, j;
 
     offset_t pos = url_ftell(pb);
     put_be32(pb, 0); /* size */
     put_tag(pb, "stsz");
     put_be32(pb, 0); /* version & flags */
 
-    for (i=0; i<track->entry; i++) {
-        tst = track->cluster[i].size/track->cluster[i].entries;
-        if(oldtst != -1 && tst != oldtst) {
-            equalChunks = 0;
-        }
-        oldtst = tst;
-        entries += track->cluster[i].entries;
-    }
-    if (equalChunks) {
-        int sSize = track->cluster[0].size/track->cluster[0].entries;
-        put_be32(pb, sSize); // sample size
-        put_be32(pb, entries); // sample count
+    if (track->equalSampleSizes) {
+        put_be32(pb, track->firstSampleSize); // sample size
+        put_be32(pb, track->entrySamples); // sample count
     }
     else {
         put_be32(pb, 0); // sample size
-        put_be32(pb, entries); // sample count
+        put_be32(pb, track->entrySamples); // sample count
+        mov_index_rewind(track);
         for (i=0; i<track->entry; i++) {
-            for ( j=0; j<track->cluster[i].entries; j++) {
-                put_be32(pb, track->cluster[i].size /
-                         track->cluster[i].entries);
+            mov_index_next(track, &e);
+            for ( j=0; j<e.entries; j++) {
+                put_be32(pb, e.size / e.entries);
             }
         }
     }
@@ -149,29 +387,26 @@ static int mov_write_stsz_tag(ByteIOContext *pb, MOVTrack* track)
 /* Sample to chunk atom */
 static int mov_write_stsc_tag(ByteIOContext *pb, MOVTrack* track)
 {
-    int index = 0, oldval = -1, i;
-    offset_t entryPos, curpos;
+    MOVIentry e;
+    int64_t oldval = -1;
+    int i;
 
     offset_t pos = url_ftell(pb);
     put_be32(pb, 0); /* size */
     put_tag(pb, "stsc");
     put_be32(pb, 0); // version & flags
-    entryPos = url_ftell(pb);
-    put_be32(pb, track->entry); // entry count
+    put_be32(pb, track->stscEntries); // entry count
+    mov_index_rewind(track);
     for (i=0; i<track->entry; i++) {
-        if(oldval != track->cluster[i].samplesInChunk)
+        mov_index_next(track, &e);
+        if(oldval != e.samplesInChunk)
         {
             put_be32(pb, i+1); // first chunk
-            put_be32(pb, track->cluster[i].samplesInChunk); // samples per chunk
+            put_be32(pb, e.samplesInChunk); // samples per chunk
             put_be32(pb, 0x1); // sample description index
-            oldval = track->cluster[i].samplesInChunk;
-            index++;
+            oldval = e.samplesInChunk;
         }
     }
-    curpos = url_ftell(pb);
-    url_fseek(pb, entryPos, SEEK_SET);
-    put_be32(pb, index); // rewrite size
-    url_fseek(pb, curpos, SEEK_SET);
 
     return updateSize (pb, pos);
 }
@@ -179,24 +414,19 @@ static int mov_write_stsc_tag(ByteIOContext *pb, MOVTrack* track)
 /* Sync sample atom */
 static int mov_write_stss_tag(ByteIOContext *pb, MOVTrack* track)
 {
-    offset_t curpos, entryPos;
-    int i, index = 0;
+    MOVIentry e;
+    int i;
     offset_t pos = url_ftell(pb);
     put_be32(pb, 0); // size
     put_tag(pb, "stss");
     put_be32(pb, 0); // version & flags
-    entryPos = url_ftell(pb);
-    put_be32(pb, track->entry); // entry count
+    put_be32(pb, track->hasKeyframes); // entry count
+    mov_index_rewind(track);
     for (i=0; i<track->entry; i++) {
-        if(track->cluster[i].key_frame == 1) {
+        mov_index_next(track, &e);
+        if(e.key_frame == 1)
             put_be32(pb, i+1);
-            index++;
-        }
     }
-    curpos = url_ftell(pb);
-    url_fseek(pb, entryPos, SEEK_SET);
-    put_be32(pb, index); // rewrite size
-    url_fseek(pb, curpos, SEEK_SET);
     return updateSize (pb, pos);
 }
 
@@ -671,34 +901,33 @@ static int mov_write_stsd_tag(ByteIOContext *pb, MOVTrack* track)
 
 static int mov_write_ctts_tag(ByteIOContext *pb, MOVTrack* track)
 {
-    Time2Sample *ctts_entries;
-    uint32_t entries = 0;
+    MOVIentry e;
+    Time2Sample ctts_entry;
     uint32_t atom_size;
     int i;
 
-    ctts_entries = av_malloc((track->entry + 1) * sizeof(*ctts_entries)); /* worst case */
-    ctts_entries[0].count = 1;
-    ctts_entries[0].duration = track->cluster[0].cts;
-    for (i=1; i<track->entry; i++) {
-        if (track->cluster[i].cts == ctts_entries[entries].duration) {
-            ctts_entries[entries].count++; /* compress */
-        } else {
-            entries++;
-            ctts_entries[entries].duration = track->cluster[i].cts;
-            ctts_entries[entries].count = 1;
-        }
-    }
-    entries++; /* last one */
-    atom_size = 16 + (entries * 8);
+    atom_size = 16 + (track->cttsEntries * 8);
     put_be32(pb, atom_size); /* size */
     put_tag(pb, "ctts");
     put_be32(pb, 0); /* version & flags */
-    put_be32(pb, entries); /* entry count */
-    for (i=0; i<entries; i++) {
-        put_be32(pb, ctts_entries[i].count);
-        put_be32(pb, ctts_entries[i].duration);
+    put_be32(pb, track->cttsEntries); /* entry count */
+    mov_index_rewind(track);
+    mov_index_next(track, &e);
+    ctts_entry.count = 1;
+    ctts_entry.duration = e.cts;
+    for (i=1; i<track->entry; i++) {
+        mov_index_next(track, &e);
+        if (e.cts == ctts_entry.duration) {
+            ctts_entry.count++; /* compress */
+        } else {
+            put_be32(pb, ctts_entry.count);
+            put_be32(pb, ctts_entry.duration);
+            ctts_entry.duration = e.cts;
+            ctts_entry.count = 1;
+        }
     }
-    av_free(ctts_entries);
+    put_be32(pb, ctts_entry.count); /* last one */
+    put_be32(pb, ctts_entry.duration);
     return atom_size;
 }
 
@@ -706,6 +935,13 @@ static int mov_write_ctts_tag(ByteIOContext *pb, MOVTrack* track)
 /* Time to sample atom */
 static int mov_write_stts_tag(ByteIOContext *pb, MOVTrack* track)
 {
+    if (!track->sampleCount) { /* fragmented, the samples are in moof atoms */
+        put_be32(pb, 0x10); /* size */
+        put_tag(pb, "stts");
+        put_be32(pb, 0); /* version & flags */
+        put_be32(pb, 0); /* entry count */
+        return 0x10;
+    }
     put_be32(pb, 0x18); /* size */
     put_tag(pb, "stts");
     put_be32(pb, 0); /* version & flags */
@@ -990,7 +1226,7 @@ static int mov_write_mvhd_tag(ByteIOContext *pb, MOVContext *mov)
     int version;
 
     for (i=0; i<mov->nb_streams; i++) {
-        if(mov->tracks[i].entry > 0) {
+        if(mov->tracks[i].entry > 0 || mov->fragments) {
             maxTrackLenTemp = av_rescale_rnd(mov->tracks[i].trackDuration, globalTimescale, mov->tracks[i].timescale, AV_ROUND_UP);
             if(maxTrackLen < maxTrackLenTemp)
                 maxTrackLen = maxTrackLenTemp;
@@ -1290,6 +1526,30 @@ static int mov_write_uuidusmt_tag (ByteIOContext *pb, AVFormatContext *s)
     return size;
 }
 
+static int mov_write_trex_tag(ByteIOContext *pb, MOVTrack *track)
+{
+    put_be32(pb, 0x20); /* size */
+    put_tag(pb, "trex");
+    put_be32(pb, 0); /* version & flags */
+    put_be32(pb, track->trackID); /* track-id */
+    put_be32(pb, 1); /* default sample description index */
+    put_be32(pb, 0); /* default sample duration */
+    put_be32(pb, 0); /* default sample size */
+    put_be32(pb, 0); /* default sample flags */
+    return 0x20;
+}
+
+static int mov_write_mvex_tag(ByteIOContext *pb, MOVContext *mov)
+{
+    int i;
+    offset_t pos = url_ftell(pb);
+    put_be32(pb, 0); /* size */
+    put_tag(pb, "mvex");
+    for (i=0; i<mov->nb_streams; i++)
+        mov_write_trex_tag(pb, &mov->tracks[i]);
+    return updateSize(pb, pos);
+}
+
 static int mov_write_moov_tag(ByteIOContext *pb, MOVContext *mov,
                               AVFormatContext *s)
 {
@@ -1300,7 +1560,7 @@ static int mov_write_moov_tag(ByteIOContext *pb, MOVContext *mov,
     mov->timescale = globalTimescale;
 
     for (i=0; i<mov->nb_streams; i++) {
-        if(mov->tracks[i].entry <= 0) continue;
+        if(mov->tracks[i].entry <= 0 && !mov->fragments) continue;
 
         if(mov->tracks[i].enc->codec_type == CODEC_TYPE_VIDEO) {
             mov->tracks[i].timescale = mov->tracks[i].enc->time_base.den;
@@ -1319,10 +1579,12 @@ static int mov_write_moov_tag(ByteIOContext *pb, MOVContext *mov,
     mov_write_mvhd_tag(pb, mov);
     //mov_write_iods_tag(pb, mov);
     for (i=0; i<mov->nb_streams; i++) {
-        if(mov->tracks[i].entry > 0) {
+        if(mov->tracks[i].entry > 0 || mov->fragments) {
             mov_write_trak_tag(pb, &(mov->tracks[i]));
         }
     }
+    if (mov->fragments)
+        mov_write_mvex_tag(pb, mov);
 
     if (mov->mode == MODE_PSP)
         mov_write_uuidusmt_tag(pb, s);
@@ -1343,6 +1605,259 @@ static int mov_write_mdat_tag(ByteIOContext *pb, MOVContext* mov)
     return 0;
 }
 
+/* Fragmented output: the moov atom written by the header only describes
+ * the tracks, the samples of each GOP are then written as a moof atom
+ * followed by an mdat atom holding the data of one track after the
+ * other. Nothing is seeked back to, so the output can be a pipe, and
+ * only the current fragment is kept in memory. */
+
+static int mov_write_tfhd_tag(ByteIOContext *pb, MOVTrack *track, offset_t moof_pos)
+{
+    int flags = 0x01 | 0x08 | 0x20; /* base data offset, default duration and flags */
+    offset_t pos = url_ftell(pb);
+
+    if (track->sampleSize)
+        flags |= 0x10; /* default size */
+    put_be32(pb, 0); /* size */
+    put_tag(pb, "tfhd");
+    put_be32(pb, flags); /* version & flags */
+    put_be32(pb, track->trackID); /* track-id */
+    put_be64(pb, moof_pos); /* base data offset */
+    put_be32(pb, track->sampleDuration); /* default sample duration */
+    if (track->sampleSize)
+        put_be32(pb, track->sampleSize); /* default sample size */
+    if (track->enc->codec_type == CODEC_TYPE_VIDEO)
+        put_be32(pb, MOV_SAMPLE_NON_SYNC); /* default sample flags */
+    else
+        put_be32(pb, MOV_SAMPLE_SYNC);
+    return updateSize(pb, pos);
+}
+
+static int mov_write_tfdt_tag(ByteIOContext *pb, MOVTrack *track, int samples)
+{
+    put_be32(pb, 20); /* size */
+    put_tag(pb, "tfdt");
+    put_byte(pb, 1); /* version */
+    put_be24(pb, 0); /* flags */
+    put_be64(pb, (int64_t)(track->sampleCount - samples) * track->sampleDuration); /* base media decode time */
+    return 20;
+}
+
+static int mov_write_trun_tag(ByteIOContext *pb, MOVTrack *track, int samples, int data_offset)
+{
+    MOVIentry e;
+    int flags = 0x01; /* data offset */
+    int i;
+    offset_t pos = url_ftell(pb);
+
+    if (!track->sampleSize)
+        flags |= 0x200; /* sample size */
+    if (track->enc->codec_type == CODEC_TYPE_VIDEO)
+        flags |= 0x400; /* sample flags */
+    if (track->hasCts)
+        flags |= 0x800; /* sample composition time offset */
+
+    put_be32(pb, 0); /* size */
+    put_tag(pb, "trun");
+    put_be32(pb, flags); /* version & flags */
+    put_be32(pb, samples); /* sample count */
+    put_be32(pb, data_offset); /* data offset */
+    if (!track->sampleSize) { /* one sample per packet */
+        mov_index_rewind(track);
+        for (i=0; i<track->entry; i++) {
+            mov_index_next(track, &e);
+            put_be32(pb, e.size);
+            if (flags & 0x400)
+                put_be32(pb, e.key_frame ? MOV_SAMPLE_SYNC : MOV_SAMPLE_NON_SYNC);
+            if (flags & 0x800)
+                put_be32(pb, e.cts);
+        }
+    }
+    return updateSize(pb, pos);
+}
+
+static int mov_write_traf_tag(ByteIOContext *pb, MOVTrack *track,
+                              offset_t moof_pos, int data_offset)
+{
+    int samples = track->entrySamples;
+    offset_t pos = url_ftell(pb);
+
+    put_be32(pb, 0); /* size */
+    put_tag(pb, "traf");
+    mov_write_tfhd_tag(pb, track, moof_pos);
+    mov_write_tfdt_tag(pb, track, samples);
+    mov_write_trun_tag(pb, track, samples, data_offset);
+    return updateSize(pb, pos);
+}
+
+static int mov_write_moof_tag(ByteIOContext *pb, MOVContext *mov,
+                              offset_t moof_pos, int moof_size)
+{
+    int i, data_offset = moof_size + 8; /* after the mdat header */
+    offset_t pos = url_ftell(pb);
+
+    put_be32(pb, 0); /* size */
+    put_tag(pb, "moof");
+    put_be32(pb, 16); /* size */
+    put_tag(pb, "mfhd");
+    put_be32(pb, 0); /* version & flags */
+    put_be32(pb, mov->fragmentSeq); /* sequence number */
+    for (i=0; i<mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+
+        if (!track->entry)
+            continue;
+        mov_write_traf_tag(pb, track, moof_pos, data_offset);
+        data_offset += track->fragSize;
+    }
+    return updateSize(pb, pos);
+}
+
+/* write the atoms through a dynamic buffer so that sizes can be updated
+   without seeking in the output */
+static int mov_write_buffered(ByteIOContext *pb, ByteIOContext *dyn)
+{
+    uint8_t *buf;
+    int size = url_close_dyn_buf(dyn, &buf);
+
+    put_buffer(pb, buf, size);
+    av_free(buf);
+    return size;
+}
+
+static int mov_flush_fragment(AVFormatContext *s)
+{
+    MOVContext *mov = s->priv_data;
+    ByteIOContext *pb = &s->pb;
+    ByteIOContext moof;
+    offset_t moof_pos = url_ftell(pb);
+    uint8_t *buf;
+    int i, moof_size, mdat_size = 0;
+
+    for (i=0; i<mov->nb_streams; i++)
+        mdat_size += mov->tracks[i].fragSize;
+    if (!mdat_size)
+        return 0;
+    mov->fragmentSeq++;
+
+    /* the data offsets depend on the size of the moof atom */
+    if (url_open_dyn_buf(&moof) < 0)
+        return -1;
+    mov_write_moof_tag(&moof, mov, moof_pos, 0);
+    moof_size = url_close_dyn_buf(&moof, &buf);
+    av_free(buf);
+    if (url_open_dyn_buf(&moof) < 0)
+        return -1;
+    mov_write_moof_tag(&moof, mov, moof_pos, moof_size);
+    mov_write_buffered(pb, &moof);
+
+    put_be32(pb, mdat_size + 8); /* size */
+    put_tag(pb, "mdat");
+    for (i=0; i<mov->nb_streams; i++) {
+        MOVTrack *track = &mov->tracks[i];
+
+        if (!track->entry)
+            continue;
+        mov_write_buffered(pb, &track->fragData);
+        mov_index_reset(track);
+        track->fragSize = 0;
+    }
+    put_flush_packet(pb);
+    return 0;
+}
+
+/* a fragment is ended by a key frame of the reference track, audio only
+   files are cut about every second */
+static int mov_fragment_full(MOVContext *mov)
+{
+    MOVTrack *track = &mov->tracks[mov->refTrack];
+
+    if (!track->entry)
+        return 0;
+    if (track->enc->codec_type == CODEC_TYPE_VIDEO)
+        return 1;
+    return track->entrySamples * track->sampleDuration >= track->timescale;
+}
+
+/**
+ * Write the moov atom before the mdat atom. The data is moved forward in
+ * place, starting from the end of the file, by the size of the moov atom
+ * and the chunk offsets are patched accordingly, so that no separate
+ * qt-faststart pass is needed.
+ *
+ * @return -1 if the output cannot be read back, the moov atom must then
+ *         be written at the end, AVERROR_IO if moving the data failed
+ */
+static int mov_write_moov_faststart(AVFormatContext *s, offset_t data_start, offset_t data_end)
+{
+    MOVContext *mov = s->priv_data;
+    ByteIOContext *pb = &s->pb;
+    ByteIOContext moov;
+    URLContext *in, *out = url_fileno(pb);
+    uint8_t *moov_buf = NULL, *buf;
+    offset_t pos;
+    int i, len, ret, moov_size, shift = 0;
+
+    if (url_is_streamed(pb) || url_open(&in, s->filename, URL_RDONLY) < 0) {
+        av_log(s, AV_LOG_INFO, "cannot read back %s for faststart, writing moov at the end\n", s->filename);
+        return -1;
+    }
+    buf = av_malloc(MOV_FASTSTART_BUFFER_SIZE);
+    if (!buf)
+        goto fail;
+
+    /* the size of the moov atom depends on whether the shifted chunk
+       offsets need 64 bits, iterate until it is stable */
+    for (;;) {
+        if (url_open_dyn_buf(&moov) < 0)
+            goto fail;
+        mov_write_moov_tag(&moov, mov, s);
+        av_free(moov_buf);
+        moov_size = url_close_dyn_buf(&moov, &moov_buf);
+        if (moov_size == shift)
+            break;
+        for (i=0; i<mov->nb_streams; i++)
+            mov->tracks[i].posShift = moov_size;
+        shift = moov_size;
+    }
+
+    put_flush_packet(pb);
+    pos = data_end;
+    while (pos > data_start) {
+        len = FFMIN(pos - data_start, MOV_FASTSTART_BUFFER_SIZE);
+        pos -= len;
+        if (url_seek(in, pos, SEEK_SET) != pos)
+            goto fail_move;
+        for (i = 0; i < len; i += ret) {
+            ret = url_read(in, buf + i, len - i);
+            if (ret <= 0)
+                goto fail_move;
+        }
+        if (url_seek(out, pos + shift, SEEK_SET) != pos + shift ||
+            url_write(out, buf, len) != len)
+            goto fail_move;
+    }
+    if (url_seek(out, data_start, SEEK_SET) != data_start ||
+        url_write(out, moov_buf, moov_size) != moov_size)
+        goto fail_move;
+
+    ret = 0;
+ end:
+    av_free(moov_buf);
+    av_free(buf);
+    url_close(in);
+    return ret;
+ fail_move:
+    av_log(s, AV_LOG_ERROR, "faststart: moving the data of %s failed\n", s->filename);
+    ret = AVERROR_IO;
+    goto end;
+ fail:
+    for (i=0; i<mov->nb_streams; i++)
+        mov->tracks[i].posShift = 0;
+    ret = -1;
+    goto end;
+}
+
 /* TODO: This needs to be more general */
 static void mov_write_ftyp_tag (ByteIOContext *pb, AVFormatContext *s)
 {
@@ -1462,11 +1977,15 @@ static int mov_write_header(AVFormatContext *s)
         }
     }
 
+    mov->fragments = !!(s->flags & AVFMT_FLAG_FRAGMENT);
+    mov->refTrack = 0;
+
     for(i=0; i<s->nb_streams; i++){
         AVStream *st= s->streams[i];
         MOVTrack *track= &mov->tracks[i];
 
         track->enc = st->codec;
+        mov_index_reset(track);
         track->language = ff_mov_iso639_to_lang(st->language, mov->mode != MODE_MOV);
         track->mode = mov->mode;
         if(st->codec->codec_type == CODEC_TYPE_VIDEO){
@@ -1477,12 +1996,33 @@ static int mov_write_header(AVFormatContext *s)
             av_set_pts_info(st, 64, 1, st->codec->sample_rate);
             track->sampleSize = (av_get_bits_per_sample(st->codec->codec_id) >> 3) * st->codec->channels;
         }
+        if (st->codec->codec_type == CODEC_TYPE_VIDEO &&
+            s->streams[mov->refTrack]->codec->codec_type != CODEC_TYPE_VIDEO)
+            mov->refTrack = i;
     }
 
-    mov_write_mdat_tag(pb, mov);
     mov->time = s->timestamp + 0x7C25B080; //1970 based -> 1904 based
     mov->nb_streams = s->nb_streams;
 
+    if (mov->fragments) {
+        ByteIOContext moov;
+
+        /* the sample descriptions need the extradata now */
+        for(i=0; i<s->nb_streams; i++){
+            MOVTrack *track= &mov->tracks[i];
+            if (track->enc->extradata_size > 0) {
+                track->vosLen = track->enc->extradata_size;
+                track->vosData = av_malloc(track->vosLen);
+                memcpy(track->vosData, track->enc->extradata, track->vosLen);
+            }
+        }
+        if (url_open_dyn_buf(&moov) < 0)
+            return -1;
+        mov_write_moov_tag(&moov, mov, s);
+        mov_write_buffered(pb, &moov);
+    } else
+        mov_write_mdat_tag(pb, mov);
+
     put_flush_packet(pb);
 
     return 0;
@@ -1494,10 +2034,11 @@ static int mov_write_packet(AVFormatContext *s, AVPacket *pkt)
     ByteIOContext *pb = &s->pb;
     MOVTrack *trk = &mov->tracks[pkt->stream_index];
     AVCodecContext *enc = trk->enc;
+    MOVIentry e;
     unsigned int samplesInChunk = 0;
     int size= pkt->size;
 
-    if (url_is_streamed(&s->pb)) return 0; /* Can't handle that */
+    if (url_is_streamed(&s->pb) && !mov->fragments) return 0; /* Can't handle that */
     if (!size) return 0; /* Discard 0 sized packets */
 
     if (enc->codec_id == CODEC_ID_AMR_NB) {
@@ -1534,24 +2075,31 @@ static int mov_write_packet(AVFormatContext *s, AVPacket *pkt)
         size = pkt->size;
     }
 
-    if (!(trk->entry % MOV_INDEX_CLUSTER_SIZE)) {
-        trk->cluster = av_realloc(trk->cluster, (trk->entry + MOV_INDEX_CLUSTER_SIZE) * sizeof(*trk->cluster));
-        if (!trk->cluster)
+    if (mov->fragments) {
+        if (pkt->stream_index == mov->refTrack && (pkt->flags & PKT_FLAG_KEY) &&
+            mov_fragment_full(mov) && mov_flush_fragment(s) < 0)
+            return -1;
+        if (!trk->entry && url_open_dyn_buf(&trk->fragData) < 0)
             return -1;
+        pb = &trk->fragData;
+        trk->fragSize += size;
     }
 
-    trk->cluster[trk->entry].pos = url_ftell(pb);
-    trk->cluster[trk->entry].samplesInChunk = samplesInChunk;
-    trk->cluster[trk->entry].size = size;
-    trk->cluster[trk->entry].entries = samplesInChunk;
+    memset(&e, 0, sizeof(e));
+    e.pos = url_ftell(pb);
+    e.samplesInChunk = samplesInChunk;
+    e.size = size;
+    e.entries = samplesInChunk;
     if(enc->codec_type == CODEC_TYPE_VIDEO) {
         if (pkt->dts != pkt->pts)
             trk->hasBframes = 1;
-        trk->cluster[trk->entry].cts = pkt->pts - pkt->dts;
-        trk->cluster[trk->entry].key_frame = !!(pkt->flags & PKT_FLAG_KEY);
-        if(trk->cluster[trk->entry].key_frame)
+        e.cts = pkt->pts - pkt->dts;
+        e.key_frame = !!(pkt->flags & PKT_FLAG_KEY);
+        if(e.key_frame)
             trk->hasKeyframes++;
     }
+    if (mov_index_add(trk, &e) < 0)
+        return -1;
     trk->entry++;
     trk->sampleCount += samplesInChunk;
     mov->mdat_size += size;
@@ -1571,6 +2119,11 @@ static int mov_write_trailer(AVFormatContext *s)
 
     offset_t moov_pos = url_ftell(pb);
 
+    if (mov->fragments) {
+        res = mov_flush_fragment(s);
+        goto end;
+    }
+
     /* Write size of mdat tag */
     if (mov->mdat_size+8 <= UINT32_MAX) {
         url_fseek(pb, mov->mdat_pos, SEEK_SET);
@@ -1584,10 +2137,16 @@ static int mov_write_trailer(AVFormatContext *s)
     }
     url_fseek(pb, moov_pos, SEEK_SET);
 
-    mov_write_moov_tag(pb, mov, s);
+    if (s->flags & AVFMT_FLAG_FASTSTART)
+        res = mov_write_moov_faststart(s, mov->mdat_pos - 8, moov_pos);
+    if (!(s->flags & AVFMT_FLAG_FASTSTART) || res == -1) {
+        mov_write_moov_tag(pb, mov, s);
+        res = 0;
+    }
 
+ end:
     for (i=0; i<mov->nb_streams; i++) {
-        av_freep(&mov->tracks[i].cluster);
+        mov_index_free(&mov->tracks[i]);
 
         if( mov->tracks[i].vosLen ) av_free( mov->tracks[i].vosData );
 
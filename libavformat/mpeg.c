@@ -74,6 +74,8 @@ typedef struct {
 #define PACK_START_CODE             ((unsigned int)0x000001ba)
 #define SYSTEM_HEADER_START_CODE    ((unsigned int)0x000001bb)
 #define SEQUENCE_END_CODE           ((unsigned int)0x000001b7)
+#define SEQUENCE_START_CODE         ((unsigned int)0x000001b3)
+#define GOP_START_CODE              ((unsigned int)0x000001b8)
 #define PACKET_START_CODE_MASK      ((unsigned int)0xffffff00)
 #define PACKET_START_CODE_PREFIX    ((unsigned int)0x00000100)
 #define ISO_11172_END_CODE          ((unsigned int)0x000001b9)
@@ -1288,9 +1290,20 @@ static int mpegps_probe(AVProbeData *p)
 }
 
 
+typedef struct PSScrEntry {
+    int64_t pos; /* position of the pack header */
+    int64_t scr; /* system clock reference of the pack, 90kHz */
+} PSScrEntry;
+
 typedef struct MpegDemuxContext {
     int header_state;
     unsigned char psm_es_type[256];
+    /* pack positions and SCRs learned while seeking, sorted by position */
+    PSScrEntry *scr_index;
+    int nb_scr_index;
+    unsigned int scr_index_size;
+    int64_t scr_index_file_size; /* file size when the last pack was found */
+    int scr_broken; /* SCR not usable for seeking (missing or discontinuous) */
 } MpegDemuxContext;
 
 static int mpegps_read_header(AVFormatContext *s,
@@ -1677,6 +1690,9 @@ static int mpegps_read_packet(AVFormatContext *s,
 
 static int mpegps_read_close(AVFormatContext *s)
 {
+    MpegDemuxContext *m = s->priv_data;
+
+    av_freep(&m->scr_index);
     return 0;
 }
 
@@ -1712,6 +1728,321 @@ static int64_t mpegps_read_dts(AVFormatContext *s, int stream_index,
     return dts;
 }
 
+/* Seeking: the target is bracketed by interpolating between pack SCRs,
+   which are present every few kilobytes and do not depend on the stream,
+   then the PES headers are scanned from shortly before the target to the
+   wanted frame. The packs found on the way are remembered, so repeated
+   seeks in the same file converge in a few reads. */
+
+#define PS_SEEK_WINDOW      (128*1024)    ///< scan linearly once the SCR bracket is this small
+#define PS_SEEK_PREROLL     90000         ///< the SCR of a pack precedes the DTS of its payload
+#define PS_SEEK_MAX_PREROLL (16*90000)    ///< give up looking further back for a keyframe
+#define PS_SEEK_MAX_SCAN    (8*1024*1024) ///< maximum size of a linear scan
+
+/**
+ * Read the SCR of the first pack header at or after *ppos.
+ * @return the SCR, with the pack position in *ppos, or AV_NOPTS_VALUE
+ */
+static int64_t mpegps_read_scr(AVFormatContext *s, int64_t *ppos, int max_size)
+{
+    ByteIOContext *pb = &s->pb;
+    uint32_t state = 0xff;
+    int size = max_size, startcode, c, b1, b2, b3, b4;
+
+    url_fseek(pb, *ppos, SEEK_SET);
+    do {
+        startcode = find_next_start_code(pb, &size, &state);
+        if (startcode < 0)
+            return AV_NOPTS_VALUE;
+    } while (startcode != PACK_START_CODE);
+    *ppos = url_ftell(pb) - 4;
+
+    c = get_byte(pb);
+    if ((c & 0xc0) == 0x40) {
+        /* MPEG2 pack header */
+        b1 = get_byte(pb);
+        b2 = get_byte(pb);
+        b3 = get_byte(pb);
+        b4 = get_byte(pb);
+        return ((int64_t)((c >> 3) & 7) << 30) | ((c & 3) << 28) | (b1 << 20) |
+               (((b2 >> 3) & 0x1f) << 15) | ((b2 & 3) << 13) | (b3 << 5) | (b4 >> 3);
+    } else if ((c & 0xf0) == 0x20) {
+        /* MPEG1 pack header, coded like a PTS */
+        return get_pts(pb, c);
+    }
+    return AV_NOPTS_VALUE;
+}
+
+/**
+ * Add a pack to the SCR index.
+ * @return < 0 if it contradicts the known packs (SCR discontinuity)
+ */
+static int mpegps_add_scr(MpegDemuxContext *m, int64_t pos, int64_t scr)
+{
+    PSScrEntry *entries;
+    int a = -1, b = m->nb_scr_index, mid;
+
+    while (b - a > 1) {
+        mid = (a + b) >> 1;
+        if (m->scr_index[mid].pos <= pos)
+            a = mid;
+        else
+            b = mid;
+    }
+    if (a >= 0 && m->scr_index[a].pos == pos)
+        return 0;
+    if ((a >= 0 && m->scr_index[a].scr > scr) ||
+        (b < m->nb_scr_index && m->scr_index[b].scr < scr))
+        return -1;
+
+    entries = av_fast_realloc(m->scr_index, &m->scr_index_size,
+                              (m->nb_scr_index + 1) * sizeof(PSScrEntry));
+    if (!entries)
+        return -1;
+    m->scr_index = entries;
+    memmove(entries + b + 1, entries + b, (m->nb_scr_index - b) * sizeof(PSScrEntry));
+    entries[b].pos = pos;
+    entries[b].scr = scr;
+    m->nb_scr_index++;
+    return 0;
+}
+
+/**
+ * Make sure the first and last packs of the file are in the SCR index.
+ */
+static int mpegps_scr_bounds(AVFormatContext *s)
+{
+    MpegDemuxContext *m = s->priv_data;
+    int64_t file_size, start, pos, scr, last_pos, last_scr;
+
+    file_size = url_fsize(&s->pb);
+    if (file_size <= 0)
+        return -1;
+    if (m->nb_scr_index && file_size == m->scr_index_file_size)
+        return 0;
+
+    if (!m->nb_scr_index) {
+        pos = s->data_offset;
+        scr = mpegps_read_scr(s, &pos, MAX_SYNC_SIZE);
+        if (scr == AV_NOPTS_VALUE || mpegps_add_scr(m, pos, scr) < 0)
+            return -1;
+    }
+
+    last_pos = -1;
+    last_scr = AV_NOPTS_VALUE;
+    for (start = file_size; last_scr == AV_NOPTS_VALUE && start > 0 &&
+                            file_size - start < MAX_SYNC_SIZE; ) {
+        start = FFMAX(start - 65536, 0);
+        pos = start;
+        while ((scr = mpegps_read_scr(s, &pos, file_size - pos)) != AV_NOPTS_VALUE) {
+            last_pos = pos;
+            last_scr = scr;
+            pos += 4;
+        }
+    }
+    if (last_scr == AV_NOPTS_VALUE || mpegps_add_scr(m, last_pos, last_scr) < 0)
+        return -1;
+    m->scr_index_file_size = file_size;
+    return 0;
+}
+
+/**
+ * Find the position of a pack with an SCR a little below target_scr.
+ * @return the position, or < 0 on SCR discontinuity
+ */
+static int64_t mpegps_find_scr_pos(AVFormatContext *s, int64_t target_scr)
+{
+    MpegDemuxContext *m = s->priv_data;
+    PSScrEntry *lo, *hi;
+    int64_t pos, scr, step;
+    int a, b, mid, i;
+
+    if (target_scr < m->scr_index[0].scr)
+        return s->data_offset;
+
+    for (i = 0; ; i++) {
+        a = -1;
+        b = m->nb_scr_index;
+        while (b - a > 1) {
+            mid = (a + b) >> 1;
+            if (m->scr_index[mid].scr <= target_scr)
+                a = mid;
+            else
+                b = mid;
+        }
+        lo = &m->scr_index[a];
+        if (b == m->nb_scr_index)
+            return lo->pos;
+        hi = &m->scr_index[b];
+        if (hi->pos - lo->pos <= PS_SEEK_WINDOW || i >= 64)
+            return lo->pos;
+
+        /* interpolate, but always cut at least 1/16 of the bracket */
+        step = (hi->pos - lo->pos) >> 4;
+        pos = lo->pos + av_rescale(target_scr - lo->scr, hi->pos - lo->pos, hi->scr - lo->scr);
+        pos = FFMAX(pos, lo->pos + step);
+        pos = FFMIN(pos, hi->pos - step);
+        scr = mpegps_read_scr(s, &pos, MAX_SYNC_SIZE);
+        if (scr == AV_NOPTS_VALUE || pos >= hi->pos)
+            return lo->pos;
+        if (mpegps_add_scr(m, pos, scr) < 0)
+            return -1;
+    }
+}
+
+/**
+ * Check whether a video PES payload contains a sequence or GOP header.
+ * The payload is consumed.
+ */
+static int mpegps_pes_is_keyframe(ByteIOContext *pb, int len)
+{
+    uint8_t buf[2048 + 3], *p, *end;
+    int n, keep = 0;
+
+    while (len > 0) {
+        n = get_buffer(pb, buf + keep, FFMIN(len, 2048));
+        if (n <= 0)
+            break;
+        len -= n;
+        p = buf;
+        end = buf + keep + n;
+        while (p + 3 < end) {
+            if (p[2] > 1)
+                p += 3;
+            else if (p[1])
+                p += 2;
+            else if (p[0] || p[2] != 1)
+                p++;
+            else if ((PACKET_START_CODE_PREFIX | p[3]) == SEQUENCE_START_CODE ||
+                     (PACKET_START_CODE_PREFIX | p[3]) == GOP_START_CODE) {
+                url_fskip(pb, len);
+                return 1;
+            } else
+                p += 3;
+        }
+        /* keep a possibly truncated start code for the next chunk */
+        keep = end - p;
+        memmove(buf, p, keep);
+    }
+    return 0;
+}
+
+/**
+ * Scan the PES headers from pos for the packet of st to seek to.
+ * @return 1 if a keyframe was found, 0 if only another frame was found,
+ *         -1 if none
+ */
+static int mpegps_seek_scan(AVFormatContext *s, AVStream *st, int64_t pos,
+                            int64_t timestamp, int flags, int keyframe_only,
+                            int64_t *ppos, int64_t *pts)
+{
+    int64_t end = pos + PS_SEEK_MAX_SCAN, pes_pos, pes_pts, dts;
+    int64_t last_dts = AV_NOPTS_VALUE, key_pos = -1;
+    int len, startcode, key, found = -1;
+
+    url_fseek(&s->pb, pos, SEEK_SET);
+    while (url_ftell(&s->pb) < end) {
+        len = mpegps_read_pes_header(s, &pes_pos, &startcode, &pes_pts, &dts);
+        if (len < 0)
+            break;
+        if (startcode != st->id) {
+            url_fskip(&s->pb, len);
+            continue;
+        }
+        if (dts == AV_NOPTS_VALUE) {
+            /* a keyframe may start in a PES without timestamp, its time
+               lies between the surrounding timestamps */
+            if (keyframe_only && last_dts != AV_NOPTS_VALUE &&
+                mpegps_pes_is_keyframe(&s->pb, len))
+                key_pos = pes_pos;
+            else
+                url_fskip(&s->pb, len);
+            continue;
+        }
+        if ((flags & AVSEEK_FLAG_BACKWARD) && dts > timestamp)
+            break;
+        if (key_pos >= 0) {
+            if ((flags & AVSEEK_FLAG_BACKWARD) || last_dts >= timestamp) {
+                *ppos = key_pos;
+                *pts = last_dts;
+                found = 1;
+                if (!(flags & AVSEEK_FLAG_BACKWARD))
+                    break;
+            }
+            key_pos = -1;
+        }
+        last_dts = dts;
+        if (keyframe_only)
+            key = mpegps_pes_is_keyframe(&s->pb, len);
+        else {
+            key = 1;
+            url_fskip(&s->pb, len);
+        }
+        if (flags & AVSEEK_FLAG_BACKWARD) {
+            if (key || found <= 0) {
+                *ppos = pes_pos;
+                *pts = dts;
+                found = key;
+            }
+        } else if (dts >= timestamp) {
+            if (key || found < 0) {
+                *ppos = pes_pos;
+                *pts = dts;
+                found = key;
+            }
+            if (key)
+                break;
+        }
+    }
+    return found;
+}
+
+static int mpegps_read_seek(AVFormatContext *s, int stream_index,
+                            int64_t timestamp, int flags)
+{
+    MpegDemuxContext *m = s->priv_data;
+    AVStream *st = s->streams[stream_index];
+    int64_t margin, pos, pes_pos = 0, pts = 0;
+    int index, keyframe_only, found;
+
+    if (m->scr_broken || s->pb.is_streamed)
+        return -1;
+    if (mpegps_scr_bounds(s) < 0) {
+        /* no usable packs, let av_seek_frame_binary() handle it */
+        m->scr_broken = 1;
+        return -1;
+    }
+    keyframe_only = !(flags & AVSEEK_FLAG_ANY) &&
+                    (st->codec->codec_id == CODEC_ID_MPEG1VIDEO ||
+                     st->codec->codec_id == CODEC_ID_MPEG2VIDEO);
+
+    for (margin = PS_SEEK_PREROLL; ; margin <<= 1) {
+        pos = mpegps_find_scr_pos(s, timestamp - margin);
+        if (pos < 0) {
+            m->scr_broken = 1;
+            return -1;
+        }
+        /* the packets already seen may give a closer starting point */
+        index = av_index_search_timestamp(st, timestamp - margin,
+                                          AVSEEK_FLAG_BACKWARD | AVSEEK_FLAG_ANY);
+        if (index >= 0 && st->index_entries[index].pos > pos)
+            pos = st->index_entries[index].pos;
+
+        found = mpegps_seek_scan(s, st, pos, timestamp, flags, keyframe_only,
+                                 &pes_pos, &pts);
+        if (found > 0 || !(flags & AVSEEK_FLAG_BACKWARD) ||
+            pos <= s->data_offset || margin >= PS_SEEK_MAX_PREROLL)
+            break;
+    }
+    if (found < 0)
+        return -1;
+
+    url_fseek(&s->pb, pes_pos, SEEK_SET);
+    m->header_state = 0xff;
+    av_update_cur_dts(s, st, pts);
+    return 0;
+}
+
 #ifdef CONFIG_MPEG1SYSTEM_MUXER
 AVOutputFormat mpeg1system_muxer = {
     "mpeg",
@@ -1796,7 +2127,7 @@ AVInputFormat mpegps_demuxer = {
     mpegps_read_header,
     mpegps_read_packet,
     mpegps_read_close,
-    NULL, //mpegps_read_seek,
+    mpegps_read_seek,
     mpegps_read_dts,
     .flags = AVFMT_SHOW_IDS,
 };
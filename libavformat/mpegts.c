@@ -980,6 +980,18 @@ static void handle_packet(MpegTSContext *ts, const uint8_t *packet)
     if (!tss)
         return;
 
+    if (tss->type == MPEGTS_PES) {
+        PESContext *pes = tss->u.pes_filter.opaque;
+
+        /* drop the packets of unwanted streams before any parsing. The
+           PES is resynchronized on the next start if the stream is
+           wanted again */
+        if (pes->st && pes->st->discard >= AVDISCARD_ALL) {
+            pes->state = MPEGTS_SKIP;
+            return;
+        }
+    }
+
     /* continuity check (currently not used) */
     cc = (packet[3] & 0xf);
     cc_ok = (tss->last_cc < 0) || ((((tss->last_cc + 1) & 0x0f) == cc));
@@ -1051,12 +1063,22 @@ static int mpegts_resync(ByteIOContext *pb)
     return -1;
 }
 
-/* return -1 if error or EOF. Return 0 if OK. */
-static int read_packet(ByteIOContext *pb, uint8_t *buf, int raw_packet_size)
+/* return -1 if error or EOF. Return 0 if OK. *data is set to the
+   packet, which is taken directly from the I/O buffer when it is
+   entirely there, and copied in buf otherwise. */
+static int read_packet(ByteIOContext *pb, uint8_t *buf, int raw_packet_size,
+                       const uint8_t **data)
 {
     int skip, len;
 
     for(;;) {
+        if (pb->buf_end - pb->buf_ptr >= raw_packet_size &&
+            pb->buf_ptr[0] == 0x47) {
+            *data = pb->buf_ptr;
+            pb->buf_ptr += raw_packet_size;
+            break;
+        }
+        *data = buf;
         len = get_buffer(pb, buf, TS_PACKET_SIZE);
         if (len != TS_PACKET_SIZE)
             return AVERROR_IO;
@@ -1083,6 +1105,7 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
     AVFormatContext *s = ts->stream;
     ByteIOContext *pb = &s->pb;
     uint8_t packet[TS_PACKET_SIZE];
+    const uint8_t *data;
     int packet_num, ret;
 
     ts->stop_parse = 0;
@@ -1093,10 +1116,10 @@ static int handle_packets(MpegTSContext *ts, int nb_packets)
         packet_num++;
         if (nb_packets != 0 && packet_num >= nb_packets)
             break;
-        ret = read_packet(pb, packet, ts->raw_packet_size);
+        ret = read_packet(pb, packet, ts->raw_packet_size, &data);
         if (ret != 0)
             return ret;
-        handle_packet(ts, packet);
+        handle_packet(ts, data);
     }
     return 0;
 }
@@ -1265,7 +1288,8 @@ goto_auto_guess:
         int pcr_pid, pid, nb_packets, nb_pcrs, ret, pcr_l;
         int64_t pcrs[2], pcr_h;
         int packet_count[2];
-        uint8_t packet[TS_PACKET_SIZE];
+        uint8_t packet_buf[TS_PACKET_SIZE];
+        const uint8_t *packet;
 
         /* only read packets */
 
@@ -1282,7 +1306,7 @@ goto_auto_guess:
         nb_pcrs = 0;
         nb_packets = 0;
         for(;;) {
-            ret = read_packet(&s->pb, packet, ts->raw_packet_size);
+            ret = read_packet(&s->pb, packet_buf, ts->raw_packet_size, &packet);
             if (ret < 0)
                 return -1;
             pid = ((packet[1] & 0x1f) << 8) | packet[2];
@@ -1328,15 +1352,18 @@ static int mpegts_raw_read_packet(AVFormatContext *s,
     int64_t pcr_h, next_pcr_h, pos;
     int pcr_l, next_pcr_l;
     uint8_t pcr_buf[12];
+    const uint8_t *data;
 
     if (av_new_packet(pkt, TS_PACKET_SIZE) < 0)
         return -ENOMEM;
     pkt->pos= url_ftell(&s->pb);
-    ret = read_packet(&s->pb, pkt->data, ts->raw_packet_size);
+    ret = read_packet(&s->pb, pkt->data, ts->raw_packet_size, &data);
     if (ret < 0) {
         av_free_packet(pkt);
         return ret;
     }
+    if (data != pkt->data)
+        memcpy(pkt->data, data, TS_PACKET_SIZE);
     if (ts->mpeg2ts_compute_pcr) {
         /* compute exact PCR for each packet */
         if (parse_pcr(&pcr_h, &pcr_l, pkt->data) == 0) {
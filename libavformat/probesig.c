@@ -0,0 +1,233 @@
+/*
+ * Input format probing by signature
+ * Copyright (c) 2006 The ffmpeg Project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include "avformat.h"
+
+/*
+ * Most demuxers recognize their files by a few magic bytes at a fixed
+ * offset. Those signatures are kept in one prefix trie per offset, so
+ * that av_probe_input_format() only has to call the read_probe()
+ * function of the demuxers whose signature matches the probe data.
+ *
+ * A signature only selects candidates: the candidate is used if its
+ * read_probe() returns AVPROBE_SCORE_MAX or more, otherwise all the
+ * demuxers are probed as before. Signatures must therefore only be
+ * declared for magic bytes that no other demuxer would fully accept.
+ */
+
+#define MAX_SIGNATURE_SIZE 24
+
+typedef struct ProbeSignature {
+    const char *format;              ///< demuxer name
+    int offset;
+    int size;
+    uint8_t magic[MAX_SIGNATURE_SIZE];
+} ProbeSignature;
+
+static const ProbeSignature probe_signatures[] = {
+    { "4xm",          8,  4, "4XMV" },
+    { "aiff",         8,  4, "AIFF" },
+    { "aiff",         8,  4, "AIFC" },
+    { "amr",          0,  5, "#!AMR" },
+    { "asf",          0,  8, "\x30\x26\xB2\x75\x8E\x66\xCF\x11" },
+    { "au",           0,  4, ".snd" },
+    { "avi",          8,  4, "AVI " },
+    { "ea",           0,  4, "SCHl" },
+    { "ffm",          0,  4, "FFM1" },
+    { "film_cpk",     0,  4, "FILM" },
+    { "gxf",          0,  6, "\x00\x00\x00\x00\x01\xBC" },
+    { "ipmovie",      0, 20, "Interplay MVE File\x1A\x00" },
+    { "matroska",     0,  4, "\x1A\x45\xDF\xA3" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "moov" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "mdat" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "ftyp" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "pnot" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "udta" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "skip" },
+    { "mov,mp4,m4a,3gp,3g2,mj2", 4, 4, "uuid" },
+    { "mp3",          0,  3, "ID3" },
+    { "mxf",          0,  4, "\x06\x0E\x2B\x34" },
+    { "nsv",          0,  4, "NSVf" },
+    { "nsv",          0,  4, "NSVs" },
+    { "nut",          0, 24, "nut/multimedia container" },
+    { "nuv",          0, 11, "NuppelVideo" },
+    { "nuv",          0, 11, "MythTVVideo" },
+    { "ogg",          0,  4, "OggS" },
+    { "rm",           0,  4, ".RMF" },
+    { "rm",           0,  4, ".ra\xFD" },
+    { "RoQ",          0,  6, "\x84\x10\xFF\xFF\xFF\xFF" },
+    { "smk",          0,  4, "SMK2" },
+    { "smk",          0,  4, "SMK4" },
+    { "sol",          2,  4, "SOL\x00" },
+    { "voc",          0, 20, "Creative Voice File\x1A" },
+    { "wav",          8,  4, "WAVE" },
+    { "wc3movie",     8,  4, "MOVE" },
+    { "yuv4mpegpipe", 0,  9, "YUV4MPEG2" },
+};
+
+typedef struct ProbeMatch {
+    AVInputFormat *fmt;
+    int order;                       ///< registration order, breaks ties like the full probe
+    struct ProbeMatch *next;
+} ProbeMatch;
+
+typedef struct ProbeNode {
+    uint8_t byte;
+    struct ProbeNode *child;
+    struct ProbeNode *next;          ///< next node with the same parent
+    ProbeMatch *matches;             ///< formats whose signature ends here
+} ProbeNode;
+
+typedef struct ProbeTrie {
+    int offset;
+    ProbeNode *children;
+    struct ProbeTrie *next;
+} ProbeTrie;
+
+/* the tries are filled as the formats are registered and, like the list
+   of registered formats, live as long as the process: they are never
+   freed */
+static ProbeTrie *probe_tries;
+static int probe_formats;
+
+static ProbeNode *probe_node_find(ProbeNode *node, uint8_t byte)
+{
+    for(; node; node = node->next)
+        if (node->byte == byte)
+            return node;
+    return NULL;
+}
+
+/**
+ * Declare that files of the given input format start with size magic
+ * bytes at offset. Only the formats registered with
+ * av_register_input_format() are probed.
+ *
+ * @return 0 if OK, < 0 if an error occured
+ */
+int av_register_probe_signature(AVInputFormat *fmt, int offset, const uint8_t *magic, int size)
+{
+    ProbeTrie *trie;
+    ProbeNode **children, *node = NULL;
+    ProbeMatch *match, **pmatch;
+    int i;
+
+    if (offset < 0 || size <= 0)
+        return -1;
+
+    for(trie = probe_tries; trie; trie = trie->next)
+        if (trie->offset == offset)
+            break;
+    if (!trie) {
+        trie = av_mallocz(sizeof(ProbeTrie));
+        if (!trie)
+            return AVERROR_NOMEM;
+        trie->offset = offset;
+        trie->next = probe_tries;
+        probe_tries = trie;
+    }
+
+    children = &trie->children;
+    for(i = 0; i < size; i++) {
+        node = probe_node_find(*children, magic[i]);
+        if (!node) {
+            node = av_mallocz(sizeof(ProbeNode));
+            if (!node)
+                return AVERROR_NOMEM;
+            node->byte = magic[i];
+            node->next = *children;
+            *children = node;
+        }
+        children = &node->child;
+    }
+
+    for(pmatch = &node->matches; *pmatch; pmatch = &(*pmatch)->next)
+        if ((*pmatch)->fmt == fmt)
+            return 0;
+    match = av_mallocz(sizeof(ProbeMatch));
+    if (!match)
+        return AVERROR_NOMEM;
+    match->fmt = fmt;
+    match->order = probe_formats;
+    *pmatch = match;
+    return 0;
+}
+
+/**
+ * Add the built-in signatures of a newly registered input format.
+ */
+void av_register_probe_signatures(AVInputFormat *fmt)
+{
+    int i;
+
+    for(i = 0; i < sizeof(probe_signatures) / sizeof(probe_signatures[0]); i++) {
+        const ProbeSignature *sig = &probe_signatures[i];
+        if (!strcmp(sig->format, fmt->name))
+            av_register_probe_signature(fmt, sig->offset, sig->magic, sig->size);
+    }
+    probe_formats++;
+}
+
+#define MAX_CANDIDATES 16
+
+/**
+ * Probe only the input formats whose signature matches the probe data.
+ *
+ * @param score_ret the score of the returned format is put here
+ * @return the best matching format, NULL if no signature matched
+ */
+AVInputFormat *av_probe_input_format_signature(AVProbeData *pd, int *score_ret)
+{
+    ProbeMatch *candidates[MAX_CANDIDATES];
+    int nb_candidates = 0, i, j, score, score_max = 0, order = INT_MAX;
+    AVInputFormat *fmt = NULL;
+    ProbeTrie *trie;
+
+    for(trie = probe_tries; trie; trie = trie->next) {
+        ProbeNode *node = trie->children;
+
+        for(i = trie->offset; i < pd->buf_size; i++) {
+            ProbeMatch *match;
+
+            node = probe_node_find(node, pd->buf[i]);
+            if (!node)
+                break;
+            for(match = node->matches; match; match = match->next) {
+                for(j = 0; j < nb_candidates; j++)
+                    if (candidates[j]->fmt == match->fmt)
+                        break;
+                if (j == nb_candidates && nb_candidates < MAX_CANDIDATES)
+                    candidates[nb_candidates++] = match;
+            }
+            node = node->child;
+        }
+    }
+
+    for(i = 0; i < nb_candidates; i++) {
+        if (!candidates[i]->fmt->read_probe)
+            continue;
+        score = candidates[i]->fmt->read_probe(pd);
+        if (score > score_max || (score == score_max && candidates[i]->order < order)) {
+            score_max = score;
+            order = candidates[i]->order;
+            fmt = candidates[i]->fmt;
+        }
+    }
+    *score_ret = score_max;
+    return score_max > 0 ? fmt : NULL;
+}
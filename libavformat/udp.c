@@ -20,6 +20,10 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#include <sys/poll.h>
+#endif
 #include <netinet/in.h>
 #ifndef __BEOS__
 # include <arpa/inet.h>
@@ -33,6 +37,12 @@
 #define IPV6_DROP_MEMBERSHIP IPV6_LEAVE_GROUP
 #endif
 
+/* maximum number of datagrams moved by one system call */
+#define UDP_MAX_BATCH 64
+
+/* default time a written datagram may wait for the rest of its batch */
+#define UDP_BATCH_DELAY 10000
+
 typedef struct {
     int udp_fd;
     int ttl;
@@ -44,6 +54,28 @@ typedef struct {
 #else
     struct sockaddr_storage dest_addr;
     size_t dest_addr_len;
+#endif
+    int buffer_size;            /* socket buffer size, 0 for the default */
+    int batch;                  /* datagrams per system call */
+    int batch_delay;            /* maximum time a datagram is queued, in us */
+
+    /* datagrams received by the last batch and not read yet, or
+       datagrams written and not sent yet */
+    uint8_t *batch_buf;         /* batch * max_packet_size bytes */
+    int batch_len[UDP_MAX_BATCH];
+    int batch_index, batch_count;
+    int64_t batch_deadline;     /* time at which the queued datagrams are sent */
+
+#ifdef HAVE_PTHREADS
+    /* ring of received datagrams filled by a thread */
+    int fifo_size;              /* number of datagrams, 0 if no thread */
+    uint8_t *fifo_buf;
+    int *fifo_len;
+    int fifo_rindex, fifo_count;
+    int thread_started, thread_exit, thread_error;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
 #endif
 } UDPContext;
 
@@ -234,6 +266,13 @@ static int udp_ipv6_set_local(URLContext *h) {
  *         'ttl=n'       : set the ttl value (for multicast only)
  *         'localport=n' : set the local port
  *         'pkt_size=n'  : set max packet size
+ *         'buffer_size=n' : set the socket receive or send buffer size
+ *         'batch=n'     : receive or send up to n datagrams per system
+ *                         call (only for direct reads, not with RTP)
+ *         'batch_delay=n' : send the queued datagrams on the next write
+ *                         once the first of them waited n ms (10 ms)
+ *         'fifo_size=n' : receive the datagrams in a thread and keep up
+ *                         to n of them until they are read
  *
  * @param s1 media file context
  * @param uri of the remote server
@@ -281,6 +320,115 @@ int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+#ifdef HAVE_RECVMMSG
+/* receive up to nb datagrams of at most size bytes in buf. Block until
+   at least one is available. */
+static int udp_recv_batch(int fd, uint8_t *buf, int size, int *len, int nb)
+{
+    struct mmsghdr msgs[UDP_MAX_BATCH];
+    struct iovec iov[UDP_MAX_BATCH];
+    int i, n;
+
+    memset(msgs, 0, nb * sizeof(msgs[0]));
+    for(i = 0; i < nb; i++) {
+        iov[i].iov_base = buf + i * size;
+        iov[i].iov_len = size;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    n = recvmmsg(fd, msgs, nb, MSG_WAITFORONE, NULL);
+    for(i = 0; i < n; i++)
+        len[i] = msgs[i].msg_len;
+    return n;
+}
+#else
+static int udp_recv_batch(int fd, uint8_t *buf, int size, int *len, int nb)
+{
+    int n = recv(fd, buf, size, 0);
+
+    if (n < 0)
+        return -1;
+    len[0] = n;
+    return 1;
+}
+#endif
+
+#ifdef HAVE_PTHREADS
+static void *udp_receive_thread(void *arg)
+{
+    URLContext *h = arg;
+    UDPContext *s = h->priv_data;
+    struct pollfd pfd;
+    int windex, nb, n, ret;
+
+    pfd.fd = s->udp_fd;
+    pfd.events = POLLIN;
+    for(;;) {
+        pthread_mutex_lock(&s->mutex);
+        /* wait for free space, the socket buffer absorbs the burst
+           meanwhile */
+        while (s->fifo_count == s->fifo_size && !s->thread_exit)
+            pthread_cond_wait(&s->cond, &s->mutex);
+        if (s->thread_exit) {
+            pthread_mutex_unlock(&s->mutex);
+            break;
+        }
+        windex = (s->fifo_rindex + s->fifo_count) % s->fifo_size;
+        nb = s->fifo_size - s->fifo_count;
+        pthread_mutex_unlock(&s->mutex);
+
+        /* only the free slots up to the end of the ring are filled */
+        nb = FFMIN(nb, s->fifo_size - windex);
+        nb = FFMIN(nb, s->batch);
+
+        /* poll with a timeout so that the thread notices udp_close() */
+        ret = poll(&pfd, 1, 100);
+        if (ret <= 0) {
+            if (ret < 0 && errno != EINTR)
+                break;
+            continue;
+        }
+        n = udp_recv_batch(s->udp_fd, s->fifo_buf + windex * h->max_packet_size,
+                           h->max_packet_size, s->fifo_len + windex, nb);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            break;
+        }
+        pthread_mutex_lock(&s->mutex);
+        s->fifo_count += n;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+    }
+    pthread_mutex_lock(&s->mutex);
+    s->thread_error = 1;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return NULL;
+}
+
+static int udp_fifo_read(URLContext *h, uint8_t *buf, int size)
+{
+    UDPContext *s = h->priv_data;
+    int len;
+
+    pthread_mutex_lock(&s->mutex);
+    while (s->fifo_count == 0 && !s->thread_error)
+        pthread_cond_wait(&s->cond, &s->mutex);
+    if (s->fifo_count == 0) {
+        pthread_mutex_unlock(&s->mutex);
+        return AVERROR_IO;
+    }
+    len = FFMIN(size, s->fifo_len[s->fifo_rindex]);
+    memcpy(buf, s->fifo_buf + s->fifo_rindex * h->max_packet_size, len);
+    s->fifo_rindex = (s->fifo_rindex + 1) % s->fifo_size;
+    s->fifo_count--;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->mutex);
+    return len;
+}
+#endif
+
 /* put it in UDP context */
 /* return non zero if error */
 static int udp_open(URLContext *h, const char *uri, int flags)
@@ -305,10 +453,13 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (!s)
         return -ENOMEM;
 
+    memset(s, 0, sizeof(UDPContext));
     h->priv_data = s;
     s->ttl = 16;
     s->is_multicast = 0;
     s->local_port = 0;
+    s->batch = 1;
+    s->batch_delay = UDP_BATCH_DELAY;
     p = strchr(uri, '?');
     if (p) {
         s->is_multicast = find_info_tag(buf, sizeof(buf), "multicast", p);
@@ -321,7 +472,31 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         if (find_info_tag(buf, sizeof(buf), "pkt_size", p)) {
             h->max_packet_size = strtol(buf, NULL, 10);
         }
+        if (find_info_tag(buf, sizeof(buf), "buffer_size", p)) {
+            s->buffer_size = strtol(buf, NULL, 10);
+        }
+        if (find_info_tag(buf, sizeof(buf), "batch", p)) {
+            s->batch = strtol(buf, NULL, 10);
+        }
+        if (find_info_tag(buf, sizeof(buf), "batch_delay", p)) {
+            s->batch_delay = strtol(buf, NULL, 10) * 1000;
+        }
+#ifdef HAVE_PTHREADS
+        if (!is_output && find_info_tag(buf, sizeof(buf), "fifo_size", p)) {
+            s->fifo_size = strtol(buf, NULL, 10);
+        }
+#endif
     }
+#ifndef HAVE_RECVMMSG
+    s->batch = 1;
+#endif
+    s->batch = clip(s->batch, 1, UDP_MAX_BATCH);
+    if (h->max_packet_size <= 0 || h->max_packet_size > INT_MAX / UDP_MAX_BATCH)
+        goto fail;
+#ifdef HAVE_PTHREADS
+    if (s->fifo_size > INT_MAX / h->max_packet_size)
+        goto fail;
+#endif
 
     /* fill the dest addr */
     url_split(NULL, 0, NULL, 0, hostname, sizeof(hostname), &port, NULL, 0, uri);
@@ -400,14 +575,42 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     if (is_output) {
         /* limit the tx buf size to limit latency */
-        tmp = UDP_TX_BUF_SIZE;
+        tmp = s->buffer_size ? s->buffer_size : UDP_TX_BUF_SIZE;
         if (setsockopt(udp_fd, SOL_SOCKET, SO_SNDBUF, &tmp, sizeof(tmp)) < 0) {
             perror("setsockopt sndbuf");
             goto fail;
         }
+    } else if (s->buffer_size) {
+        /* a large receive buffer avoids losing datagrams in bursts */
+        tmp = s->buffer_size;
+        if (setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &tmp, sizeof(tmp)) < 0)
+            perror("setsockopt rcvbuf");
+    }
+
+    if (s->batch > 1) {
+        s->batch_buf = av_malloc(s->batch * h->max_packet_size);
+        if (!s->batch_buf)
+            goto fail;
     }
 
     s->udp_fd = udp_fd;
+
+#ifdef HAVE_PTHREADS
+    if (s->fifo_size > 0) {
+        s->fifo_buf = av_malloc(s->fifo_size * h->max_packet_size);
+        s->fifo_len = av_malloc(s->fifo_size * sizeof(int));
+        if (!s->fifo_buf || !s->fifo_len)
+            goto fail;
+        pthread_mutex_init(&s->mutex, NULL);
+        pthread_cond_init(&s->cond, NULL);
+        if (pthread_create(&s->thread, NULL, udp_receive_thread, h)) {
+            pthread_mutex_destroy(&s->mutex);
+            pthread_cond_destroy(&s->cond);
+            goto fail;
+        }
+        s->thread_started = 1;
+    }
+#endif
     return 0;
  fail:
     if (udp_fd >= 0)
@@ -415,6 +618,11 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         closesocket(udp_fd);
 #else
         close(udp_fd);
+#endif
+    av_free(s->batch_buf);
+#ifdef HAVE_PTHREADS
+    av_free(s->fifo_buf);
+    av_free(s->fifo_len);
 #endif
     av_free(s);
     return AVERROR_IO;
@@ -430,6 +638,28 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
 #endif
     int from_len, len;
 
+#ifdef HAVE_PTHREADS
+    if (s->fifo_size > 0)
+        return udp_fifo_read(h, buf, size);
+#endif
+    if (s->batch > 1) {
+        while (s->batch_index >= s->batch_count) {
+            len = udp_recv_batch(s->udp_fd, s->batch_buf, h->max_packet_size,
+                                 s->batch_len, s->batch);
+            if (len < 0) {
+                if (errno != EAGAIN && errno != EINTR)
+                    return AVERROR_IO;
+                continue;
+            }
+            s->batch_index = 0;
+            s->batch_count = len;
+        }
+        len = FFMIN(size, s->batch_len[s->batch_index]);
+        memcpy(buf, s->batch_buf + s->batch_index * h->max_packet_size, len);
+        s->batch_index++;
+        return len;
+    }
+
     for(;;) {
         from_len = sizeof(from);
         len = recvfrom (s->udp_fd, buf, size, 0,
@@ -444,11 +674,65 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     return len;
 }
 
+#ifdef HAVE_RECVMMSG
+/* send the datagrams queued by udp_write() */
+static int udp_flush_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    struct mmsghdr msgs[UDP_MAX_BATCH];
+    struct iovec iov[UDP_MAX_BATCH];
+    int i, n;
+
+    memset(msgs, 0, s->batch_count * sizeof(msgs[0]));
+    for(i = 0; i < s->batch_count; i++) {
+        iov[i].iov_base = s->batch_buf + i * h->max_packet_size;
+        iov[i].iov_len = s->batch_len[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &s->dest_addr;
+#ifndef CONFIG_IPV6
+        msgs[i].msg_hdr.msg_namelen = sizeof(s->dest_addr);
+#else
+        msgs[i].msg_hdr.msg_namelen = s->dest_addr_len;
+#endif
+    }
+    i = 0;
+    while (i < s->batch_count) {
+        n = sendmmsg(s->udp_fd, msgs + i, s->batch_count - i, 0);
+        if (n < 0) {
+            if (errno != EINTR && errno != EAGAIN) {
+                s->batch_count = 0;
+                return AVERROR_IO;
+            }
+        } else {
+            i += n;
+        }
+    }
+    s->batch_count = 0;
+    return 0;
+}
+#endif
+
 static int udp_write(URLContext *h, uint8_t *buf, int size)
 {
     UDPContext *s = h->priv_data;
     int ret;
 
+#ifdef HAVE_RECVMMSG
+    if (s->batch > 1 && size <= h->max_packet_size) {
+        if (s->batch_count == 0)
+            s->batch_deadline = av_gettime() + s->batch_delay;
+        memcpy(s->batch_buf + s->batch_count * h->max_packet_size, buf, size);
+        s->batch_len[s->batch_count++] = size;
+        if ((s->batch_count == s->batch || av_gettime() >= s->batch_deadline) &&
+            udp_flush_batch(h) < 0)
+            return AVERROR_IO;
+        return size;
+    }
+    if (s->batch_count > 0 && udp_flush_batch(h) < 0)
+        return AVERROR_IO;
+#endif
+
     for(;;) {
         ret = sendto (s->udp_fd, buf, size, 0,
                       (struct sockaddr *) &s->dest_addr,
@@ -471,6 +755,25 @@ static int udp_close(URLContext *h)
 {
     UDPContext *s = h->priv_data;
 
+#ifdef HAVE_RECVMMSG
+    if ((h->flags & URL_WRONLY) && s->batch_count > 0)
+        udp_flush_batch(h);
+#endif
+#ifdef HAVE_PTHREADS
+    if (s->thread_started) {
+        pthread_mutex_lock(&s->mutex);
+        s->thread_exit = 1;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->mutex);
+        pthread_join(s->thread, NULL);
+        pthread_mutex_destroy(&s->mutex);
+        pthread_cond_destroy(&s->cond);
+    }
+    av_free(s->fifo_buf);
+    av_free(s->fifo_len);
+#endif
+    av_free(s->batch_buf);
+
 #ifndef CONFIG_BEOS_NETSERVER
 #ifndef CONFIG_IPV6
     if (s->is_multicast && !(h->flags & URL_WRONLY)) {
@@ -45,6 +45,7 @@ void av_register_input_format(AVInputFormat *format)
     while (*p != NULL) p = &(*p)->next;
     *p = format;
     format->next = NULL;
+    av_register_probe_signatures(format);
 }
 
 void av_register_output_format(AVOutputFormat *format)
@@ -418,6 +419,14 @@ AVInputFormat *av_probe_input_format(AVProbeData *pd, int is_opened)
     AVInputFormat *fmt1, *fmt;
     int score, score_max;
 
+    /* the demuxers whose signature matches are tried first, a full match
+       can not be beaten by any other demuxer */
+    if (is_opened && pd->buf_size > 0) {
+        fmt = av_probe_input_format_signature(pd, &score);
+        if (fmt && score >= AVPROBE_SCORE_MAX)
+            return fmt;
+    }
+
     fmt = NULL;
     score_max = 0;
     for(fmt1 = first_iformat; fmt1 != NULL; fmt1 = fmt1->next) {
@@ -545,6 +554,7 @@ int av_open_input_file(AVFormatContext **ic_ptr, const char *filename,
     int err, must_open_file, file_opened, probe_size;
     AVProbeData probe_data, *pd = &probe_data;
     ByteIOContext pb1, *pb = &pb1;
+    int64_t probe_start = av_gettime();
 
     file_opened = 0;
     pd->filename = "";
@@ -592,6 +602,8 @@ int av_open_input_file(AVFormatContext **ic_ptr, const char *filename,
             /* guess file format */
             fmt = av_probe_input_format(pd, 1);
         }
+        av_log(NULL, AV_LOG_DEBUG, "probed %s as %s in %"PRId64" us with %d bytes\n",
+               filename, fmt ? fmt->name : "unknown", av_gettime() - probe_start, pd->buf_size);
         av_freep(&pd->buf);
     }
 
@@ -851,6 +863,34 @@ static void compute_pkt_fields(AVFormatContext *s, AVStream *st,
     }
 }
 
+/**
+ * Timestamp fixup of AVFMT_FLAG_NOPARSE: only what can be done without
+ * looking at the payload or at the previous frames is done, the
+ * timestamps of the container are trusted otherwise.
+ */
+static void compute_pkt_fields_noparse(AVStream *st, AVPacket *pkt)
+{
+    int num, den;
+
+    if(st->cur_dts != AV_NOPTS_VALUE){
+        if(pkt->pts != AV_NOPTS_VALUE)
+            pkt->pts= lsb2full(pkt->pts, st->cur_dts, st->pts_wrap_bits);
+        if(pkt->dts != AV_NOPTS_VALUE)
+            pkt->dts= lsb2full(pkt->dts, st->cur_dts, st->pts_wrap_bits);
+    }
+    if (pkt->dts == AV_NOPTS_VALUE)
+        pkt->dts = pkt->pts;
+    if (pkt->duration == 0) {
+        compute_frame_duration(&num, &den, st, NULL, pkt);
+        if (den && num)
+            pkt->duration = av_rescale(1, num * (int64_t)st->time_base.den, den * (int64_t)st->time_base.num);
+    }
+    if (pkt->dts != AV_NOPTS_VALUE)
+        st->cur_dts = pkt->dts;
+    if(is_intra_only(st->codec))
+        pkt->flags |= PKT_FLAG_KEY;
+}
+
 void av_destruct_packet_nofree(AVPacket *pkt)
 {
     pkt->data = NULL; pkt->size = 0;
@@ -869,7 +909,10 @@ static int av_read_frame_internal(AVFormatContext *s, AVPacket *pkt)
                 /* no parsing needed: we just output the packet as is */
                 /* raw data support */
                 *pkt = s->cur_pkt;
-                compute_pkt_fields(s, st, NULL, pkt);
+                if (s->flags & AVFMT_FLAG_NOPARSE)
+                    compute_pkt_fields_noparse(st, pkt);
+                else
+                    compute_pkt_fields(s, st, NULL, pkt);
                 s->cur_st = NULL;
                 break;
             } else if (s->cur_len > 0 && st->discard < AVDISCARD_ALL) {
@@ -931,7 +974,7 @@ static int av_read_frame_internal(AVFormatContext *s, AVPacket *pkt)
             s->cur_st = st;
             s->cur_ptr = s->cur_pkt.data;
             s->cur_len = s->cur_pkt.size;
-            if (st->need_parsing && !st->parser) {
+            if (st->need_parsing && !st->parser && !(s->flags & AVFMT_FLAG_NOPARSE)) {
                 st->parser = av_parser_init(st->codec->codec_id);
                 if (!st->parser) {
                     /* no parser available : just output the raw packets */
@@ -1123,6 +1166,32 @@ void av_update_cur_dts(AVFormatContext *s, AVStream *ref_st, int64_t timestamp){
     }
 }
 
+/**
+ * Make room for nb_entries more index entries.
+ */
+static AVIndexEntry *av_grow_index_entries(AVStream *st, int nb_entries)
+{
+    AVIndexEntry *entries;
+    unsigned int min_size;
+
+    if((unsigned)st->nb_index_entries + nb_entries >= UINT_MAX / sizeof(AVIndexEntry))
+        return NULL;
+    min_size= (st->nb_index_entries + nb_entries) * sizeof(AVIndexEntry);
+    if(min_size <= st->index_entries_allocated_size)
+        return st->index_entries;
+
+    /* grow geometrically so that appending entries one by one is cheap */
+    if(min_size < st->index_entries_allocated_size / 2 * 3 &&
+       st->index_entries_allocated_size < UINT_MAX / 3)
+        min_size= st->index_entries_allocated_size / 2 * 3;
+    entries = av_fast_realloc(st->index_entries,
+                              &st->index_entries_allocated_size,
+                              min_size);
+    if(entries)
+        st->index_entries= entries;
+    return entries;
+}
+
 /**
  * Add a index entry into a sorted list updateing if it is already there.
  *
@@ -1134,25 +1203,17 @@ int av_add_index_entry(AVStream *st,
     AVIndexEntry *entries, *ie;
     int index;
 
-    if((unsigned)st->nb_index_entries + 1 >= UINT_MAX / sizeof(AVIndexEntry))
-        return -1;
-
-    entries = av_fast_realloc(st->index_entries,
-                              &st->index_entries_allocated_size,
-                              (st->nb_index_entries + 1) *
-                              sizeof(AVIndexEntry));
+    entries = av_grow_index_entries(st, 1);
     if(!entries)
         return -1;
 
-    st->index_entries= entries;
-
-    index= av_index_search_timestamp(st, timestamp, AVSEEK_FLAG_ANY);
-
-    if(index<0){
+    if(!st->nb_index_entries || entries[st->nb_index_entries - 1].timestamp < timestamp){
+        /* entries are usually added in timestamp order */
         index= st->nb_index_entries++;
         ie= &entries[index];
-        assert(index==0 || ie[-1].timestamp < timestamp);
     }else{
+        index= av_index_search_timestamp(st, timestamp, AVSEEK_FLAG_ANY);
+        assert(index >= 0);
         ie= &entries[index];
         if(ie->timestamp != timestamp){
             if(ie->timestamp <= timestamp)
@@ -1172,6 +1233,48 @@ int av_add_index_entry(AVStream *st,
     return index;
 }
 
+/**
+ * Add several index entries at once.
+ *
+ * Entries sorted by strictly increasing timestamps which all come after
+ * the existing ones are appended with a single copy, anything else is
+ * merged with av_add_index_entry().
+ *
+ * @param entries the entries to add, timestamps in the timebase of the given stream
+ * @return 0 if OK, < 0 if an error occured, in which case only part of
+ *         the entries may have been merged
+ */
+int av_add_index_entries(AVStream *st, const AVIndexEntry *entries, int nb_entries)
+{
+    int i, sorted = 1;
+
+    if(nb_entries <= 0)
+        return 0;
+
+    if(st->nb_index_entries &&
+       st->index_entries[st->nb_index_entries - 1].timestamp >= entries[0].timestamp)
+        sorted= 0;
+    for(i = 1; i < nb_entries && sorted; i++)
+        if(entries[i].timestamp <= entries[i - 1].timestamp)
+            sorted= 0;
+
+    if(!av_grow_index_entries(st, nb_entries))
+        return -1;
+
+    if(!sorted){
+        for(i = 0; i < nb_entries; i++){
+            const AVIndexEntry *e = &entries[i];
+            if(av_add_index_entry(st, e->pos, e->timestamp, e->size, e->min_distance, e->flags) < 0)
+                return -1;
+        }
+        return 0;
+    }
+
+    memcpy(st->index_entries + st->nb_index_entries, entries, nb_entries * sizeof(AVIndexEntry));
+    st->nb_index_entries += nb_entries;
+    return 0;
+}
+
 /**
  * build an index for raw streams using a parser.
  */
@@ -1748,7 +1851,17 @@ static void av_estimate_timings(AVFormatContext *ic)
     }
     ic->file_size = file_size;
 
-    if ((!strcmp(ic->iformat->name, "mpeg") ||
+    if ((ic->flags & AVFMT_FLAG_INDEXCACHE) && av_index_cache_load(ic) >= 0 &&
+        av_has_timings(ic)) {
+        /* timings restored from the index cache */
+        fill_all_stream_timings(ic);
+    } else if (av_has_timings(ic) &&
+               ((ic->flags & AVFMT_FLAG_HEADERONLY) || ic->probesize > 0 ||
+                ic->probe_packets > 0 || ic->probe_time > 0)) {
+        /* probing is limited: the timings of the components are used
+           rather than reading the end of the file */
+        fill_all_stream_timings(ic);
+    } else if ((!strcmp(ic->iformat->name, "mpeg") ||
          !strcmp(ic->iformat->name, "mpegts")) &&
         file_size && !ic->pb.is_streamed) {
         /* get accurate estimate from the PTSes */
@@ -1861,6 +1974,7 @@ int av_find_stream_info(AVFormatContext *ic)
     int64_t last_dts[MAX_STREAMS];
     int64_t duration_sum[MAX_STREAMS];
     int duration_count[MAX_STREAMS]={0};
+    int64_t start= ic->probe_time > 0 ? av_gettime() : 0;
 
     for(i=0;i<ic->nb_streams;i++) {
         st = ic->streams[i];
@@ -1893,6 +2007,8 @@ int av_find_stream_info(AVFormatContext *ic)
             st = ic->streams[i];
             if (!has_codec_parameters(st->codec))
                 break;
+            if (ic->flags & AVFMT_FLAG_HEADERONLY)
+                continue;
             /* variable fps and no guess at the real fps */
             if(   st->codec->time_base.den >= 101LL*st->codec->time_base.num
                && duration_count[i]<20 && st->codec->codec_type == CODEC_TYPE_VIDEO)
@@ -1911,11 +2027,20 @@ int av_find_stream_info(AVFormatContext *ic)
             }
         } else {
             /* we did not get all the codec info, but we read too much data */
-            if (read_size >= MAX_READ_SIZE) {
+            if (read_size >= (ic->probesize > 0 ? ic->probesize : MAX_READ_SIZE)) {
                 ret = count;
                 break;
             }
         }
+        /* the budget set by the user also limits formats without header */
+        if ((ic->probesize > 0 && read_size >= ic->probesize) ||
+            (ic->probe_packets > 0 && count >= ic->probe_packets) ||
+            (ic->probe_time > 0 && av_gettime() - start >= ic->probe_time * 1000LL)) {
+            av_log(ic, AV_LOG_DEBUG, "probe budget exhausted after %d packets, %d bytes\n",
+                   count, read_size);
+            ret = count;
+            break;
+        }
 
         /* NOTE: a new stream can be added there if no header in file
            (AVFMTCTX_NOHEADER) */
@@ -2152,6 +2277,9 @@ void av_close_input_file(AVFormatContext *s)
     if (s->cur_st && s->cur_st->parser)
         av_free_packet(&s->cur_pkt);
 
+    if (s->flags & AVFMT_FLAG_INDEXCACHE)
+        av_index_cache_save(s);
+
     if (s->iformat->read_close)
         s->iformat->read_close(s);
     for(i=0;i<s->nb_streams;i++) {
@@ -2414,57 +2542,183 @@ int av_write_frame(AVFormatContext *s, AVPacket *pkt)
     return ret;
 }
 
+typedef struct InterleavePacket {
+    AVPacket pkt;
+    int64_t seq;                     ///< arrival order, breaks ties between equal dts
+    int64_t dts;                     ///< dts in AV_TIME_BASE units, for the delay statistics
+    struct InterleavePacket *next;
+} InterleavePacket;
+
+typedef struct AVInterleaver {
+    InterleavePacket *first[MAX_STREAMS]; ///< per stream queues, sorted by dts
+    InterleavePacket *last[MAX_STREAMS];
+    int heap[MAX_STREAMS];           ///< streams with buffered packets, min-heap on their first packet
+    int heap_pos[MAX_STREAMS];
+    int heap_size;
+    int64_t seq;
+    int64_t max_dts;                 ///< highest dts of the buffered packets in AV_TIME_BASE units
+} AVInterleaver;
+
+/**
+ * Compare the dts of two packets in their stream time bases.
+ * @return < 0, 0 or > 0 if a is before, at the same time or after b
+ */
+static int interleave_compare(AVFormatContext *s, InterleavePacket *a, InterleavePacket *b){
+    AVStream *st = s->streams[b->pkt.stream_index];
+    AVStream *st2= s->streams[a->pkt.stream_index];
+    int64_t left=  st2->time_base.num * (int64_t)st ->time_base.den;
+    int64_t right= st ->time_base.num * (int64_t)st2->time_base.den;
+
+    if(a->pkt.dts * left > b->pkt.dts * right) //FIXME this can overflow
+        return 1;
+    if(a->pkt.dts * left < b->pkt.dts * right)
+        return -1;
+    return 0;
+}
+
+static int interleave_before(AVFormatContext *s, InterleavePacket *a, InterleavePacket *b){
+    int cmp= interleave_compare(s, a, b);
+    return cmp < 0 || (cmp == 0 && a->seq < b->seq);
+}
+
+static void interleave_heap_swap(AVInterleaver *il, int i, int j){
+    int t= il->heap[i];
+    il->heap[i]= il->heap[j];
+    il->heap[j]= t;
+    il->heap_pos[il->heap[i]]= i;
+    il->heap_pos[il->heap[j]]= j;
+}
+
+static void interleave_heap_up(AVFormatContext *s, AVInterleaver *il, int i){
+    while(i > 0){
+        int parent= (i - 1) >> 1;
+        if(!interleave_before(s, il->first[il->heap[i]], il->first[il->heap[parent]]))
+            break;
+        interleave_heap_swap(il, i, parent);
+        i= parent;
+    }
+}
+
+static void interleave_heap_down(AVFormatContext *s, AVInterleaver *il, int i){
+    for(;;){
+        int child= 2*i + 1;
+        if(child >= il->heap_size)
+            break;
+        if(child + 1 < il->heap_size &&
+           interleave_before(s, il->first[il->heap[child + 1]], il->first[il->heap[child]]))
+            child++;
+        if(!interleave_before(s, il->first[il->heap[child]], il->first[il->heap[i]]))
+            break;
+        interleave_heap_swap(il, i, child);
+        i= child;
+    }
+}
+
+/**
+ * Add a packet to the queue of its stream, which is kept sorted by dts,
+ * packets with the same dts staying in arrival order.
+ */
+static void interleave_add_packet(AVFormatContext *s, AVInterleaver *il, InterleavePacket *this_pktl){
+    int stream_index= this_pktl->pkt.stream_index;
+    InterleavePacket **next_point;
+
+    if(!il->first[stream_index]){
+        il->first[stream_index]=
+        il->last [stream_index]= this_pktl;
+        il->heap[il->heap_size]= stream_index;
+        il->heap_pos[stream_index]= il->heap_size;
+        interleave_heap_up(s, il, il->heap_size++);
+        return;
+    }
+
+    /* dts normally increase within a stream, so this is an append */
+    if(!interleave_before(s, this_pktl, il->last[stream_index])){
+        il->last[stream_index]->next= this_pktl;
+        il->last[stream_index]= this_pktl;
+        return;
+    }
+
+    next_point= &il->first[stream_index];
+    while(!interleave_before(s, this_pktl, *next_point))
+        next_point= &(*next_point)->next;
+    this_pktl->next= *next_point;
+    *next_point= this_pktl;
+    if(next_point == &il->first[stream_index])
+        interleave_heap_up(s, il, il->heap_pos[stream_index]);
+}
+
+/**
+ * Remove the packet with the lowest dts from the queues.
+ */
+static InterleavePacket *interleave_get_packet(AVFormatContext *s, AVInterleaver *il){
+    int stream_index= il->heap[0];
+    InterleavePacket *pktl= il->first[stream_index];
+
+    il->first[stream_index]= pktl->next;
+    if(!pktl->next){
+        il->last[stream_index]= NULL;
+        il->heap_size--;
+        if(il->heap_size)
+            interleave_heap_swap(il, 0, il->heap_size);
+    }
+    interleave_heap_down(s, il, 0);
+    return pktl;
+}
+
 /**
  * interleave_packet implementation which will interleave per DTS.
  * packets with pkt->destruct == av_destruct_packet will be freed inside this function.
  * so they cannot be used after it, note calling av_free_packet() on them is still safe
+ *
+ * Every stream has its own queue and the streams are kept in a heap ordered
+ * by the dts of their first packet, so that adding and removing a packet
+ * only costs O(log(nb_streams)) for correctly ordered input.
  */
 static int av_interleave_packet_per_dts(AVFormatContext *s, AVPacket *out, AVPacket *pkt, int flush){
-    AVPacketList *pktl, **next_point, *this_pktl;
-    int stream_count=0;
-    int streams[MAX_STREAMS];
+    AVInterleaver *il= s->interleaver;
+    InterleavePacket *pktl;
+    AVStream *st;
 
-    if(pkt){
-        AVStream *st= s->streams[ pkt->stream_index];
+    if(!il){
+        il= s->interleaver= av_mallocz(sizeof(AVInterleaver));
+        if(!il)
+            return AVERROR_NOMEM;
+    }
 
+    if(pkt){
 //        assert(pkt->destruct != av_destruct_packet); //FIXME
 
-        this_pktl = av_mallocz(sizeof(AVPacketList));
-        this_pktl->pkt= *pkt;
+        pktl = av_mallocz(sizeof(InterleavePacket));
+        if(!pktl)
+            return AVERROR_NOMEM;
+        pktl->pkt= *pkt;
+        pktl->seq= il->seq++;
         if(pkt->destruct == av_destruct_packet)
             pkt->destruct= NULL; // non shared -> must keep original from being freed
         else
-            av_dup_packet(&this_pktl->pkt);  //shared -> must dup
-
-        next_point = &s->packet_buffer;
-        while(*next_point){
-            AVStream *st2= s->streams[ (*next_point)->pkt.stream_index];
-            int64_t left=  st2->time_base.num * (int64_t)st ->time_base.den;
-            int64_t right= st ->time_base.num * (int64_t)st2->time_base.den;
-            if((*next_point)->pkt.dts * left > pkt->dts * right) //FIXME this can overflow
-                break;
-            next_point= &(*next_point)->next;
-        }
-        this_pktl->next= *next_point;
-        *next_point= this_pktl;
-    }
+            av_dup_packet(&pktl->pkt);  //shared -> must dup
 
-    memset(streams, 0, sizeof(streams));
-    pktl= s->packet_buffer;
-    while(pktl){
-//av_log(s, AV_LOG_DEBUG, "show st:%d dts:%lld\n", pktl->pkt.stream_index, pktl->pkt.dts);
-        if(streams[ pktl->pkt.stream_index ] == 0)
-            stream_count++;
-        streams[ pktl->pkt.stream_index ]++;
-        pktl= pktl->next;
+        /* the packets leave the queues in dts order, so the highest dts
+           added since they were last empty is still buffered */
+        st= s->streams[pkt->stream_index];
+        pktl->dts= av_rescale(pkt->dts, AV_TIME_BASE * (int64_t)st->time_base.num, st->time_base.den);
+        if(!il->heap_size || pktl->dts > il->max_dts)
+            il->max_dts= pktl->dts;
+        interleave_add_packet(s, il, pktl);
+
+        s->interleave_packets++;
+        s->interleave_bytes += pkt->size;
+        s->interleave_max_packets= FFMAX(s->interleave_max_packets, s->interleave_packets);
+        s->interleave_max_bytes  = FFMAX(s->interleave_max_bytes  , s->interleave_bytes);
     }
 
-    if(s->nb_streams == stream_count || (flush && stream_count)){
-        pktl= s->packet_buffer;
+    if(s->nb_streams == il->heap_size || (flush && il->heap_size)){
+        pktl= interleave_get_packet(s, il);
         *out= pktl->pkt;
-
-        s->packet_buffer= pktl->next;
+        s->interleave_max_delay= FFMAX(s->interleave_max_delay, il->max_dts - pktl->dts);
         av_freep(&pktl);
+        s->interleave_packets--;
+        s->interleave_bytes -= out->size;
         return 1;
     }else{
         av_init_packet(out);
@@ -2565,6 +2819,10 @@ int av_write_trailer(AVFormatContext *s)
             goto fail;
     }
 
+    if(s->interleave_max_packets)
+        av_log(s, AV_LOG_DEBUG, "interleaving: max %d packets, %"PRId64" bytes buffered, max delay %"PRId64" us\n",
+               s->interleave_max_packets, s->interleave_max_bytes, s->interleave_max_delay);
+
     if(s->oformat->write_trailer)
         ret = s->oformat->write_trailer(s);
 fail:
@@ -2573,6 +2831,7 @@ fail:
     for(i=0;i<s->nb_streams;i++)
         av_freep(&s->streams[i]->priv_data);
     av_freep(&s->priv_data);
+    av_freep(&s->interleaver);
     return ret;
 }
 
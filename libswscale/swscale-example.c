@@ -21,7 +21,9 @@
 #include <string.h>
 #include <inttypes.h>
 #include <stdarg.h>
+#include <sys/time.h>
 
+#include "config.h"
 #include "swscale.h"
 #include "img_format.h"
 
@@ -66,10 +68,11 @@ static void doTest(uint8_t *ref[3], int refStride[3], int w, int h, int srcForma
 	uint8_t *src[3];
 	uint8_t *dst[3];
 	uint8_t *out[3];
+	uint8_t *threadDst[3];
 	int srcStride[3], dstStride[3];
 	int i;
 	uint64_t ssdY, ssdU, ssdV;
-	struct SwsContext *srcContext, *dstContext, *outContext;
+	struct SwsContext *srcContext, *dstContext, *outContext, *threadContext;
 	
 	for(i=0; i<3; i++){
 		// avoid stride % bpp != 0
@@ -86,12 +89,16 @@ static void doTest(uint8_t *ref[3], int refStride[3], int w, int h, int srcForma
 		src[i]= (uint8_t*) malloc(srcStride[i]*srcH);
 		dst[i]= (uint8_t*) malloc(dstStride[i]*dstH);
 		out[i]= (uint8_t*) malloc(refStride[i]*h);
+		threadDst[i]= (uint8_t*) malloc(dstStride[i]*dstH);
+		memset(dst[i], 0, dstStride[i]*dstH);
+		memset(threadDst[i], 0, dstStride[i]*dstH);
 	}
 
 	srcContext= sws_getContext(w, h, IMGFMT_YV12, srcW, srcH, srcFormat, flags, NULL, NULL, NULL);
 	dstContext= sws_getContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, NULL, NULL, NULL);
 	outContext= sws_getContext(dstW, dstH, dstFormat, w, h, IMGFMT_YV12, flags, NULL, NULL, NULL);
-	if(srcContext==NULL ||dstContext==NULL ||outContext==NULL){
+	threadContext= sws_getCachedContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, NULL, NULL, NULL);
+	if(srcContext==NULL ||dstContext==NULL ||outContext==NULL ||threadContext==NULL){
 		printf("Failed allocating swsContext\n");
 		goto end;
 	}
@@ -102,6 +109,35 @@ static void doTest(uint8_t *ref[3], int refStride[3], int w, int h, int srcForma
 	sws_scale(dstContext, src, srcStride, 0, srcH, dst, dstStride);
 	sws_scale(outContext, dst, dstStride, 0, dstH, out, refStride);
 
+	// the threaded scaler must give the same output
+	if(sws_setThreads(threadContext, 3) >= 0){
+		sws_scale(threadContext, src, srcStride, 0, srcH, threadDst, dstStride);
+		for(i=0; i<3; i++){
+			if(memcmp(dst[i], threadDst[i], dstStride[i]*dstH)){
+				printf(" %s %dx%d -> %s %4dx%4d flags=%2d differs with threads\n",
+					sws_format_name(srcFormat), srcW, srcH,
+					sws_format_name(dstFormat), dstW, dstH,
+					flags);
+				break;
+			}
+		}
+	}
+
+	// so must a context taken back from the cache
+	sws_releaseContext(threadContext);
+	threadContext= sws_getCachedContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, NULL, NULL, NULL);
+	for(i=0; i<3; i++) memset(threadDst[i], 0, dstStride[i]*dstH);
+	sws_scale(threadContext, src, srcStride, 0, srcH, threadDst, dstStride);
+	for(i=0; i<3; i++){
+		if(memcmp(dst[i], threadDst[i], dstStride[i]*dstH)){
+			printf(" %s %dx%d -> %s %4dx%4d flags=%2d differs with cached context\n",
+				sws_format_name(srcFormat), srcW, srcH,
+				sws_format_name(dstFormat), dstW, dstH,
+				flags);
+			break;
+		}
+	}
+
 #if defined(ARCH_X86) || defined(ARCH_X86_64)
 	asm volatile ("emms\n\t");
 #endif
@@ -129,11 +165,13 @@ static void doTest(uint8_t *ref[3], int refStride[3], int w, int h, int srcForma
 	sws_freeContext(srcContext);
 	sws_freeContext(dstContext);
 	sws_freeContext(outContext);
+	sws_releaseContext(threadContext);
 
 	for(i=0; i<3; i++){
 		free(src[i]);
 		free(dst[i]);
 		free(out[i]);
+		free(threadDst[i]);
 	}
 }
 
@@ -177,6 +215,94 @@ printf("%s -> %s\n",
 	}
 }
 
+typedef struct BenchCase{
+	const char *name;	///< the scaler path which takes most of the time
+	int dstW, dstH, dstFormat, flags;
+}BenchCase;
+
+static BenchCase benchCase[]={
+{"hScale 4 taps, yuv2yuvX", 1024, 768, IMGFMT_YV12,  SWS_BICUBIC},
+{"hScale 8 taps, yuv2yuvX",  360, 288, IMGFMT_YV12,  SWS_BICUBIC},
+{"hScale generic, yuv2yuvX", 360, 288, IMGFMT_YV12,  SWS_LANCZOS},
+{"yuv2packedX",              640, 480, IMGFMT_BGR32, SWS_BICUBIC},
+{"fast bilinear",           1024, 768, IMGFMT_YV12,  SWS_FAST_BILINEAR},
+{"yuv2rgb 32 bit",           720, 576, IMGFMT_BGR32, SWS_BICUBIC},
+{"yuv2rgb 24 bit",           720, 576, IMGFMT_BGR24, SWS_BICUBIC},
+{"yuv2rgb 16 bit",           720, 576, IMGFMT_BGR16, SWS_BICUBIC},
+{NULL}
+};
+
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+static int benchCaps[]={
+0,
+SWS_CPU_CAPS_MMX,
+SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2,
+SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2|SWS_CPU_CAPS_SSE2,
+};
+static const char *benchCapsName[]={"C", "MMX", "MMX2", "SSE2"};
+#else
+static int benchCaps[]={0};
+static const char *benchCapsName[]={"C"};
+#endif
+
+#define BENCH_W 720
+#define BENCH_H 576
+#define BENCH_RUNS 50
+
+/**
+ * Time the main scaler paths with each set of cpu capabilities. The
+ * capabilities only select the code when libswscale is compiled with
+ * RUNTIME_CPUDETECT, otherwise the best compiled in variant always runs.
+ */
+static void bench(void){
+	uint8_t *src[3], *dst[3];
+	int srcStride[3]={BENCH_W, BENCH_W/2, BENCH_W/2};
+	int dstStride[3];
+	int i, j, k, run;
+
+	for(i=0; i<3; i++){
+		src[i]= malloc(srcStride[i]*BENCH_H);
+		for(j=0; j<srcStride[i]*BENCH_H; j++)
+			src[i][j]= random();
+		dst[i]= malloc(4*1024*768);
+	}
+
+	for(i=0; benchCase[i].name; i++){
+		BenchCase *b= &benchCase[i];
+
+		dstStride[0]= IMGFMT_IS_BGR(b->dstFormat) ? b->dstW*((IMGFMT_BGR_DEPTH(b->dstFormat)+7)>>3) : b->dstW;
+		dstStride[1]= dstStride[2]= b->dstW/2;
+		for(k=0; k<sizeof(benchCaps)/sizeof(benchCaps[0]); k++){
+			struct SwsContext *c= sws_getContext(BENCH_W, BENCH_H, IMGFMT_YV12,
+				b->dstW, b->dstH, b->dstFormat, b->flags | benchCaps[k], NULL, NULL, NULL);
+			struct timeval start, end;
+			int usec;
+
+			if(!c){
+				printf("Failed allocating swsContext\n");
+				continue;
+			}
+			sws_scale(c, src, srcStride, 0, BENCH_H, dst, dstStride);
+			gettimeofday(&start, NULL);
+			for(run=0; run<BENCH_RUNS; run++)
+				sws_scale(c, src, srcStride, 0, BENCH_H, dst, dstStride);
+			gettimeofday(&end, NULL);
+#if defined(ARCH_X86) || defined(ARCH_X86_64)
+			asm volatile ("emms\n\t");
+#endif
+			usec= (end.tv_sec - start.tv_sec)*1000000 + end.tv_usec - start.tv_usec;
+			printf("%-26s %4dx%4d %-5s %8.3f ms\n", b->name, b->dstW, b->dstH,
+				benchCapsName[k], usec/1000.0/BENCH_RUNS);
+			sws_freeContext(c);
+		}
+	}
+
+	for(i=0; i<3; i++){
+		free(src[i]);
+		free(dst[i]);
+	}
+}
+
 #define W 96
 #define H 96
 
@@ -190,6 +316,11 @@ int main(int argc, char **argv){
 	int x, y;
 	struct SwsContext *sws;
 
+	if(argc > 1 && !strcmp(argv[1], "-bench")){
+		bench();
+		return 0;
+	}
+
 	sws= sws_getContext(W/12, H/12, IMGFMT_BGR32, W, H, IMGFMT_YV12, 2, NULL, NULL, NULL);
         
 	for(y=0; y<H; y++){
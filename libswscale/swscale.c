@@ -67,6 +67,9 @@ untested special converters
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 #endif
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include "swscale.h"
 #include "swscale_internal.h"
 #include "x86_cpu.h"
@@ -756,7 +759,13 @@ static inline void yuv2packedXinC(SwsContext *c, int16_t *lumFilter, int16_t **l
 }
 
 
-//Note: we have C, X86, MMX, MMX2, 3DNOW version therse no 3DNOW+MMX2 one
+//Note: we have C, X86, MMX, MMX2, 3DNOW, SSE2 version therse no 3DNOW+MMX2 one
+#if defined(ARCH_X86_64) && defined(HAVE_MMX)
+// every x86-64 cpu has MMX2 and SSE2
+#define HAVE_MMX2
+#define HAVE_SSE2
+#endif
+
 //Plain C versions
 #if !defined (HAVE_MMX) || defined (RUNTIME_CPUDETECT)
 #define COMPILE_C
@@ -774,23 +783,29 @@ static inline void yuv2packedXinC(SwsContext *c, int16_t *lumFilter, int16_t **l
 #define COMPILE_MMX
 #endif
 
-#if defined (HAVE_MMX2) || defined (RUNTIME_CPUDETECT)
+#if (defined (HAVE_MMX2) && !defined (HAVE_SSE2)) || defined (RUNTIME_CPUDETECT)
 #define COMPILE_MMX2
 #endif
 
 #if (defined (HAVE_3DNOW) && !defined (HAVE_MMX2)) || defined (RUNTIME_CPUDETECT)
 #define COMPILE_3DNOW
 #endif
+
+#if defined (HAVE_SSE2) || defined (RUNTIME_CPUDETECT)
+#define COMPILE_SSE2
+#endif
 #endif //ARCH_X86 || ARCH_X86_64
 
 #undef HAVE_MMX
 #undef HAVE_MMX2
 #undef HAVE_3DNOW
+#undef HAVE_SSE2
 
 #ifdef COMPILE_C
 #undef HAVE_MMX
 #undef HAVE_MMX2
 #undef HAVE_3DNOW
+#undef HAVE_SSE2
 #undef HAVE_ALTIVEC
 #define RENAME(a) a ## _C
 #include "swscale_template.c"
@@ -847,6 +862,17 @@ static inline void yuv2packedXinC(SwsContext *c, int16_t *lumFilter, int16_t **l
 #include "swscale_template.c"
 #endif
 
+//SSE2 versions
+#ifdef COMPILE_SSE2
+#undef RENAME
+#define HAVE_MMX
+#define HAVE_MMX2
+#undef HAVE_3DNOW
+#define HAVE_SSE2
+#define RENAME(a) a ## _SSE2
+#include "swscale_template.c"
+#endif
+
 #endif //ARCH_X86 || ARCH_X86_64
 
 // minor note: the HAVE_xyz is messed up after that line so don't use it
@@ -877,8 +903,8 @@ static inline int initFilter(int16_t **outFilter, int16_t **filterPos, int *outF
 		asm volatile("emms\n\t"::: "memory"); //FIXME this shouldnt be required but it IS (even for non mmx versions)
 #endif
 
-	// Note the +1 is for the MMXscaler which reads over the end
-	*filterPos = av_malloc((dstW+1)*sizeof(int16_t));
+	// Note the +3 is for the MMX and SSE2 scalers which read over the end
+	*filterPos = av_malloc((dstW+3)*sizeof(int16_t));
 
 	if(ABS(xInc - 0x10000) <10) // unscaled
 	{
@@ -1203,10 +1229,10 @@ static inline int initFilter(int16_t **outFilter, int16_t **filterPos, int *outF
 		}
 	}
 
-	// Note the +1 is for the MMXscaler which reads over the end
+	// Note the +3 is for the MMX and SSE2 scalers which read over the end
 	/* align at 16 for AltiVec (needed by hScale_altivec_real) */
-	*outFilter= av_malloc(*outFilterSize*(dstW+1)*sizeof(int16_t));
-	memset(*outFilter, 0, *outFilterSize*(dstW+1)*sizeof(int16_t));
+	*outFilter= av_malloc(*outFilterSize*(dstW+3)*sizeof(int16_t));
+	memset(*outFilter, 0, *outFilterSize*(dstW+3)*sizeof(int16_t));
 
 	/* Normalize & Store in outFilter */
 	for(i=0; i<dstW; i++)
@@ -1230,18 +1256,137 @@ static inline int initFilter(int16_t **outFilter, int16_t **filterPos, int *outF
 		}
 	}
 	
-	(*filterPos)[dstW]= (*filterPos)[dstW-1]; // the MMX scaler will read over the end
-	for(i=0; i<*outFilterSize; i++)
+	// the MMX and SSE2 scalers will read over the end
+	for(i=dstW; i<dstW+3; i++)
 	{
-		int j= dstW*(*outFilterSize);
-		(*outFilter)[j + i]= (*outFilter)[j + i - (*outFilterSize)];
+		int j;
+		(*filterPos)[i]= (*filterPos)[i-1];
+		for(j=0; j<*outFilterSize; j++)
+			(*outFilter)[i*(*outFilterSize) + j]= (*outFilter)[(i-1)*(*outFilterSize) + j];
 	}
 
 	av_free(filter);
         return 0;
 }
 
+/*
+ * Contexts share the filters computed from the same parameters, the
+ * cache of sws_getCachedContext() is protected by the same lock.
+ */
+#ifdef HAVE_PTHREADS
+static pthread_mutex_t cacheLock= PTHREAD_MUTEX_INITIALIZER;
+#define CACHE_LOCK()   pthread_mutex_lock(&cacheLock)
+#define CACHE_UNLOCK() pthread_mutex_unlock(&cacheLock)
+#else
+#define CACHE_LOCK()
+#define CACHE_UNLOCK()
+#endif
+
+typedef struct SharedFilter {
+	int xInc, srcW, dstW, filterAlign, one, flags;
+	double param[2];
+	int16_t *filter;
+	int16_t *filterPos;
+	int filterSize;
+	int refCount;
+	struct SharedFilter *next;
+} SharedFilter;
+
+static SharedFilter *sharedFilters= NULL;
+
+/**
+ * initFilter() which returns the filter of another context if it was
+ * computed with the same parameters. Free it with releaseFilter().
+ */
+static int initSharedFilter(int16_t **outFilter, int16_t **filterPos, int *outFilterSize, int xInc,
+			      int srcW, int dstW, int filterAlign, int one, int flags,
+			      SwsVector *srcFilter, SwsVector *dstFilter, double param[2])
+{
+	SharedFilter *f;
+
+	// filters with vectors are rare, they are not shared
+	if(srcFilter || dstFilter)
+		return initFilter(outFilter, filterPos, outFilterSize, xInc, srcW, dstW,
+				  filterAlign, one, flags, srcFilter, dstFilter, param);
+
+	CACHE_LOCK();
+	for(f= sharedFilters; f; f= f->next)
+	{
+		if(f->xInc == xInc && f->srcW == srcW && f->dstW == dstW && f->filterAlign == filterAlign
+		   && f->one == one && f->flags == flags && f->param[0] == param[0] && f->param[1] == param[1])
+		{
+			f->refCount++;
+			*outFilter    = f->filter;
+			*filterPos    = f->filterPos;
+			*outFilterSize= f->filterSize;
+			CACHE_UNLOCK();
+			return 0;
+		}
+	}
+	CACHE_UNLOCK();
+
+	initFilter(outFilter, filterPos, outFilterSize, xInc, srcW, dstW,
+		   filterAlign, one, flags, NULL, NULL, param);
+
+	f= av_malloc(sizeof(SharedFilter));
+	if(!f) return 0; // not shared then
+	f->xInc       = xInc;
+	f->srcW       = srcW;
+	f->dstW       = dstW;
+	f->filterAlign= filterAlign;
+	f->one        = one;
+	f->flags      = flags;
+	f->param[0]   = param[0];
+	f->param[1]   = param[1];
+	f->filter     = *outFilter;
+	f->filterPos  = *filterPos;
+	f->filterSize = *outFilterSize;
+	f->refCount   = 1;
+
+	// another thread may have computed it in the meantime, it does not matter
+	CACHE_LOCK();
+	f->next= sharedFilters;
+	sharedFilters= f;
+	CACHE_UNLOCK();
+	return 0;
+}
+
+static void releaseFilter(int16_t *filter, int16_t *filterPos)
+{
+	SharedFilter **pf, *f;
+
+	if(!filter) return;
+
+	CACHE_LOCK();
+	for(pf= &sharedFilters; *pf; pf= &(*pf)->next)
+	{
+		if((*pf)->filter == filter)
+		{
+			f= *pf;
+			if(--f->refCount == 0)
+			{
+				*pf= f->next;
+				av_free(f);
+				break;
+			}
+			CACHE_UNLOCK();
+			return;
+		}
+	}
+	CACHE_UNLOCK();
+
+	av_free(filter);
+	av_free(filterPos);
+}
+
 #ifdef HAVE_MMX2
+// x86-64 position independent code cannot take absolute addresses of the fragments
+#ifdef ARCH_X86_64
+#define FRAGMENT(label) #label"(%%rip)"
+#else
+#define FRAGMENT(label) #label
+#endif
+
 static void initMMX2HScaler(int dstW, int xInc, uint8_t *funnyCode, int16_t *filter, int32_t *filterPos, int numSplits)
 {
 	uint8_t *fragmentA;
@@ -1285,14 +1430,14 @@ static void initMMX2HScaler(int dstW, int xInc, uint8_t *funnyCode, int16_t *fil
 	// End
 		"9:				\n\t"
 //		"int $3\n\t"
-		"lea 0b, %0			\n\t"
-		"lea 1b, %1			\n\t"
-		"lea 2b, %2			\n\t"
+		"lea "FRAGMENT(0b)", %0		\n\t"
+		"lea "FRAGMENT(1b)", %1		\n\t"
+		"lea "FRAGMENT(2b)", %2		\n\t"
 		"dec %1				\n\t"
 		"dec %2				\n\t"
 		"sub %0, %1			\n\t"
 		"sub %0, %2			\n\t"
-		"lea 9b, %3			\n\t"
+		"lea "FRAGMENT(9b)", %3		\n\t"
 		"sub %0, %3			\n\t"
 
 
@@ -1323,14 +1468,14 @@ static void initMMX2HScaler(int dstW, int xInc, uint8_t *funnyCode, int16_t *fil
 	// End
 		"9:				\n\t"
 //		"int $3\n\t"
-		"lea 0b, %0			\n\t"
-		"lea 1b, %1			\n\t"
-		"lea 2b, %2			\n\t"
+		"lea "FRAGMENT(0b)", %0		\n\t"
+		"lea "FRAGMENT(1b)", %1		\n\t"
+		"lea "FRAGMENT(2b)", %2		\n\t"
 		"dec %1				\n\t"
 		"dec %2				\n\t"
 		"sub %0, %1			\n\t"
 		"sub %0, %2			\n\t"
-		"lea 9b, %3			\n\t"
+		"lea "FRAGMENT(9b)", %3		\n\t"
 		"sub %0, %3			\n\t"
 
 
@@ -1428,7 +1573,9 @@ static SwsFunc getSwsFunc(int flags){
 #ifdef RUNTIME_CPUDETECT
 #if defined(ARCH_X86) || defined(ARCH_X86_64)
 	// ordered per speed fasterst first
-	if(flags & SWS_CPU_CAPS_MMX2)
+	if(flags & SWS_CPU_CAPS_SSE2)
+		return swScale_SSE2;
+	else if(flags & SWS_CPU_CAPS_MMX2)
 		return swScale_MMX2;
 	else if(flags & SWS_CPU_CAPS_3DNOW)
 		return swScale_3DNow;
@@ -1447,7 +1594,9 @@ static SwsFunc getSwsFunc(int flags){
 	return swScale_C;
 #endif /* defined(ARCH_X86) || defined(ARCH_X86_64) */
 #else //RUNTIME_CPUDETECT
-#ifdef HAVE_MMX2
+#ifdef HAVE_SSE2
+	return swScale_SSE2;
+#elif defined (HAVE_MMX2)
 	return swScale_MMX2;
 #elif defined (HAVE_3DNOW)
 	return swScale_3DNow;
@@ -1799,6 +1948,7 @@ int sws_setColorspaceDetails(SwsContext *c, const int inv_table[4], int srcRange
 	int64_t cgv = -inv_table[3];
 	int64_t cy  = 1<<16;
 	int64_t oy  = 0;
+	int i;
 
 	if(isYUV(c->dstFormat) || isGray(c->dstFormat)) return -1;
 	memcpy(c->srcColorspaceTable, inv_table, sizeof(int)*4);
@@ -1833,6 +1983,9 @@ int sws_setColorspaceDetails(SwsContext *c, const int inv_table[4], int srcRange
 	c->ugCoeff=   roundToInt16(cgu*8192) * 0x0001000100010001ULL;
 	c->yOffset=   roundToInt16(oy *   8) * 0x0001000100010001ULL;
 
+	for(i=0; i<8; i++)
+		c->sse2Coeffs[i][0]= c->sse2Coeffs[i][1]= (&c->yCoeff)[i];
+
 	yuv2rgb_c_init_tables(c, inv_table, srcRange, brightness, contrast, saturation);
 	//FIXME factorize
 
@@ -1875,8 +2028,10 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 #endif
 
 #ifndef RUNTIME_CPUDETECT //ensure that the flags match the compiled variant if cpudetect is off
-	flags &= ~(SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2|SWS_CPU_CAPS_3DNOW|SWS_CPU_CAPS_ALTIVEC);
-#ifdef HAVE_MMX2
+	flags &= ~(SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2|SWS_CPU_CAPS_3DNOW|SWS_CPU_CAPS_ALTIVEC|SWS_CPU_CAPS_SSE2);
+#ifdef HAVE_SSE2
+	flags |= SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2|SWS_CPU_CAPS_SSE2;
+#elif defined (HAVE_MMX2)
 	flags |= SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2;
 #elif defined (HAVE_3DNOW)
 	flags |= SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_3DNOW;
@@ -1885,6 +2040,10 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 #elif defined (HAVE_ALTIVEC)
 	flags |= SWS_CPU_CAPS_ALTIVEC;
 #endif
+#else
+	// the SSE2 code uses MMX2 instructions too
+	if(flags & SWS_CPU_CAPS_SSE2)
+		flags |= SWS_CPU_CAPS_MMX|SWS_CPU_CAPS_MMX2;
 #endif /* RUNTIME_CPUDETECT */
 	if(clip_table[512] != 255) globalInit();
 	if(rgb15to16 == NULL) sws_rgb2rgb_init(flags);
@@ -1941,6 +2100,8 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 	c->origDstFormat= origDstFormat;
 	c->origSrcFormat= origSrcFormat;
         c->vRounder= 4* 0x0001000100010001ULL;
+	c->dstYStart= 0;
+	c->dstYEnd= dstH;
 
 	usesHFilter= usesVFilter= 0;
 	if(dstFilter->lumV!=NULL && dstFilter->lumV->length>1) usesVFilter=1;
@@ -2064,7 +2225,8 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 
 	if(flags & SWS_CPU_CAPS_MMX2)
 	{
-		c->canMMX2BeUsed= (dstW >=srcW && (dstW&31)==0 && (srcW&15)==0) ? 1 : 0;
+		// the chroma scaler is split in 4 parts of 4 pixel fragments too
+		c->canMMX2BeUsed= (dstW >=srcW && (dstW&31)==0 && (c->chrDstW&15)==0 && (srcW&15)==0) ? 1 : 0;
 		if(!c->canMMX2BeUsed && dstW >=srcW && (srcW&15)==0 && (flags&SWS_FAST_BILINEAR))
 		{
 			if(flags&SWS_PRINT_INFO)
@@ -2106,11 +2268,11 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 		  (flags & SWS_CPU_CAPS_ALTIVEC) ? 8 :
 		  1;
 
-		initFilter(&c->hLumFilter, &c->hLumFilterPos, &c->hLumFilterSize, c->lumXInc,
+		initSharedFilter(&c->hLumFilter, &c->hLumFilterPos, &c->hLumFilterSize, c->lumXInc,
 				 srcW      ,       dstW, filterAlign, 1<<14,
 				 (flags&SWS_BICUBLIN) ? (flags|SWS_BICUBIC)  : flags,
 				 srcFilter->lumH, dstFilter->lumH, c->param);
-		initFilter(&c->hChrFilter, &c->hChrFilterPos, &c->hChrFilterSize, c->chrXInc,
+		initSharedFilter(&c->hChrFilter, &c->hChrFilterPos, &c->hChrFilterSize, c->chrXInc,
 				 c->chrSrcW, c->chrDstW, filterAlign, 1<<14,
 				 (flags&SWS_BICUBLIN) ? (flags|SWS_BILINEAR) : flags,
 				 srcFilter->chrH, dstFilter->chrH, c->param);
@@ -2148,11 +2310,11 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 		  (flags & SWS_CPU_CAPS_ALTIVEC) ? 8 :
 		  1;
 
-		initFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize, c->lumYInc,
+		initSharedFilter(&c->vLumFilter, &c->vLumFilterPos, &c->vLumFilterSize, c->lumYInc,
 				srcH      ,        dstH, filterAlign, (1<<12)-4,
 				(flags&SWS_BICUBLIN) ? (flags|SWS_BICUBIC)  : flags,
 				srcFilter->lumV, dstFilter->lumV, c->param);
-		initFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize, c->chrYInc,
+		initSharedFilter(&c->vChrFilter, &c->vChrFilterPos, &c->vChrFilterSize, c->chrYInc,
 				c->chrSrcH, c->chrDstH, filterAlign, (1<<12)-4,
 				(flags&SWS_BICUBLIN) ? (flags|SWS_BILINEAR) : flags,
 				srcFilter->chrV, dstFilter->chrV, c->param);
@@ -2249,7 +2411,9 @@ SwsContext *sws_getContext(int srcW, int srcH, int origSrcFormat, int dstW, int
 			MSG_INFO("from %s to %s ", 
 				sws_format_name(srcFormat), sws_format_name(dstFormat));
 
-		if(flags & SWS_CPU_CAPS_MMX2)
+		if(flags & SWS_CPU_CAPS_SSE2)
+			MSG_INFO("using SSE2\n");
+		else if(flags & SWS_CPU_CAPS_MMX2)
 			MSG_INFO("using MMX2\n");
 		else if(flags & SWS_CPU_CAPS_3DNOW)
 			MSG_INFO("using 3DNOW\n");
@@ -2373,6 +2537,273 @@ int sws_scale_ordered(SwsContext *c, uint8_t* src[], int srcStride[], int srcSli
 	}
 }
 
+#ifdef HAVE_PTHREADS
+/*
+ * Threaded scaling: the destination is split into horizontal bands, each
+ * one scaled from the whole source picture by its own band context. A
+ * band context is a copy of the main one which only owns its ring
+ * buffers of horizontally scaled lines; it fills them with the source
+ * lines its first destination line needs, so every band outputs exactly
+ * the lines the main context would.
+ */
+typedef struct SwsThreads {
+	int nbBands;
+	SwsContext **bands;		///< bands[0] is scaled by the caller, bands[i] by workers[i-1]
+	pthread_t *workers;
+	int nbWorkers;
+	uint8_t **src, **dst;		///< picture being scaled
+	int *srcStride, *dstStride;
+	int job;			///< number of pictures passed to the workers
+	int pending;			///< bands of the current picture not scaled yet
+	int done;
+	pthread_mutex_t lock;
+	pthread_cond_t jobCond;
+	pthread_cond_t doneCond;
+} SwsThreads;
+
+static void freeBand(SwsContext *band){
+	int i;
+	if(!band) return;
+
+	if(band->lumPixBuf)
+		for(i=0; i<band->vLumBufSize; i++)
+			av_free(band->lumPixBuf[i]);
+	av_free(band->lumPixBuf);
+	if(band->chrPixBuf)
+		for(i=0; i<band->vChrBufSize; i++)
+			av_free(band->chrPixBuf[i]);
+	av_free(band->chrPixBuf);
+	av_free(band);
+}
+
+static SwsContext *allocBand(SwsContext *c, int dstYStart, int dstYEnd){
+	SwsContext *band= av_malloc(sizeof(SwsContext));
+	int i;
+	if(!band) return NULL;
+
+	memcpy(band, c, sizeof(SwsContext));
+	band->threads= c->threads;
+	band->dstYStart= dstYStart;
+	band->dstYEnd= dstYEnd;
+	band->lumPixBuf= av_malloc(c->vLumBufSize*2*sizeof(int16_t*));
+	band->chrPixBuf= av_malloc(c->vChrBufSize*2*sizeof(int16_t*));
+	if(band->lumPixBuf) memset(band->lumPixBuf, 0, c->vLumBufSize*2*sizeof(int16_t*));
+	if(band->chrPixBuf) memset(band->chrPixBuf, 0, c->vChrBufSize*2*sizeof(int16_t*));
+	if(!band->lumPixBuf || !band->chrPixBuf)
+		goto fail;
+	// same layout and initial content as the buffers of sws_getContext()
+	for(i=0; i<c->vLumBufSize; i++){
+		band->lumPixBuf[i]= band->lumPixBuf[i+c->vLumBufSize]= av_malloc(4000);
+		if(!band->lumPixBuf[i]) goto fail;
+		memset(band->lumPixBuf[i], 0, 4000);
+	}
+	for(i=0; i<c->vChrBufSize; i++){
+		band->chrPixBuf[i]= band->chrPixBuf[i+c->vChrBufSize]= av_malloc(8000);
+		if(!band->chrPixBuf[i]) goto fail;
+		memset(band->chrPixBuf[i], 64, 8000);
+	}
+	return band;
+fail:
+	freeBand(band);
+	return NULL;
+}
+
+/**
+ * Copy the state of the main context which may have changed since the
+ * last picture (colorspace details) to a band context.
+ */
+static void updateBand(SwsContext *band, SwsContext *c){
+	int16_t **lumPixBuf= band->lumPixBuf;
+	int16_t **chrPixBuf= band->chrPixBuf;
+	int dstYStart= band->dstYStart;
+	int dstYEnd= band->dstYEnd;
+
+	memcpy(band, c, sizeof(SwsContext));
+	band->lumPixBuf= lumPixBuf;
+	band->chrPixBuf= chrPixBuf;
+	band->dstYStart= dstYStart;
+	band->dstYEnd= dstYEnd;
+}
+
+static int scaleBand(SwsContext *band, uint8_t* src[], int srcStride[], uint8_t* dst[], int dstStride[]){
+	// swScale() modifies them
+	uint8_t *src2[3]= {src[0], src[1], src[2]};
+	uint8_t *dst2[3]= {dst[0], dst[1], dst[2]};
+	int srcStride2[3]= {srcStride[0], srcStride[1], srcStride[2]};
+	int dstStride2[3]= {dstStride[0], dstStride[1], dstStride[2]};
+
+	return band->swScale(band, src2, srcStride2, 0, band->srcH, dst2, dstStride2);
+}
+
+static void *bandWorker(void *arg){
+	SwsContext *band= arg;
+	SwsThreads *t= band->threads;
+	int job= 0;
+
+	pthread_mutex_lock(&t->lock);
+	for(;;){
+		while(t->job == job && !t->done)
+			pthread_cond_wait(&t->jobCond, &t->lock);
+		if(t->done)
+			break;
+		job= t->job;
+		pthread_mutex_unlock(&t->lock);
+
+		scaleBand(band, t->src, t->srcStride, t->dst, t->dstStride);
+
+		pthread_mutex_lock(&t->lock);
+		if(--t->pending == 0)
+			pthread_cond_signal(&t->doneCond);
+	}
+	pthread_mutex_unlock(&t->lock);
+	return NULL;
+}
+
+static void freeThreads(SwsContext *c){
+	SwsThreads *t= c->threads;
+	int i;
+	if(!t) return;
+
+	pthread_mutex_lock(&t->lock);
+	t->done= 1;
+	pthread_cond_broadcast(&t->jobCond);
+	pthread_mutex_unlock(&t->lock);
+	for(i=0; i<t->nbWorkers; i++)
+		pthread_join(t->workers[i], NULL);
+
+	for(i=0; i<t->nbBands; i++)
+		freeBand(t->bands[i]);
+	pthread_mutex_destroy(&t->lock);
+	pthread_cond_destroy(&t->jobCond);
+	pthread_cond_destroy(&t->doneCond);
+	av_free(t->bands);
+	av_free(t->workers);
+	av_free(t);
+	c->threads= NULL;
+}
+
+static int scaleThreads(SwsContext *c, uint8_t* src[], int srcStride[], uint8_t* dst[], int dstStride[]){
+	SwsThreads *t= c->threads;
+	int i;
+
+	for(i=0; i<t->nbBands; i++)
+		updateBand(t->bands[i], c);
+
+	pthread_mutex_lock(&t->lock);
+	t->src= src;
+	t->srcStride= srcStride;
+	t->dst= dst;
+	t->dstStride= dstStride;
+	t->pending= t->nbWorkers;
+	t->job++;
+	pthread_cond_broadcast(&t->jobCond);
+	pthread_mutex_unlock(&t->lock);
+
+	scaleBand(t->bands[0], src, srcStride, dst, dstStride);
+
+	pthread_mutex_lock(&t->lock);
+	while(t->pending > 0)
+		pthread_cond_wait(&t->doneCond, &t->lock);
+	pthread_mutex_unlock(&t->lock);
+
+	// as if the picture had been scaled by the main context
+	c->dstY= c->dstH;
+	return c->dstH;
+}
+#else
+static void freeThreads(SwsContext *c){
+}
+#endif
+
+/**
+ * Split the destination into horizontal bands which sws_scale() scales
+ * concurrently when it is given the whole source picture in one slice.
+ * The output is the same as with a single thread.
+ *
+ * @param threads number of threads, 1 to scale on the calling thread only
+ * @return 0 if OK, < 0 if the scaling of this context cannot be split
+ */
+int sws_setThreads(SwsContext *c, int threads){
+#ifdef HAVE_PTHREADS
+	SwsThreads *t;
+	int i, align, bandH, dstY;
+#endif
+
+	freeThreads(c);
+	if(threads <= 1)
+		return 0;
+#ifdef HAVE_PTHREADS
+	// the unscaled special converters do not use the ring buffers
+	if(c->swScale != getSwsFunc(c->flags))
+		return -1;
+	// the MMX 15/16 bit writers take their dither from global variables
+	if((c->flags & SWS_CPU_CAPS_MMX) && (isRGB(c->dstFormat) || isBGR(c->dstFormat))
+	   && ((c->dstFormat&0xFF) == 15 || (c->dstFormat&0xFF) == 16))
+		return -1;
+
+	// keep the chroma lines of a destination line in its band
+	align= 1<<c->chrDstVSubSample;
+	bandH= (c->dstH + threads - 1)/threads;
+	bandH= (bandH + align - 1) & ~(align - 1);
+	threads= (c->dstH + bandH - 1)/bandH;
+	if(threads <= 1)
+		return 0;
+
+	t= av_malloc(sizeof(SwsThreads));
+	if(!t) return -1;
+	memset(t, 0, sizeof(SwsThreads));
+	t->bands= av_malloc(threads*sizeof(SwsContext*));
+	t->workers= av_malloc((threads-1)*sizeof(pthread_t));
+	pthread_mutex_init(&t->lock, NULL);
+	pthread_cond_init(&t->jobCond, NULL);
+	pthread_cond_init(&t->doneCond, NULL);
+	c->threads= t;
+	if(!t->bands || !t->workers)
+		goto fail;
+
+	for(dstY=0; dstY < c->dstH; dstY+= bandH){
+		t->bands[t->nbBands]= allocBand(c, dstY, FFMIN(dstY + bandH, c->dstH));
+		if(!t->bands[t->nbBands])
+			goto fail;
+		t->nbBands++;
+	}
+	for(i=1; i<t->nbBands; i++){
+		if(pthread_create(&t->workers[i-1], NULL, bandWorker, t->bands[i]))
+			goto fail;
+		t->nbWorkers++;
+	}
+	return 0;
+fail:
+	freeThreads(c);
+	return -1;
+#else
+	return -1;
+#endif
+}
+
+#ifdef HAVE_PTHREADS
+/**
+ * Check that the destination lines have room for what the SIMD writers
+ * store past the last pixel (up to 8 pixels at once), concurrently scaled
+ * bands would overwrite the first pixels of each other otherwise.
+ */
+static int dstLinesPadded(SwsContext *c, int dstStride[]){
+	int dstFormat= c->dstFormat;
+	int lumW= (c->dstW + 7)&~7;
+	int chrW= (c->chrDstW + 7)&~7;
+
+	if(isPacked(dstFormat)){
+		int bpp= (isRGB(dstFormat) || isBGR(dstFormat)) ? ((dstFormat&0xFF)+7)>>3 : 2;
+		return ABS(dstStride[0]) >= lumW*bpp;
+	}
+	if(isGray(dstFormat))
+		return ABS(dstStride[0]) >= lumW;
+	if(dstFormat == IMGFMT_NV12 || dstFormat == IMGFMT_NV21)
+		return ABS(dstStride[0]) >= lumW && ABS(dstStride[1]) >= 2*chrW;
+	return ABS(dstStride[0]) >= lumW && ABS(dstStride[1]) >= chrW && ABS(dstStride[2]) >= chrW;
+}
+#endif
+
 /**
  * swscale warper, so we don't need to export the SwsContext
  */
@@ -2386,6 +2817,10 @@ int sws_scale(SwsContext *c, uint8_t* srcParam[], int srcStrideParam[], int srcS
 	sws_orderYUV(c->origDstFormat, dst, dstStride, dstParam, dstStrideParam);
 //printf("sws: slice %d %d\n", srcSliceY, srcSliceH);
 
+#ifdef HAVE_PTHREADS
+	if(c->threads && srcSliceY == 0 && srcSliceH == c->srcH && dstLinesPadded(c, dstStride))
+		return scaleThreads(c, src, srcStride, dst, dstStride);
+#endif
 	return c->swScale(c, src, srcStride, srcSliceY, srcSliceH, dst, dstStride);
 }
 
@@ -2679,6 +3114,8 @@ void sws_freeContext(SwsContext *c){
 	int i;
 	if(!c) return;
 
+	freeThreads(c);
+
 	if(c->lumPixBuf)
 	{
 		for(i=0; i<c->vLumBufSize; i++)
@@ -2701,14 +3138,18 @@ void sws_freeContext(SwsContext *c){
 		c->chrPixBuf=NULL;
 	}
 
-	av_free(c->vLumFilter);
+	releaseFilter(c->vLumFilter, c->vLumFilterPos);
 	c->vLumFilter = NULL;
-	av_free(c->vChrFilter);
+	c->vLumFilterPos = NULL;
+	releaseFilter(c->vChrFilter, c->vChrFilterPos);
 	c->vChrFilter = NULL;
-	av_free(c->hLumFilter);
+	c->vChrFilterPos = NULL;
+	releaseFilter(c->hLumFilter, c->hLumFilterPos);
 	c->hLumFilter = NULL;
-	av_free(c->hChrFilter);
+	c->hLumFilterPos = NULL;
+	releaseFilter(c->hChrFilter, c->hChrFilterPos);
 	c->hChrFilter = NULL;
+	c->hChrFilterPos = NULL;
 #ifdef HAVE_ALTIVEC
 	av_free(c->vYCoeffsBank);
 	c->vYCoeffsBank = NULL;
@@ -2716,15 +3157,6 @@ void sws_freeContext(SwsContext *c){
 	c->vCCoeffsBank = NULL;
 #endif
 
-	av_free(c->vLumFilterPos);
-	c->vLumFilterPos = NULL;
-	av_free(c->vChrFilterPos);
-	c->vChrFilterPos = NULL;
-	av_free(c->hLumFilterPos);
-	c->hLumFilterPos = NULL;
-	av_free(c->hChrFilterPos);
-	c->hChrFilterPos = NULL;
-
 #if defined(ARCH_X86) || defined(ARCH_X86_64)
 #ifdef MAP_ANONYMOUS
 	if(c->funnyYCode) munmap(c->funnyYCode, MAX_FUNNY_CODE_SIZE);
@@ -2751,3 +3183,124 @@ void sws_freeContext(SwsContext *c){
 	av_free(c);
 }
 
+
+/*
+ * Idle contexts released by sws_releaseContext(), most recently used
+ * first, at most cacheSize of them.
+ */
+static SwsContext *cache= NULL;
+static int cacheSize= 16;
+
+/**
+ * Get a context like sws_getContext(), reusing an idle context with the
+ * same parameters if there is one. The context must be given back with
+ * sws_releaseContext() instead of sws_freeContext().
+ */
+SwsContext *sws_getCachedContext(int srcW, int srcH, int srcFormat, int dstW, int dstH, int dstFormat, int flags,
+                         SwsFilter *srcFilter, SwsFilter *dstFilter, double *param){
+	SwsContext **pc, *c= NULL;
+	int key[7]= {srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags};
+	double p[2]= {SWS_PARAM_DEFAULT, SWS_PARAM_DEFAULT};
+
+	// contexts using filter vectors are not cached
+	if(srcFilter || dstFilter)
+		return sws_getContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, srcFilter, dstFilter, param);
+
+	if(param){
+		p[0]= param[0];
+		p[1]= param[1];
+	}
+
+	CACHE_LOCK();
+	for(pc= &cache; *pc; pc= &(*pc)->cacheNext)
+	{
+		if(!memcmp((*pc)->cacheKey, key, sizeof(key)) && (*pc)->param[0] == p[0] && (*pc)->param[1] == p[1])
+		{
+			c= *pc;
+			*pc= c->cacheNext;
+			c->cacheNext= NULL;
+			break;
+		}
+	}
+	CACHE_UNLOCK();
+
+	if(c){
+		int *invTable, *table, srcRange, dstRange, brightness, contrast, saturation;
+
+		// undo sws_setColorspaceDetails() of the previous user
+		if(sws_getColorspaceDetails(c, &invTable, &srcRange, &table, &dstRange, &brightness, &contrast, &saturation) >= 0
+		   && (memcmp(invTable, Inverse_Table_6_9[SWS_CS_DEFAULT], 4*sizeof(int))
+		       || memcmp(table, Inverse_Table_6_9[SWS_CS_DEFAULT], 4*sizeof(int))
+		       || srcRange || dstRange || brightness || contrast != 1<<16 || saturation != 1<<16))
+			sws_setColorspaceDetails(c, Inverse_Table_6_9[SWS_CS_DEFAULT], 0, Inverse_Table_6_9[SWS_CS_DEFAULT], 0, 0, 1<<16, 1<<16);
+		return c;
+	}
+
+	c= sws_getContext(srcW, srcH, srcFormat, dstW, dstH, dstFormat, flags, NULL, NULL, param);
+	if(c)
+		memcpy(c->cacheKey, key, sizeof(key));
+	return c;
+}
+
+/**
+ * Remove the contexts after the first cacheSize ones from the cache,
+ * the lock must be held.
+ * @return the removed contexts, linked by cacheNext
+ */
+static SwsContext *trimCache(void){
+	SwsContext **pc= &cache, *evicted;
+	int i;
+
+	for(i=0; *pc && i < cacheSize; i++)
+		pc= &(*pc)->cacheNext;
+	evicted= *pc;
+	*pc= NULL;
+	return evicted;
+}
+
+static void freeContextList(SwsContext *c){
+	while(c){
+		SwsContext *next= c->cacheNext;
+		sws_freeContext(c);
+		c= next;
+	}
+}
+
+/**
+ * Put a context from sws_getCachedContext() back into the cache, the
+ * least recently used contexts are freed if the cache is full.
+ */
+void sws_releaseContext(SwsContext *c){
+	SwsContext *evicted;
+
+	if(!c) return;
+	if(!c->cacheKey[0]){
+		sws_freeContext(c);
+		return;
+	}
+	// the worker threads are not kept for the next user
+	sws_setThreads(c, 1);
+
+	CACHE_LOCK();
+	c->cacheNext= cache;
+	cache= c;
+	evicted= trimCache();
+	CACHE_UNLOCK();
+
+	freeContextList(evicted);
+}
+
+/**
+ * Set the maximum number of idle contexts kept by sws_releaseContext(),
+ * 0 frees them all and disables the cache.
+ */
+void sws_setCacheSize(int size){
+	SwsContext *evicted;
+
+	CACHE_LOCK();
+	cacheSize= FFMAX(size, 0);
+	evicted= trimCache();
+	CACHE_UNLOCK();
+
+	freeContextList(evicted);
+}
@@ -70,6 +70,7 @@ extern "C" {
 #define SWS_CPU_CAPS_MMX2  0x20000000
 #define SWS_CPU_CAPS_3DNOW 0x40000000
 #define SWS_CPU_CAPS_ALTIVEC 0x10000000
+#define SWS_CPU_CAPS_SSE2  0x08000000
 
 #define SWS_MAX_REDUCE_CUTOFF 0.002
 
@@ -108,6 +109,11 @@ int sws_scale(struct SwsContext *context, uint8_t* src[], int srcStride[], int s
                            int srcSliceH, uint8_t* dst[], int dstStride[]);
 int sws_scale_ordered(struct SwsContext *context, uint8_t* src[], int srcStride[], int srcSliceY,
                            int srcSliceH, uint8_t* dst[], int dstStride[]);
+int sws_setThreads(struct SwsContext *context, int threads);
+struct SwsContext *sws_getCachedContext(int srcW, int srcH, int srcFormat, int dstW, int dstH, int dstFormat, int flags,
+			 SwsFilter *srcFilter, SwsFilter *dstFilter, double *param);
+void sws_releaseContext(struct SwsContext *swsContext);
+void sws_setCacheSize(int size);
 
 
 int sws_setColorspaceDetails(struct SwsContext *c, const int inv_table[4], int srcRange, const int table[4], int dstRange, int brightness, int contrast, int saturation);
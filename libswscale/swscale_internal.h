@@ -129,6 +129,19 @@ typedef struct SwsContext{
 #define U_TEMP       "11*8+4*4*256*2+24"
 #define V_TEMP       "11*8+4*4*256*2+32"
 
+/* offsets into sse2Coeffs */
+#define SSE2_Y_COEFF   "0*16"
+#define SSE2_VR_COEFF  "1*16"
+#define SSE2_UB_COEFF  "2*16"
+#define SSE2_VG_COEFF  "3*16"
+#define SSE2_UG_COEFF  "4*16"
+#define SSE2_Y_OFFSET  "5*16"
+#define SSE2_U_OFFSET  "6*16"
+#define SSE2_V_OFFSET  "7*16"
+#define SSE2_B_DITHER  "8*16"
+#define SSE2_G_DITHER  "9*16"
+#define SSE2_R_DITHER  "10*16"
+
 	uint64_t redDither   __attribute__((aligned(8)));
 	uint64_t greenDither __attribute__((aligned(8)));
 	uint64_t blueDither  __attribute__((aligned(8)));
@@ -149,6 +162,15 @@ typedef struct SwsContext{
 	uint64_t u_temp       __attribute__((aligned(8)));
 	uint64_t v_temp       __attribute__((aligned(8)));
 
+	int dstYStart, dstYEnd;			///< lines output by swScale(), all of them unless the context scales one band
+	struct SwsThreads *threads;		///< bands scaled concurrently, see sws_setThreads()
+	int cacheKey[7];			///< sws_getCachedContext() parameters, cacheKey[0] is 0 if not cacheable
+	struct SwsContext *cacheNext;		///< next idle context in the cache
+
+	/* yCoeff to vOffset and the dither of the current line for the SSE2
+	   yuv2rgb converters, 8 words each */
+	uint64_t sse2Coeffs[11][2] __attribute__((aligned(16)));
+
 #ifdef HAVE_ALTIVEC
 
   vector signed short   CY;
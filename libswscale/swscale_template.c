@@ -25,6 +25,10 @@
 #undef PREFETCHW
 #undef EMMS
 #undef SFENCE
+#undef SSE2_CLOBBERS
+#undef YSCALEYUV2YV12X
+#undef YSCALEYUV2PACKEDX
+#undef YSCALEYUV2PACKEDX_END
 
 #ifdef HAVE_3DNOW
 /* On K6 femms is faster of emms. On K7 femms is directly mapped on emms. */
@@ -63,10 +67,64 @@
 #endif
 #define MOVNTQ(a,b)  REAL_MOVNTQ(a,b)
 
+/* gcc only knows the xmm registers if it may use SSE itself */
+#if defined(HAVE_SSE2) && defined(__SSE__)
+#define SSE2_CLOBBERS , "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7"
+#else
+#define SSE2_CLOBBERS
+#endif
+
 #ifdef HAVE_ALTIVEC
 #include "swscale_altivec_template.c"
 #endif
 
+#ifdef HAVE_SSE2
+/* 16 pixels per iteration, stored 8 at a time like the MMX version so that
+   the same amount is written past the end of the line */
+#define YSCALEYUV2YV12X(x, offset, dest, width) \
+		asm volatile(\
+			"xor %%"REG_a", %%"REG_a"	\n\t"\
+			"movq "VROUNDER_OFFSET"(%0), %%xmm3\n\t"\
+			"punpcklqdq %%xmm3, %%xmm3	\n\t"\
+			"movdqa %%xmm3, %%xmm4		\n\t"\
+			"lea " offset "(%0), %%"REG_d"	\n\t"\
+			"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+			ASMALIGN16\
+			"1:				\n\t"\
+			"movq 8(%%"REG_d"), %%xmm0	\n\t" /* filterCoeff */\
+			"movdqu " #x "(%%"REG_S", %%"REG_a", 2), %%xmm2\n\t" /* srcData */\
+			"movdqu 16+" #x "(%%"REG_S", %%"REG_a", 2), %%xmm5\n\t" /* srcData */\
+			"punpcklqdq %%xmm0, %%xmm0	\n\t"\
+			"add $16, %%"REG_d"		\n\t"\
+			"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+			"test %%"REG_S", %%"REG_S"	\n\t"\
+			"pmulhw %%xmm0, %%xmm2		\n\t"\
+			"pmulhw %%xmm0, %%xmm5		\n\t"\
+			"paddw %%xmm2, %%xmm3		\n\t"\
+			"paddw %%xmm5, %%xmm4		\n\t"\
+			" jnz 1b			\n\t"\
+			"psraw $3, %%xmm3		\n\t"\
+			"psraw $3, %%xmm4		\n\t"\
+			"packuswb %%xmm4, %%xmm3	\n\t"\
+			"movq %%xmm3, (%1, %%"REG_a")	\n\t"\
+			"add $8, %%"REG_a"		\n\t"\
+			"cmp %2, %%"REG_a"		\n\t"\
+			" jae 2f			\n\t"\
+			"movhps %%xmm3, (%1, %%"REG_a")	\n\t"\
+			"add $8, %%"REG_a"		\n\t"\
+			"cmp %2, %%"REG_a"		\n\t"\
+			"movq "VROUNDER_OFFSET"(%0), %%xmm3\n\t"\
+			"punpcklqdq %%xmm3, %%xmm3	\n\t"\
+			"movdqa %%xmm3, %%xmm4		\n\t"\
+			"lea " offset "(%0), %%"REG_d"	\n\t"\
+			"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+			"jb 1b				\n\t"\
+			"2:				\n\t"\
+                        :: "r" (&c->redDither),\
+                        "r" (dest), "p" (width)\
+                        : "%"REG_a, "%"REG_d, "%"REG_S SSE2_CLOBBERS\
+                );
+#else
 #define YSCALEYUV2YV12X(x, offset, dest, width) \
 		asm volatile(\
 			"xor %%"REG_a", %%"REG_a"	\n\t"\
@@ -102,6 +160,7 @@
                         "r" (dest), "p" (width)\
                         : "%"REG_a, "%"REG_d, "%"REG_S\
                 );
+#endif
 
 #define YSCALEYUV2YV12X_ACCURATE(x, offset, dest, width) \
 		asm volatile(\
@@ -185,6 +244,55 @@
 			   "m" (lumSrc+lumFilterSize), "m" (chrSrc+chrFilterSize)
 			: "%eax", "%ebx", "%ecx", "%edx", "%esi"
 */
+#ifdef HAVE_SSE2
+/* same as below but the taps are applied to U and V (and to both luma
+   quadruples) with one pmulhw each */
+#define YSCALEYUV2PACKEDX \
+	asm volatile(\
+		"xor %%"REG_a", %%"REG_a"	\n\t"\
+		ASMALIGN16\
+		"nop				\n\t"\
+		"1:				\n\t"\
+		"lea "CHR_MMX_FILTER_OFFSET"(%0), %%"REG_d"\n\t"\
+		"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+		"movq "VROUNDER_OFFSET"(%0), %%xmm3\n\t"\
+		"punpcklqdq %%xmm3, %%xmm3	\n\t"\
+		ASMALIGN16\
+		"2:				\n\t"\
+		"movq 8(%%"REG_d"), %%xmm0	\n\t" /* filterCoeff */\
+		"movq (%%"REG_S", %%"REG_a"), %%xmm2	\n\t" /* UsrcData */\
+		"movhps 4096(%%"REG_S", %%"REG_a"), %%xmm2\n\t" /* VsrcData */\
+		"punpcklqdq %%xmm0, %%xmm0	\n\t"\
+		"add $16, %%"REG_d"		\n\t"\
+		"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+		"pmulhw %%xmm0, %%xmm2		\n\t"\
+		"paddw %%xmm2, %%xmm3		\n\t"\
+		"test %%"REG_S", %%"REG_S"	\n\t"\
+		" jnz 2b			\n\t"\
+		"movdq2q %%xmm3, %%mm3		\n\t"\
+		"punpckhqdq %%xmm3, %%xmm3	\n\t"\
+		"movdq2q %%xmm3, %%mm4		\n\t"\
+\
+		"lea "LUM_MMX_FILTER_OFFSET"(%0), %%"REG_d"\n\t"\
+		"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+		"movq "VROUNDER_OFFSET"(%0), %%xmm1\n\t"\
+		"punpcklqdq %%xmm1, %%xmm1	\n\t"\
+		ASMALIGN16\
+		"2:				\n\t"\
+		"movq 8(%%"REG_d"), %%xmm0	\n\t" /* filterCoeff */\
+		"movdqu (%%"REG_S", %%"REG_a", 2), %%xmm2\n\t" /* Y1srcData Y2srcData */\
+		"punpcklqdq %%xmm0, %%xmm0	\n\t"\
+		"add $16, %%"REG_d"		\n\t"\
+		"mov (%%"REG_d"), %%"REG_S"	\n\t"\
+		"pmulhw %%xmm0, %%xmm2		\n\t"\
+		"paddw %%xmm2, %%xmm1		\n\t"\
+		"test %%"REG_S", %%"REG_S"	\n\t"\
+		" jnz 2b			\n\t"\
+		"movdq2q %%xmm1, %%mm1		\n\t"\
+		"punpckhqdq %%xmm1, %%xmm1	\n\t"\
+		"movdq2q %%xmm1, %%mm7		\n\t"\
+
+#else
 #define YSCALEYUV2PACKEDX \
 	asm volatile(\
 		"xor %%"REG_a", %%"REG_a"	\n\t"\
@@ -227,11 +335,13 @@
 		"test %%"REG_S", %%"REG_S"	\n\t"\
 		" jnz 2b			\n\t"\
 
+#endif
+
 #define YSCALEYUV2PACKEDX_END\
         :: "r" (&c->redDither), \
             "m" (dummy), "m" (dummy), "m" (dummy),\
             "r" (dest), "m" (dstW)\
-        : "%"REG_a, "%"REG_d, "%"REG_S\
+        : "%"REG_a, "%"REG_d, "%"REG_S SSE2_CLOBBERS\
         );
 
 #define YSCALEYUV2PACKEDX_ACCURATE \
@@ -1056,7 +1166,7 @@ static inline void RENAME(yuv2packedX)(SwsContext *c, int16_t *lumFilter, int16_
 			:: "r" (&c->redDither), 
 			   "m" (dummy), "m" (dummy), "m" (dummy),
 			   "r" (dest), "m" (dstW)
-			: "%"REG_a, "%"REG_b, "%"REG_d, "%"REG_S //FIXME ebx
+			: "%"REG_a, "%"REG_b, "%"REG_d, "%"REG_S SSE2_CLOBBERS //FIXME ebx
 			);
                         return;
                 case IMGFMT_BGR15:
@@ -1116,7 +1226,7 @@ static inline void RENAME(yuv2packedX)(SwsContext *c, int16_t *lumFilter, int16_
 			:: "r" (&c->redDither), 
 			   "m" (dummy), "m" (dummy), "m" (dummy),
 			   "r" (dest), "m" (dstW)
-			: "%"REG_a, "%"REG_b, "%"REG_d, "%"REG_S //FIXME ebx
+			: "%"REG_a, "%"REG_b, "%"REG_d, "%"REG_S SSE2_CLOBBERS //FIXME ebx
 			);
 		return;
 	case IMGFMT_BGR15:
@@ -2250,6 +2360,183 @@ static inline void RENAME(hScale)(int16_t *dst, int dstW, uint8_t *src, int srcW
 {
 #ifdef HAVE_MMX
 	assert(filterSize % 4 == 0 && filterSize>0);
+#ifdef HAVE_SSE2
+	/* 4 (2 for the generic filter size) output pixels per iteration, the
+	   rounding matches the MMX version exactly */
+	if(filterSize==4) // allways true for upscaling, sometimes for down too
+	{
+		long counter= -2*dstW;
+		filter-= counter*2;
+		filterPos-= counter/2;
+		dst-= counter/2;
+		asm volatile(
+			"pxor %%xmm7, %%xmm7		\n\t"
+			"movq "MANGLE(w02)", %%xmm6	\n\t"
+			"punpcklqdq %%xmm6, %%xmm6	\n\t"
+			"push %%"REG_BP"		\n\t" // we use 7 regs here ...
+			"mov %%"REG_a", %%"REG_BP"	\n\t"
+			ASMALIGN16
+			"1:				\n\t"
+			"movzwl (%2, %%"REG_BP"), %%eax	\n\t"
+			"movzwl 2(%2, %%"REG_BP"), %%ebx\n\t"
+			"movd (%3, %%"REG_a"), %%xmm0	\n\t"
+			"movd (%3, %%"REG_b"), %%xmm1	\n\t"
+			"movzwl 4(%2, %%"REG_BP"), %%eax\n\t"
+			"movzwl 6(%2, %%"REG_BP"), %%ebx\n\t"
+			"movd (%3, %%"REG_a"), %%xmm2	\n\t"
+			"movd (%3, %%"REG_b"), %%xmm3	\n\t"
+			"punpckldq %%xmm1, %%xmm0	\n\t"
+			"punpckldq %%xmm3, %%xmm2	\n\t"
+			"movdqu (%1, %%"REG_BP", 4), %%xmm1\n\t"
+			"movdqu 16(%1, %%"REG_BP", 4), %%xmm3\n\t"
+			"punpcklbw %%xmm7, %%xmm0	\n\t"
+			"punpcklbw %%xmm7, %%xmm2	\n\t"
+			"pmaddwd %%xmm1, %%xmm0		\n\t"
+			"pmaddwd %%xmm3, %%xmm2		\n\t"
+			"psrad $8, %%xmm0		\n\t"
+			"psrad $8, %%xmm2		\n\t"
+			"packssdw %%xmm2, %%xmm0	\n\t"
+			"pmaddwd %%xmm6, %%xmm0		\n\t"
+			"packssdw %%xmm0, %%xmm0	\n\t"
+			"movq %%xmm0, (%4, %%"REG_BP")	\n\t"
+			"add $8, %%"REG_BP"		\n\t"
+			" jnc 1b			\n\t"
+
+			"pop %%"REG_BP"			\n\t"
+			: "+a" (counter)
+			: "c" (filter), "d" (filterPos), "S" (src), "D" (dst)
+			: "%"REG_b SSE2_CLOBBERS
+		);
+	}
+	else if(filterSize==8)
+	{
+		long counter= -2*dstW;
+		filter-= counter*4;
+		filterPos-= counter/2;
+		dst-= counter/2;
+		asm volatile(
+			"pxor %%xmm7, %%xmm7		\n\t"
+			"movq "MANGLE(w02)", %%xmm6	\n\t"
+			"punpcklqdq %%xmm6, %%xmm6	\n\t"
+			"push %%"REG_BP"		\n\t" // we use 7 regs here ...
+			"mov %%"REG_a", %%"REG_BP"	\n\t"
+			ASMALIGN16
+			"1:				\n\t"
+			"movzwl (%2, %%"REG_BP"), %%eax	\n\t"
+			"movzwl 2(%2, %%"REG_BP"), %%ebx\n\t"
+			"movq (%3, %%"REG_a"), %%xmm0	\n\t"
+			"movq (%3, %%"REG_b"), %%xmm1	\n\t"
+			"movdqu (%1, %%"REG_BP", 8), %%xmm2\n\t"
+			"movdqu 16(%1, %%"REG_BP", 8), %%xmm3\n\t"
+			"punpcklbw %%xmm7, %%xmm0	\n\t"
+			"punpcklbw %%xmm7, %%xmm1	\n\t"
+			"pmaddwd %%xmm2, %%xmm0		\n\t"
+			"pmaddwd %%xmm3, %%xmm1		\n\t"
+			"movdqa %%xmm0, %%xmm2		\n\t"
+			"punpcklqdq %%xmm1, %%xmm0	\n\t"
+			"punpckhqdq %%xmm1, %%xmm2	\n\t"
+			"paddd %%xmm2, %%xmm0		\n\t"
+
+			"movzwl 4(%2, %%"REG_BP"), %%eax\n\t"
+			"movzwl 6(%2, %%"REG_BP"), %%ebx\n\t"
+			"movq (%3, %%"REG_a"), %%xmm4	\n\t"
+			"movq (%3, %%"REG_b"), %%xmm1	\n\t"
+			"movdqu 32(%1, %%"REG_BP", 8), %%xmm2\n\t"
+			"movdqu 48(%1, %%"REG_BP", 8), %%xmm3\n\t"
+			"punpcklbw %%xmm7, %%xmm4	\n\t"
+			"punpcklbw %%xmm7, %%xmm1	\n\t"
+			"pmaddwd %%xmm2, %%xmm4		\n\t"
+			"pmaddwd %%xmm3, %%xmm1		\n\t"
+			"movdqa %%xmm4, %%xmm2		\n\t"
+			"punpcklqdq %%xmm1, %%xmm4	\n\t"
+			"punpckhqdq %%xmm1, %%xmm2	\n\t"
+			"paddd %%xmm2, %%xmm4		\n\t"
+
+			"psrad $8, %%xmm0		\n\t"
+			"psrad $8, %%xmm4		\n\t"
+			"packssdw %%xmm4, %%xmm0	\n\t"
+			"pmaddwd %%xmm6, %%xmm0		\n\t"
+			"packssdw %%xmm0, %%xmm0	\n\t"
+			"movq %%xmm0, (%4, %%"REG_BP")	\n\t"
+			"add $8, %%"REG_BP"		\n\t"
+			" jnc 1b			\n\t"
+
+			"pop %%"REG_BP"			\n\t"
+			: "+a" (counter)
+			: "c" (filter), "d" (filterPos), "S" (src), "D" (dst)
+			: "%"REG_b SSE2_CLOBBERS
+		);
+	}
+	else
+	{
+		uint8_t *offset = src+filterSize;
+		uint8_t *offset8 = src+filterSize-7;
+		long counter= -2*dstW;
+//		filter-= counter*filterSize/2;
+		filterPos-= counter/2;
+		dst-= counter/2;
+		asm volatile(
+			"pxor %%xmm7, %%xmm7		\n\t"
+			"movq "MANGLE(w02)", %%xmm6	\n\t"
+			"punpcklqdq %%xmm6, %%xmm6	\n\t"
+			ASMALIGN16
+			"1:				\n\t"
+			"mov %2, %%"REG_c"		\n\t"
+			"movzwl (%%"REG_c", %0), %%eax	\n\t"
+			"movzwl 2(%%"REG_c", %0), %%ebx	\n\t"
+			"mov %5, %%"REG_c"		\n\t"
+			"pxor %%xmm4, %%xmm4		\n\t"
+			"pxor %%xmm5, %%xmm5		\n\t"
+			"2:				\n\t" // 8 taps
+			"movq (%%"REG_c", %%"REG_a"), %%xmm0\n\t"
+			"movq (%%"REG_c", %%"REG_b"), %%xmm2\n\t"
+			"movdqu (%1), %%xmm1		\n\t"
+			"movdqu (%1, %6), %%xmm3	\n\t"
+			"punpcklbw %%xmm7, %%xmm0	\n\t"
+			"punpcklbw %%xmm7, %%xmm2	\n\t"
+			"pmaddwd %%xmm1, %%xmm0		\n\t"
+			"pmaddwd %%xmm3, %%xmm2		\n\t"
+			"paddd %%xmm0, %%xmm4		\n\t"
+			"paddd %%xmm2, %%xmm5		\n\t"
+			"add $16, %1			\n\t"
+			"add $8, %%"REG_c"		\n\t"
+			"cmp %7, %%"REG_c"		\n\t"
+			" jb 2b				\n\t"
+			"cmp %4, %%"REG_c"		\n\t"
+			" jae 3f			\n\t" // 4 remaining taps
+			"movd (%%"REG_c", %%"REG_a"), %%xmm0\n\t"
+			"movd (%%"REG_c", %%"REG_b"), %%xmm2\n\t"
+			"movq (%1), %%xmm1		\n\t"
+			"movq (%1, %6), %%xmm3		\n\t"
+			"punpcklbw %%xmm7, %%xmm0	\n\t"
+			"punpcklbw %%xmm7, %%xmm2	\n\t"
+			"pmaddwd %%xmm1, %%xmm0		\n\t"
+			"pmaddwd %%xmm3, %%xmm2		\n\t"
+			"paddd %%xmm0, %%xmm4		\n\t"
+			"paddd %%xmm2, %%xmm5		\n\t"
+			"add $8, %1			\n\t"
+			"3:				\n\t"
+			"add %6, %1			\n\t"
+			"movdqa %%xmm4, %%xmm0		\n\t"
+			"punpcklqdq %%xmm5, %%xmm4	\n\t"
+			"punpckhqdq %%xmm5, %%xmm0	\n\t"
+			"paddd %%xmm0, %%xmm4		\n\t"
+			"psrad $8, %%xmm4		\n\t"
+			"packssdw %%xmm4, %%xmm4	\n\t"
+			"pmaddwd %%xmm6, %%xmm4		\n\t"
+			"packssdw %%xmm4, %%xmm4	\n\t"
+			"mov %3, %%"REG_a"		\n\t"
+			"movd %%xmm4, (%%"REG_a", %0)	\n\t"
+			"add $4, %0			\n\t"
+			" jnc 1b			\n\t"
+
+			: "+r" (counter), "+r" (filter)
+			: "m" (filterPos), "m" (dst), "m"(offset),
+			  "m" (src), "r" (filterSize*2), "m" (offset8)
+			: "%"REG_b, "%"REG_a, "%"REG_c SSE2_CLOBBERS
+		);
+	}
+#else
 	if(filterSize==4) // allways true for upscaling, sometimes for down too
 	{
 		long counter= -2*dstW;
@@ -2388,6 +2675,7 @@ static inline void RENAME(hScale)(int16_t *dst, int dstW, uint8_t *src, int srcW
 			: "%"REG_b, "%"REG_a, "%"REG_c
 		);
 	}
+#endif /* HAVE_SSE2 */
 #else
 #ifdef HAVE_ALTIVEC
 	hScale_altivec_real(dst, dstW, src, srcW, xInc, filter, filterPos, filterSize);
@@ -2487,10 +2775,14 @@ static inline void RENAME(hyscale)(uint16_t *dst, long dstWidth, uint8_t *src, i
 			PREFETCH" 64(%%"REG_c")		\n\t"
 
 #ifdef ARCH_X86_64
+			"mov %4, %%r8			\n\t"
 
+/* the call would overwrite the red zone below the stack pointer */
 #define FUNNY_Y_CODE \
 			"movl (%%"REG_b"), %%esi	\n\t"\
-			"call *%4			\n\t"\
+			"sub $128, %%rsp		\n\t"\
+			"call *%%r8			\n\t"\
+			"add $128, %%rsp		\n\t"\
 			"movl (%%"REG_b", %%"REG_a"), %%esi\n\t"\
 			"add %%"REG_S", %%"REG_c"	\n\t"\
 			"add %%"REG_a", %%"REG_D"	\n\t"\
@@ -2519,6 +2811,9 @@ FUNNY_Y_CODE
 			:: "m" (src), "m" (dst), "m" (mmx2Filter), "m" (mmx2FilterPos),
 			"m" (funnyYCode)
 			: "%"REG_a, "%"REG_b, "%"REG_c, "%"REG_d, "%"REG_S, "%"REG_D
+#ifdef ARCH_X86_64
+			, "%r8"
+#endif
 		);
 		for(i=dstWidth-1; (i*xInc)>>16 >=srcW-1; i--) dst[i] = src[srcW-1]*128;
 	}
@@ -2642,6 +2937,12 @@ inline static void RENAME(hcscale)(uint16_t *dst, long dstWidth, uint8_t *src1,
     {
     	return;
     }
+    if(src1 == formatConvBuffer)
+    {
+	// the fast bilinear scaler reads one sample past the end of the line
+	formatConvBuffer[srcW]= formatConvBuffer[srcW-1];
+	formatConvBuffer[2048+srcW]= formatConvBuffer[2048+srcW-1];
+    }
 
 #ifdef HAVE_MMX
 	// use the new MMX scaler if the mmx2 can't be used (its faster than the x86asm one)
@@ -2672,10 +2973,14 @@ inline static void RENAME(hcscale)(uint16_t *dst, long dstWidth, uint8_t *src1,
 			PREFETCH" 64(%%"REG_c")		\n\t"
 
 #ifdef ARCH_X86_64
+			"mov %4, %%r8			\n\t"
 
+/* the call would overwrite the red zone below the stack pointer */
 #define FUNNY_UV_CODE \
 			"movl (%%"REG_b"), %%esi	\n\t"\
-			"call *%4			\n\t"\
+			"sub $128, %%rsp		\n\t"\
+			"call *%%r8			\n\t"\
+			"add $128, %%rsp		\n\t"\
 			"movl (%%"REG_b", %%"REG_a"), %%esi\n\t"\
 			"add %%"REG_S", %%"REG_c"	\n\t"\
 			"add %%"REG_a", %%"REG_D"	\n\t"\
@@ -2712,6 +3017,9 @@ FUNNY_UV_CODE
 			:: "m" (src1), "m" (dst), "m" (mmx2Filter), "m" (mmx2FilterPos),
 			"m" (funnyUVCode), "m" (src2)
 			: "%"REG_a, "%"REG_b, "%"REG_c, "%"REG_d, "%"REG_S, "%"REG_D
+#ifdef ARCH_X86_64
+			, "%r8"
+#endif
 		);
 		for(i=dstWidth-1; (i*xInc)>>16 >=srcW-1; i--)
 		{
@@ -2797,6 +3105,7 @@ static int RENAME(swScale)(SwsContext *c, uint8_t* src[], int srcStride[], int s
 	const int srcW= c->srcW;
 	const int dstW= c->dstW;
 	const int dstH= c->dstH;
+	const int dstYEnd= c->dstYEnd;
 	const int chrDstW= c->chrDstW;
 	const int chrSrcW= c->chrSrcW;
 	const int lumXInc= c->lumXInc;
@@ -2880,14 +3189,14 @@ i--;
 	if(srcSliceY ==0){
 		lumBufIndex=0;
 		chrBufIndex=0;
-		dstY=0;	
+		dstY= c->dstYStart;
 		lastInLumBuf= -1;
 		lastInChrBuf= -1;
 	}
 
 	lastDstY= dstY;
 
-	for(;dstY < dstH; dstY++){
+	for(;dstY < dstYEnd; dstY++){
 		unsigned char *dest =dst[0]+dstStride[0]*dstY;
 		const int chrDstY= dstY>>c->chrDstVSubSample;
 		unsigned char *uDest=dst[1]+dstStride[1]*chrDstY;
@@ -3020,14 +3329,14 @@ i--;
             }else{
 		for(i=0; i<vLumFilterSize; i++)
 		{
-			lumMmxFilter[4*i+0]= (int32_t)lumSrcPtr[i];
+			*(int16_t**)(lumMmxFilter+4*i)= lumSrcPtr[i];
 			lumMmxFilter[4*i+2]= 
 			lumMmxFilter[4*i+3]= 
 				((uint16_t)vLumFilter[dstY*vLumFilterSize + i])*0x10001;
 		}
 		for(i=0; i<vChrFilterSize; i++)
 		{
-			chrMmxFilter[4*i+0]= (int32_t)chrSrcPtr[i];
+			*(int16_t**)(chrMmxFilter+4*i)= chrSrcPtr[i];
 			chrMmxFilter[4*i+2]= 
 			chrMmxFilter[4*i+3]= 
 				((uint16_t)vChrFilter[chrDstY*vChrFilterSize + i])*0x10001;
@@ -3048,8 +3357,8 @@ i--;
 			if((dstY&chrSkipMask) || isGray(dstFormat)) uDest=vDest= NULL; //FIXME split functions in lumi / chromi
 			if(vLumFilterSize == 1 && vChrFilterSize == 1) // Unscaled YV12
 			{
-				int16_t *lumBuf = lumPixBuf[0];
-				int16_t *chrBuf= chrPixBuf[0];
+				int16_t *lumBuf = lumSrcPtr[0];
+				int16_t *chrBuf= chrSrcPtr[0];
 				RENAME(yuv2yuv1)(lumBuf, chrBuf, dest, uDest, vDest, dstW, chrDstW);
 			}
 			else //General YV12
@@ -180,6 +180,13 @@ uint64_t __attribute__((aligned(8))) dither8[2]={
 	0x0602060206020602LL,
 	0x0004000400040004LL,};
 
+/* the masks above for the SSE2 converters */
+static const uint64_t attribute_used __attribute__((aligned(16))) sse2_redmask[2]= {0xf8f8f8f8f8f8f8f8ULL, 0xf8f8f8f8f8f8f8f8ULL};
+static const uint64_t attribute_used __attribute__((aligned(16))) sse2_grnmask[2]= {0xfcfcfcfcfcfcfcfcULL, 0xfcfcfcfcfcfcfcfcULL};
+static const uint64_t attribute_used __attribute__((aligned(16))) sse2_M24A[2]=    {0x00FF0000FF0000FFULL, 0x00FF0000FF0000FFULL};
+static const uint64_t attribute_used __attribute__((aligned(16))) sse2_M24B[2]=    {0xFF0000FF0000FF00ULL, 0xFF0000FF0000FF00ULL};
+static const uint64_t attribute_used __attribute__((aligned(16))) sse2_M24C[2]=    {0x0000FF0000FF0000ULL, 0x0000FF0000FF0000ULL};
+
 #undef HAVE_MMX
 
 //MMX versions
@@ -198,6 +205,15 @@ uint64_t __attribute__((aligned(8))) dither8[2]={
 #define RENAME(a) a ## _MMX2
 #include "yuv2rgb_template.c"
 
+//SSE2 versions
+#undef RENAME
+#define HAVE_MMX
+#define HAVE_MMX2
+#define HAVE_SSE2
+#define RENAME(a) a ## _SSE2
+#include "yuv2rgb_template.c"
+#undef HAVE_SSE2
+
 #endif /* defined(ARCH_X86) || defined(ARCH_X86_64) */
 
 const int32_t Inverse_Table_6_9[8][4] = {
@@ -579,6 +595,16 @@ EPILOG(1)
 SwsFunc yuv2rgb_get_func_ptr (SwsContext *c)
 {
 #if defined(HAVE_MMX2) || defined(HAVE_MMX)
+    if(c->flags & SWS_CPU_CAPS_SSE2){
+	switch(c->dstFormat){
+	case IMGFMT_RGB32: return yuv420_rgb32_rgb_SSE2;
+	case IMGFMT_BGR32: return yuv420_rgb32_SSE2;
+	case IMGFMT_RGB24: return yuv420_rgb24_rgb_SSE2;
+	case IMGFMT_BGR24: return yuv420_rgb24_SSE2;
+	case IMGFMT_BGR16: return yuv420_rgb16_SSE2;
+	case IMGFMT_BGR15: return yuv420_rgb15_SSE2;
+	}
+    }
     if(c->flags & SWS_CPU_CAPS_MMX2){
 	switch(c->dstFormat){
 	case IMGFMT_BGR32: return yuv420_rgb32_MMX2;
@@ -47,6 +47,490 @@
 #define SFENCE "/nop"
 #endif
 
+#ifdef HAVE_SSE2
+
+/* gcc only knows the xmm registers if it may use SSE itself */
+#undef SSE2_CLOBBERS
+#ifdef __SSE__
+#define SSE2_CLOBBERS , "%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7"
+#else
+#define SSE2_CLOBBERS
+#endif
+
+/* The SSE2 converters do the same arithmetic as the MMX ones on 16 pixels
+   per iteration, followed by 8 pixels if the width is not a multiple of 16,
+   so that they write exactly what the MMX code writes. */
+
+#define SSE2_LOOP_START \
+		     "add $8, %0			\n\t"\
+		     " jg 2f				\n\t"\
+		    "1:					\n\t"\
+		     "movq -8 (%2, %0), %%xmm0;" /* Load 8 Cb */\
+		     "movq -8 (%3, %0), %%xmm1;" /* Load 8 Cr */\
+		     "movdqu -16 (%5, %0, 2), %%xmm6;" /* Load 16 Y */\
+
+#define SSE2_LOOP_END \
+		     "add $8, %0			\n\t"\
+		     " jle 1b				\n\t"\
+		    "2:					\n\t"\
+		     "cmp $8, %0			\n\t"\
+		     " je 3f				\n\t"\
+		     "movd -8 (%2, %0), %%xmm0;" /* Load 4 Cb */\
+		     "movd -8 (%3, %0), %%xmm1;" /* Load 4 Cr */\
+		     "movq -16 (%5, %0, 2), %%xmm6;" /* Load 8 Y */\
+
+#define YUV2RGB_SSE2 \
+		     /* same as YUV2RGB, the even luma is taken by shifting instead \
+			of masking, the result is xmm0 -> B, xmm1 -> R, xmm2 -> G */\
+		     "pxor %%xmm4, %%xmm4;"\
+		     "punpcklbw %%xmm4, %%xmm0;" /* scatter 8 Cb */\
+		     "punpcklbw %%xmm4, %%xmm1;" /* scatter 8 Cr */\
+\
+		     "psllw $3, %%xmm0;"\
+		     "psllw $3, %%xmm1;"\
+\
+		     "psubsw "SSE2_U_OFFSET"(%4), %%xmm0;"\
+		     "psubsw "SSE2_V_OFFSET"(%4), %%xmm1;"\
+\
+		     "movdqa %%xmm0, %%xmm2;"\
+		     "movdqa %%xmm1, %%xmm3;"\
+\
+		     "pmulhw "SSE2_UG_COEFF"(%4), %%xmm2;"\
+		     "pmulhw "SSE2_VG_COEFF"(%4), %%xmm3;"\
+\
+		     "pmulhw "SSE2_UB_COEFF"(%4), %%xmm0;"\
+		     "pmulhw "SSE2_VR_COEFF"(%4), %%xmm1;"\
+\
+		     "paddsw %%xmm3, %%xmm2;" /* Cgreen */\
+\
+		     "movdqa %%xmm6, %%xmm7;"\
+		     "psllw $8, %%xmm6;"\
+		     "psrlw $8, %%xmm7;" /* Y odd */\
+\
+		     "psrlw $5, %%xmm6;" /* Y even, promoted */\
+		     "psllw $3, %%xmm7;" /* Y odd, promoted */\
+\
+		     "psubw "SSE2_Y_OFFSET"(%4), %%xmm6;"\
+		     "psubw "SSE2_Y_OFFSET"(%4), %%xmm7;"\
+\
+		     "pmulhw "SSE2_Y_COEFF"(%4), %%xmm6;"\
+		     "pmulhw "SSE2_Y_COEFF"(%4), %%xmm7;"\
+\
+		     "movdqa %%xmm0, %%xmm3;"\
+		     "movdqa %%xmm1, %%xmm4;"\
+		     "movdqa %%xmm2, %%xmm5;"\
+\
+		     "paddsw %%xmm6, %%xmm0;" /* B even */\
+		     "paddsw %%xmm7, %%xmm3;" /* B odd */\
+\
+		     "paddsw %%xmm6, %%xmm1;" /* R even */\
+		     "paddsw %%xmm7, %%xmm4;" /* R odd */\
+\
+		     "paddsw %%xmm6, %%xmm2;" /* G even */\
+		     "paddsw %%xmm7, %%xmm5;" /* G odd */\
+\
+		     "packuswb %%xmm0, %%xmm0;"\
+		     "packuswb %%xmm1, %%xmm1;"\
+		     "packuswb %%xmm2, %%xmm2;"\
+\
+		     "packuswb %%xmm3, %%xmm3;"\
+		     "packuswb %%xmm4, %%xmm4;"\
+		     "packuswb %%xmm5, %%xmm5;"\
+\
+		     "punpcklbw %%xmm3, %%xmm0;" /* B15 - B0 */\
+		     "punpcklbw %%xmm4, %%xmm1;" /* R15 - R0 */\
+		     "punpcklbw %%xmm5, %%xmm2;" /* G15 - G0 */\
+
+/* pixel 0-7 of rgb16, the dither is added to pixel 0-15 */
+#define RGB16_SSE2_LOW \
+		     "paddusb "SSE2_B_DITHER"(%4), %%xmm0;"\
+		     "paddusb "SSE2_G_DITHER"(%4), %%xmm2;"\
+		     "paddusb "SSE2_R_DITHER"(%4), %%xmm1;"\
+\
+		     "pand "MANGLE(sse2_redmask)", %%xmm0;"\
+		     "pand "MANGLE(sse2_grnmask)", %%xmm2;"\
+		     "pand "MANGLE(sse2_redmask)", %%xmm1;"\
+\
+		     "psrlw $3, %%xmm0;"\
+		     "pxor %%xmm4, %%xmm4;"\
+\
+		     "movdqa %%xmm0, %%xmm5;"\
+		     "movdqa %%xmm2, %%xmm7;"\
+\
+		     "punpcklbw %%xmm4, %%xmm2;"\
+		     "punpcklbw %%xmm1, %%xmm0;"\
+\
+		     "psllw $3, %%xmm2;"\
+		     "por %%xmm2, %%xmm0;"\
+		     "movdqu %%xmm0, (%1);" /* store pixel 0-7 */\
+
+#define RGB16_SSE2_HIGH \
+		     "punpckhbw %%xmm4, %%xmm7;"\
+		     "punpckhbw %%xmm1, %%xmm5;"\
+\
+		     "psllw $3, %%xmm7;"\
+		     "por %%xmm7, %%xmm5;"\
+		     "movdqu %%xmm5, 16 (%1);" /* store pixel 8-15 */\
+
+#define RGB15_SSE2_LOW \
+		     "paddusb "SSE2_B_DITHER"(%4), %%xmm0;"\
+		     "paddusb "SSE2_G_DITHER"(%4), %%xmm2;"\
+		     "paddusb "SSE2_R_DITHER"(%4), %%xmm1;"\
+\
+		     "pand "MANGLE(sse2_redmask)", %%xmm0;"\
+		     "pand "MANGLE(sse2_redmask)", %%xmm2;"\
+		     "pand "MANGLE(sse2_redmask)", %%xmm1;"\
+\
+		     "psrlw $3, %%xmm0;"\
+		     "psrlw $1, %%xmm1;"\
+		     "pxor %%xmm4, %%xmm4;"\
+\
+		     "movdqa %%xmm0, %%xmm5;"\
+		     "movdqa %%xmm2, %%xmm7;"\
+\
+		     "punpcklbw %%xmm4, %%xmm2;"\
+		     "punpcklbw %%xmm1, %%xmm0;"\
+\
+		     "psllw $2, %%xmm2;"\
+		     "por %%xmm2, %%xmm0;"\
+		     "movdqu %%xmm0, (%1);" /* store pixel 0-7 */\
+
+#define RGB15_SSE2_HIGH \
+		     "punpckhbw %%xmm4, %%xmm7;"\
+		     "punpckhbw %%xmm1, %%xmm5;"\
+\
+		     "psllw $2, %%xmm7;"\
+		     "por %%xmm7, %%xmm5;"\
+		     "movdqu %%xmm5, 16 (%1);" /* store pixel 8-15 */\
+
+/* pshufw on both quadwords */
+#define PSHUFW_SSE2(imm, src, dst) \
+		     "pshuflw $" #imm ", %%xmm" #src ", %%xmm" #dst ";"\
+		     "pshufhw $" #imm ", %%xmm" #dst ", %%xmm" #dst ";"\
+
+/* The MMX2 rgb24 packing of pixel 0-7 and 8-15 in the low and high
+   quadwords, b is the register of the first byte of a pixel, r of the
+   third; each step leaves the next 8 bytes of both halves in xmm6. */
+#define RGB24_SSE2_Q0(b, r) \
+		     "movdqa "MANGLE(sse2_M24A)", %%xmm4;"\
+		     "movdqa "MANGLE(sse2_M24C)", %%xmm7;"\
+		     PSHUFW_SSE2(0x50, b, 5) /* B3 B2 B3 B2  B1 B0 B1 B0 */\
+		     PSHUFW_SSE2(0x50, 2, 3) /* G3 G2 G3 G2  G1 G0 G1 G0 */\
+		     PSHUFW_SSE2(0x00, r, 6) /* R1 R0 R1 R0  R1 R0 R1 R0 */\
+\
+		     "pand %%xmm4, %%xmm5;"\
+		     "pand %%xmm4, %%xmm3;"\
+		     "pand %%xmm7, %%xmm6;"\
+\
+		     "psllq $8, %%xmm3;"\
+		     "por %%xmm5, %%xmm6;"\
+		     "por %%xmm3, %%xmm6;"\
+
+#define RGB24_SSE2_Q1(b, r) \
+		     "psrlq $8, %%xmm2;" /* 00 G7 G6 G5  G4 G3 G2 G1 */\
+		     PSHUFW_SSE2(0xA5, b, 5) /* B5 B4 B5 B4  B3 B2 B3 B2 */\
+		     PSHUFW_SSE2(0x55, 2, 3) /* G4 G3 G4 G3  G4 G3 G4 G3 */\
+		     PSHUFW_SSE2(0xA5, r, 6) /* R5 R4 R5 R4  R3 R2 R3 R2 */\
+\
+		     "pand "MANGLE(sse2_M24B)", %%xmm5;"\
+		     "pand %%xmm7, %%xmm3;"\
+		     "pand %%xmm4, %%xmm6;"\
+\
+		     "por %%xmm5, %%xmm3;"\
+		     "por %%xmm3, %%xmm6;"\
+
+#define RGB24_SSE2_Q2(b, r) \
+		     PSHUFW_SSE2(0xFF, b, 5) /* B7 B6 B7 B6  B7 B6 B6 B7 */\
+		     PSHUFW_SSE2(0xFA, 2, 3) /* 00 G7 00 G7  G6 G5 G6 G5 */\
+		     PSHUFW_SSE2(0xFA, r, 6) /* R7 R6 R7 R6  R5 R4 R5 R4 */\
+\
+		     "pand %%xmm7, %%xmm5;"\
+		     "pand %%xmm4, %%xmm3;"\
+		     "pand "MANGLE(sse2_M24B)", %%xmm6;"\
+\
+		     "por %%xmm5, %%xmm3;"\
+		     "por %%xmm3, %%xmm6;"\
+
+#define RGB24_SSE2(b, r) \
+		     RGB24_SSE2_Q0(b, r)\
+		     "movq %%xmm6, (%1);"\
+		     "movhps %%xmm6, 24 (%1);"\
+		     RGB24_SSE2_Q1(b, r)\
+		     "movq %%xmm6, 8 (%1);"\
+		     "movhps %%xmm6, 32 (%1);"\
+		     RGB24_SSE2_Q2(b, r)\
+		     "movq %%xmm6, 16 (%1);"\
+		     "movhps %%xmm6, 40 (%1);"\
+
+#define RGB24_SSE2_LOW(b, r) \
+		     RGB24_SSE2_Q0(b, r)\
+		     "movq %%xmm6, (%1);"\
+		     RGB24_SSE2_Q1(b, r)\
+		     "movq %%xmm6, 8 (%1);"\
+		     RGB24_SSE2_Q2(b, r)\
+		     "movq %%xmm6, 16 (%1);"\
+
+/* pixel 0-7 of rgb32 with a zero fourth byte, b is the register of the
+   first byte of a pixel, r of the third */
+#define RGB32_SSE2_LOW(b, r) \
+		     "pxor %%xmm3, %%xmm3;"\
+		     "movdqa %%xmm" #b ", %%xmm6;"\
+		     "movdqa %%xmm" #r ", %%xmm7;"\
+		     "punpcklbw %%xmm2, %%xmm6;" /* G7 B7 ... G0 B0 */\
+		     "punpcklbw %%xmm3, %%xmm7;" /* 00 R7 ... 00 R0 */\
+		     "movdqa %%xmm6, %%xmm5;"\
+		     "punpcklwd %%xmm7, %%xmm6;" /* ARGB3 - ARGB0 */\
+		     "punpckhwd %%xmm7, %%xmm5;" /* ARGB7 - ARGB4 */\
+		     "movdqu %%xmm6, (%1);"\
+		     "movdqu %%xmm5, 16 (%1);"\
+
+#define RGB32_SSE2_HIGH(b, r) \
+		     "punpckhbw %%xmm2, %%xmm" #b ";" /* G15 B15 ... G8 B8 */\
+		     "punpckhbw %%xmm3, %%xmm" #r ";" /* 00 R15 ... 00 R8 */\
+		     "movdqa %%xmm" #b ", %%xmm5;"\
+		     "punpcklwd %%xmm" #r ", %%xmm" #b ";" /* ARGB11 - ARGB8 */\
+		     "punpckhwd %%xmm" #r ", %%xmm5;" /* ARGB15 - ARGB12 */\
+		     "movdqu %%xmm" #b ", 32 (%1);"\
+		     "movdqu %%xmm5, 48 (%1);"\
+
+static inline void RENAME(setDither)(SwsContext *c, uint64_t b, uint64_t g, uint64_t r){
+    c->sse2Coeffs[8][0] = c->sse2Coeffs[8][1] = b;
+    c->sse2Coeffs[9][0] = c->sse2Coeffs[9][1] = g;
+    c->sse2Coeffs[10][0]= c->sse2Coeffs[10][1]= r;
+}
+
+static inline int RENAME(yuv420_rgb16)(SwsContext *c, uint8_t* src[], int srcStride[], int srcSliceY,
+             int srcSliceH, uint8_t* dst[], int dstStride[]){
+    int y, h_size;
+
+    if(c->srcFormat == IMGFMT_422P){
+	srcStride[1] *= 2;
+	srcStride[2] *= 2;
+    }
+
+    h_size= (c->dstW+7)&~7;
+    if(h_size*2 > dstStride[0]) h_size-=8;
+
+    for (y= 0; y<srcSliceH; y++ ) {
+	uint8_t *_image = dst[0] + (y+srcSliceY)*dstStride[0];
+	uint8_t *_py = src[0] + y*srcStride[0];
+	uint8_t *_pu = src[1] + (y>>1)*srcStride[1];
+	uint8_t *_pv = src[2] + (y>>1)*srcStride[2];
+	long index= -h_size/2;
+
+	RENAME(setDither)(c, dither8[y&1], dither4[y&1], dither8[(y+1)&1]);
+	    __asm__ __volatile__ (
+SSE2_LOOP_START
+YUV2RGB_SSE2
+RGB16_SSE2_LOW
+RGB16_SSE2_HIGH
+		     "add $32, %1			\n\t"
+SSE2_LOOP_END
+YUV2RGB_SSE2
+RGB16_SSE2_LOW
+		    "3:					\n\t"
+		     : "+r" (index), "+r" (_image)
+		     : "r" (_pu - index), "r" (_pv - index), "r"(c->sse2Coeffs), "r" (_py - 2*index)
+		     : "memory" SSE2_CLOBBERS
+		     );
+    }
+
+    return srcSliceH;
+}
+
+static inline int RENAME(yuv420_rgb15)(SwsContext *c, uint8_t* src[], int srcStride[], int srcSliceY,
+             int srcSliceH, uint8_t* dst[], int dstStride[]){
+    int y, h_size;
+
+    if(c->srcFormat == IMGFMT_422P){
+	srcStride[1] *= 2;
+	srcStride[2] *= 2;
+    }
+
+    h_size= (c->dstW+7)&~7;
+    if(h_size*2 > dstStride[0]) h_size-=8;
+
+    for (y= 0; y<srcSliceH; y++ ) {
+	uint8_t *_image = dst[0] + (y+srcSliceY)*dstStride[0];
+	uint8_t *_py = src[0] + y*srcStride[0];
+	uint8_t *_pu = src[1] + (y>>1)*srcStride[1];
+	uint8_t *_pv = src[2] + (y>>1)*srcStride[2];
+	long index= -h_size/2;
+
+	RENAME(setDither)(c, dither8[y&1], dither8[y&1], dither8[(y+1)&1]);
+	    __asm__ __volatile__ (
+SSE2_LOOP_START
+YUV2RGB_SSE2
+RGB15_SSE2_LOW
+RGB15_SSE2_HIGH
+		     "add $32, %1			\n\t"
+SSE2_LOOP_END
+YUV2RGB_SSE2
+RGB15_SSE2_LOW
+		    "3:					\n\t"
+		     : "+r" (index), "+r" (_image)
+		     : "r" (_pu - index), "r" (_pv - index), "r"(c->sse2Coeffs), "r" (_py - 2*index)
+		     : "memory" SSE2_CLOBBERS
+		     );
+    }
+
+    return srcSliceH;
+}
+
+static inline int RENAME(yuv420_rgb24)(SwsContext *c, uint8_t* src[], int srcStride[], int srcSliceY,
+             int srcSliceH, uint8_t* dst[], int dstStride[]){
+    int y, h_size;
+
+    if(c->srcFormat == IMGFMT_422P){
+	srcStride[1] *= 2;
+	srcStride[2] *= 2;
+    }
+
+    h_size= (c->dstW+7)&~7;
+    if(h_size*3 > dstStride[0]) h_size-=8;
+
+    for (y= 0; y<srcSliceH; y++ ) {
+	uint8_t *_image = dst[0] + (y+srcSliceY)*dstStride[0];
+	uint8_t *_py = src[0] + y*srcStride[0];
+	uint8_t *_pu = src[1] + (y>>1)*srcStride[1];
+	uint8_t *_pv = src[2] + (y>>1)*srcStride[2];
+	long index= -h_size/2;
+
+	    __asm__ __volatile__ (
+SSE2_LOOP_START
+YUV2RGB_SSE2
+RGB24_SSE2(0, 1)
+		     "add $48, %1			\n\t"
+SSE2_LOOP_END
+YUV2RGB_SSE2
+RGB24_SSE2_LOW(0, 1)
+		    "3:					\n\t"
+		     : "+r" (index), "+r" (_image)
+		     : "r" (_pu - index), "r" (_pv - index), "r"(c->sse2Coeffs), "r" (_py - 2*index)
+		     : "memory" SSE2_CLOBBERS
+		     );
+    }
+
+    return srcSliceH;
+}
+
+/* same for IMGFMT_RGB24, red first */
+static inline int RENAME(yuv420_rgb24_rgb)(SwsContext *c, uint8_t* src[], int srcStride[], int srcSliceY,
+             int srcSliceH, uint8_t* dst[], int dstStride[]){
+    int y, h_size;
+
+    if(c->srcFormat == IMGFMT_422P){
+	srcStride[1] *= 2;
+	srcStride[2] *= 2;
+    }
+
+    h_size= (c->dstW+7)&~7;
+    if(h_size*3 > dstStride[0]) h_size-=8;
+
+    for (y= 0; y<srcSliceH; y++ ) {
+	uint8_t *_image = dst[0] + (y+srcSliceY)*dstStride[0];
+	uint8_t *_py = src[0] + y*srcStride[0];
+	uint8_t *_pu = src[1] + (y>>1)*srcStride[1];
+	uint8_t *_pv = src[2] + (y>>1)*srcStride[2];
+	long index= -h_size/2;
+
+	    __asm__ __volatile__ (
+SSE2_LOOP_START
+YUV2RGB_SSE2
+RGB24_SSE2(1, 0)
+		     "add $48, %1			\n\t"
+SSE2_LOOP_END
+YUV2RGB_SSE2
+RGB24_SSE2_LOW(1, 0)
+		    "3:					\n\t"
+		     : "+r" (index), "+r" (_image)
+		     : "r" (_pu - index), "r" (_pv - index), "r"(c->sse2Coeffs), "r" (_py - 2*index)
+		     : "memory" SSE2_CLOBBERS
+		     );
+    }
+
+    return srcSliceH;
+}
+
+static inline int RENAME(yuv420_rgb32)(SwsContext *c, uint8_t* src[], int srcStride[], int srcSliceY,
+             int srcSliceH, uint8_t* dst[], int dstStride[]){
+    int y, h_size;
+
+    if(c->srcFormat == IMGFMT_422P){
+	srcStride[1] *= 2;
+	srcStride[2] *= 2;
+    }
+
+    h_size= (c->dstW+7)&~7;
+    if(h_size*4 > dstStride[0]) h_size-=8;
+
+    for (y= 0; y<srcSliceH; y++ ) {
+	uint8_t *_image = dst[0] + (y+srcSliceY)*dstStride[0];
+	uint8_t *_py = src[0] + y*srcStride[0];
+	uint8_t *_pu = src[1] + (y>>1)*srcStride[1];
+	uint8_t *_pv = src[2] + (y>>1)*srcStride[2];
+	long index= -h_size/2;
+
+	    __asm__ __volatile__ (
+SSE2_LOOP_START
+YUV2RGB_SSE2
+RGB32_SSE2_LOW(0, 1)
+RGB32_SSE2_HIGH(0, 1)
+		     "add $64, %1			\n\t"
+SSE2_LOOP_END
+YUV2RGB_SSE2
+RGB32_SSE2_LOW(0, 1)
+		    "3:					\n\t"
+		     : "+r" (index), "+r" (_image)
+		     : "r" (_pu - index), "r" (_pv - index), "r"(c->sse2Coeffs), "r" (_py - 2*index)
+		     : "memory" SSE2_CLOBBERS
+		     );
+    }
+
+    return srcSliceH;
+}
+
+/* same for IMGFMT_RGB32, red first */
+static inline int RENAME(yuv420_rgb32_rgb)(SwsContext *c, uint8_t* src[], int srcStride[], int srcSliceY,
+             int srcSliceH, uint8_t* dst[], int dstStride[]){
+    int y, h_size;
+
+    if(c->srcFormat == IMGFMT_422P){
+	srcStride[1] *= 2;
+	srcStride[2] *= 2;
+    }
+
+    h_size= (c->dstW+7)&~7;
+    if(h_size*4 > dstStride[0]) h_size-=8;
+
+    for (y= 0; y<srcSliceH; y++ ) {
+	uint8_t *_image = dst[0] + (y+srcSliceY)*dstStride[0];
+	uint8_t *_py = src[0] + y*srcStride[0];
+	uint8_t *_pu = src[1] + (y>>1)*srcStride[1];
+	uint8_t *_pv = src[2] + (y>>1)*srcStride[2];
+	long index= -h_size/2;
+
+	    __asm__ __volatile__ (
+SSE2_LOOP_START
+YUV2RGB_SSE2
+RGB32_SSE2_LOW(1, 0)
+RGB32_SSE2_HIGH(1, 0)
+		     "add $64, %1			\n\t"
+SSE2_LOOP_END
+YUV2RGB_SSE2
+RGB32_SSE2_LOW(1, 0)
+		    "3:					\n\t"
+		     : "+r" (index), "+r" (_image)
+		     : "r" (_pu - index), "r" (_pv - index), "r"(c->sse2Coeffs), "r" (_py - 2*index)
+		     : "memory" SSE2_CLOBBERS
+		     );
+    }
+
+    return srcSliceH;
+}
+
+#else /* HAVE_SSE2 */
+
 #define YUV2RGB \
 		     /* Do the multiply part of the conversion for even and odd pixels,
 			register usage:
@@ -538,3 +1022,5 @@ YUV2RGB
     __asm__ __volatile__ (EMMS);
     return srcSliceH;
 }
+
+#endif /* HAVE_SSE2 */
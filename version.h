@@ -0,0 +1 @@
+#define FFMPEG_VERSION "SVN-rUNKNOWN"